@@ -0,0 +1,674 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "engine.hpp"
+#include "../render/commandlist.hpp"
+#include "../io/encoders.hpp"
+#include "../utils/utils.hpp"
+
+
+// Benchmark cases, in the order they run. Each one prepares the frame it measures,
+// "lights" replaces the scene lights so it stays last
+const Engine::BenchCase Engine::BENCH_CASES[] = {
+	{"depth",     &Engine::benchDepth},
+	{"prepass",   &Engine::benchPrepass},
+	{"views",     &Engine::benchViews},
+	{"overlay",   &Engine::benchOverlay},
+	{"wireframe", &Engine::benchWireframe},
+	{"shapes",    &Engine::benchShapes},
+	{"encoders",  &Engine::benchEncoders},
+	{"formats",   &Engine::benchFormats},
+	{"textures",  &Engine::benchTextures},
+	{"msaa",      &Engine::benchMSAA},
+	{"lights",    &Engine::benchLights},
+};
+
+
+// Renders `frames` frames of the scene with every case of BENCH_CASES, without presenting, or with the case named `only`
+void Engine::benchmark(int frames, const char *only) {
+	const BenchCase *selected = nullptr;
+	if (only) {
+		for (const BenchCase &bench : BENCH_CASES) {
+			if (std::string(only) == bench.name) selected = &bench;
+		}
+
+		if ( !selected ) {
+			std::cerr << "Unknown benchmark " << only << ", expected one of:";
+			for (const BenchCase &bench : BENCH_CASES) std::cerr << " " << bench.name;
+			std::cerr << std::endl;
+			return;
+		}
+	}
+
+	if ( !this->loadScene() ) return;
+	this->loadTextures();
+
+	// WIREFRAME only builds the edge list here, the wireframe is measured on its own, like the debug views
+	enSettings.WIREFRAME = false;
+	enDebugView = DebugView::NONE;
+
+	Frame &frame = enFrames[0];
+	frame.residentTextures = enTextureCount;
+	this->bindScene(frame, true);
+
+	std::cout << "\nBenchmark: " << enScene.name << ", " << frame.drawTriCount << " triangles, "
+		<< enSettings.W << "x" << enSettings.H << ", " << frames << " frames, "
+		<< enPool.threadCount() << " threads, light culling "
+		<< (enSettings.LIGHT_CULLING ? "on" : "off") << "\n";
+
+	for (const BenchCase &bench : BENCH_CASES) {
+		if (selected && selected != &bench) continue;
+		(this->*bench.run)(frame, frames);
+	}
+}
+
+// Geometry, shadow maps and light grid of a frame, what the raster side of a case draws with
+void Engine::benchPrepare(Frame &frame) {
+	this->transform(frame);
+	this->sortGeometry(frame);
+	this->project(frame);
+	this->shadowPass(frame);
+	frame.lightGrid.build(frame.lights, frame.lightCount, nullptr, frame.projection, enSettings.LIGHT_CULLING, enPool);
+}
+
+// Depth only path against the full colour path, over the same opaque triangles
+void Engine::benchDepth(Frame &frame, int frames) {
+	Surface &surface = frame.surface;
+	ShadingContext ctx = { frame.lights, &frame.lightGrid, frame.shadowMaps, enSettings.SHADOW_PCF, enSettings.SHADOW_BIAS };
+	this->benchPrepare(frame);
+
+	uint64_t tDepthSum = 0, tColorSum = 0;
+
+	for (int i=0; i<frames; i++) {
+		std::fill(frame.depth, frame.depth + surface.surfSize, 0.f);
+		TIME_PT tPt1 = TIME_NOW();
+		this->depthPass(frame);
+		TIME_PT tPt2 = TIME_NOW();
+
+		std::fill(frame.depth, frame.depth + surface.surfSize, 0.f);
+		TIME_PT tPt3 = TIME_NOW();
+		this->drawGeometry(frame, BlendMode::OPAQUE, DepthMode::TEST_WRITE, 1, ctx);
+		TIME_PT tPt4 = TIME_NOW();
+
+		tDepthSum += TIME_DUR(tPt2, tPt1);
+		tColorSum += TIME_DUR(tPt4, tPt3);
+	}
+
+	std::cout
+		<< "\n Depth only " << tDepthSum/1E3F/frames << " ms"
+		<< "\tColour " << tColorSum/1E3F/frames << " ms\n";
+}
+
+// Depth pre-pass against forward shading of the same frame, a pixel the pre-pass wrote
+// and its EQUAL test then rejected is left black
+void Engine::benchPrepass(Frame &frame, int) {
+	Settings saved = enSettings;
+	Surface &surface = frame.surface;
+	std::vector<uint8_t> images[2];
+
+	enSettings.VISIBILITY_BUFFER = false;
+	this->transform(frame);
+	this->sortGeometry(frame);
+	this->project(frame);
+	this->shadowPass(frame);
+
+	for (int i=0; i<2; i++) {
+		enSettings.DEPTH_PREPASS = (i == 1);
+		this->rasterize(frame);
+
+		images[i].resize( (size_t) 3*surface.surfSize );
+		surface.toRGB8(images[i].data());
+	}
+
+	// Triangles meeting within the bias of EQUAL may swap which one wins a pixel, a hole is
+	// a pixel only forward shading covered
+	int differing = 0, holes = 0;
+	for (int i=0; i<surface.surfSize; i++) {
+		const uint8_t *a = &images[0][3*i];
+		const uint8_t *b = &images[1][3*i];
+
+		if (std::memcmp(a, b, 3) == 0) continue;
+		differing++;
+		if (b[0] == 0 && b[1] == 0 && b[2] == 0) holes++;
+	}
+
+	std::cout << " Pre-pass against forward " << differing << " of " << surface.surfSize << " pixels differ, "
+		<< holes << " holes" << (holes == 0 ? "" : " FAILED") << "\n";
+
+	enSettings = saved;
+}
+
+// Heatmaps of the pipeline statistics
+void Engine::benchViews(Frame &frame, int frames) {
+	ShadingContext ctx = { frame.lights, &frame.lightGrid, frame.shadowMaps, enSettings.SHADOW_PCF, enSettings.SHADOW_BIAS };
+	this->benchPrepare(frame);
+
+	const std::pair<const char *, DebugView> views[] = {
+		{"Overdraw", DebugView::OVERDRAW},
+		{"Density", DebugView::DENSITY},
+		{"Tile cost", DebugView::TILE_COST},
+	};
+
+	std::cout << " Debug views";
+	for (const auto &[name, view] : views) {
+		enDebugView = view;
+		uint64_t tSum = 0;
+
+		for (int i=0; i<frames; i++) {
+			TIME_PT tPt1 = TIME_NOW();
+			this->debugView(frame, ctx);
+			tSum += TIME_DUR(TIME_NOW(), tPt1);
+		}
+
+		std::cout << "\t" << name << " " << tSum/1E3F/frames << " ms";
+	}
+	std::cout << "\n";
+
+	enDebugView = DebugView::NONE;
+}
+
+// Debug overlay with a marker and a normal on every vertex
+void Engine::benchOverlay(Frame &frame, int frames) {
+	Settings saved = enSettings;
+	enSettings.DEBUG_VERTICES = true;
+	enSettings.DEBUG_NORMALS = true;
+	enSettings.DEBUG_BOUNDS = true;
+
+	this->transform(frame);
+	this->sortGeometry(frame);
+	this->project(frame);
+
+	uint64_t tRecordSum = 0, tDrawSum = 0;
+
+	for (int i=0; i<frames; i++) {
+		TIME_PT tPt1 = TIME_NOW();
+		this->recordDebug(frame);
+		TIME_PT tPt2 = TIME_NOW();
+		frame.debugDraw.draw(frame.surface, enPool);
+		TIME_PT tPt3 = TIME_NOW();
+
+		tRecordSum += TIME_DUR(tPt2, tPt1);
+		tDrawSum   += TIME_DUR(tPt3, tPt2);
+	}
+
+	std::cout
+		<< " Debug overlay " << frame.debugDraw.count() << " primitives"
+		<< "\tRecord " << tRecordSum/1E3F/frames << " ms"
+		<< "\tDraw " << tDrawSum/1E3F/frames << " ms\n";
+
+	enSettings = saved;
+	frame.debugDraw.begin(frame.surface.surfWidth, frame.surface.surfHeight, frame.projection);
+}
+
+// Wireframe with every edge and with the hidden ones removed
+void Engine::benchWireframe(Frame &frame, int frames) {
+	if ( !enEdges ) return;
+
+	std::cout << "\n";
+
+	for (bool hidden : {false, true}) {
+		enSettings.WIREFRAME = true;
+		enSettings.WIREFRAME_HIDDEN = hidden;
+
+		uint64_t tGeometrySum = 0, tRasterSum = 0;
+
+		for (int i=-1; i<frames; i++) {
+			TIME_PT tPt1 = TIME_NOW();
+			this->transform(frame);
+			this->sortGeometry(frame);
+			this->project(frame);
+			this->recordDebug(frame);
+			TIME_PT tPt2 = TIME_NOW();
+			this->rasterize(frame);
+			TIME_PT tPt3 = TIME_NOW();
+
+			if (i < 0) continue;
+			tGeometrySum += TIME_DUR(tPt2, tPt1);
+			tRasterSum   += TIME_DUR(tPt3, tPt2);
+		}
+
+		std::cout
+			<< " Wireframe " << (hidden ? "hidden" : "all   ") << " " << enEdgeCount << " edges"
+			<< "\tGeometry " << tGeometrySum/1E3F/frames << " ms"
+			<< "\tRaster " << tRasterSum/1E3F/frames << " ms\n";
+	}
+
+	enSettings.WIREFRAME = false;
+	frame.debugDraw.begin(frame.surface.surfWidth, frame.surface.surfHeight, frame.projection);
+}
+
+// HUD like 2D shapes drawn directly, then recorded once into a command list and replayed
+void Engine::benchShapes(Frame &frame, int frames) {
+	const int shapeCount = 2000;
+	Surface &surface = frame.surface;
+	int w = surface.surfWidth;
+	int h = surface.surfHeight;
+
+	std::vector<int> params(5*shapeCount);
+	std::vector<Color> colors(shapeCount);
+	for (int i=0; i<shapeCount; i++) {
+		for (int k=0; k<5; k++) params[5*i + k] = (int) (randf()*std::max(w, h));
+		colors[i] = randColor();
+	}
+
+	// Same calls on a Surface and on a CommandList
+	auto drawShapes = [&](auto &target) {
+		for (int i=0; i<shapeCount; i++) {
+			const int *p = &params[5*i];
+			int x = p[0] % w;
+			int y = p[1] % h;
+
+			switch (i % 5) {
+				case 0: target.fillRect(x, y, p[2] % 200, p[3] % 60, colors[i]); break;
+				case 1: target.drawRect(x, y, p[2] % 200, p[3] % 60, colors[i], 1 + p[4] % 3); break;
+				case 2: target.fillCircle(x, y, 4 + p[2] % 40, colors[i]); break;
+				case 3: target.drawLine(x, y, p[2] % w, p[3] % h, colors[i], 1 + p[4] % 3); break;
+				case 4: target.fillTris(x, y, x + p[2] % 80 - 40, y + 1 + p[3] % 40, x + p[4] % 80 - 40, y + 42 + p[3] % 40, colors[i]); break;
+			}
+		}
+	};
+
+	CommandList commands;
+	uint64_t tDirectSum = 0, tReplaySum = 0;
+
+	for (int i=0; i<frames; i++) {
+		TIME_PT tPt1 = TIME_NOW();
+		drawShapes(surface);
+		tDirectSum += TIME_DUR(TIME_NOW(), tPt1);
+	}
+
+	TIME_PT tPtRecord1 = TIME_NOW();
+	drawShapes(commands);
+	TIME_PT tPtRecord2 = TIME_NOW();
+	commands.execute(surface, enPool);
+	TIME_PT tPtRecord3 = TIME_NOW();
+
+	for (int i=0; i<frames; i++) {
+		TIME_PT tPt1 = TIME_NOW();
+		commands.execute(surface, enPool);
+		tReplaySum += TIME_DUR(TIME_NOW(), tPt1);
+	}
+
+	std::cout
+		<< "\n 2D shapes " << shapeCount << " (" << commands.count() << " commands)"
+		<< "\tDirect " << tDirectSum/1E3F/frames << " ms"
+		<< "\tRecord " << TIME_DUR(tPtRecord2, tPtRecord1)/1E3F << " ms"
+		<< "\tFirst " << TIME_DUR(tPtRecord3, tPtRecord2)/1E3F << " ms"
+		<< "\tReplay " << tReplaySum/1E3F/frames << " ms\n";
+}
+
+// Image encoders on a rendered frame, QOI files are decoded back and compared. The strip has black
+// after colours (its index slot starts empty, not black) and a run from the first pixel
+void Engine::benchEncoders(Frame &frame, int frames) {
+	Surface &surface = frame.surface;
+	int w = surface.surfWidth;
+	int h = surface.surfHeight;
+
+	this->benchPrepare(frame);
+	this->rasterize(frame);
+
+	std::vector<uint8_t> rgb( (size_t) 3*w*h );
+	surface.toRGB8(rgb.data());
+
+	const std::vector<uint8_t> strip = {
+		0, 0, 0,  0, 0, 0,  200, 10, 10,  0, 0, 0,  10, 200, 10,  10, 10, 200,  10, 200, 10,  0, 0, 0,
+		0, 0, 0,  255, 255, 255,  0, 0, 0,  200, 10, 10,  201, 11, 9,  0, 0, 0,  10, 10, 200,  200, 10, 10,
+	};
+
+	// Opaque RGB back from the decoder, alpha 255 everywhere
+	auto roundTrip = [](const std::vector<uint8_t> &pixels, int pw, int ph) {
+		std::vector<uint8_t> file, rgba;
+		encodeQOI(pixels.data(), pw, ph, file);
+
+		int dw, dh;
+		if ( !decodeQOI(file.data(), file.size(), dw, dh, rgba) || dw != pw || dh != ph ) return false;
+
+		for (int i=0; i<pw*ph; i++) {
+			if ( std::memcmp(&rgba[4*i], &pixels[3*i], 3) != 0 || rgba[4*i + 3] != 255 ) return false;
+		}
+		return true;
+	};
+	bool ok = roundTrip(strip, (int) strip.size()/3, 1) && roundTrip(rgb, w, h);
+
+	const std::pair<const char *, ImageFormat> formats[] = {
+		{"PNG", ImageFormat::PNG},
+		{"QOI", ImageFormat::QOI},
+		{"PPM", ImageFormat::PPM},
+	};
+
+	std::cout << "\n Encoders " << w << "x" << h;
+	for (const auto &[name, format] : formats) {
+		std::vector<uint8_t> bytes;
+		uint64_t tSum = 0;
+
+		for (int i=0; i<frames; i++) {
+			TIME_PT tPt1 = TIME_NOW();
+			if (format == ImageFormat::PNG) encodePNG(rgb.data(), w, h, bytes, &enPool);
+			else if (format == ImageFormat::QOI) encodeQOI(rgb.data(), w, h, bytes);
+			else encodePPM(rgb.data(), w, h, bytes);
+			tSum += TIME_DUR(TIME_NOW(), tPt1);
+		}
+
+		std::cout << "\t" << name << " " << tSum/1E3F/frames << " ms (" << bytes.size()/1024 << " KB)";
+	}
+	std::cout << "\tQOI round trip " << (ok ? "ok" : "FAILED") << "\n";
+}
+
+// Presented image in every SURFACE_FORMAT, encoded from a rendered frame on the workers (rgb32f is the
+// frame itself) and converted for SDLTexture (the 8 bit ones are uploaded as they are). Every stored value of the formats decodes and encodes back to itself,
+// the linear ones keep the 8 bit display values of the float image
+void Engine::benchFormats(Frame &frame, int frames) {
+	Surface &surface = frame.surface;
+	int size = surface.surfSize;
+
+	this->benchPrepare(frame);
+	this->rasterize(frame);
+
+	std::vector<uint8_t> reference( (size_t) 3*size );
+	surface.toRGB8(reference.data());
+
+	// Round trips, over every 8 and 10 bit value and every half but the NaNs
+	int mismatches = 0;
+	for (int v=0; v<256; v++) {
+		Byte4 p = { (uint8_t) v, (uint8_t) v, (uint8_t) v, 0xFF };
+		Byte4 linear = PixelRGBA8::encode( PixelRGBA8::decode(p) );
+		Byte4 srgb = PixelSRGBA8::encode( PixelSRGBA8::decode(p) );
+		mismatches += (std::memcmp(&linear, &p, 4) != 0) + (std::memcmp(&srgb, &p, 4) != 0);
+	}
+	for (uint32_t v=0; v<1024; v++) {
+		uint32_t p = v | (v << 10) | (v << 20) | (3u << 30);
+		mismatches += (PixelRGB10A2::encode( PixelRGB10A2::decode(p) ) != p);
+	}
+	for (uint32_t v=0; v<0x10000; v++) {
+		uint16_t h = (uint16_t) v;
+		if ((h & 0x7C00) == 0x7C00 && (h & 0x3FF)) continue;
+
+		Half4 p = PixelRGBA16F::encode( PixelRGBA16F::decode({h, h, h, 0x3C00}) );
+		mismatches += (p.r != h || p.g != h || p.b != h);
+	}
+
+	std::cout << "\n Surface formats " << surface.surfWidth << "x" << surface.surfHeight
+		<< ", round trips " << (mismatches == 0 ? "ok" : "FAILED") << "\n";
+
+	auto measure = [&](const char *name, auto display, bool encoded, bool uploaded, bool srgb) {
+		std::vector<uint32_t> texture(size);
+		uint64_t tEncodeSum = 0, tConvertSum = 0;
+
+		for (int i=0; i<frames; i++) {
+			TIME_PT tPt1 = TIME_NOW();
+			if (encoded) {
+				enPool.parallelFor(size, 4096, [&](int begin, int end) {
+					display.encodeDisplay(surface.data(), begin, end);
+				});
+			}
+			TIME_PT tPt2 = TIME_NOW();
+			if ( !uploaded ) display.toU32Surface(texture.data());
+			TIME_PT tPt3 = TIME_NOW();
+
+			tEncodeSum += TIME_DUR(tPt2, tPt1);
+			tConvertSum += TIME_DUR(tPt3, tPt2);
+		}
+
+		// sRGB has its own curve, the others only round the display values
+		std::vector<uint8_t> rgb( (size_t) 3*size );
+		display.toRGB8(rgb.data());
+
+		int maxError = 0;
+		for (size_t i=0; i<rgb.size(); i++) {
+			maxError = std::max(maxError, std::abs(rgb[i] - reference[i]));
+		}
+
+		bool failed = !srgb && maxError > 1;
+
+		std::cout
+			<< "  " << name << "\t" << sizeof(*display.data()) << " B/pixel"
+			<< "\tEncode " << tEncodeSum/1E3F/frames << " ms"
+			<< "\tPresent " << tConvertSum/1E3F/frames << " ms"
+			<< "\tMax error " << maxError << (failed ? " FAILED" : "") << "\n";
+	};
+
+	std::vector<Half4> halves(size);
+	std::vector<uint32_t> packed(size);
+	std::vector<Byte4> bytes(size);
+
+	measure("rgb32f",  surface, false, false, false);
+	measure("rgba16f", SurfaceRGBA16F(halves.data(), surface.surfWidth, surface.surfHeight), true, false, false);
+	measure("rgb10a2", SurfaceRGB10A2(packed.data(), surface.surfWidth, surface.surfHeight), true, false, false);
+	measure("rgba8",   SurfaceRGBA8(bytes.data(), surface.surfWidth, surface.surfHeight), true, true, false);
+	measure("srgba8",  SurfaceSRGBA8(bytes.data(), surface.surfWidth, surface.surfHeight), true, true, true);
+}
+
+// Trilinear sampling of a ground plane seen at an angle (rotated, so rows of pixels cross
+// rows of texels), row-major texels one pixel at a time against tiled texels by quads,
+// and compressed blocks decoded by the sampler
+void Engine::benchTextures(Frame &frame, int frames) {
+	const int size = 2048;
+	Surface &surface = frame.surface;
+	int w = surface.surfWidth & ~1;
+	int h = surface.surfHeight & ~1;
+
+	std::vector<uint32_t> rgba(size*size);
+	for (int i=0; i<size*size; i++) rgba[i] = pcg32_random_r() | 0xFF000000;
+
+	Texture rowMajor, tiled, bc1, bc4, bc5;
+	rowMajor.create(rgba.data(), size, size, TextureLayout::ROW_MAJOR);
+	tiled.create(rgba.data(), size, size, TextureLayout::TILED);
+
+	Texture *compressed[] = {&bc1, &bc4, &bc5};
+	const TextureFormat formats[] = {TextureFormat::BC1, TextureFormat::BC4, TextureFormat::BC5};
+	for (int i=0; i<3; i++) {
+		compressed[i]->create(rgba.data(), size, size, TextureLayout::TILED);
+		compressed[i]->compress(formats[i]);
+	}
+
+	std::vector<Vec2> uvs(w*h);
+	float cosA = std::cos(1.f), sinA = std::sin(1.f);
+	for (int y=0; y<h; y++) {
+		float depth = 1.f + 8.f*y/h;
+		for (int x=0; x<w; x++) {
+			Vec2 p( (x - w/2.f)/w*depth, depth );
+			uvs[y*w + x] = Vec2(cosA*p.x - sinA*p.y, sinA*p.x + cosA*p.y);
+		}
+	}
+
+	// Derivatives from the next pixel, like a quad would
+	auto perPixel = [&](const Sampler &sampler) {
+		enPool.parallelFor(h - 1, 8, [&](int begin, int end) {
+			for (int y=begin; y<end; y++) {
+				for (int x=0; x<w - 1; x++) {
+					const Vec2 &uv = uvs[y*w + x];
+					float lod = sampler.lod(uvs[y*w + x + 1] - uv, uvs[(y + 1)*w + x] - uv);
+					surface.data()[y*surface.surfWidth + x] = sampler.sample(uv, lod);
+				}
+			}
+		});
+	};
+
+	auto perQuad = [&](const Sampler &sampler) {
+		enPool.parallelFor(h/2, 4, [&](int begin, int end) {
+			for (int y=2*begin; y<2*end; y+=2) {
+				for (int x=0; x<w; x+=2) {
+					Vec2 uv[4] = {uvs[y*w + x], uvs[y*w + x + 1], uvs[(y + 1)*w + x], uvs[(y + 1)*w + x + 1]};
+					Color out[4];
+					sampler.sampleQuad(uv, out);
+
+					Color *p = surface.data() + y*surface.surfWidth + x;
+					p[0] = out[0];
+					p[1] = out[1];
+					p[surface.surfWidth] = out[2];
+					p[surface.surfWidth + 1] = out[3];
+				}
+			}
+		});
+	};
+
+	struct Run {
+		const char *name;
+		const Texture *texture;
+		bool quads;
+	};
+	const Run runs[] = {
+		{"Row-major", &rowMajor, false},
+		{"Tiled", &tiled, false},
+		{"Tiled quads", &tiled, true},
+		{"BC1 quads", &bc1, true},
+		{"BC4 quads", &bc4, true},
+		{"BC5 quads", &bc5, true},
+	};
+
+	std::cout << "\n Texture " << size << "x" << size << " " << tiled.levelCount << " levels, " << w << "x" << h << " samples";
+
+	for (const Run &run : runs) {
+		Sampler sampler = { run.texture };
+		uint64_t tSum = 0;
+
+		for (int i=-1; i<frames; i++) {
+			TIME_PT tPt1 = TIME_NOW();
+			if (run.quads) perQuad(sampler);
+			else perPixel(sampler);
+
+			if (i >= 0) tSum += TIME_DUR(TIME_NOW(), tPt1);
+		}
+
+		std::cout << "\t" << run.name << " " << tSum/1E3F/frames << " ms (" << run.texture->memorySize()/1024/1024.f << " MB)";
+	}
+	std::cout << "\n";
+}
+
+// Forward rendering with every MSAA level, against 4x supersampling (twice the width and height)
+void Engine::benchMSAA(Frame &frame, int frames) {
+	struct AAMode {
+		const char *name;
+		int samples;
+		int scale;
+	};
+	const AAMode aaModes[] = {
+		{"No AA  ", 1, 1},
+		{"MSAA 2x", 2, 1},
+		{"MSAA 4x", 4, 1},
+		{"MSAA 8x", 8, 1},
+		{"SSAA 4x", 1, 2},
+	};
+
+	Settings saved = enSettings;
+	int w = enSettings.W;
+	int h = enSettings.H;
+	enSettings.VISIBILITY_BUFFER = false;
+	enSettings.DEPTH_PREPASS = false;
+
+	std::cout << "\n";
+
+	for (const AAMode &aa : aaModes) {
+		frame.allocate(frame.vxCount, frame.triCount, enLightCount, w*aa.scale, h*aa.scale, aa.samples);
+
+		uint64_t tRasterSum = 0;
+
+		for (int i=-1; i<frames; i++) {
+			this->transform(frame);
+			this->sortGeometry(frame);
+			this->project(frame);
+			this->shadowPass(frame);
+
+			TIME_PT tPt1 = TIME_NOW();
+			this->rasterize(frame);
+			TIME_PT tPt2 = TIME_NOW();
+
+			if (i < 0) continue;
+			tRasterSum += TIME_DUR(tPt2, tPt1);
+		}
+
+		std::cout << "  " << aa.name << "\tRaster " << tRasterSum/1E3F/frames << " ms\n";
+	}
+
+	enSettings = saved;
+	frame.allocate(frame.vxCount, frame.triCount, enLightCount, w, h, enSettings.MSAA);
+}
+
+// Every rendering mode, once with the scene lights and then with 1, 64 and 1024 random point lights
+void Engine::benchLights(Frame &frame, int frames) {
+	struct Mode {
+		const char *name;
+		bool visibility;
+		bool prepass;
+	};
+	const Mode modes[] = {
+		{"Forward",    false, false},
+		{"Pre-pass",   false, true},
+		{"Visibility", true,  false},
+	};
+	const int lightCounts[] = {0, 1, 64, 1024};	// 0 keeps the scene lights
+
+	// Random lights are scattered around the bounds of the scene
+	Vec3 bbMin = enSceneMin, bbMax = enSceneMax;
+	Vec3 bbCenter = (bbMin + bbMax)/2.f;
+	Vec3 bbExtent = (bbMax - bbMin)*0.75f;
+	float bbSize = glm::length(bbMax - bbMin);
+
+	for (int lightCount : lightCounts) {
+		if (lightCount > 0) {
+			MEM_DEALLOC(enLights, enLightCapacity);
+			enLightCount = enLightCapacity = lightCount;
+			MEM_ALLOC(enLights, Light, enLightCount);
+
+			for (int i=0; i<enLightCount; i++) {
+				Light &light = enLights[i];
+				light.type = LightType::POINT;
+				light.position = bbCenter + bbExtent*randBiVec3();
+				light.color = randColor();
+				light.range = bbSize*(0.1f + 0.2f*randf());
+			}
+
+			frame.allocate(frame.vxCount, frame.triCount, enLightCount, enSettings.W, enSettings.H, enSettings.MSAA);
+		}
+
+		std::cout << "\n " << enLightCount << (lightCount > 0 ? " random" : " scene") << " lights\n";
+
+		for (const Mode &mode : modes) {
+			enSettings.VISIBILITY_BUFFER = mode.visibility;
+			enSettings.DEPTH_PREPASS = mode.prepass;
+
+			uint64_t tGeometrySum = 0, tShadowSum = 0, tRasterSum = 0;
+			uint64_t tileLightSum = 0, tileCount = 0;
+
+			// +1 warm up frame
+			for (int i=-1; i<frames; i++) {
+				TIME_PT tPt1 = TIME_NOW();
+				this->transform(frame);
+				this->sortGeometry(frame);
+				this->project(frame);
+				TIME_PT tPt2 = TIME_NOW();
+				this->shadowPass(frame);
+				TIME_PT tPt3 = TIME_NOW();
+				this->rasterize(frame);
+				TIME_PT tPt4 = TIME_NOW();
+
+				if (i < 0) continue;
+				tGeometrySum += TIME_DUR(tPt2, tPt1);
+				tShadowSum   += TIME_DUR(tPt3, tPt2);
+				tRasterSum   += TIME_DUR(tPt4, tPt3);
+
+				const LightGrid &grid = frame.lightGrid;
+				for (const std::vector<uint32_t> &tile : grid.tiles) {
+					tileLightSum += tile.size() + grid.global.size();
+				}
+				tileCount += grid.tiles.size();
+			}
+
+			std::cout
+				<< "  " << mode.name
+				<< "\tGeometry " << tGeometrySum/1E3F/frames << " ms"
+				<< "\tShadows "  << tShadowSum/1E3F/frames   << " ms"
+				<< "\tRaster "   << tRasterSum/1E3F/frames   << " ms"
+				<< "\tLights/Tile " << (float) tileLightSum/tileCount << "\n";
+
+			// Same for every light count
+			if (lightCount == 0) {
+				std::cout << "  ";
+				frame.stats.print(std::cout, 1);
+			}
+		}
+	}
+}
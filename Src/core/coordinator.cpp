@@ -0,0 +1,255 @@
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#include "coordinator.hpp"
+#include "../io/imagewriter.hpp"
+#include "../utils/utils.hpp"
+
+#include "nlohmann_json/json.hpp" // downloaded from https://github.com/nlohmann/json
+using json = nlohmann::json;
+
+
+// Reply line of the render server, a byte at a time so nothing of the pixels after it is read
+static bool readLine(Socket &socket, std::string &line) {
+	line.clear();
+	char c;
+
+	while ( socket.recvAll(&c, 1) ) {
+		if (c == '\n') return true;
+		line += c;
+	}
+
+	return false;
+}
+
+
+// Constructors and Destructors
+Coordinator::Coordinator() {
+}
+
+
+// Methods
+bool Coordinator::run(const std::string &scene, const std::vector<std::string> &addresses, int frames) {
+	const char *settingsPath = "settings.json";
+
+	if ( !_settings.loadFromJSON(settingsPath) ) {
+		std::cerr << "Failed to load settings from " << settingsPath << ". Using default settings." << std::endl;
+	}
+
+	_scene = scene;
+	_workers = std::vector<Worker>(addresses.size());
+
+	for (size_t i=0; i<addresses.size(); i++) {
+		_workers[i].address = addresses[i];
+
+		if ( !_workers[i].socket.connect(addresses[i]) ) {
+			std::cerr << "Failed to connect to the worker " << addresses[i] << std::endl;
+			return false;
+		}
+	}
+
+	int count = (int) _workers.size();
+	if (_settings.H < count*STRIP_MIN_ROWS) {
+		std::cerr << "Too many workers for " << _settings.H << " rows" << std::endl;
+		return false;
+	}
+
+	_image.assign( (size_t) 3*_settings.W*_settings.H, 0 );
+
+	// Scene loads on every worker, not timed
+	this->splitEvenly(count);
+	if (this->renderFrame(0.f, count) < 0.f) return false;
+
+	std::cout << "\nDistributed " << _scene << " at " << _settings.W << "x" << _settings.H << " on " << count << " workers, " << frames << " frames\n";
+
+	// Whole frames on one worker, the reference of the scaling
+	this->splitEvenly(1);
+
+	float tSingle = 0.f;
+	for (int i=0; i<frames; i++) {
+		float ms = this->renderFrame(i/(float) _settings.FPS, 1);
+		if (ms < 0.f) return false;
+		tSingle += ms;
+	}
+	tSingle /= frames;
+
+	std::vector<uint8_t> reference = _image;
+
+	// Strips on every worker, even at first then balanced
+	this->splitEvenly(count);
+
+	float tMulti = 0.f, tFirst = 0.f, imbalanceFirst = 0.f, imbalanceLast = 0.f;
+	for (int i=0; i<frames; i++) {
+		float ms = this->renderFrame(i/(float) _settings.FPS, count);
+		if (ms < 0.f) return false;
+
+		// Slowest strip over the average one
+		float slowest = 0.f, sum = 0.f;
+		for (int j=0; j<count; j++) {
+			slowest = std::max(slowest, _workers[j].renderMs);
+			sum += _workers[j].renderMs;
+		}
+		float imbalance = sum > 0.f ? slowest*count/sum : 1.f;
+
+		if (i == 0) {
+			tFirst = ms;
+			imbalanceFirst = imbalance;
+		}
+		imbalanceLast = imbalance;
+		tMulti += ms;
+
+		this->balance(count);
+	}
+	tMulti /= frames;
+
+	// Same time as the last reference frame, only float rounding may differ along the edges
+	int maxDiff = 0;
+	for (size_t i=0; i<_image.size(); i++) {
+		maxDiff = std::max(maxDiff, std::abs((int) _image[i] - (int) reference[i]));
+	}
+
+	float speedup = tSingle/tMulti;
+
+	std::cout << "1 worker  \t" << tSingle << " ms per frame\n"
+			  << count << " workers \t" << tMulti << " ms per frame (first " << tFirst << " ms on even strips)"
+			  << "\tSpeedup " << speedup << "\tEfficiency " << 100.f*speedup/count << " %\n"
+			  << "Imbalance \t" << imbalanceFirst << " on even strips, " << imbalanceLast << " balanced (slowest strip over the average)\n"
+			  << "Strips    \t";
+	for (int j=0; j<count; j++) {
+		std::cout << _workers[j].address << " rows " << _workers[j].first << "-" << _workers[j].last
+			<< " (" << _workers[j].renderMs << " ms, " << _workers[j].totalMs << " ms with the transfer)  ";
+	}
+	std::cout << "\nComposite \tmax difference " << maxDiff << " against the single worker frame\n";
+
+	// The last frame
+	std::vector<uint8_t> bytes;
+	ImageWriter::encode(_image.data(), _settings.W, _settings.H, ImageFormat::PNG, bytes, nullptr);
+
+	std::string path = "Out/" + std::filesystem::path(_scene).stem().string() + "_distributed.png";
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file) {
+		fwrite(bytes.data(), 1, bytes.size(), file);
+		fclose(file);
+		std::cout << "Saved " << path << "\n";
+	}
+	std::cout << std::endl;
+
+	return true;
+}
+
+float Coordinator::renderFrame(float time, int count) {
+	TIME_PT tPt1 = TIME_NOW();
+
+	// One thread per worker, the strips are disjoint rows of the image
+	std::vector<std::thread> threads;
+	for (int i=0; i<count; i++) {
+		threads.emplace_back(&Coordinator::renderStrip, this, std::ref(_workers[i]), time);
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+
+	for (int i=0; i<count; i++) {
+		if ( !_workers[i].ok ) return -1.f;
+	}
+
+	return TIME_DUR(TIME_NOW(), tPt1)/1E3F;
+}
+
+void Coordinator::renderStrip(Worker &worker, float time) {
+	TIME_PT tPt1 = TIME_NOW();
+	int rows = worker.last - worker.first;
+	worker.ok = false;
+
+	json request = {
+		{"scene", _scene},
+		{"time", time},
+		{"width", _settings.W},
+		{"height", _settings.H},
+		{"fov", _settings.AOV},
+		{"format", "raw"},
+		{"region", {0, worker.first, _settings.W, rows}},
+	};
+
+	std::string line;
+	if ( !worker.socket.sendAll(request.dump() + "\n") || !readLine(worker.socket, line) ) {
+		std::cerr << "Lost the worker " << worker.address << std::endl;
+		return;
+	}
+
+	json reply = json::parse(line, nullptr, false);
+	if ( reply.is_discarded() || !reply.value("ok", false) ) {
+		std::cerr << "Worker " << worker.address << ": " << (reply.is_discarded() ? line : reply.value("error", line)) << std::endl;
+		return;
+	}
+
+	size_t bytes = reply.value("bytes", (size_t) 0);
+	if (bytes != (size_t) 3*_settings.W*rows) {
+		std::cerr << "Worker " << worker.address << " sent " << bytes << " bytes for " << rows << " rows" << std::endl;
+		return;
+	}
+
+	if ( !worker.socket.recvAll(_image.data() + (size_t) 3*_settings.W*worker.first, bytes) ) {
+		std::cerr << "Lost the worker " << worker.address << std::endl;
+		return;
+	}
+
+	worker.renderMs = reply.value("render_ms", 0.f);
+	worker.totalMs = TIME_DUR(TIME_NOW(), tPt1)/1E3F;
+	worker.ok = true;
+}
+
+void Coordinator::splitEvenly(int count) {
+	for (int i=0; i<count; i++) {
+		_workers[i].first = _settings.H*i/count;
+		_workers[i].last = _settings.H*(i+1)/count;
+	}
+}
+
+/*
+The render time of a strip is taken as spread evenly over its rows, new boundaries split
+the summed time in equal parts. The time a worker spends on the whole scene whatever its
+strip (transform, shadows) moves with the rows too, a few frames settle it
+*/
+void Coordinator::balance(int count) {
+	if (count < 2) return;
+
+	float total = 0.f;
+	for (int i=0; i<count; i++) {
+		total += _workers[i].renderMs;
+	}
+	if (total <= 0.f) return;
+
+	std::vector<int> bounds(count + 1);
+	bounds[0] = 0;
+	bounds[count] = _settings.H;
+
+	float target = total/count, sum = 0.f;
+	int strip = 0;
+
+	for (int k=1; k<count; k++) {
+		float goal = target*k;
+
+		// Strip holding the goal
+		while (strip < count-1 && sum + _workers[strip].renderMs < goal) {
+			sum += _workers[strip].renderMs;
+			strip++;
+		}
+
+		const Worker &w = _workers[strip];
+		float perRow = w.renderMs/std::max(1, w.last - w.first);
+		int row = w.first + (perRow > 0.f ? (int) ((goal - sum)/perRow + 0.5f) : 0);
+
+		// Room for the strips before and after
+		bounds[k] = std::clamp(row, bounds[k-1] + STRIP_MIN_ROWS, _settings.H - (count - k)*STRIP_MIN_ROWS);
+	}
+
+	for (int i=0; i<count; i++) {
+		_workers[i].first = bounds[i];
+		_workers[i].last = bounds[i+1];
+	}
+}
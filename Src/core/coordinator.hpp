@@ -0,0 +1,58 @@
+// Sort-first distributed rendering, render servers draw strips of the frame for a coordinator
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "settings.hpp"
+#include "../io/socket.hpp"
+
+
+#define STRIP_MIN_ROWS 8	// Smallest strip a worker gets
+
+
+/*
+Every worker is a render server (qazwsx --serve host:port) that finds the scene at the same path.
+A frame is cut into one strip of rows per worker, each worker renders the whole scene through
+the projection of its strip and sends back the RGB8 pixels, received straight into their rows
+of the image. After each frame the strips move so that the render time of every strip, spread
+over its rows, splits equally between the workers
+*/
+class Coordinator {
+	// Constructors / Destructors
+	public:
+		Coordinator();
+
+	private:
+		struct Worker {
+			std::string address;
+			Socket socket;
+			int first;			// Rows [first, last) of the frame
+			int last;
+			float renderMs;		// Last frame, on the worker
+			float totalMs;		// With the request and the transfer
+			bool ok;
+		};
+
+	// Attributes
+	private:
+		Settings _settings;
+		std::string _scene;
+		std::vector<Worker> _workers;
+		std::vector<uint8_t> _image;	// W x H RGB8, composited from the strips
+
+	// Methods
+	public:
+		// Renders `frames` frames of `scene` on the first worker alone, then on all of them
+		bool run(const std::string &scene, const std::vector<std::string> &addresses, int frames);
+
+	private:
+		// Frame at `time` on the first `count` workers, in their current strips, returns the time in ms or -1
+		float renderFrame(float time, int count);
+		void renderStrip(Worker &worker, float time);
+
+		void splitEvenly(int count);
+		void balance(int count);
+};
@@ -1,16 +1,33 @@
+#include <csignal>
 #include <iostream>
 #include <vector>
 #include <cmath>
 #include <numbers>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
 
 #include "SDL3/SDL.h"
 #include "engine.hpp"
 #include "settings.hpp"
+#include "../render/raster.hpp"
+#include "../render/shaders.hpp"
+#include "../render/commandlist.hpp"
+#include "../io/encoders.hpp"
 
 // #define TRACK_MEMORY    // Can be used to Track Allocated and Deallocated memory
 #include "../utils/utils.hpp"
 
 
+// Set by SIGINT and SIGTERM, ends a headless pipeline
+static volatile std::sig_atomic_t engineStop = 0;
+
+static void onStopSignal(int) {
+	engineStop = 1;
+}
+
+
 /*
 Engine Class handles SDL Setup and Deinitialization itself
 while RenderEngine Setup and destruction is explicitly
@@ -19,22 +36,22 @@ handled by Engine::pipeline()
 
 
 // Constructors and Destructors
-Engine::Engine() {
-	SDLWindow = nullptr;
-	SDLRenderer = nullptr;
-	SDLTexture = nullptr;
+// The scene file parses on a task while the settings load and the window opens, `headless` has no window
+Engine::Engine(const char *filename, bool headless) : enPool(enOwnPool) {
+	tPtCreate = TIME_NOW();
 
-	enTextureBuffer = nullptr;
-	enBuffer = nullptr;
-	enVerticies = nullptr;
-	enTrisRefBuffer = nullptr;
-	enTrisProjectedBuffer = nullptr;
+	this->beginLoad(filename);
+	this->engineSetup(nullptr);
+	if ( !headless ) this->SDLSetup();
+}
 
-	this->engineSetup();
-	this->SDLSetup();
+// Headless, without a window, on the settings and workers of the render server
+Engine::Engine(const Settings &settings, ThreadPool &pool) : enPool(pool) {
+	this->engineSetup(&settings);
 }
 
 Engine::~Engine() {
+	this->stopPipeline();
 	this->SDLDestroy();
 	this->engineDestroy();
 }
@@ -59,14 +76,23 @@ void Engine::SDLSetup() {
 		exit(EXIT_FAILURE);
 	}
 
-	SDLTexture = SDL_CreateTexture(SDLRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, enSettings.W, enSettings.H);
+	// 8 bit presented images are uploaded as they are, the other formats go through textureBuffer
+	bool bytes = (enSurfaceFormat == PixelFormat::RGBA8 || enSurfaceFormat == PixelFormat::SRGBA8);
+	SDL_PixelFormat format = bytes ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGBA8888;
+
+	SDLTexture = SDL_CreateTexture(SDLRenderer, format, SDL_TEXTUREACCESS_STREAMING, enSettings.W, enSettings.H);
 	if ( !SDLTexture ) {
 		SDL_Log("SDL_CreateTexture failed: %s", SDL_GetError());
 		exit(EXIT_FAILURE);
 	}
+
+	// Frames rendered below the window resolution are stretched with bilinear filtering
+	SDL_SetTextureScaleMode(SDLTexture, SDL_SCALEMODE_LINEAR);
 }
 
 void Engine::SDLDestroy() {
+	if ( !SDLWindow ) return;
+
 	SDL_DestroyTexture(SDLTexture);
 	SDL_DestroyRenderer(SDLRenderer);
 	SDL_DestroyWindow(SDLWindow);
@@ -74,6 +100,12 @@ void Engine::SDLDestroy() {
 }
 
 void Engine::handleEvents() {
+	// Headless, stopped by a signal instead of the window
+	if ( !SDLWindow ) {
+		if (engineStop) isRunning = false;
+		return;
+	}
+
 	while (SDL_PollEvent(&SDLEvent)) {
 		if (SDLEvent.type == SDL_EVENT_QUIT) {
 			isRunning = false;
@@ -83,316 +115,2208 @@ void Engine::handleEvents() {
 
 
 // Engine Methods (Setup, Destruction and Scene Loading)
-void Engine::engineSetup() {
+// `settings` is null to load settings.json and start the own workers
+void Engine::engineSetup(const Settings *settings) {
+	SDLWindow = nullptr;
+	SDLRenderer = nullptr;
+	SDLTexture = nullptr;
+
+	enVerticies = nullptr;
+	enNormals = nullptr;
+	enUVs = nullptr;
+	enIndices = nullptr;
+	enMeshes = nullptr;
+	enMeshVxCount = 0;
+	enMeshIndexCount = 0;
+	enMeshCount = 0;
+	enMeshVxCapacity = 0;
+	enMeshIndexCapacity = 0;
+	enMeshCapacity = 0;
+	enInstances = nullptr;
+	enInstanceCount = 0;
+	enInstanceCapacity = 0;
+	enTriCapacity = 0;
+	enTrisInstance = nullptr;
+	enMaterials = nullptr;
+	enMaterialCapacity = 0;
+	enSceneMin = Vec3(0.f);
+	enSceneMax = Vec3(0.f);
+	enNormalLength = 0.f;
+	enEdges = nullptr;
+	enEdgeCount = 0;
+	enMaterialCount = 0;
+	enTextures = nullptr;
+	enTextureCount = 0;
+	enLights = nullptr;
+	enLightCount = 0;
+	enLightCapacity = 0;
+	enTexturesLoaded = 0;
+	enLoadStop = false;
+	enFirstFrameTime = 0;
+	enStreamed = false;
+	enReloadState = ReloadState::IDLE;
+	enReloadTextures = false;
+	enRestartRefine = false;
+	enParseReloadTime = 0;
+	enPatchTime = 0;
+	enFrames = nullptr;
+	enFrameCount = 0;
+	enShownFrame = nullptr;
+	enFramePixelBytes = 0;
+	enAccumBuffer = nullptr;
+	enVideoFormat = VideoFormat::Y4M;
+	enVideoFrames = 0;
+	enDebugView = DebugView::NONE;
+
 	isRunning = true;
 	deltaTime = 0.0f;
 
 	// Load Settings
 	const char *settingsPath = "settings.json";
 
-	if ( !enSettings.loadFromJSON(settingsPath) ) {
+	if (settings) {
+		enSettings = *settings;
+	}
+	else if ( !enSettings.loadFromJSON(settingsPath) ) {
 		std::cerr << "Failed to load settings from " << settingsPath << ". Using default settings." << std::endl;
 	}
 
 
-	MEM_ALLOC(enTextureBuffer, uint32_t, enSettings.W*enSettings.H);
-	MEM_ALLOC(enBuffer, Color,enSettings.W*enSettings.H);
-
 	projMat = glm::perspective(glm::radians(enSettings.AOV), enSettings.ASR, enSettings.EPSILON, enSettings.FAR_CLIP);
-	enSurface = Surface(enBuffer, enSettings.W, enSettings.H);
+
+	if (&enPool == &enOwnPool) {
+		enPool.start(enSettings.THREADS);
+	}
+
+	enImageFormat = ImageFormat::PNG;
+	if ( !ImageWriter::parseFormat(enSettings.IMAGE_FORMAT, enImageFormat) ) {
+		std::cerr << "Unknown IMAGE_FORMAT \"" << enSettings.IMAGE_FORMAT << "\", saving PNG." << std::endl;
+	}
+
+	enSurfaceFormat = PixelFormat::RGB32F;
+	if ( !parsePixelFormat(enSettings.SURFACE_FORMAT, enSurfaceFormat) ) {
+		std::cerr << "Unknown SURFACE_FORMAT \"" << enSettings.SURFACE_FORMAT << "\", expected rgb32f, rgba16f, rgb10a2, rgba8 or srgba8." << std::endl;
+	}
+
+	if ( !PipelineStats::parseView(enSettings.DEBUG_VIEW, enDebugView) ) {
+		std::cerr << "Unknown DEBUG_VIEW \"" << enSettings.DEBUG_VIEW << "\", expected none, overdraw, density or tile_cost." << std::endl;
+	}
+
+	enRenderScale = enSettings.MAX_SCALE;
+	enScaleFrames = 0;
+	enScaleTimeSum = 0;
+
+	enRefineView = glm::mat4(1.f);
+	enRefineStep = -1;
 
 	// will be initialized when scene is loaded
-	enScene = {};
 	enVxCount = 0;
 	enTriCount = 0;
 }
 
 void Engine::engineDestroy() {
 
-	MEM_DEALLOC(enTrisRefBuffer, enTriCount);
-	MEM_DEALLOC(enTrisProjectedBuffer, enTriCount);
-	MEM_DEALLOC(enVerticies, enVxCount);
+	// Loading may still be going on, the textures stop after the current one
+	enLoadStop = true;
+	if (enTextureThread.joinable()) enTextureThread.join();
+	if (enSceneParsed.valid()) enSceneParsed.wait();
+	if (enReloadParsed.valid()) enReloadParsed.wait();
+	enWatcher.close();
+
+	// Reads into the mesh buffers freed below
+	enStreamer.stop();
+	enPack.close();
+
+	enImageWriter.stop();
+	enOwnPool.stop();
+
+	delete[] enFrames;
+	enFrames = nullptr;
+
+	if (enAccumBuffer) MEM_DEALLOC(enAccumBuffer, enSettings.W*enSettings.H);
+	if (enEdges) MEM_DEALLOC(enEdges, enEdgeCount*2);
+
+	MEM_DEALLOC(enLights, enLightCapacity);
+	MEM_DEALLOC(enTextures, enTextureCount);
+	MEM_DEALLOC(enTrisInstance, enTriCapacity);
+	MEM_DEALLOC(enInstances, enInstanceCapacity);
+	MEM_DEALLOC(enMaterials, enMaterialCapacity);
+	MEM_DEALLOC(enMeshes, enMeshCapacity);
+	MEM_DEALLOC(enIndices, enMeshIndexCapacity);
+	MEM_DEALLOC(enUVs, enMeshVxCapacity);
+	MEM_DEALLOC(enNormals, enMeshVxCapacity);
+	MEM_DEALLOC(enVerticies, enMeshVxCapacity);
+
+}
+
+// Edges shared by several triangles are kept once, as (smaller index, larger index) pairs
+static void buildEdgeList(const uint32_t *indices, int triCount, std::vector<uint64_t> &edges) {
+	edges.resize( (size_t) triCount*3 );
+
+	for (int i=0; i<triCount; i++) {
+		for (int j=0; j<3; j++) {
+			uint64_t a = indices[3*i + j];
+			uint64_t b = indices[3*i + (j+1)%3];
+			edges[3*i + j] = (std::min(a, b) << 32) | std::max(a, b);
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+	edges.erase( std::unique(edges.begin(), edges.end()), edges.end() );
+}
+
+// Capacity for `count` elements, grown by half again so that small additions fit next time
+static int growCapacity(int capacity, int count) {
+	return (count <= capacity) ? capacity : std::max(count, capacity + capacity/2);
+}
+
+// Moves `buf` from `oldCapacity` to `capacity` elements, keeping the first `keep`
+template <typename T>
+static void moveBuffer(T *&buf, int oldCapacity, int capacity, int keep) {
+	if (capacity == oldCapacity) return;
+
+	T *grown;
+	MEM_ALLOC(grown, T, capacity);
+	if (buf) {
+		std::copy(buf, buf + std::min(keep, capacity), grown);
+		MEM_DEALLOC(buf, oldCapacity);
+	}
+	buf = grown;
+}
+
+template <typename T>
+static void reserveBuffer(T *&buf, int &capacity, int keep, int count) {
+	int grown = growCapacity(capacity, count);
+	moveBuffer(buf, capacity, grown, keep);
+	capacity = grown;
+}
+
+// Writes `value` at buf[i] unless it is already there (for i < valid), counting the bytes written
+template <typename T>
+static inline void patchElement(T *buf, int i, int valid, const T &value, size_t &bytes) {
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	if (i < valid && std::memcmp(&buf[i], &value, sizeof(T)) == 0) return;
+
+	std::memcpy(&buf[i], &value, sizeof(T));
+	bytes += sizeof(T);
+}
+
+// FNV-1a of everything each object is drawn with, a reload compares them to find the changed objects
+static void objectHashes(const Scene &scene, std::vector<uint64_t> &hashes) {
+	hashes.assign(scene.sceneObjectCount, 0);
+
+	for (uint32_t i=0; i<scene.sceneObjectCount; i++) {
+		const Object &obj = scene.sceneObjects[i];
+		const Mesh &mesh = scene.sceneMeshes[obj.mesh];
+		uint64_t hash = 14695981039346656037ULL;
+
+		// A word at a time, the tail a byte at a time
+		auto add = [&hash](const void *data, size_t size) {
+			const uint8_t *bytes = (const uint8_t *) data;
+			size_t i = 0;
+			for (uint64_t word; i + 8 <= size; i += 8) {
+				std::memcpy(&word, bytes + i, 8);
+				hash = (hash ^ word) * 1099511628211ULL;
+			}
+			for (; i < size; i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ULL;
+			}
+		};
+
+		add(scene.sceneVerticies + mesh.firstVertex, mesh.vertexCount*sizeof(Vec3));
+		add(scene.sceneNormals + mesh.firstVertex, mesh.vertexCount*sizeof(Vec3));
+		if (scene.sceneUVs) add(scene.sceneUVs + mesh.firstVertex, mesh.vertexCount*sizeof(Vec2));
+		add(mesh.indices, mesh.indexCount*sizeof(uint32_t));
+		add(obj.transforms.data(), obj.transforms.size()*sizeof(glm::mat4));
+
+		const Material &material = obj.material;
+		int modes[2] = { (int) material.shading, (int) material.blend };
+		add(&material.color, sizeof(Color));
+		add(modes, sizeof(modes));
+		if (material.texture >= 0) {
+			const std::string &file = scene.sceneTextureFiles[material.texture];
+			add(file.data(), file.size());
+		}
+
+		hashes[i] = hash;
+	}
+}
+
+// Instance whose range of the frame buffers holds `pos`, `first` is Instance::firstVertex or Instance::firstTriangle
+static int findInstance(const Instance *instances, int count, uint32_t Instance::*first, int pos) {
+	const Instance *it = std::upper_bound(instances, instances + count, (uint32_t) pos, [&](uint32_t p, const Instance &inst) {
+		return p < inst.*first;
+	});
+	return (int) (it - instances) - 1;
+}
+
+void Engine::beginLoad(const char *filename) {
+	enSceneFile = filename;
+	enParseTime = 0;
+
+	enSceneParsed = std::async(std::launch::async, [this]() {
+		TIME_PT tPt1 = TIME_NOW();
+
+		// Only the tables of a packed scene, its geometry streams in
+		if ( ScenePack::isPack(enSceneFile) ) {
+			bool ok = enPack.open(enSceneFile);
+			enParseTime = TIME_DUR(TIME_NOW(), tPt1);
+			return ok;
+		}
+
+		bool ok = enScene.loadJSONScene(enSceneFile.c_str());
+
+		if (ok) {
+			enObjectNames.clear();
+			for (uint32_t i=0; i<enScene.sceneObjectCount; i++) {
+				enObjectNames.push_back(enScene.sceneObjects[i].name);
+			}
+			objectHashes(enScene, enObjectHashes);
+		}
+
+		enParseTime = TIME_DUR(TIME_NOW(), tPt1);
+		return ok;
+	});
+}
+
+// Waits for the parse of beginLoad() and builds the engine buffers, the textures are left to loadTextures()
+bool Engine::loadScene() {
+	if ( !enSceneParsed.valid() ) return false;
+
+	TIME_PT tPtWait1 = TIME_NOW();
+	if ( !enSceneParsed.get() ) return false;
+
+	std::cout << "Scene parsed in " << enParseTime/1E3F << " ms on a task, waited "
+		<< TIME_DUR(TIME_NOW(), tPtWait1)/1E3F << " ms for it after the setup" << std::endl;
+
+	// Before engineSetup() the scene parse is already going on
+	enStreamed = ScenePack::isPack(enSceneFile);
+	if (enStreamed) {
+		this->loadPack();
+	}
+	else {
+		this->buildBuffers(enScene);
+
+		// Taken over from the scene before their texels are loaded
+		enTextureCount = enScene.sceneTextureCount;
+		enTextures = enScene.sceneTextures;
+		enTextureFiles = std::move(enScene.sceneTextureFiles);
+		enScene.sceneTextureCount = 0;
+		enScene.sceneTextures = nullptr;
+
+		enScene.unload();
+	}
+	enTexturesLoaded = 0;
+
+	if (enSettings.MSAA > 1 && (enSettings.VISIBILITY_BUFFER || enSettings.DEPTH_PREPASS)) {
+		std::cerr << "MSAA only applies to plain forward rendering, the visibility buffer and depth pre-pass render without it." << std::endl;
+	}
+
+	// Every frame in flight owns its geometry and colour buffers
+	enFrameCount = enSettings.FRAMES_IN_FLIGHT;
+	enFrames = new Frame[enFrameCount];
+
+	size_t framePixelBytes = 0;
+	for (int i=0; i<enFrameCount; i++) {
+		enFrames[i].allocate(enVxCount, enTriCount, enLightCount, enSettings.W, enSettings.H, enSettings.MSAA, SDLWindow ? enSurfaceFormat : PixelFormat::RGB32F);
+		enFrames[i].projection = projMat;
+		enFrames[i].fov = enSettings.AOV;
+		enFrames[i].aspect = enSettings.ASR;
+		framePixelBytes += enFrames[i].pixelMemory();
+	}
+	enFramePixelBytes = framePixelBytes;
 
-	MEM_DEALLOC(enBuffer, 		 W*H);
-	MEM_DEALLOC(enTextureBuffer, W*H);
+	enSurface = enFrames[0].surface;
 
+	if (enSettings.PROGRESSIVE) {
+		MEM_ALLOC(enAccumBuffer, Color, enSettings.W*enSettings.H);
+
+		if (enSettings.DYNAMIC_RESOLUTION || enSettings.MSAA > 1) {
+			std::cerr << "Progressive refinement picks its own resolution and samples, DYNAMIC_RESOLUTION and MSAA are ignored." << std::endl;
+		}
+	}
+
+	return true;
 }
 
-void Engine::loadScene(const char *filename) {
-	enScene.loadJSONScene(filename);
+// Writes the meshes, instances, materials and lights of `scene` over the engine buffers. Only the
+// elements that differ are written and a buffer is only reallocated when it outgrows its capacity,
+// so the hot reload patches the buffers in place. Returns the bytes written
+size_t Engine::buildBuffers(const Scene &scene) {
+	size_t bytes = 0;
+
+	int oldMeshVxCount = enMeshVxCount;
+	int oldMeshIndexCount = enMeshIndexCount;
+	int oldMeshCount = enMeshCount;
+	int oldInstanceCount = enInstanceCount;
+	int oldTriCount = enTriCount;
+	int oldMaterialCount = enMaterialCount;
+	int oldLightCount = enLightCount;
+
+	enMeshVxCount = scene.sceneVertexCount;
+	enMeshCount = scene.sceneMeshCount;
+	enInstanceCount = scene.sceneInstanceCount;
+	enTriCount = scene.sceneTriangleCount;
+
+	enMaterialCount = scene.sceneObjectCount;
+	enLightCount = scene.sceneLightCount;
+
+	enMeshIndexCount = 0;
+	for (int i=0; i<enMeshCount; i++) {
+		enMeshIndexCount += scene.sceneMeshes[i].indexCount;
+	}
 
-	enVxCount = enScene.sceneVertexCount;
-	enTriCount = enScene.sceneTriangleCount;
+	int meshVxCapacity = growCapacity(enMeshVxCapacity, enMeshVxCount);
+	moveBuffer(enVerticies, enMeshVxCapacity, meshVxCapacity, oldMeshVxCount);
+	moveBuffer(enNormals, enMeshVxCapacity, meshVxCapacity, oldMeshVxCount);
+	moveBuffer(enUVs, enMeshVxCapacity, meshVxCapacity, oldMeshVxCount);
+	enMeshVxCapacity = meshVxCapacity;
 
-	MEM_ALLOC(enVerticies, Vec3, enVxCount);
-	MEM_ALLOC(enTrisRefBuffer, Tris3D_ref, enTriCount);
-	MEM_ALLOC(enTrisProjectedBuffer, Tris2D, enTriCount);
+	reserveBuffer(enIndices, enMeshIndexCapacity, oldMeshIndexCount, enMeshIndexCount);
+	reserveBuffer(enMeshes, enMeshCapacity, oldMeshCount, enMeshCount);
+	reserveBuffer(enMaterials, enMaterialCapacity, oldMaterialCount, enMaterialCount);
+	reserveBuffer(enInstances, enInstanceCapacity, oldInstanceCount, enInstanceCount);
+	reserveBuffer(enTrisInstance, enTriCapacity, oldTriCount, enTriCount);
+	reserveBuffer(enLights, enLightCapacity, oldLightCount, enLightCount);
 
 	// Point Scene Data to Engine Buffers
-	for (int i=0; i<enVxCount; i++) {
-		enVerticies[i].x = enScene.sceneVerticies[i].x;
-		enVerticies[i].y = enScene.sceneVerticies[i].y;
-		enVerticies[i].z = enScene.sceneVerticies[i].z;
+	for (int i=0; i<enMeshVxCount; i++) {
+		patchElement(enVerticies, i, oldMeshVxCount, scene.sceneVerticies[i], bytes);
+		patchElement(enNormals, i, oldMeshVxCount, scene.sceneNormals[i], bytes);
+		patchElement(enUVs, i, oldMeshVxCount, scene.sceneUVs ? scene.sceneUVs[i] : Vec2(0.f), bytes);
+	}
+
+	// Flatten the index buffers of all meshes into one, with the edges of every mesh for the
+	// wireframe (an instance reuses those of its mesh)
+	std::vector<uint64_t> edges, meshEdges;
+
+	for (uint32_t i=0, k=0; i<scene.sceneMeshCount; i++) {
+		const Mesh &mesh = scene.sceneMeshes[i];
+
+		MeshRange range = {};
+		range.firstVertex = mesh.firstVertex;
+		range.vertexCount = mesh.vertexCount;
+		range.firstIndex = k;
+		range.triangleCount = mesh.triangleCount;
+		range.min = Vec3(INFINITY);
+		range.max = Vec3(-INFINITY);
+
+		for (uint32_t j=0; j<mesh.indexCount; j++) {
+			patchElement(enIndices, (int) k++, oldMeshIndexCount, mesh.indices[j], bytes);
+
+			const Vec3 &v = enVerticies[mesh.firstVertex + mesh.indices[j]];
+			range.min = glm::min(range.min, v);
+			range.max = glm::max(range.max, v);
+		}
+
+		if (enSettings.WIREFRAME) {
+			buildEdgeList(mesh.indices, mesh.triangleCount, meshEdges);
+
+			range.firstEdge = (uint32_t) edges.size();
+			range.edgeCount = (uint32_t) meshEdges.size();
+			edges.insert(edges.end(), meshEdges.begin(), meshEdges.end());
+		}
+
+		patchElement(enMeshes, (int) i, oldMeshCount, range, bytes);
+	}
+
+	// Every instance gets its range of the frame buffers, in object order
+	enVxCount = 0;
+	enSceneMin = Vec3(INFINITY);
+	enSceneMax = Vec3(-INFINITY);
+
+	for (uint32_t i=0, n=0, t=0; i<scene.sceneObjectCount; i++) {
+		const Object &obj = scene.sceneObjects[i];
+		const MeshRange &range = enMeshes[obj.mesh];
+
+		patchElement(enMaterials, (int) i, oldMaterialCount, obj.material, bytes);
+
+		for (const glm::mat4 &transform : obj.transforms) {
+			Instance inst = {};
+			inst.transform = transform;
+			inst.mesh = obj.mesh;
+			inst.object = i;
+			inst.firstVertex = enVxCount;
+			inst.firstTriangle = t;
+			inst.rigid = isRigid(transform);
+			patchElement(enInstances, (int) n, oldInstanceCount, inst, bytes);
+
+			for (uint32_t j=0; j<range.triangleCount; j++) {
+				patchElement(enTrisInstance, (int) t++, oldTriCount, n, bytes);
+			}
+			enVxCount += range.vertexCount;
+			n++;
+
+			// Corners of the mesh bounds
+			for (int c=0; c<8; c++) {
+				Vec3 corner((c & 1) ? range.max.x : range.min.x, (c & 2) ? range.max.y : range.min.y, (c & 4) ? range.max.z : range.min.z);
+				corner = Vec3( transform * Vec4(corner, 1.f) );
+				enSceneMin = glm::min(enSceneMin, corner);
+				enSceneMax = glm::max(enSceneMax, corner);
+			}
+		}
+	}
+
+	std::cout << "Instancing: " << enMeshVxCount << " mesh verticies for " << enVxCount
+		<< " instanced ones, " << enInstanceCount << " instances of " << enMeshCount << " meshes" << std::endl;
+
+	// Compared up to the padding after castShadows, lights are not zeroed before they are read
+	for (int i=0; i<enLightCount; i++) {
+		bool same = i < oldLightCount && std::memcmp(&enLights[i], &scene.sceneLights[i], offsetof(Light, castShadows) + sizeof(bool)) == 0;
+		enLights[i] = scene.sceneLights[i];
+		if ( !same ) bytes += sizeof(Light);
+	}
+
+	enNormalLength = enInstanceCount > 0 ? 0.02f*glm::length(enSceneMax - enSceneMin) : 0.f;
+
+	// Debug only, allocated again every time
+	if (enSettings.WIREFRAME) {
+		if (enEdges) MEM_DEALLOC(enEdges, enEdgeCount*2);
+		enEdgeCount = (int) edges.size();
+		MEM_ALLOC(enEdges, uint32_t, enEdgeCount*2);
+
+		for (int i=0; i<enEdgeCount; i++) {
+			enEdges[2*i] = (uint32_t) (edges[i] >> 32);
+			enEdges[2*i+1] = (uint32_t) edges[i];
+		}
+
+		std::cout << "Wireframe: " << enEdgeCount << " unique mesh edges" << std::endl;
+	}
+
+	return bytes;
+}
+
+/*
+Materials, lights and textures of an opened pack, its geometry stays on disk. The mesh buffers
+become the arena of the streamer with as many chunk slots as STREAM_BUDGET_MB holds, the frames
+are allocated empty and grow with what they draw
+*/
+void Engine::loadPack() {
+	size_t slotBytes = (size_t) CHUNK_VERTICES*(2*sizeof(Vec3) + sizeof(Vec2)) + (size_t) CHUNK_INDICES*sizeof(uint32_t);
+	int slots = (int) std::max<size_t>(1, (size_t) enSettings.STREAM_BUDGET_MB*1024*1024 / slotBytes);
+
+	enMeshVxCount = enMeshVxCapacity = slots*CHUNK_VERTICES;
+	enMeshIndexCount = enMeshIndexCapacity = slots*CHUNK_INDICES;
+	MEM_ALLOC(enVerticies, Vec3, enMeshVxCapacity);
+	MEM_ALLOC(enNormals, Vec3, enMeshVxCapacity);
+	MEM_ALLOC(enUVs, Vec2, enMeshVxCapacity);
+	MEM_ALLOC(enIndices, uint32_t, enMeshIndexCapacity);
+
+	enMaterialCount = enMaterialCapacity = (int) enPack.materials.size();
+	MEM_ALLOC(enMaterials, Material, enMaterialCapacity);
+	std::copy(enPack.materials.begin(), enPack.materials.end(), enMaterials);
+
+	enLightCount = enLightCapacity = (int) enPack.lights.size();
+	MEM_ALLOC(enLights, Light, enLightCapacity);
+	std::copy(enPack.lights.begin(), enPack.lights.end(), enLights);
+
+	enTextureCount = (int) enPack.textureNames.size();
+	MEM_ALLOC(enTextures, Texture, enTextureCount);
+	for (int i=0; i<enTextureCount; i++) {
+		enTextures[i].name = enPack.textureNames[i];
+	}
+	enTextureFiles = enPack.textureFiles;
+
+	enScene.name = enPack.name;
+	enObjectNames = enPack.objectNames;
+	enInstanceCount = (int) enPack.instances.size();
+
+	enSceneMin = Vec3(INFINITY);
+	enSceneMax = Vec3(-INFINITY);
+	for (const PackChunk &chunk : enPack.chunks) {
+		enSceneMin = glm::min(enSceneMin, chunk.min);
+		enSceneMax = glm::max(enSceneMax, chunk.max);
 	}
+	enNormalLength = enPack.chunks.empty() ? 0.f : 0.02f*glm::length(enSceneMax - enSceneMin);
 
-	// Set up the engine's triangle references to point to engine vertices
-	for (uint32_t i=0; i<enScene.sceneObjectCount; i++) {
-		Mesh &mesh = *enScene.sceneObjects[i].mesh;
+	if (enSettings.WIREFRAME) {
+		std::cerr << "Streamed scenes have no edge list, the wireframe only shows the bounds of the missing chunks." << std::endl;
+	}
+
+	enStreamer.start(enPack, slots, enVerticies, enNormals, enUVs, enIndices);
+
+	std::cout << "Streaming: " << slots << " chunk slots of " << slotBytes/1024 << " KB (" << enSettings.STREAM_BUDGET_MB
+		<< " MB) for " << enPack.dataBytes/1024.f/1024.f << " MB of geometry" << std::endl;
+}
+
+// Points the frame at the instances it draws, all of them, or the resident ones in view when streamed
+void Engine::bindScene(Frame &frame, bool wait) {
+	if (enStreamed) {
+		enStreamer.update(frame, this->modelMatrix(frame.time), wait);
+		return;
+	}
+
+	frame.instances = enInstances;
+	frame.meshes = enMeshes;
+	frame.trisInstance = enTrisInstance;
+	frame.instanceCount = enInstanceCount;
+	frame.drawVxCount = enVxCount;
+	frame.drawTriCount = enTriCount;
+}
+
+// In file order, frames draw the objects of the textures loaded when they start.
+// A texture that fails to load is white, the scene is already on screen
+void Engine::loadTextures() {
+	TIME_PT tPt1 = TIME_NOW();
 
-		for (uint32_t j=0, k=0; j<mesh.triangleCount; j++) {
-			Tris3D_ref &tRef = enTrisRefBuffer[j];
-			tRef.v1 = &enVerticies[ mesh.indices[k++] ];
-			tRef.v2 = &enVerticies[ mesh.indices[k++] ];
-			tRef.v3 = &enVerticies[ mesh.indices[k++] ];
+	for (int i=0; i<enTextureCount; i++) {
+		if (enLoadStop) return;
+
+		if ( !enTextures[i].load(enTextureFiles[i]) ) {
+			uint32_t white = 0xFFFFFFFF;
+			enTextures[i].create(&white, 1, 1);
+			std::cerr << "Drawing the texture '" << enTextures[i].name << "' white." << std::endl;
 		}
+
+		enTexturesLoaded = i + 1;
 	}
 
-	enScene.unload();
+	if (enTextureCount > 0) {
+		std::cout << "Textures: " << enTextureCount << " loaded in " << TIME_DUR(TIME_NOW(), tPt1)/1E3F << " ms" << std::endl;
+	}
 }
 
 
 // Geometry Methods (Transformations, Sorting, Projection)
-// Transformation
-void Engine::transform() {
+// Model to view space at `time` (in s), the camera and the scene only move through it
+glm::mat4 Engine::modelMatrix(float time) {
 
 	// TODO: Replace with proper transformation matrices
 
 	Vec3 translation(0.f, 0.f, -3.f); 	// Move everything away from camera a bit
 
 	// float rotationX = glm::radians(45.0f); // in radians
-	float rotationY = glm::radians(10.0f); // in radians
+	float rotationY = glm::radians(10.0f + enSettings.ROTATION_SPEED*time); // in radians
 	// float rotationZ = glm::radians(10.0f); // in radians
 
 	float rotationX = 0.f; // in radians
 	// float rotationY = 0.f; // in radians
 	float rotationZ = 0.f; // in radians
 
+	// Translation * Z Rotation * Y Rotation * X Rotation
+	glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), translation);
+	modelMat = glm::rotate(modelMat, rotationZ, Vec3(0.0f, 0.0f, 1.0f));
+	modelMat = glm::rotate(modelMat, rotationY, Vec3(0.0f, 1.0f, 0.0f));
+	modelMat = glm::rotate(modelMat, rotationX, Vec3(1.0f, 0.0f, 0.0f));
+
+	return modelMat;
+}
+
+// Transformation
+void Engine::transform(Frame &frame) {
+	glm::mat4 modelMat = this->modelMatrix(frame.time);
+
+	// Rotations are applied after the translation, so the model matrix ends with it
+	glm::mat4 viewMat = glm::translate(glm::mat4(1.0f), Vec3(modelMat[3]));
 
-	glm::mat4 rotXMat = glm::rotate(glm::mat4(1.0f), rotationX, Vec3(1.0f, 0.0f, 0.0f));
-	glm::mat4 rotYMat = glm::rotate(glm::mat4(1.0f), rotationY, Vec3(0.0f, 1.0f, 0.0f));
-	glm::mat4 rotZMat = glm::rotate(glm::mat4(1.0f), rotationZ, Vec3(0.0f, 0.0f, 1.0f));
+	// Applying transformations to all verticies, in batches of INSTANCE_BATCH whatever the instance
+	// sizes: a chunk covers parts of one or more instances and every instance part runs the block kernel
+	enPool.parallelFor(frame.drawVxCount, INSTANCE_BATCH, [&](int begin, int end) {
+		int n = findInstance(frame.instances, frame.instanceCount, &Instance::firstVertex, begin);
 
-	std::cout << "Translation: " << translation.x << ", " << translation.y << ", " << translation.z << std::endl;
-	std::cout << "Rotation: " << rotationX << ", " << rotationY << ", " << rotationZ << std::endl;
+		for (int i=begin; i<end; n++) {
+			const Instance &inst = frame.instances[n];
+			const MeshRange &mesh = frame.meshes[inst.mesh];
 
-	// Applying transformations to all verticies
-	for (int i=0; i<enVxCount; i++) {
-		Vec3 &v = enVerticies[i];
+			int local = i - inst.firstVertex;
+			int count = std::min(end, (int) (inst.firstVertex + mesh.vertexCount)) - i;
 
-		// x Rotation
-		if (rotationX != 0)	{
-			Vec4 rx = rotXMat * Vec4(v, 1.0f);
-			v = Vec3(rx);
-		}
+			// Rigid instances keep the normals as they are, the others go through the inverse transpose
+			glm::mat4 m = modelMat * inst.transform;
+			glm::mat3 normalMat = inst.rigid ? glm::mat3(m) : glm::transpose( glm::inverse(glm::mat3(m)) );
 
-		// y Rotation
-		if (rotationY != 0)	{
-			Vec4 ry = rotYMat * Vec4(v, 1.0f);
-			v = Vec3(ry);
+			transformVerticies(enVerticies + mesh.firstVertex + local, enNormals + mesh.firstVertex + local, count, m, normalMat, inst.rigid,
+				frame.verticies + i, frame.normals + i);
+			i += count;
 		}
+	});
 
-		// z Rotation
-		if (rotationZ != 0)	{
-			Vec4 rz = rotZMat * Vec4(v, 1.0f);
-			v = Vec3(rz);
+	// Rebuilding the triangle references, sorting reorders them every frame
+	enPool.parallelFor(frame.drawTriCount, INSTANCE_BATCH, [&](int begin, int end) {
+		for (int i=begin; i<end; i++) {
+			const Instance &inst = frame.instances[ frame.trisInstance[i] ];
+			const uint32_t *idx = &enIndices[ frame.meshes[inst.mesh].firstIndex + 3*(i - inst.firstTriangle) ];
+			Vec3 *verts = frame.verticies + inst.firstVertex;
+
+			Tris3D_ref &tRef = frame.trisRef[i];
+			tRef.v1 = &verts[ idx[0] ];
+			tRef.v2 = &verts[ idx[1] ];
+			tRef.v3 = &verts[ idx[2] ];
+			tRef.id = i;
 		}
+	});
 
-		// Translation
-		v += translation;
+	// Lights stay put while the scene spins, only the translation applies
+	for (int i=0; i<enLightCount; i++) {
+		frame.lights[i] = enLights[i];
+		frame.lights[i].position = Vec3( viewMat * Vec4(enLights[i].position, 1.0f) );
 	}
-
 }
 
 // Sorting the geometry in Descending order of depth by Tris3D::getCenter().z
-void Engine::sortGeometry() {
-	std::sort(enTrisRefBuffer, enTrisRefBuffer + enTriCount, [](Tris3D_ref &a, Tris3D_ref &b) {
+// With depth testing, Ascending order instead, so hidden pixels fail early
+void Engine::sortGeometry(Frame &frame) {
+	// Edges need no order, the hidden line depth pass has its depth buffer
+	if (enSettings.WIREFRAME) return;
+
+	if (enSettings.DEPTH_TEST) {
+		std::sort(frame.trisRef, frame.trisRef + frame.drawTriCount, [](Tris3D_ref &a, Tris3D_ref &b) {
+			return a.getCenter().z > b.getCenter().z;
+		});
+		return;
+	}
+
+	std::sort(frame.trisRef, frame.trisRef + frame.drawTriCount, [](Tris3D_ref &a, Tris3D_ref &b) {
 		return a.getCenter().z < b.getCenter().z;
 	});
 }
 
-// TODO: Handle out of screen projected points
-// Projects 3D Reference Triangles to 2D Triangles
-void Engine::project() {
-	for (int i=0; i<enTriCount; i++) {
-		const Tris3D_ref tRef = enTrisRefBuffer[i];
-		Tris2D &out = enTrisProjectedBuffer[i];
-
-		Vec3 *inVecs[3] = {tRef.v1, tRef.v2, tRef.v3};
-		Vec2 *outVecs[3] = {&out.v1, &out.v2, &out.v3};
+// Geometry side of the pipeline statistics, the early-outs of the rasterizers.
+// False when the triangle faces away and `cullBack` drops it
+static bool cullStats(const Tris2D_p &tris, int w, int h, bool cullBack, PipelineStats &stats) {
+	const Vec4 &a = tris.v1;
+	const Vec4 &b = tris.v2;
+	const Vec4 &c = tris.v3;
+
+	// Counter clockwise in NDC is clockwise once y points down
+	float area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	if (area > 0.f) {
+		if (cullBack) {
+			stats.culledBack++;
+			return false;
+		}
+		stats.backFacing++;
+	}
 
-		for (int j=0; j<3; j++) {
-			Vec3 in_vec = *inVecs[j];     // Input Vector
-			Vec2 *out_vec = outVecs[j];   // Output Vector
+	if (std::abs(area) < 1E-8F) {
+		stats.culledSmall++;
+		return true;
+	}
 
-			Vec4 intr = projMat * Vec4(in_vec, 1.0f);
+	int xSt = std::max(0, (int) std::floor( std::min({a.x, b.x, c.x}) ));
+	int ySt = std::max(0, (int) std::floor( std::min({a.y, b.y, c.y}) ));
+	int xEn = std::min(w-1, (int) std::ceil( std::max({a.x, b.x, c.x}) ));
+	int yEn = std::min(h-1, (int) std::ceil( std::max({a.y, b.y, c.y}) ));
 
-			// Normalize intr coordinates
-			if (intr.w != 0) {
-				out_vec->x = intr.x/intr.w;
-				out_vec->y = intr.y/intr.w;
-			}
+	if (xSt > xEn || ySt > yEn) stats.culledFrustum++;
+	return true;
+}
 
-			// Normal Space to Screen Space conversion
-			// (-1, 1)  -- x2 ->  (0, 2)  -- /2 ->  (0, 1)  -- xS ->  (0, S)
-			out_vec->x = enSettings.W * (1.f+out_vec->x)/2.f;
-			out_vec->y = enSettings.H * (1.f-out_vec->y)/2.f;
-		}
+// Clip space planes of the clipper, a corner is on the inside of a plane when its distance is positive:
+// the near plane w = `near`, then the guard band, the rasterizers lose precision on larger screen coordinates
+#define CLIP_PLANES 5
+#define CLIP_CORNERS (3 + CLIP_PLANES)
+
+static inline float clipDistance(const Vec4 &v, int plane, float near) {
+	switch (plane) {
+		case 0:  return v.w - near;
+		case 1:  return GUARD_BAND*v.w - v.x;
+		case 2:  return GUARD_BAND*v.w + v.x;
+		case 3:  return GUARD_BAND*v.w - v.y;
+		default: return GUARD_BAND*v.w + v.y;
 	}
 }
 
+// Clips a triangle (clip space) against the clip planes, Sutherland-Hodgman.
+// Returns the corners of the polygon left (0 or 3 and more), with their weights of the corners of the triangle
+static int clipTriangle(const Vec4 clip[3], float near, Vec4 poly[CLIP_CORNERS], Vec3 weights[CLIP_CORNERS]) {
+	Vec4 polyIn[CLIP_CORNERS] = { clip[0], clip[1], clip[2] };
+	Vec3 weightsIn[CLIP_CORNERS] = { Vec3(1.f, 0.f, 0.f), Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f) };
+	int count = 3;
+
+	for (int plane=0; plane<CLIP_PLANES; plane++) {
+		int n = 0;
+		for (int j=0; j<count; j++) {
+			int k = (j+1) % count;
+			float dj = clipDistance(polyIn[j], plane, near);
+			float dk = clipDistance(polyIn[k], plane, near);
+
+			if (dj >= 0.f) {
+				poly[n] = polyIn[j];
+				weights[n++] = weightsIn[j];
+			}
 
-// Rendering Methods
-void Engine::rasterize() {
-	// Rendering Triangles from ss_points buffer
-	enSurface.fill(COLOR_BLACK);
-
-	Vec3 light_dir = glm::normalize( Vec3(-1.f, -1.f, -1.f) );
+			// The edge crosses the plane, cut from its inside corner so that the triangles sharing it cut it at the same point
+			if ( (dj >= 0.f) != (dk >= 0.f) ) {
+				int in = (dj >= 0.f) ? j : k;
+				int out = (dj >= 0.f) ? k : j;
+				float dIn = (dj >= 0.f) ? dj : dk;
+				float dOut = (dj >= 0.f) ? dk : dj;
+				float t = dIn/(dIn - dOut);
+				poly[n] = glm::mix(polyIn[in], polyIn[out], t);
+				weights[n++] = glm::mix(weightsIn[in], weightsIn[out], t);
+			}
+		}
 
-	// Drawing Triangles
-	for (int i=0; i<enTriCount; i++) {
-		Tris2D &tRender = enTrisProjectedBuffer[i];
-		Vec2 &a = tRender.v1;
-		Vec2 &b = tRender.v2;
-		Vec2 &c = tRender.v3;
+		count = n;
+		if (count < 3) return 0;
 
-		// Fill Triangle
-		Vec3 normal = enTrisRefBuffer[i].getNormal();
-		float light_intensity = glm::dot(normal, -light_dir);
-		Color fillColor = COLOR_BLUE * light_intensity;
+		std::copy(poly, poly + count, polyIn);
+		std::copy(weights, weights + count, weightsIn);
+	}
 
-		// enSurface.fillTris(tRender, COLOR_BLUE);
-		// enSurface.fillTris(tRender, fillColor);
-		enSurface.fillTris(tRender, normal);
+	return count;
+}
 
-		// Draw Triangle
-		// enSurface.drawTris(tRender, COLOR_WHITE, 1);
+// Projects 3D Reference Triangles to 2D Triangles, clipped against the near plane and the guard band
+void Engine::project(Frame &frame) {
+	frame.stats.reset();
+	frame.stats.vertices = frame.drawVxCount;
+	frame.projectedCount = 0;
 
-		// Draw Verticies
-		// enSurface.fillCircle(a, 2, COLOR_WHITE);
-		// enSurface.fillCircle(b, 2, COLOR_WHITE);
-		// enSurface.fillCircle(c, 2, COLOR_WHITE);
+	// Only the hidden line depth pass uses the projected triangles of a wireframe
+	if (enSettings.WIREFRAME && !enSettings.WIREFRAME_HIDDEN) {
+		frame.stats.submitted = frame.drawTriCount;
+		return;
 	}
 
-	// NOTE: Debug Center Lines
-	if (enSettings.DEBUG) {
-		int w = enSettings.W;
-		int h = enSettings.H;
-		enSurface.drawLine(0, h/2, w-1, h/2, COLOR_RED, 1);
-		enSurface.drawLine(w/2, 0, w/2, h-1, COLOR_GREEN, 1);
-	}
+	int w = frame.surface.surfWidth;
+	int h = frame.surface.surfHeight;
+	float near = std::max(enSettings.NEAR_CLIP, enSettings.EPSILON);
+	bool cullBack = enSettings.BACKFACE_CULLING;
+	bool loading = frame.residentTextures < enTextureCount;
+
+	// Clip space to screen space, keeping 1/w for perspective correct interpolation
+	auto toScreen = [&](const Vec4 &clip) {
+		float invW = 1.f/clip.w;
+
+		// Normal Space to Screen Space conversion
+		// (-1, 1)  -- x2 ->  (0, 2)  -- /2 ->  (0, 1)  -- xS ->  (0, S)
+		// then the sub pixel jitter of progressive refinement
+		return Vec4(
+			w * (1.f + clip.x*invW)/2.f + frame.jitter.x,
+			h * (1.f - clip.y*invW)/2.f + frame.jitter.y,
+			clip.z*invW,
+			invW
+		);
+	};
+
+	for (int i=0; i<frame.drawTriCount; i++) {
+		const Tris3D_ref tRef = frame.trisRef[i];
+
+		// Objects still waiting for their texture are not drawn
+		if (loading && !this->isResident(frame, frame.instances[ frame.trisInstance[tRef.id] ].object)) continue;
+
+		Vec4 clip[3] = {
+			frame.projection * Vec4(*tRef.v1, 1.f),
+			frame.projection * Vec4(*tRef.v2, 1.f),
+			frame.projection * Vec4(*tRef.v3, 1.f)
+		};
+
+		// Inside every clip plane, as most triangles are
+		uint32_t outside[3] = {0, 0, 0};
+		for (int j=0; j<3; j++) {
+			for (int plane=0; plane<CLIP_PLANES; plane++) {
+				if (clipDistance(clip[j], plane, near) < 0.f) outside[j] |= 1u << plane;
+			}
+		}
 
-	// Tonemapping
-	enSurface.tonemap();
-}
+		if ( (outside[0] | outside[1] | outside[2]) == 0 ) {
+			Tris2D_p &out = frame.trisProjected[frame.projectedCount++];
+			out = Tris2D_p( toScreen(clip[0]), toScreen(clip[1]), toScreen(clip[2]), tRef.id );
+			if ( !cullStats(out, w, h, cullBack, frame.stats) ) frame.projectedCount--;
+			continue;
+		}
 
-void Engine::render() {
-	// Copying data to 32 bit buffer
-	enSurface.toU32Surface(enTextureBuffer);
+		// Outside of the same plane, behind the camera or far off screen
+		uint32_t culled = outside[0] & outside[1] & outside[2];
+		if (culled != 0) {
+			if (culled & 1u) frame.stats.culledNear++;
+			else frame.stats.culledFrustum++;
+			continue;
+		}
 
-	// Copying data to VRAM
-	SDL_UpdateTexture(SDLTexture, NULL, enTextureBuffer, enSettings.W*4);
-	if ( !SDLTexture ) {
-		SDL_Log("SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
-		return;
+		// Crossing a plane, cut into a fan of triangles
+		Vec4 poly[CLIP_CORNERS];
+		Vec3 weights[CLIP_CORNERS];
+		int corners = clipTriangle(clip, near, poly, weights);
+
+		if (corners < 3) {
+			frame.stats.culledFrustum++;
+			continue;
+		}
+
+		// Room for the pieces and for every triangle left
+		frame.stats.clipped++;
+		frame.reserveProjected(frame.projectedCount + (corners - 2) + (frame.drawTriCount - i - 1));
+
+		for (int k=1; k+1<corners; k++) {
+			Tris2D_p &out = frame.trisProjected[frame.projectedCount++];
+			out = Tris2D_p( toScreen(poly[0]), toScreen(poly[k]), toScreen(poly[k+1]), tRef.id );
+			out.clipped = true;
+			out.weights[0] = weights[0];
+			out.weights[1] = weights[k];
+			out.weights[2] = weights[k+1];
+			if ( !cullStats(out, w, h, cullBack, frame.stats) ) frame.projectedCount--;
+		}
 	}
 
-	// Presenting to Display device
-	SDL_RenderClear(SDLRenderer);
-	SDL_RenderTexture(SDLRenderer, SDLTexture, NULL, NULL);
-	SDL_RenderPresent(SDLRenderer);
+	// Sent to the raster stage, with the ones culled by the clipper and the back faces
+	frame.stats.submitted = frame.projectedCount + frame.stats.culledNear + frame.stats.culledFrustum + frame.stats.culledBack;
 }
 
 
-void Engine::pipeline(const char *filename) {
-	// Loading Scene into Memory
-	// this->loadScene("Scenes/default.json");
-	this->loadScene(filename);
+// Records the debug overlay of this frame, the raster stage draws it after tonemapping
+void Engine::recordDebug(Frame &frame) {
+	DebugDraw &debug = frame.debugDraw;
+	int w = frame.surface.surfWidth;
+	int h = frame.surface.surfHeight;
 
+	debug.begin(w, h, frame.projection);
 
-	TIME_PT tPtTransform1, tPtTransform2, tPtSortGeo1, tPtSortGeo2, tPtProject1, tPtProject2, tPtRaster1, tPtRaster2;
+	// Every unique edge, the overlays draw over them
+	if (enSettings.WIREFRAME) {
+		enPool.parallelFor(frame.drawVxCount, 4096, [&](int begin, int end) {
+			for (int i=begin; i<end; i++) {
+				frame.clipVerticies[i] = frame.projection * Vec4(frame.verticies[i], 1.0f);
+			}
+		});
 
-	// Transformation
-	// TODO: Fix it with parameters properly
-	// NOTE: This is just for testing purposes
-	tPtTransform1 = TIME_NOW();
-	this->transform();
-	tPtTransform2 = TIME_NOW();
+		for (int i=0; i<frame.instanceCount; i++) {
+			if ( !this->isResident(frame, frame.instances[i].object) ) continue;
 
+			const MeshRange &mesh = frame.meshes[ frame.instances[i].mesh ];
+			debug.lines(frame.clipVerticies + frame.instances[i].firstVertex, enEdges + 2*mesh.firstEdge, mesh.edgeCount, COLOR_WHITE, enSettings.WIREFRAME_HIDDEN, enPool);
+		}
+	}
 
-	// Sorting Geometry
-	tPtSortGeo1 = TIME_NOW();
-	this->sortGeometry();
-	tPtSortGeo2 = TIME_NOW();
+	// Instances of the chunks still streaming in
+	if ( !frame.placeholders.empty() ) {
+		glm::mat4 modelMat = this->modelMatrix(frame.time);
+		for (size_t i=0; i<frame.placeholders.size(); i+=2) {
+			debug.aabb(modelMat, frame.placeholders[i], frame.placeholders[i+1], COLOR_GRAY);
+		}
+	}
 
+	if (enSettings.DEBUG_BOUNDS) {
+		glm::mat4 modelMat = this->modelMatrix(frame.time);
+		for (int i=0; i<frame.instanceCount; i++) {
+			const MeshRange &mesh = frame.meshes[ frame.instances[i].mesh ];
+			debug.aabb(modelMat * frame.instances[i].transform, mesh.min, mesh.max, COLOR_YELLOW);
+		}
+	}
 
-	// Projection
-	tPtProject1 = TIME_NOW();
-	this->project();
-	tPtProject2 = TIME_NOW();
+	if (enSettings.DEBUG_NORMALS) {
+		for (int i=0; i<frame.drawVxCount; i++) {
+			debug.normal(frame.verticies[i], frame.normals[i], enNormalLength, COLOR_BLUE);
+		}
+	}
 
+	if (enSettings.DEBUG_VERTICES) {
+		for (int i=0; i<frame.drawVxCount; i++) {
+			debug.point3D(frame.verticies[i], 1, COLOR_WHITE);
+		}
+	}
 
-	// Rasterization
-	tPtRaster1 = TIME_NOW();
-	this->rasterize();
-	tPtRaster2 = TIME_NOW();
+	// Center lines
+	if (enSettings.DEBUG) {
+		debug.line(Vec2(0.f, h/2 + 0.5f), Vec2((float) w, h/2 + 0.5f), COLOR_RED);
+		debug.line(Vec2(w/2 + 0.5f, 0.f), Vec2(w/2 + 0.5f, (float) h), COLOR_GREEN);
+	}
+}
 
-	// Logging
-	auto tTransformuS = TIME_DUR(tPtTransform2, tPtTransform1);
-	auto tSortuS   = TIME_DUR(tPtSortGeo2, tPtSortGeo1);
-	auto tProjectuS = TIME_DUR(tPtProject2, tPtProject1);
-	auto tRasteruS  = TIME_DUR(tPtRaster2, tPtRaster1);
+// Renders the shadow maps of the shadow casting lights, every cascade in parallel
+void Engine::shadowPass(Frame &frame) {
+	if (enSettings.SHADOWS == false || frame.cheapShading || enSettings.WIREFRAME) {
+		for (int i=0; i<frame.lightCount; i++) {
+			frame.shadowMaps[i].cascadeCount = 0;
+		}
+		return;
+	}
 
-	std::cout
-		<< "\nTransform: " << tTransformuS << "/" << (tTransformuS/1E3F) << " \t"
-		<< "Sort: "      << tSortuS        << "/" << (tSortuS/1E3F)	     << " \t"
-		<< "Project: "   << tProjectuS     << "/" << (tProjectuS/1E3F)	 << " \t"
-		<< "Raster: "    << tRasteruS      << "/" << (tRasteruS/1E3F)	 << " \t(us/ms)\n";
+	// View space bounds of the geometry, the cascades are fitted to them
+	Vec3 bbMin(INFINITY), bbMax(-INFINITY);
+	for (int i=0; i<frame.drawVxCount; i++) {
+		bbMin = glm::min(bbMin, frame.verticies[i]);
+		bbMax = glm::max(bbMax, frame.verticies[i]);
+	}
 
+	float tanHalfFovY = std::tan( glm::radians(frame.fov)/2.f );
 
-	float lastLogTime = 0.f;
-	TIME_PT tPtRender1, tPtRender2, tDt1, tDt2;
+	// (light, cascade) pairs
+	std::vector< std::pair<int, int> > jobs;
 
-	tDt1 = TIME_NOW();
+	for (int i=0; i<frame.lightCount; i++) {
+		ShadowMap &map = frame.shadowMaps[i];
+		map.cascadeCount = 0;
 
-	// Main Loop
-	while (isRunning) {
+		if ( !frame.lights[i].castShadows ) continue;
 
-		// Calculate delta time
-		{
-			tDt2 = TIME_NOW();
-			deltaTime = TIME_DUR(tDt2, tDt1)/1E6F;
-			tDt1 = TIME_NOW();
+		map.setup(frame.lights[i], enSettings.SHADOW_MAP_SIZE, enSettings.SHADOW_CASCADES, bbMin, bbMax, tanHalfFovY, frame.aspect);
+		for (int c=0; c<map.cascadeCount; c++) {
+			jobs.push_back({i, c});
 		}
+	}
 
+	// Blended instances do not cast shadows
+	enPool.parallelFor(jobs.size(), 1, [&](int begin, int end) {
+		for (int j=begin; j<end; j++) {
+			ShadowMap &map = frame.shadowMaps[ jobs[j].first ];
+			map.clear(jobs[j].second);
 
-		// Handle Events
-		this->handleEvents();
+			for (int i=0; i<frame.instanceCount; i++) {
+				const Instance &inst = frame.instances[i];
+				const MeshRange &mesh = frame.meshes[inst.mesh];
+				if (enMaterials[inst.object].blend != BlendMode::OPAQUE || !this->isResident(frame, inst.object)) continue;
 
+				map.render(jobs[j].second, frame.verticies + inst.firstVertex, mesh.vertexCount, enIndices + mesh.firstIndex, mesh.triangleCount);
+			}
+		}
+	});
+}
 
-		// Render
-		tPtRender1 = TIME_NOW();
-			this->render();
-		tPtRender2 = TIME_NOW();
 
-		lastLogTime += deltaTime;
+// Rendering Methods
+// Picks the rasterizer specialization for the blend and depth state
+template <typename VS, typename FS>
+static inline void drawTris(Frame &frame, const Tris2D_p &tris, BlendMode blend, DepthMode depth, const VS &vs, const FS &fs) {
+	if (blend == BlendMode::OPAQUE) {
+		switch (depth) {
+			case DepthMode::NONE:
+				rasterTris< RasterState<DepthMode::NONE, BlendMode::OPAQUE> >(frame.surface, frame.depth, tris, vs, fs, frame.stats);
+				break;
+			case DepthMode::EQUAL:
+				rasterTris< RasterState<DepthMode::EQUAL, BlendMode::OPAQUE> >(frame.surface, frame.depth, tris, vs, fs, frame.stats);
+				break;
+			default:
+				rasterTris< RasterState<DepthMode::TEST_WRITE, BlendMode::OPAQUE> >(frame.surface, frame.depth, tris, vs, fs, frame.stats);
+				break;
+		}
+	}
+	else {
+		if (depth == DepthMode::NONE) {
+			rasterTris< RasterState<DepthMode::NONE, BlendMode::ADDITIVE> >(frame.surface, frame.depth, tris, vs, fs, frame.stats);
+		}
+		else {
+			rasterTris< RasterState<DepthMode::TEST, BlendMode::ADDITIVE> >(frame.surface, frame.depth, tris, vs, fs, frame.stats);
+		}
+	}
+}
 
-		// Logs all the timings
-		if ( lastLogTime>enSettings.UPDATE_TIME ) {
-			lastLogTime = 0.f;
+// Same with `SAMPLES` MSAA samples per pixel
+template <int SAMPLES, typename VS, typename FS>
+static inline void drawTrisMS(Frame &frame, const Tris2D_p &tris, BlendMode blend, DepthMode depth, const VS &vs, const FS &fs) {
+	int w = frame.surface.surfWidth;
+	int h = frame.surface.surfHeight;
 
-			auto tRender = TIME_DUR(tPtRender2, tPtRender1);
-			std::cout << "FPS " << 1/deltaTime << "\tRender  " << tRender/1E3F << " ms\tdt " << deltaTime*1E3F << " ms\n";
+	if (blend == BlendMode::OPAQUE) {
+		if (depth == DepthMode::NONE) {
+			rasterTrisMS< SAMPLES, RasterState<DepthMode::NONE, BlendMode::OPAQUE> >(frame.samples, frame.depth, w, h, tris, vs, fs, frame.stats);
+		}
+		else {
+			rasterTrisMS< SAMPLES, RasterState<DepthMode::TEST_WRITE, BlendMode::OPAQUE> >(frame.samples, frame.depth, w, h, tris, vs, fs, frame.stats);
 		}
 	}
+	else {
+		if (depth == DepthMode::NONE) {
+			rasterTrisMS< SAMPLES, RasterState<DepthMode::NONE, BlendMode::ADDITIVE> >(frame.samples, frame.depth, w, h, tris, vs, fs, frame.stats);
+		}
+		else {
+			rasterTrisMS< SAMPLES, RasterState<DepthMode::TEST, BlendMode::ADDITIVE> >(frame.samples, frame.depth, w, h, tris, vs, fs, frame.stats);
+		}
+	}
+}
 
+// Picks the MSAA specialization, 1 sample is the plain rasterizer
+template <typename VS, typename FS>
+static inline void drawTris(Frame &frame, const Tris2D_p &tris, BlendMode blend, DepthMode depth, int samples, const VS &vs, const FS &fs) {
+	switch (samples) {
+		case 2:  drawTrisMS<2>(frame, tris, blend, depth, vs, fs); break;
+		case 4:  drawTrisMS<4>(frame, tris, blend, depth, vs, fs); break;
+		case 8:  drawTrisMS<8>(frame, tris, blend, depth, vs, fs); break;
+		default: drawTris(frame, tris, blend, depth, vs, fs);      break;
+	}
+}
 
-	TIME_PT tPtSave1, tPtSave2;
-	// Save the Surface
-	tPtSave1 = TIME_NOW();
-	enSurface.savePNG( std::format("Out/{}.png", enScene.name.c_str()).c_str() );
-	tPtSave2 = TIME_NOW();
+// Builds the shader pair of the material of triangle `i` and hands it to `draw(vs, fs)`
+template <typename DrawFn>
+void Engine::withShaders(Frame &frame, int i, const ShadingContext &ctx, DrawFn &&draw) {
+	const Tris2D_p &tris = frame.trisProjected[i];
+	const Instance &inst = frame.instances[ frame.trisInstance[tris.id] ];
+	const MeshRange &mesh = frame.meshes[inst.mesh];
+	const Material &material = enMaterials[inst.object];
+
+	// Verticies of the triangle, in the frame buffers and in the mesh library (UVs)
+	const uint32_t *meshIdx = &enIndices[ mesh.firstIndex + 3*(tris.id - inst.firstTriangle) ];
+	const uint32_t idx[3] = {inst.firstVertex + meshIdx[0], inst.firstVertex + meshIdx[1], inst.firstVertex + meshIdx[2]};
+	const uint32_t uvIdx[3] = {mesh.firstVertex + meshIdx[0], mesh.firstVertex + meshIdx[1], mesh.firstVertex + meshIdx[2]};
+
+	// A texture multiplies the colour of the lit shading models
+	auto drawLit = [&](const auto &vs, const auto &fs) {
+		using VS = std::decay_t<decltype(vs)>;
+		using FS = std::decay_t<decltype(fs)>;
+
+		if (material.texture >= 0) {
+			TexturedVS<VS> tvs = { vs, enUVs, uvIdx };
+			TexturedFS<FS> tfs = { fs, Sampler{ &enTextures[material.texture] } };
+			draw(tvs, tfs);
+		}
+		else {
+			draw(vs, fs);
+		}
+	};
+
+	switch (material.shading) {
+		case ShadingModel::FLAT: {
+			// Lit once at the centroid of the source triangle, with the lights of the tile it lands in
+			Tris3D_ref tRef(&frame.verticies[idx[0]], &frame.verticies[idx[1]], &frame.verticies[idx[2]]);
+			int cx = (int) ( (tris.v1.x + tris.v2.x + tris.v3.x)/3.f );
+			int cy = (int) ( (tris.v1.y + tris.v2.y + tris.v3.y)/3.f );
+			ConstantFS fs = { shadeLit(ctx, tRef.getCenter(), tRef.getNormal(), material.color, cx, cy) };
+			drawLit(NullVS(), fs);
+			break;
+		}
 
-	uint64_t t_save_us   = TIME_DUR(tPtSave2, tPtSave1);
-	std::cout << "\nSave\t " << t_save_us / 1000.f << " ms\n\n";
+		case ShadingModel::GOURAUD: {
+			GouraudVS vs = { ctx, frame.verticies, frame.normals, idx, &tris, material.color };
+			drawLit(vs, ColorFS());
+			break;
+		}
+
+		case ShadingModel::PHONG: {
+			PhongVS vs = { frame.verticies, frame.normals, idx };
+			PhongFS fs = { ctx, material.color };
+			drawLit(vs, fs);
+			break;
+		}
+
+		case ShadingModel::NORMAL: {
+			NormalVS vs = { frame.normals, idx };
+			draw(vs, NormalFS());
+			break;
+		}
+
+		case ShadingModel::UV: {
+			UVVS vs = { enUVs, uvIdx };
+			draw(vs, UVFS());
+			break;
+		}
+	}
+}
+
+// Forward rendering, shades every triangle of `blend` as it is rasterized
+void Engine::drawGeometry(Frame &frame, BlendMode blend, DepthMode depth, int samples, const ShadingContext &ctx) {
+	// Drawing Triangles
+	for (int i=0; i<frame.projectedCount; i++) {
+		const Tris2D_p &tRender = frame.trisProjected[i];
+
+		if (this->trisMaterial(frame, tRender.id).blend != blend) continue;
+
+		// Fill Triangle
+		this->withShaders(frame, i, ctx, [&](const auto &vs, const auto &fs) {
+			drawTris(frame, tRender, blend, depth, samples, vs, fs);
+		});
+
+		// Draw Triangle
+		// frame.surface.drawTris(tRender.toTris2D(), COLOR_WHITE, 1);
+	}
+}
+
+// Depth only pass of the opaque triangles, forward shading then only shades the visible ones
+void Engine::depthPass(Frame &frame) {
+	Surface &surface = frame.surface;
+
+	for (int i=0; i<frame.projectedCount; i++) {
+		const Tris2D_p &tRender = frame.trisProjected[i];
+
+		if (this->trisMaterial(frame, tRender.id).blend != BlendMode::OPAQUE) continue;
+
+		rasterTrisDepth(frame.depth, surface.surfWidth, surface.surfHeight, tRender);
+	}
+}
+
+// Visibility buffer, first pass: triangle index and depth of every pixel, no shading
+void Engine::visibilityPass(Frame &frame) {
+	Surface &surface = frame.surface;
+	std::fill(frame.visibility, frame.visibility + surface.surfSize, VISIBILITY_EMPTY);
+
+	for (int i=0; i<frame.projectedCount; i++) {
+		const Tris2D_p &tRender = frame.trisProjected[i];
+
+		if (this->trisMaterial(frame, tRender.id).blend != BlendMode::OPAQUE) continue;
+
+		rasterTrisID(frame.visibility, frame.depth, surface.surfWidth, surface.surfHeight, tRender, i, frame.stats);
+	}
+}
+
+// Visibility buffer, second pass: shades every covered pixel exactly once, rows in parallel
+void Engine::shadingPass(Frame &frame, const ShadingContext &ctx) {
+	Surface &surface = frame.surface;
+	int w = surface.surfWidth;
+
+	int h = surface.surfHeight;
+
+	// Shaded pixels, each task counts its own
+	std::atomic<uint64_t> shaded = 0;
+
+	// By 2x2 quads, the pixels of a quad seeing the same triangle are shaded together,
+	// textured shaders take their derivatives from them
+	enPool.parallelFor((h + 1)/2, 4, [&](int begin, int end) {
+		uint64_t count = 0;
+
+		for (int y=2*begin; y<std::min(h, 2*end); y+=2) {
+			for (int x=0; x<w; x+=2) {
+				uint32_t ids[4];
+				for (int k=0; k<4; k++) {
+					int px = x + (k & 1);
+					int py = y + (k >> 1);
+					ids[k] = (px < w && py < h) ? frame.visibility[py*w + px] : VISIBILITY_EMPTY;
+				}
+
+				for (int k=0; k<4; k++) {
+					uint32_t id = ids[k];
+					if (id == VISIBILITY_EMPTY) continue;
+
+					// Lanes of this triangle, they are done afterwards
+					uint32_t mask = 0;
+					for (int j=k; j<4; j++) {
+						if (ids[j] != id) continue;
+						mask |= 1u << j;
+						ids[j] = VISIBILITY_EMPTY;
+					}
+
+					Color out[4];
+					this->withShaders(frame, id, ctx, [&](const auto &vs, const auto &fs) {
+						shadeQuad(frame.trisProjected[id], x, y, mask, vs, fs, out);
+					});
+
+					for (int j=k; j<4; j++) {
+						if (mask & (1u << j)) surface.data()[(y + (j >> 1))*w + x + (j & 1)] = out[j];
+					}
+					count += std::popcount(mask);
+				}
+			}
+		}
+
+		shaded += count;
+	});
+
+	frame.stats.pixelsShaded += shaded;
+}
+
+void Engine::rasterize(Frame &frame) {
+	Surface &surface = frame.surface;
+	bool visibility = enSettings.VISIBILITY_BUFFER;
+	bool depthTest = enSettings.DEPTH_TEST || visibility;
+	bool prepass = depthTest && enSettings.DEPTH_PREPASS;
+
+	// Edges only, hidden behind the depth of the opaque triangles
+	if (enSettings.WIREFRAME) {
+		surface.fill(COLOR_BLACK);
+
+		if (enSettings.WIREFRAME_HIDDEN) {
+			std::fill(frame.depth, frame.depth + surface.surfSize, 0.f);
+			this->depthPass(frame);
+		}
+
+		frame.debugDraw.draw(surface, enPool, enSettings.WIREFRAME_HIDDEN ? frame.depth : nullptr);
+		return;
+	}
+
+	// Samples per pixel, the visibility buffer and the depth pre-pass only have one,
+	// progressive refinement accumulates jittered frames instead
+	int samples = (visibility || prepass || frame.refineStep >= 0) ? 1 : frame.sampleCount;
+
+	// Rendering Triangles from ss_points buffer
+	if (samples > 1) {
+		std::fill(frame.samples, frame.samples + surface.surfSize*samples, COLOR_BLACK);
+	}
+	else {
+		surface.fill(COLOR_BLACK);
+	}
+
+	if (depthTest) {
+		std::fill(frame.depth, frame.depth + surface.surfSize*samples, 0.f);
+	}
+
+	ShadingContext ctx = { frame.lights, &frame.lightGrid, frame.shadowMaps, enSettings.SHADOW_PCF, enSettings.SHADOW_BIAS };
+
+	// Opaque triangles first, blended ones on top of them
+	// Light tiles get depth bounds from the visibility or depth pre-pass, plain forward shading only has their screen rectangle
+	if (visibility) {
+		this->visibilityPass(frame);
+		frame.lightGrid.build(frame.lights, frame.lightCount, frame.depth, frame.projection, enSettings.LIGHT_CULLING, enPool);
+		this->shadingPass(frame, ctx);
+	}
+	else if (prepass) {
+		this->depthPass(frame);
+		frame.lightGrid.build(frame.lights, frame.lightCount, frame.depth, frame.projection, enSettings.LIGHT_CULLING, enPool);
+		this->drawGeometry(frame, BlendMode::OPAQUE, DepthMode::EQUAL, 1, ctx);
+	}
+	else {
+		frame.lightGrid.build(frame.lights, frame.lightCount, nullptr, frame.projection, enSettings.LIGHT_CULLING, enPool);
+		this->drawGeometry(frame, BlendMode::OPAQUE, depthTest ? DepthMode::TEST_WRITE : DepthMode::NONE, samples, ctx);
+	}
+
+	this->drawGeometry(frame, BlendMode::ADDITIVE, depthTest ? DepthMode::TEST : DepthMode::NONE, samples, ctx);
+
+	if (frame.accumIndex >= 0) {
+		this->accumulate(frame);
+	}
+
+	// Tonemapping, resolving the samples on the way
+	if (samples > 1) {
+		surface.tonemap(frame.samples, samples);
+	}
+	else {
+		surface.tonemap();
+	}
+
+	frame.stats.pixels = surface.surfSize;
+
+	if (enDebugView != DebugView::NONE) {
+		this->debugView(frame, ctx);
+	}
+
+	// NOTE: Debug overlay, pure colours are the same before and after tonemapping
+	frame.debugDraw.draw(surface, enPool);
+}
+
+/*
+Heatmaps of the frame, drawn over its image:
+	OVERDRAW	fragments written per pixel by forward rendering in the depth mode of the
+				frame (the visibility buffer and the pre-pass write once, their overdraw is
+				in the depth pass), red at 4 and above
+	DENSITY		sum of 1/area over the triangles covering a pixel, the number of triangles
+				per pixel, red at one triangle per pixel and above
+	TILE_COST	forward rasterization and shading time of every STATS_TILE tile, each
+				triangle is timed and its time spread over the tiles its bounds overlap,
+				red at the most expensive tile
+*/
+void Engine::debugView(Frame &frame, const ShadingContext &ctx) {
+	Surface &surface = frame.surface;
+	int w = surface.surfWidth;
+	int h = surface.surfHeight;
+	bool depthTest = enSettings.DEPTH_TEST || enSettings.VISIBILITY_BUFFER;
+	float maxValue = 1.f;
+
+	// The frame is rasterized again, its counters are kept as they were
+	PipelineStats counted = frame.stats;
+
+	surface.fill(COLOR_BLACK);
+	std::fill(frame.depth, frame.depth + surface.surfSize, 0.f);
+
+	// Opaque triangles first, like rasterize()
+	auto forEachTris = [&](auto &&fn) {
+		for (BlendMode blend : {BlendMode::OPAQUE, BlendMode::ADDITIVE}) {
+			for (int i=0; i<frame.projectedCount; i++) {
+				if (this->trisMaterial(frame, frame.trisProjected[i].id).blend == blend) fn(i, blend);
+			}
+		}
+	};
+
+	switch (enDebugView) {
+		case DebugView::OVERDRAW: {
+			ConstantFS one = { Color(1.f) };
+			forEachTris([&](int i, BlendMode blend) {
+				const Tris2D_p &tris = frame.trisProjected[i];
+
+				if ( !depthTest ) {
+					rasterTris< RasterState<DepthMode::NONE, BlendMode::ADDITIVE> >(surface, frame.depth, tris, NullVS(), one, frame.stats);
+				}
+				else if (blend == BlendMode::OPAQUE) {
+					rasterTris< RasterState<DepthMode::TEST_WRITE, BlendMode::ADDITIVE> >(surface, frame.depth, tris, NullVS(), one, frame.stats);
+				}
+				else {
+					rasterTris< RasterState<DepthMode::TEST, BlendMode::ADDITIVE> >(surface, frame.depth, tris, NullVS(), one, frame.stats);
+				}
+			});
+			maxValue = 4.f;
+			break;
+		}
+
+		case DebugView::DENSITY: {
+			forEachTris([&](int i, BlendMode) {
+				const Tris2D_p &tris = frame.trisProjected[i];
+				const Vec4 &a = tris.v1, &b = tris.v2, &c = tris.v3;
+
+				float area = 0.5f*std::abs( (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x) );
+				ConstantFS fs = { Color(1.f/std::max(area, 1E-3F)) };
+				rasterTris< RasterState<DepthMode::NONE, BlendMode::ADDITIVE> >(surface, frame.depth, tris, NullVS(), fs, frame.stats);
+			});
+			maxValue = 1.f;
+			break;
+		}
+
+		case DebugView::TILE_COST: {
+			int tilesX = (w + STATS_TILE - 1)/STATS_TILE;
+			int tilesY = (h + STATS_TILE - 1)/STATS_TILE;
+			std::vector<float> cost(tilesX*tilesY, 0.f);
+
+			forEachTris([&](int i, BlendMode blend) {
+				const Tris2D_p &tris = frame.trisProjected[i];
+				DepthMode depth = !depthTest ? DepthMode::NONE : (blend == BlendMode::OPAQUE) ? DepthMode::TEST_WRITE : DepthMode::TEST;
+
+				TIME_PT tPt1 = TIME_NOW();
+				this->withShaders(frame, i, ctx, [&](const auto &vs, const auto &fs) {
+					drawTris(frame, tris, blend, depth, 1, vs, fs);
+				});
+				float ns = (float) TIME_DUR_NS(TIME_NOW(), tPt1);
+
+				const Vec4 &a = tris.v1, &b = tris.v2, &c = tris.v3;
+				int xSt = std::max(0, (int) std::floor( std::min({a.x, b.x, c.x}) ));
+				int ySt = std::max(0, (int) std::floor( std::min({a.y, b.y, c.y}) ));
+				int xEn = std::min(w-1, (int) std::ceil( std::max({a.x, b.x, c.x}) ));
+				int yEn = std::min(h-1, (int) std::ceil( std::max({a.y, b.y, c.y}) ));
+				if (xSt > xEn || ySt > yEn) return;
+
+				float perPixel = ns/((xEn - xSt + 1)*(yEn - ySt + 1));
+				for (int ty=ySt/STATS_TILE; ty<=yEn/STATS_TILE; ty++) {
+					int rows = std::min(yEn, ty*STATS_TILE + STATS_TILE - 1) - std::max(ySt, ty*STATS_TILE) + 1;
+
+					for (int tx=xSt/STATS_TILE; tx<=xEn/STATS_TILE; tx++) {
+						int cols = std::min(xEn, tx*STATS_TILE + STATS_TILE - 1) - std::max(xSt, tx*STATS_TILE) + 1;
+						cost[ty*tilesX + tx] += perPixel*rows*cols;
+					}
+				}
+			});
+
+			for (int ty=0; ty<tilesY; ty++) {
+				for (int tx=0; tx<tilesX; tx++) {
+					surface.fillRect(tx*STATS_TILE, ty*STATS_TILE, STATS_TILE, STATS_TILE, Color(cost[ty*tilesX + tx]));
+				}
+			}
+			maxValue = *std::max_element(cost.begin(), cost.end());
+			break;
+		}
+
+		default:
+			return;
+	}
+
+	frame.stats = counted;
+	surface.heatmap(maxValue);
+}
+
+// Calls `fn` with the presented image of `frame`, a surface of its format
+template <typename Fn>
+void Engine::withDisplay(Frame &frame, Fn &&fn) {
+	int w = frame.surface.surfWidth;
+	int h = frame.surface.surfHeight;
+
+	switch (frame.displayFormat) {
+		case PixelFormat::RGBA16F: { SurfaceRGBA16F display((Half4 *) frame.display, w, h); fn(display); break; }
+		case PixelFormat::RGB10A2: { SurfaceRGB10A2 display((uint32_t *) frame.display, w, h); fn(display); break; }
+		case PixelFormat::RGBA8:   { SurfaceRGBA8 display((Byte4 *) frame.display, w, h); fn(display); break; }
+		case PixelFormat::SRGBA8:  { SurfaceSRGBA8 display((Byte4 *) frame.display, w, h); fn(display); break; }
+		default: fn(frame.surface); break;
+	}
+}
+
+// Presented image in SURFACE_FORMAT, quantized on the workers after the tonemapping,
+// the main thread only converts the formats SDLTexture does not take
+void Engine::encodeDisplay(Frame &frame) {
+	if (frame.displayFormat == PixelFormat::RGB32F) return;
+
+	const Color *image = frame.surface.data();
+	this->withDisplay(frame, [&](auto &display) {
+		enPool.parallelFor(display.surfSize, 4096, [&](int begin, int end) {
+			display.encodeDisplay(image, begin, end);
+		});
+	});
+}
+
+void Engine::render(Frame &frame) {
+	// Headless, nothing to present
+	if ( !SDLWindow ) return;
+
+	// Copying data to 32 bit buffer, 8 bit presented images already are
+	const void *pixels = frame.textureBuffer;
+	if (frame.displayFormat == PixelFormat::RGB32F) {
+		frame.surface.toU32Surface(frame.textureBuffer);
+	}
+	else if (frame.displayFormat == PixelFormat::RGBA8 || frame.displayFormat == PixelFormat::SRGBA8) {
+		pixels = frame.display;
+	}
+	else {
+		this->withDisplay(frame, [&](auto &display) { display.toU32Surface(frame.textureBuffer); });
+	}
+
+	// Copying data to VRAM, frames below the window resolution only fill a corner of the texture
+	int w = frame.surface.surfWidth;
+	int h = frame.surface.surfHeight;
+	SDL_Rect rect = {0, 0, w, h};
+
+	SDL_UpdateTexture(SDLTexture, &rect, pixels, w*4);
+	if ( !SDLTexture ) {
+		SDL_Log("SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
+		return;
+	}
+
+	// Presenting to Display device, upscaled to the window
+	SDL_FRect srcRect = {0.f, 0.f, (float) w, (float) h};
+	SDL_RenderClear(SDLRenderer);
+	SDL_RenderTexture(SDLRenderer, SDLTexture, &srcRect, NULL);
+	SDL_RenderPresent(SDLRenderer);
+}
+
+
+// Pipeline Stages
+/*
+Frames circulate between three stages through the queues:
+	enFreeFrames -> geometryStage() -> enRasterFrames -> rasterStage() -> enPresentFrames -> pipeline()
+so with N frames in flight, frame i+1 is transformed while frame i is
+rasterized and frame i-1 is resolved and presented.
+*/
+void Engine::startPipeline() {
+	tPtStart = TIME_NOW();
+
+	for (int i=0; i<enFrameCount; i++) {
+		enFreeFrames.push(&enFrames[i]);
+	}
+
+	enGeometryThread = std::thread(&Engine::geometryStage, this);
+	enRasterThread = std::thread(&Engine::rasterStage, this);
+}
+
+void Engine::stopPipeline() {
+	enFreeFrames.close();
+	enRasterFrames.close();
+	enPresentFrames.close();
+
+	if (enGeometryThread.joinable()) enGeometryThread.join();
+	if (enRasterThread.joinable()) enRasterThread.join();
+}
+
+void Engine::geometryStage() {
+	Frame *frame;
+	uint64_t frameIndex = 0;
+
+	while ( enFreeFrames.pop(frame) ) {
+		TIME_PT tPtGeometry1 = TIME_NOW();
+
+		frame->time = TIME_DUR(tPtGeometry1, tPtStart)/1E6F;
+
+		if (enSettings.PROGRESSIVE) {
+			// Holds on to the frame while the view stays converged
+			while ( !this->refineFrame(*frame) ) {
+				if ( enFreeFrames.closed() ) return;
+
+				std::this_thread::sleep_for(milliseconds(10));
+				tPtGeometry1 = TIME_NOW();
+				frame->time = TIME_DUR(tPtGeometry1, tPtStart)/1E6F;
+			}
+		}
+		else {
+			float scale = enRenderScale;
+			frame->resize( (int) std::round(enSettings.W*scale), (int) std::round(enSettings.H*scale) );
+		}
+
+		frame->index = frameIndex++;
+		frame->tPtSubmit = tPtGeometry1;
+		frame->residentTextures = enTexturesLoaded;
+
+		this->bindScene(*frame, false);
+		if (enSettings.PROGRESSIVE && !frame->placeholders.empty()) enRestartRefine = true;
+
+		this->transform(*frame);
+		this->sortGeometry(*frame);
+		this->project(*frame);
+		this->recordDebug(*frame);
+
+		TIME_PT tPtShadow1 = TIME_NOW();
+		this->shadowPass(*frame);
+
+		frame->tGeometry = TIME_DUR(tPtShadow1, tPtGeometry1);
+		frame->tShadow = TIME_DUR(TIME_NOW(), tPtShadow1);
+
+		if ( !enRasterFrames.push(frame) ) break;
+	}
+}
+
+void Engine::rasterStage() {
+	Frame *frame;
+
+	while ( enRasterFrames.pop(frame) ) {
+		TIME_PT tPtRaster1 = TIME_NOW();
+		this->rasterize(*frame);
+		this->encodeDisplay(*frame);
+		frame->tRaster = TIME_DUR(TIME_NOW(), tPtRaster1);
+
+		if ( !enPresentFrames.push(frame) ) break;
+	}
+}
+
+// Hands a presented frame back to the geometry stage, parking it instead
+// while frames take longer than LATENCY_BUDGET to get through the pipeline
+void Engine::recycleFrame(Frame *frame, float latencyMs) {
+	int inFlight = enFrameCount - (int) enParkedFrames.size() - (enShownFrame != nullptr);
+
+	if (latencyMs > enSettings.LATENCY_BUDGET && inFlight > 1) {
+		enParkedFrames.push_back(frame);
+		return;
+	}
+
+	if (latencyMs < enSettings.LATENCY_BUDGET/2.f && !enParkedFrames.empty()) {
+		enFreeFrames.push(enParkedFrames.back());
+		enParkedFrames.pop_back();
+	}
+
+	enFreeFrames.push(frame);
+}
+
+// Dynamic resolution, every SCALE_INTERVAL frames compares the raster stage time,
+// the part that depends on the resolution, with the FPS target and rescales towards it
+void Engine::scaleResolution(const Frame &frame) {
+	if ( !enSettings.DYNAMIC_RESOLUTION || enSettings.PROGRESSIVE ) return;
+
+	enScaleTimeSum += frame.tRaster;
+	if (++enScaleFrames < enSettings.SCALE_INTERVAL) return;
+
+	float rasterMs = enScaleTimeSum/1E3F/enScaleFrames;
+	float targetMs = 1E3F/enSettings.FPS;
+
+	enScaleFrames = 0;
+	enScaleTimeSum = 0;
+
+	// Within 10% of the target
+	float ratio = targetMs/rasterMs;
+	if (ratio > 0.9f && ratio < 1.1f) return;
+
+	// Raster time goes with the pixel count, the square of the scale.
+	// Steps are bounded so one slow frame does not drop the resolution all the way
+	float scale = enRenderScale;
+	float newScale = std::clamp(scale*std::sqrt(ratio), scale*0.75f, scale*1.1f);
+	enRenderScale = std::clamp(newScale, enSettings.MIN_SCALE, enSettings.MAX_SCALE);
+}
+
+/*
+Progressive refinement, sets up the next step of the current view on `frame`.
+While the view holds still every frame refines the previous ones:
+	2 steps at 1/4 and 1/2 resolution, without shadows
+	PROGRESSIVE_SAMPLES/4 jittered full resolution steps, accumulated, without shadows
+	PROGRESSIVE_SAMPLES jittered steps with the full lighting, accumulated from scratch
+Any change of the view starts over from the first step.
+Returns false once the view has converged, there is nothing left to render.
+*/
+bool Engine::refineFrame(Frame &frame) {
+	glm::mat4 view = this->modelMatrix(frame.time);
+
+	if (enRefineStep < 0 || view != enRefineView || enRestartRefine.exchange(false)) {
+		enRefineView = view;
+		enRefineStep = 0;
+		tPtRefine = TIME_NOW();
+	}
+
+	int aaSteps = std::max(1, enSettings.PROGRESSIVE_SAMPLES/4);
+	int litSteps = enSettings.PROGRESSIVE_SAMPLES;
+	int lastStep = 2 + aaSteps + litSteps - 1;
+
+	int step = enRefineStep;
+	if (step > lastStep) return false;
+	enRefineStep++;
+
+	frame.refineStep = step;
+	frame.refineLast = (step == lastStep);
+	frame.tPtRefine = tPtRefine;
+	frame.cheapShading = (step < 2 + aaSteps);
+
+	// Preview steps
+	if (step < 2) {
+		float scale = (step == 0) ? 0.25f : 0.5f;
+		frame.resize( (int) std::round(enSettings.W*scale), (int) std::round(enSettings.H*scale) );
+		frame.accumIndex = -1;
+		frame.jitter = Vec2(0.f);
+		return true;
+	}
+
+	// Sample `k` of the accumulation, jittered within the pixel
+	int k = (step < 2 + aaSteps) ? step - 2 : step - 2 - aaSteps;
+
+	frame.resize(enSettings.W, enSettings.H);
+	frame.accumIndex = k;
+	frame.jitter = Vec2( halton(k+1, 2) - 0.5f, halton(k+1, 3) - 0.5f );
+	return true;
+}
+
+// Adds the frame to the accumulation buffer, and replaces it by the average so far
+void Engine::accumulate(Frame &frame) {
+	Color *pixels = frame.surface.data();
+	int size = frame.surface.surfSize;
+	int k = frame.accumIndex;
+	float weight = 1.f / (k + 1);
+
+	enPool.parallelFor(size, 4096, [&](int begin, int end) {
+		for (int i=begin; i<end; i++) {
+			enAccumBuffer[i] = (k == 0) ? pixels[i] : enAccumBuffer[i] + pixels[i];
+			pixels[i] = enAccumBuffer[i] * weight;
+		}
+	});
+}
+
+// Gauges the engine owns, appended to every scrape from the metrics thread
+void Engine::exportMetrics(std::string &out) {
+	Metrics::header(out, "qazwsx_queue_depth", "Frames waiting in front of each pipeline stage", "gauge");
+	Metrics::sample(out, "qazwsx_queue_depth", "queue=\"geometry\"", (double) enFreeFrames.size());
+	Metrics::sample(out, "qazwsx_queue_depth", "queue=\"raster\"", (double) enRasterFrames.size());
+	Metrics::sample(out, "qazwsx_queue_depth", "queue=\"present\"", (double) enPresentFrames.size());
+
+	Metrics::header(out, "qazwsx_images_total", "Images submitted to the image writer", "counter");
+	Metrics::sample(out, "qazwsx_images_total", "result=\"written\"", enImageWriter.written);
+	Metrics::sample(out, "qazwsx_images_total", "result=\"dropped\"", enImageWriter.dropped);
+
+	Metrics::header(out, "qazwsx_video_frames_total", "Frames written to the video stream", "counter");
+	Metrics::sample(out, "qazwsx_video_frames_total", "", enVideo.frames);
+
+	Metrics::header(out, "qazwsx_textures_loaded", "Scene textures loaded, objects wait for theirs to be drawn", "gauge");
+	Metrics::sample(out, "qazwsx_textures_loaded", "", enTexturesLoaded);
+
+	if (enFirstFrameTime > 0) {
+		Metrics::header(out, "qazwsx_time_to_first_frame_seconds", "From the engine start to the first presented frame", "gauge");
+		Metrics::sample(out, "qazwsx_time_to_first_frame_seconds", "", enFirstFrameTime/1E6);
+	}
+
+	Metrics::header(out, "qazwsx_reload_seconds", "From a change of the scene files to the first frame presented with it", "histogram");
+	enReloadLatency.write(out, "qazwsx_reload_seconds", "");
+
+	if (enStreamed) {
+		GeometryStreamer::Counters counters = enStreamer.counters();
+
+		Metrics::header(out, "qazwsx_stream_resident_bytes", "Geometry of the streamed chunks in memory", "gauge");
+		Metrics::sample(out, "qazwsx_stream_resident_bytes", "", (double) counters.residentBytes);
+
+		Metrics::header(out, "qazwsx_stream_chunks_total", "Chunks of the visible instances, resident (hit) or not (miss) when a frame needed them", "counter");
+		Metrics::sample(out, "qazwsx_stream_chunks_total", "result=\"hit\"", (double) counters.hits);
+		Metrics::sample(out, "qazwsx_stream_chunks_total", "result=\"miss\"", (double) counters.misses);
+
+		Metrics::header(out, "qazwsx_stream_evictions_total", "Chunks evicted for the ones in view", "counter");
+		Metrics::sample(out, "qazwsx_stream_evictions_total", "", (double) counters.evictions);
+
+		Metrics::header(out, "qazwsx_stream_page_in_seconds", "From the request of a chunk to its data being resident", "histogram");
+		enStreamer.pageInLatency.write(out, "qazwsx_stream_page_in_seconds", "");
+	}
+
+	// Scene memory only changes on load and reload
+	std::lock_guard<std::mutex> lock(enPatchMutex);
+	size_t textureBytes = 0;
+	for (int i=0; i<enTexturesLoaded; i++) {
+		textureBytes += enTextures[i].memorySize();
+	}
+	size_t geometryBytes = (size_t) enMeshVxCount*(2*sizeof(Vec3) + sizeof(Vec2)) + (size_t) enMeshIndexCount*sizeof(uint32_t);
+
+	Metrics::header(out, "qazwsx_memory_bytes", "Memory of the engine buffers", "gauge");
+	Metrics::sample(out, "qazwsx_memory_bytes", "buffer=\"textures\"", (double) textureBytes);
+	Metrics::sample(out, "qazwsx_memory_bytes", "buffer=\"meshes\"", (double) geometryBytes);
+	Metrics::sample(out, "qazwsx_memory_bytes", "buffer=\"frames\"", (double) enFramePixelBytes.load());
+}
+
+
+// Hot Reload
+// The scene file and the files of its textures
+void Engine::watchScene() {
+	std::vector<std::string> paths = enTextureFiles;
+	paths.push_back(enSceneFile);
+
+	enWatcher.watch(paths);
+}
+
+/*
+One step per main loop iteration, the window keeps presenting the current scene meanwhile:
+	PENDING		changes gather until none came for RELOAD_SETTLE_MS (editors write in several steps)
+	PARSING		the scene file is parsed again on a task, with the textures that changed
+	DRAINING	presented frames are parked, once all of them are the buffers are patched
+	PRESENTING	until the first frame submitted after the patch is presented, see pipeline()
+Changes arriving during a reload wait for the next one
+*/
+void Engine::checkReload() {
+	if ( !enSettings.HOT_RELOAD ) return;
+
+	std::vector<std::string> changed;
+	if ( enWatcher.poll(changed) ) {
+		tPtChange = TIME_NOW();
+		if (enReloadFiles.empty()) tPtPending = tPtChange;
+
+		for (const std::string &path : changed) {
+			if (std::find(enReloadFiles.begin(), enReloadFiles.end(), path) == enReloadFiles.end()) {
+				enReloadFiles.push_back(path);
+			}
+		}
+	}
+
+	switch (enReloadState) {
+		case ReloadState::IDLE:
+			if ( !enReloadFiles.empty() ) enReloadState = ReloadState::PENDING;
+			break;
+
+		case ReloadState::PENDING: {
+			// The first textures still loading, or the file still being written
+			if (enTexturesLoaded < enTextureCount || TIME_DUR(TIME_NOW(), tPtChange) < RELOAD_SETTLE_MS*1000) break;
+
+			if (enTextureThread.joinable()) enTextureThread.join();
+
+			std::vector<std::string> files = std::move(enReloadFiles);
+			enReloadFiles.clear();
+
+			tPtReload = tPtPending;
+			tPtParse = TIME_NOW();
+			enReloadScene = std::make_unique<Scene>();
+			enReloadParsed = std::async(std::launch::async, [this, files]() {
+				return this->parseReload(*enReloadScene, files);
+			});
+			enReloadState = ReloadState::PARSING;
+			break;
+		}
+
+		case ReloadState::PARSING:
+			if (enReloadParsed.wait_for(milliseconds(0)) != std::future_status::ready) break;
+
+			tPtParsed = TIME_NOW();
+			if ( !enReloadParsed.get() ) {
+				std::cerr << "Reload of " << enSceneFile << " failed, keeping the current scene" << std::endl;
+				enReloadScene.reset();
+				enReloadState = ReloadState::IDLE;
+				break;
+			}
+
+			// A converged progressive view lets go of its frame
+			enRestartRefine = true;
+			enReloadState = ReloadState::DRAINING;
+			break;
+
+		case ReloadState::DRAINING:
+			if ((int) enParkedFrames.size() + (enShownFrame != nullptr) < enFrameCount) break;
+
+			this->patchScene();
+
+			for (Frame *frame : enParkedFrames) {
+				enFreeFrames.push(frame);
+			}
+			enParkedFrames.clear();
+			enReloadState = ReloadState::PRESENTING;
+			break;
+
+		case ReloadState::PRESENTING:
+			break;
+	}
+}
+
+/*
+On the reload task, the frames keep reading the engine buffers meanwhile. The JSON is one
+document and is parsed whole, the objects that changed are told apart by their hashes.
+Textures only load when their list changed or one of their files did, the others are taken
+over from the current ones by patchScene()
+*/
+bool Engine::parseReload(Scene &scene, const std::vector<std::string> &changed) {
+	TIME_PT tPt1 = TIME_NOW();
+
+	if ( !scene.loadJSONScene(enSceneFile.c_str()) ) return false;
+
+	objectHashes(scene, enReloadHashes);
+
+	auto isChanged = [&](const std::string &path) {
+		return std::find(changed.begin(), changed.end(), path) != changed.end();
+	};
+
+	enReloadTextures = (scene.sceneTextureFiles != enTextureFiles);
+	for (const std::string &path : enTextureFiles) {
+		enReloadTextures = enReloadTextures || isChanged(path);
+	}
+
+	int loaded = 0;
+	enReloadReuse.assign(scene.sceneTextureCount, -1);
+
+	for (uint32_t i=0; enReloadTextures && i<scene.sceneTextureCount; i++) {
+		const std::string &path = scene.sceneTextureFiles[i];
+		auto it = std::find(enTextureFiles.begin(), enTextureFiles.end(), path);
+
+		if (it != enTextureFiles.end() && !isChanged(path)) {
+			enReloadReuse[i] = (int) (it - enTextureFiles.begin());
+			continue;
+		}
+
+		if ( !scene.sceneTextures[i].load(path) ) {
+			uint32_t white = 0xFFFFFFFF;
+			scene.sceneTextures[i].create(&white, 1, 1);
+			std::cerr << "Drawing the texture '" << scene.sceneTextures[i].name << "' white." << std::endl;
+		}
+		loaded++;
+	}
+
+	enReloadReport = std::to_string(loaded) + " textures loaded";
+	enParseReloadTime = TIME_DUR(TIME_NOW(), tPt1);
+	return true;
+}
+
+// On the main thread with every frame parked, nothing reads the engine buffers
+void Engine::patchScene() {
+	TIME_PT tPt1 = TIME_NOW();
+	Scene &scene = *enReloadScene;
+	std::lock_guard<std::mutex> lock(enPatchMutex);
+
+	// Objects matched by name, the same name twice matches in order
+	std::vector<std::string> updated, added, removed;
+	std::vector<bool> matched(enObjectNames.size(), false);
+
+	for (uint32_t i=0; i<scene.sceneObjectCount; i++) {
+		const std::string &name = scene.sceneObjects[i].name;
+
+		size_t j = 0;
+		while (j < enObjectNames.size() && (matched[j] || enObjectNames[j] != name)) j++;
+
+		if (j == enObjectNames.size()) {
+			added.push_back(name);
+			continue;
+		}
+
+		matched[j] = true;
+		if (enObjectHashes[j] != enReloadHashes[i]) updated.push_back(name);
+	}
+	for (size_t j=0; j<enObjectNames.size(); j++) {
+		if ( !matched[j] ) removed.push_back(enObjectNames[j]);
+	}
+
+	size_t bytes = this->buildBuffers(scene);
+
+	if (enReloadTextures) {
+		for (uint32_t i=0; i<scene.sceneTextureCount; i++) {
+			if (enReloadReuse[i] < 0) continue;
+
+			// Texels swapped rather than copied, the name is the one of the new scene
+			Texture &texture = scene.sceneTextures[i], &old = enTextures[enReloadReuse[i]];
+			texture.id = old.id;
+			texture.layout = old.layout;
+			texture.format = old.format;
+			texture.levelCount = old.levelCount;
+			std::copy(old.levels, old.levels + TEXTURE_MAX_LEVELS, texture.levels);
+			texture.texels.swap(old.texels);
+			texture.blocks.swap(old.blocks);
+		}
+
+		MEM_DEALLOC(enTextures, enTextureCount);
+		enTextureCount = scene.sceneTextureCount;
+		enTextures = scene.sceneTextures;
+		enTextureFiles = std::move(scene.sceneTextureFiles);
+		scene.sceneTextureCount = 0;
+		scene.sceneTextures = nullptr;
+
+		this->watchScene();
+	}
+	enTexturesLoaded = enTextureCount;
+
+	for (int i=0; i<enFrameCount; i++) {
+		enFrames[i].reserve(enVxCount, enTriCount, enLightCount);
+	}
+
+	enScene.name = scene.name;
+	enObjectNames.clear();
+	for (uint32_t i=0; i<scene.sceneObjectCount; i++) {
+		enObjectNames.push_back(scene.sceneObjects[i].name);
+	}
+	enObjectHashes = std::move(enReloadHashes);
+	enReloadScene.reset();
+
+	enRestartRefine = true;
+
+	auto list = [](const std::vector<std::string> &names) {
+		std::string text = std::to_string(names.size());
+		for (size_t i=0; i<names.size(); i++) {
+			text += (i == 0 ? " (" : ", ") + names[i] + (i+1 == names.size() ? ")" : "");
+		}
+		return text;
+	};
+
+	enReloadReport = std::format("Reload: {} updated, {} added, {} removed, {}, {:.1f} KB patched",
+		list(updated), list(added), list(removed), enReloadReport, bytes/1024.f);
+
+	tPtPatched = TIME_NOW();
+	enPatchTime = TIME_DUR(tPtPatched, tPt1);
+}
+
+
+// Headless Rendering
+bool Engine::loadResident(const char *filename) {
+	this->beginLoad(filename);
+	if ( !this->loadScene() ) return false;
+	this->loadTextures();
+
+	for (int i=0; i<enFrameCount; i++) {
+		enFreeFrames.push(&enFrames[i]);
+	}
+	return true;
+}
+
+/*
+Renders the region of `view`, at most W x H, blocking while every frame is taken by other calls.
+The region goes through the projection of the whole view followed by a scale and offset of
+its rectangle to the clip space, so regions rendered apart line up with the whole image
+*/
+void Engine::renderImage(const RenderView &view, std::vector<uint8_t> &rgb) {
+	Frame *frame;
+	if ( !enFreeFrames.pop(frame) ) return;
+
+	frame->resize(view.region.w, view.region.h);
+	frame->time = view.time;
+	frame->residentTextures = enTexturesLoaded;
+	frame->fov = view.fov;
+	frame->aspect = (float) view.width/view.height;
+
+	float w = (float) frame->surface.surfWidth, h = (float) frame->surface.surfHeight;
+	glm::mat4 crop(1.f);
+	crop[0][0] = view.width/w;
+	crop[1][1] = view.height/h;
+	crop[3][0] = (view.width - 2.f*view.region.x - w)/w;
+	crop[3][1] = (h - view.height + 2.f*view.region.y)/h;
+
+	frame->projection = crop * glm::perspective(glm::radians(view.fov), frame->aspect, enSettings.EPSILON, enSettings.FAR_CLIP);
+
+	this->bindScene(*frame, true);
+	this->transform(*frame);
+	this->sortGeometry(*frame);
+	this->project(*frame);
+	this->recordDebug(*frame);
+	this->shadowPass(*frame);
+	this->rasterize(*frame);
+
+	rgb.resize( (size_t) 3*frame->surface.surfSize );
+	frame->surface.toRGB8(rgb.data());
+
+	enFreeFrames.push(frame);
+}
+
+
+void Engine::pipeline() {
+	// Loading Scene into Memory, the textures keep loading while the first frames render
+	if ( !this->loadScene() ) return;
+
+	enTextureThread = std::thread(&Engine::loadTextures, this);
+
+	enImageWriter.start(enSettings.IMAGE_QUEUE, &enPool);
+
+	if ( !enVideoTarget.empty() ) {
+		enVideo.open(enVideoTarget, enVideoFormat, enSettings.W, enSettings.H, enSettings.FPS, &enPool);
+	}
+
+	if ( !SDLWindow ) {
+		std::signal(SIGINT, onStopSignal);
+		std::signal(SIGTERM, onStopSignal);
+	}
+
+	this->startPipeline();
+
+	// Packs are written offline, not watched
+	if (enSettings.HOT_RELOAD && !enStreamed) {
+		this->watchScene();
+	}
+
+	if ( !enSettings.METRICS.empty() ) {
+		enMetrics.start(enSettings.METRICS, [this](std::string &out) { this->exportMetrics(out); });
+	}
+
+
+	float lastLogTime = 0.f;
+	TIME_PT tPtRender1, tPtRender2, tDt1, tDt2;
+
+	// Accumulated since last log
+	int logFrames = 0;
+	size_t placeholders = 0;
+	uint64_t tGeometrySum = 0, tShadowSum = 0, tRasterSum = 0, tRenderSum = 0, tLatencySum = 0;
+	PipelineStats logStats;
+
+	int streamed = 0;	// Frames sent to the video stream
+
+	tDt1 = TIME_NOW();
+
+	// Main Loop
+	while (isRunning) {
+
+		// Handle Events
+		this->handleEvents();
+		this->checkReload();
+
+		// Wait for the raster stage, without starving the event loop (nor a reload)
+		Frame *frame;
+		bool reloading = (enReloadState != ReloadState::IDLE || !enReloadFiles.empty());
+		if ( !enPresentFrames.popFor(frame, milliseconds(reloading ? 5 : 100)) ) {
+			continue;
+		}
+
+		// Calculate delta time
+		{
+			tDt2 = TIME_NOW();
+			deltaTime = TIME_DUR(tDt2, tDt1)/1E6F;
+			tDt1 = TIME_NOW();
+		}
+
+
+		// Resolve & Present
+		tPtRender1 = TIME_NOW();
+			this->render(*frame);
+		tPtRender2 = TIME_NOW();
+
+		uint64_t tLatency = TIME_DUR(tPtRender2, frame->tPtSubmit);
+
+		if (enFirstFrameTime == 0) {
+			int drawn = 0;
+			for (int i=0; i<enMaterialCount; i++) {
+				drawn += this->isResident(*frame, i);
+			}
+
+			enFirstFrameTime = TIME_DUR(tPtRender2, tPtCreate);
+			std::cout << "First frame " << enFirstFrameTime/1E3F << " ms after the start, "
+				<< drawn << " of " << enMaterialCount << " objects drawn\n";
+		}
+
+		logFrames++;
+		tGeometrySum += frame->tGeometry;
+		tShadowSum   += frame->tShadow;
+		tRasterSum   += frame->tRaster;
+		tRenderSum   += TIME_DUR(tPtRender2, tPtRender1);
+		tLatencySum  += tLatency;
+		logStats     += frame->stats;
+
+		if ( enMetrics.isRunning() ) {
+			FrameSample sample;
+			sample.tFrame = (uint64_t) (deltaTime*1E6F);
+			sample.tGeometry = frame->tGeometry;
+			sample.tShadow = frame->tShadow;
+			sample.tRaster = frame->tRaster;
+			sample.tPresent = TIME_DUR(tPtRender2, tPtRender1);
+			sample.tLatency = tLatency;
+			sample.triangles = frame->stats.submitted;
+			sample.pixelsWritten = frame->stats.pixelsWritten;
+			sample.inFlight = enFrameCount - (int) enParkedFrames.size();
+			sample.scale = enRenderScale;
+			enMetrics.observe(sample);
+		}
+
+		this->scaleResolution(*frame);
+
+		if (enReloadState == ReloadState::PRESENTING && frame->tPtSubmit > tPtPatched) {
+			uint64_t tReload = TIME_DUR(tPtRender2, tPtReload);
+			enReloadLatency.observe(tReload);
+			enReloadState = ReloadState::IDLE;
+
+			std::cout << enReloadReport << "\n"
+				<< "Reload latency " << tReload/1E3F << " ms: settle " << TIME_DUR(tPtParse, tPtReload)/1E3F
+				<< " ms, parse " << TIME_DUR(tPtParsed, tPtParse)/1E3F << " ms (" << enParseReloadTime/1E3F << " ms on the task)"
+				<< ", drain " << TIME_DUR(tPtPatched, tPtParsed)/1E3F - enPatchTime/1E3F
+				<< " ms, patch " << enPatchTime/1E3F
+				<< " ms, first frame " << TIME_DUR(tPtRender2, tPtPatched)/1E3F << " ms\n";
+		}
+
+		if (frame->refineLast) {
+			std::cout << "Converged in " << TIME_DUR(tPtRender2, frame->tPtRefine)/1E3F << " ms\n";
+		}
+
+		// Copied before the frame goes back to the geometry stage
+		if ( enVideo.isOpen() ) {
+			enVideo.submit(frame->surface);
+			streamed++;
+
+			// Headless, the stream decides when to stop
+			if ( !SDLWindow && (enVideo.failed || (enVideoFrames > 0 && streamed >= enVideoFrames)) ) {
+				isRunning = false;
+			}
+		}
+
+		if (enSettings.CAPTURE) {
+			std::string path = std::format("Out/{}_{:05}.{}", enScene.name, frame->index, ImageWriter::extension(enImageFormat));
+			enImageWriter.submit(frame->surface, path, enImageFormat);
+		}
+
+		placeholders = frame->placeholders.size()/2;
+
+		// The presented frame stays out of the stages until the next one replaces it, so its image can be saved on exit.
+		// A single frame in flight has nothing to overlap with and goes straight back
+		Frame *released = frame;
+		if (enFrameCount > 1) {
+			released = enShownFrame;
+			enShownFrame = frame;
+			enSurface = frame->surface;
+		}
+
+		// A reload waits for every frame, see checkReload()
+		if (released != nullptr) {
+			if (enReloadState == ReloadState::DRAINING) enParkedFrames.push_back(released);
+			else this->recycleFrame(released, tLatency/1E3F);
+		}
+
+		lastLogTime += deltaTime;
+
+		// Logs all the timings
+		if ( lastLogTime>enSettings.UPDATE_TIME ) {
+			lastLogTime = 0.f;
+
+			std::cout
+				<< "FPS " << 1/deltaTime
+				<< "\tGeometry " << tGeometrySum/1E3F/logFrames << " ms"
+				<< "\tShadows "  << tShadowSum/1E3F/logFrames   << " ms"
+				<< "\tRaster "   << tRasterSum/1E3F/logFrames   << " ms"
+				<< "\tRender "   << tRenderSum/1E3F/logFrames   << " ms"
+				<< "\tLatency "  << tLatencySum/1E3F/logFrames  << " ms"
+				<< "\tIn-Flight " << enFrameCount - enParkedFrames.size()
+				<< "\tScale " << enRenderScale.load()
+				<< "\tdt " << deltaTime*1E3F << " ms\n";
+
+			if (enSettings.PIPELINE_STATS) {
+				logStats.print(std::cout, logFrames);
+			}
+
+			if (enStreamed) {
+				GeometryStreamer::Counters counters = enStreamer.counters();
+				uint64_t hits = counters.hits, misses = counters.misses, pageIns = counters.pageIns;
+				std::cout
+					<< "Streaming\tResident " << counters.residentBytes/1024.f/1024.f << " / " << enSettings.STREAM_BUDGET_MB << " MB"
+					<< "\tHit rate " << (hits + misses > 0 ? 100.f*hits/(hits + misses) : 100.f) << " %"
+					<< "\tPage-in " << (pageIns > 0 ? counters.tPageInSum/1E3F/pageIns : 0.f) << " ms (" << pageIns << " chunks)"
+					<< "\tEvictions " << counters.evictions
+					<< "\tPlaceholders " << placeholders << "\n";
+			}
+
+			logFrames = 0;
+			tGeometrySum = tShadowSum = tRasterSum = tRenderSum = tLatencySum = 0;
+			logStats.reset();
+		}
+	}
+
+	// Stages finish their current frame before exiting,
+	// so every frame buffer holds a complete image
+	this->stopPipeline();
+	enMetrics.stop();
+
+	// Without a held frame the stages finished the next image in it
+	if (enShownFrame == nullptr) {
+		enSurface = enFrames[0].surface;
+	}
+
+	if ( enVideo.isOpen() ) {
+		enVideo.close();
+
+		int frames = enVideo.frames;
+		std::cout << "\nVideo\t " << frames << " frames";
+		if (frames > 0) {
+			std::cout << ", convert " << enVideo.tConvertSum/1E3F/frames << " ms"
+					  << ", write "   << enVideo.tWriteSum/1E3F/frames   << " ms per frame";
+		}
+		std::cout << "\n";
+	}
+
+
+	TIME_PT tPtSave1, tPtSave2;
+	// Save the Surface, after whatever is still queued
+	tPtSave1 = TIME_NOW();
+	std::string path = std::format("Out/{}.{}", enScene.name, ImageWriter::extension(enImageFormat));
+	enImageWriter.submit(enSurface, path, enImageFormat, true);
+	enImageWriter.stop();
+	tPtSave2 = TIME_NOW();
+
+	uint64_t t_save_us   = TIME_DUR(tPtSave2, tPtSave1);
+	std::cout << "\nSave\t " << t_save_us / 1000.f << " ms\n";
+
+	int written = enImageWriter.written;
+	std::cout << "Images\t " << written << " written, " << enImageWriter.dropped << " dropped";
+	if (written > 0) {
+		std::cout << ", " << enImageWriter.tEncodeSum/1E3F/written << " ms per image";
+	}
+	std::cout << "\n\n";
+
+}
+
+
+void Engine::streamTo(const char *target, VideoFormat format, int frames) {
+	enVideoTarget = target;
+	enVideoFormat = format;
+	enVideoFrames = frames;
+}
 
-}
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <thread>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "SDL3/SDL.h"
 
 #include "../math/vec.hpp"
@@ -7,8 +15,41 @@
 #include "../primitives/tris.hpp"
 #include "../primitives/rect.hpp"
 #include "../scene/scene.hpp"
+#include "../scene/scenepack.hpp"
+#include "../scene/instance.hpp"
 #include "../render/surface.hpp"
+#include "../render/shaders.hpp"
+#include "../render/texture.hpp"
+#include "../utils/queue.hpp"
+#include "../io/imagewriter.hpp"
+#include "../io/videostream.hpp"
+#include "../io/metrics.hpp"
+#include "../io/filewatcher.hpp"
 #include "settings.hpp"
+#include "frame.hpp"
+#include "streamer.hpp"
+#include "threadpool.hpp"
+
+// A view of the scene rendered headless, or a region of it
+struct RenderView {
+	float time;		// Scene time, the camera orbits with it
+	float fov;		// Vertical, in degrees
+	int width;		// Whole image
+	int height;
+	Rect region;	// Rendered pixels of the image
+};
+
+#define RELOAD_SETTLE_MS 50	// Quiet time after the last change before the scene is parsed again
+#define GUARD_BAND 4.f		// Off screen extent (in NDC) triangles are clipped to, keeps the screen coordinates small
+
+// Steps of a hot reload, driven by the main loop
+enum class ReloadState {
+	IDLE,
+	PENDING,		// Changed, waiting for the writes to settle
+	PARSING,		// Scene file parsed again on a task
+	DRAINING,		// Parking every frame, the buffers are patched once none is in flight
+	PRESENTING,		// Until the first frame of the new scene is presented
+};
 
 class Engine {
 
@@ -21,17 +62,128 @@ class Engine {
 
 		// Engine Stuff
 		Settings enSettings;		// Engine Settings
-		uint32_t *enTextureBuffer;  // intermediate Buffer for writing to SDLTexture
-		Color *enBuffer;            // Array of pixels
-		Surface enSurface;
+		Surface enSurface;			// Image of the last presented frame, saved on exit
 
 		Scene enScene;         			// Scene object
-		int enVxCount;
-		int enTriCount;
+		int enVxCount;					// Transformed verticies of a frame, every instance has its own
+		int enTriCount;					// Triangles of a frame, of every instance
+
+		// Mesh library, stored once whatever the instance count. The frame buffers are not, every frame
+		// in flight transforms every instance into its own verticies and triangles (enVxCount, enTriCount)
+		int enMeshVxCount;
+		int enMeshIndexCount;
+		int enMeshCount;
+		int enMeshVxCapacity;			// Allocated, reloads only reallocate a buffer that outgrows it
+		int enMeshIndexCapacity;
+		int enMeshCapacity;
+		Vec3 *enVerticies; 				// Holds the 3D verticies of the meshes (model space)
+		Vec3 *enNormals;				// Per vertex normals (model space)
+		Vec2 *enUVs;					// Per vertex UVs
+		uint32_t *enIndices;			// 3 indices per mesh triangle, relative to the first vertex of the mesh
+		MeshRange *enMeshes;
+
+		int enInstanceCount;
+		int enInstanceCapacity;
+		int enTriCapacity;
+		Instance *enInstances;			// In frame buffer order
+		uint32_t *enTrisInstance;		// Instance of every triangle of a frame
+
+		int enMaterialCount;
+		int enMaterialCapacity;
+		Material *enMaterials;			// One material per scene object
+		int enTextureCount;
+		Texture *enTextures;			// Material textures, Material::texture indexes them
+		Vec3 enSceneMin;				// Bounds of every instance (model space)
+		Vec3 enSceneMax;
+		float enNormalLength;			// Length of the debug normals, 2% of the scene size
+
+		int enEdgeCount;
+		uint32_t *enEdges;				// 2 indices per unique edge of every mesh (wireframe only)
+
+		int enLightCount;
+		int enLightCapacity;
+		Light *enLights;				// Scene lights (world space)
+
+		// Scene Loading
+		// Parse (task from the constructor) -> buffers (pipeline) -> textures (background, while rendering)
+		TIME_PT tPtCreate;						// Time to first frame counts from it
+		std::future<bool> enSceneParsed;		// Scene file parse, overlapped with the settings and the window
+		uint64_t enParseTime;					// us, on the parse task
+		std::thread enTextureThread;
+		std::vector<std::string> enTextureFiles;
+		std::atomic<int> enTexturesLoaded;		// In file order, objects using the next ones are not drawn yet
+		std::atomic<bool> enLoadStop;
+		std::atomic<uint64_t> enFirstFrameTime;	// us after tPtCreate, 0 until presented
+
+		// Streaming, scenes packed with --pack keep only their tables in memory
+		bool enStreamed;
+		ScenePack enPack;
+		GeometryStreamer enStreamer;			// Mesh library buffers are its arena
+
+		// Hot Reload
+		std::string enSceneFile;
+		FileWatcher enWatcher;					// The scene file and its textures
+		ReloadState enReloadState;
+		std::vector<std::string> enReloadFiles;	// Changed, for the pending reload
+		std::unique_ptr<Scene> enReloadScene;	// Parsed on a task, patched in by the main loop
+		std::future<bool> enReloadParsed;
+		bool enReloadTextures;					// The textures changed, enReloadScene has them all
+		std::vector<int> enReloadReuse;			// Unchanged texture taken over by each of enReloadScene, or -1
+		std::atomic<bool> enRestartRefine;		// Progressive refinement starts over, set with the reload
+		std::vector<std::string> enObjectNames;	// Of the loaded scene, changes are found by the hashes
+		std::vector<uint64_t> enObjectHashes;
+		std::vector<uint64_t> enReloadHashes;	// Of the objects of enReloadScene
+		std::mutex enPatchMutex;				// Held while patching, the metrics read the scene buffers
+		TIME_PT tPtChange;						// Latest change
+		TIME_PT tPtPending;						// First change of enReloadFiles
+		TIME_PT tPtReload;						// First change of the reload in progress
+		TIME_PT tPtParse;
+		TIME_PT tPtParsed;
+		TIME_PT tPtPatched;
+		uint64_t enParseReloadTime;				// us
+		uint64_t enPatchTime;
+		std::string enReloadReport;				// What the patch changed, logged with the latency
+		Histogram enReloadLatency;				// Change to the first frame presented with it
+
+		// Frame Pipeline
+		// Geometry (worker) -> Raster (worker) -> Resolve & Present (main thread)
+		int enFrameCount;				// Frames in flight
+		Frame *enFrames;
+		BlockingQueue<Frame*> enFreeFrames;		// Waiting for the geometry stage
+		BlockingQueue<Frame*> enRasterFrames;	// Waiting for the raster stage
+		BlockingQueue<Frame*> enPresentFrames;	// Waiting for the present stage
+		std::vector<Frame*> enParkedFrames;		// Held back to stay within LATENCY_BUDGET
+		std::atomic<size_t> enFramePixelBytes;	// Pixel buffers of every frame, allocated once (metrics)
+		Frame *enShownFrame;					// Last presented, held back until the next one replaces it
+
+		std::thread enGeometryThread;
+		std::thread enRasterThread;
+		TIME_PT tPtStart;
 
-		Vec3 *enVerticies; 				// Holds the 3D verticies of the scene
-		Tris3D_ref *enTrisRefBuffer; 	// Holds the triangle references to be rasterized
-		Tris2D *enTrisProjectedBuffer; 	// Holds the triangles that are projected
+		ThreadPool enOwnPool;			// Not started when the workers are shared (headless)
+		ThreadPool &enPool;				// Workers for the data parallel passes
+		ImageWriter enImageWriter;		// Saves images off the main thread
+		ImageFormat enImageFormat;
+		PixelFormat enSurfaceFormat;	// Of the presented image, SURFACE_FORMAT
+
+		VideoStream enVideo;			// Raw video of the presented frames
+		std::string enVideoTarget;		// Empty when not streaming
+		VideoFormat enVideoFormat;
+		int enVideoFrames;				// Headless stream length, 0 is unbounded
+
+		DebugView enDebugView;			// Heatmap replacing the image, see stats.hpp
+		Metrics enMetrics;				// Prometheus endpoint, when METRICS is set
+
+		// Dynamic Resolution
+		std::atomic<float> enRenderScale;	// Fraction of W and H new frames render at
+		int enScaleFrames;					// Frames measured since the last change
+		uint64_t enScaleTimeSum;
+
+		// Progressive Refinement
+		glm::mat4 enRefineView;			// View the refinement steps belong to
+		int enRefineStep;				// Next step, -1 before the first frame
+		TIME_PT tPtRefine;				// Start of the current refinement
+		Color *enAccumBuffer;			// W*H, running sum of the full resolution samples (raster stage)
 
 
 		// Rendering Stuff
@@ -41,9 +193,20 @@ class Engine {
 		glm::mat4 projMat;
 
 	public:
-		Engine();
+		Engine(const char *filename, bool headless = false);
+		Engine(const Settings &settings, ThreadPool &pool);
 		~Engine();
-		void pipeline(const char *filename);
+		void pipeline();
+		// Runs every benchmark case, or only the one named `only`
+		void benchmark(int frames, const char *only = nullptr);
+
+		// Streams every presented frame to `target` ("-" is stdout), call before pipeline().
+		// Headless, the stream stops after `frames` (0 until the target closes, SIGINT or SIGTERM)
+		void streamTo(const char *target, VideoFormat format, int frames = 0);
+
+		// Headless rendering for the render server, every frame in flight serves one call at a time
+		bool loadResident(const char *filename);
+		void renderImage(const RenderView &view, std::vector<uint8_t> &rgb);
 
 	private:
 		void SDLSetup();
@@ -51,13 +214,77 @@ class Engine {
 
 		void handleEvents();
 
-		void engineSetup();
+		void engineSetup(const Settings *settings);
 		void engineDestroy();
 
-		void loadScene(const char *filename);
-		void transform();
-		void sortGeometry();
-		void project();
-		void render();
-		void rasterize();
+		void beginLoad(const char *filename);
+		bool loadScene();
+		void loadTextures();
+		size_t buildBuffers(const Scene &scene);
+		void loadPack();
+
+		// Scene layout of `frame`, waiting for the chunks it sees when streamed and `wait`
+		void bindScene(Frame &frame, bool wait);
+
+		// Hot Reload
+		void watchScene();
+		void checkReload();
+		bool parseReload(Scene &scene, const std::vector<std::string> &changed);
+		void patchScene();
+
+		// Pipeline Stages
+		void startPipeline();
+		void stopPipeline();
+		void geometryStage();
+		void rasterStage();
+		void recycleFrame(Frame *frame, float latencyMs);
+		void scaleResolution(const Frame &frame);
+		bool refineFrame(Frame &frame);
+		void accumulate(Frame &frame);
+		void exportMetrics(std::string &out);
+
+		glm::mat4 modelMatrix(float time);
+		const Material &trisMaterial(const Frame &frame, uint32_t tris) const { return enMaterials[ frame.instances[ frame.trisInstance[tris] ].object ]; }
+		bool isResident(const Frame &frame, uint32_t object) const { return enMaterials[object].texture < frame.residentTextures; }
+
+		void transform(Frame &frame);
+		void sortGeometry(Frame &frame);
+		void project(Frame &frame);
+		void recordDebug(Frame &frame);
+		void shadowPass(Frame &frame);
+		void rasterize(Frame &frame);
+		void encodeDisplay(Frame &frame);
+		void render(Frame &frame);
+
+		void drawGeometry(Frame &frame, BlendMode blend, DepthMode depth, int samples, const ShadingContext &ctx);
+		void depthPass(Frame &frame);
+		void visibilityPass(Frame &frame);
+		void shadingPass(Frame &frame, const ShadingContext &ctx);
+		void debugView(Frame &frame, const ShadingContext &ctx);
+
+		template <typename DrawFn>
+		void withShaders(Frame &frame, int i, const ShadingContext &ctx, DrawFn &&draw);
+
+		template <typename Fn>
+		void withDisplay(Frame &frame, Fn &&fn);
+
+		// Benchmark cases, each measures one part of the pipeline on enFrames[0]
+		struct BenchCase {
+			const char *name;
+			void (Engine::*run)(Frame &frame, int frames);
+		};
+		static const BenchCase BENCH_CASES[];
+
+		void benchPrepare(Frame &frame);
+		void benchDepth(Frame &frame, int frames);
+		void benchPrepass(Frame &frame, int frames);
+		void benchViews(Frame &frame, int frames);
+		void benchOverlay(Frame &frame, int frames);
+		void benchWireframe(Frame &frame, int frames);
+		void benchShapes(Frame &frame, int frames);
+		void benchEncoders(Frame &frame, int frames);
+		void benchFormats(Frame &frame, int frames);
+		void benchTextures(Frame &frame, int frames);
+		void benchMSAA(Frame &frame, int frames);
+		void benchLights(Frame &frame, int frames);
 };
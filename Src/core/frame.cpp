@@ -0,0 +1,207 @@
+#include <algorithm>
+
+#include "frame.hpp"
+
+
+// Constructors and Destructors
+Frame::Frame() {
+	index = 0;
+	time = 0.f;
+	projection = glm::mat4(1.f);
+	fov = 60.f;
+	aspect = 1.f;
+
+	vxCount = 0;
+	triCount = 0;
+	lightCount = 0;
+	sampleCount = 1;
+	residentTextures = 0;
+
+	instances = nullptr;
+	meshes = nullptr;
+	trisInstance = nullptr;
+	instanceCount = 0;
+	drawVxCount = 0;
+	drawTriCount = 0;
+	projectedCount = 0;
+	projectedCapacity = 0;
+
+	verticies = nullptr;
+	normals = nullptr;
+	clipVerticies = nullptr;
+	trisRef = nullptr;
+	trisProjected = nullptr;
+	lights = nullptr;
+	shadowMaps = nullptr;
+
+	buffer = nullptr;
+	samples = nullptr;
+	depth = nullptr;
+	visibility = nullptr;
+	textureBuffer = nullptr;
+	display = nullptr;
+	displayFormat = PixelFormat::RGB32F;
+
+	maxWidth = 0;
+	maxHeight = 0;
+
+	refineStep = -1;
+	refineLast = false;
+	cheapShading = false;
+	accumIndex = -1;
+	jitter = Vec2(0.f);
+
+	tGeometry = 0;
+	tShadow = 0;
+	tRaster = 0;
+}
+
+Frame::~Frame() {
+	this->release();
+}
+
+
+// Methods
+void Frame::allocate(int vertexCount, int triangleCount, int lightsCount, int w, int h, int msaa, PixelFormat format) {
+	this->release();
+
+	vxCount = vertexCount;
+	triCount = triangleCount;
+	lightCount = lightsCount;
+	sampleCount = msaa;
+
+	MEM_ALLOC(verticies, Vec3, vxCount);
+	MEM_ALLOC(normals, Vec3, vxCount);
+	MEM_ALLOC(clipVerticies, Vec4, vxCount);
+	MEM_ALLOC(trisRef, Tris3D_ref, triCount);
+	MEM_ALLOC(trisProjected, Tris2D_p, triCount);
+	MEM_ALLOC(lights, Light, lightCount);
+	MEM_ALLOC(shadowMaps, ShadowMap, lightCount);
+	projectedCapacity = triCount;
+
+	MEM_ALLOC(buffer, Color, w*h);
+	MEM_ALLOC(depth, float, w*h*sampleCount);
+	if (sampleCount > 1) {
+		MEM_ALLOC(samples, Color, w*h*sampleCount);
+	}
+	MEM_ALLOC(visibility, uint32_t, w*h);
+	MEM_ALLOC(textureBuffer, uint32_t, w*h);
+	if (format != PixelFormat::RGB32F) {
+		MEM_ALLOC(display, uint8_t, w*h*pixelBytes(format));
+	}
+	displayFormat = format;
+
+	maxWidth = w;
+	maxHeight = h;
+
+	surface = Surface(buffer, w, h);
+	lightGrid.resize(w, h);
+}
+
+void Frame::reserve(int vertexCount, int triangleCount, int lightsCount) {
+	if (vertexCount > vxCount) {
+		MEM_DEALLOC(verticies, vxCount);
+		MEM_DEALLOC(normals, vxCount);
+		MEM_DEALLOC(clipVerticies, vxCount);
+
+		vxCount = vertexCount;
+		MEM_ALLOC(verticies, Vec3, vxCount);
+		MEM_ALLOC(normals, Vec3, vxCount);
+		MEM_ALLOC(clipVerticies, Vec4, vxCount);
+	}
+
+	if (triangleCount > triCount) {
+		MEM_DEALLOC(trisRef, triCount);
+
+		triCount = triangleCount;
+		MEM_ALLOC(trisRef, Tris3D_ref, triCount);
+	}
+
+	if (triangleCount > projectedCapacity) {
+		MEM_DEALLOC(trisProjected, projectedCapacity);
+
+		projectedCapacity = triangleCount;
+		MEM_ALLOC(trisProjected, Tris2D_p, projectedCapacity);
+	}
+
+	// The passes go over every light of the frame
+	if (lightsCount != lightCount) {
+		MEM_DEALLOC(lights, lightCount);
+		MEM_DEALLOC(shadowMaps, lightCount);
+
+		lightCount = lightsCount;
+		MEM_ALLOC(lights, Light, lightCount);
+		MEM_ALLOC(shadowMaps, ShadowMap, lightCount);
+	}
+}
+
+void Frame::reserveProjected(int count) {
+	if (count <= projectedCapacity) return;
+
+	// Grown by half at least, the clipped triangles come a few at a time
+	int capacity = std::max(count, projectedCapacity + projectedCapacity/2);
+	Tris2D_p *projected;
+	MEM_ALLOC(projected, Tris2D_p, capacity);
+	std::copy(trisProjected, trisProjected + projectedCount, projected);
+	MEM_DEALLOC(trisProjected, projectedCapacity);
+
+	trisProjected = projected;
+	projectedCapacity = capacity;
+}
+
+void Frame::release() {
+	MEM_DEALLOC(verticies, vxCount);
+	MEM_DEALLOC(normals, vxCount);
+	MEM_DEALLOC(clipVerticies, vxCount);
+	MEM_DEALLOC(trisRef, triCount);
+	MEM_DEALLOC(trisProjected, projectedCapacity);
+	MEM_DEALLOC(lights, lightCount);
+	MEM_DEALLOC(shadowMaps, lightCount);
+
+	MEM_DEALLOC(buffer, maxWidth*maxHeight);
+	MEM_DEALLOC(samples, maxWidth*maxHeight*sampleCount);
+	MEM_DEALLOC(depth, maxWidth*maxHeight*sampleCount);
+	MEM_DEALLOC(visibility, maxWidth*maxHeight);
+	MEM_DEALLOC(textureBuffer, maxWidth*maxHeight);
+	MEM_DEALLOC(display, maxWidth*maxHeight*pixelBytes(displayFormat));
+
+	verticies = nullptr;
+	normals = nullptr;
+	clipVerticies = nullptr;
+	trisRef = nullptr;
+	trisProjected = nullptr;
+	lights = nullptr;
+	shadowMaps = nullptr;
+	buffer = nullptr;
+	samples = nullptr;
+	depth = nullptr;
+	visibility = nullptr;
+	textureBuffer = nullptr;
+	display = nullptr;
+
+	vxCount = 0;
+	triCount = 0;
+	projectedCapacity = 0;
+	lightCount = 0;
+	sampleCount = 1;
+	maxWidth = 0;
+	maxHeight = 0;
+}
+
+void Frame::resize(int w, int h) {
+	w = std::max(1, std::min(maxWidth, w));
+	h = std::max(1, std::min(maxHeight, h));
+
+	if (w == surface.surfWidth && h == surface.surfHeight) return;
+
+	surface = Surface(buffer, w, h);
+	lightGrid.resize(w, h);
+}
+
+size_t Frame::pixelMemory() const {
+	int msaa = (sampleCount > 1) ? sampleCount : 0;
+	size_t bytes = sizeof(Color)*(1 + msaa) + sizeof(float)*sampleCount + 2*sizeof(uint32_t);
+	if (display) bytes += pixelBytes(displayFormat);
+
+	return (size_t) maxWidth*maxHeight*bytes;
+}
@@ -0,0 +1,112 @@
+// Per frame resources, one instance per frame in flight
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../math/vec.hpp"
+#include "../math/color.hpp"
+#include "../primitives/tris.hpp"
+#include "../render/surface.hpp"
+#include "../render/lightgrid.hpp"
+#include "../render/shadowmap.hpp"
+#include "../render/debugdraw.hpp"
+#include "../render/stats.hpp"
+#include "../scene/light.hpp"
+#include "../scene/instance.hpp"
+#include "../utils/utils.hpp"
+
+
+class Frame {
+	// Constructors / Destructors
+	public:
+		Frame();
+		~Frame();
+
+	// Attributes
+	public:
+		uint64_t index;				// Frame number
+		float time;					// Scene time of this frame (in sec)
+		glm::mat4 projection;		// View to clip space, of the rendered region
+		float fov;					// Vertical field of view (in degrees) and width over height of the whole view,
+		float aspect;				// the shadow cascades cover it whatever the region
+
+		int vxCount;				// Allocated, at least the verticies and triangles drawn
+		int triCount;
+		int lightCount;
+		int sampleCount;			// MSAA samples per pixel, 1 without MSAA
+		int residentTextures;		// Loaded when the frame started, objects of the others are left out
+
+		// Scene layout it is drawn with, the engine buffers or the visible and resident part of a streamed scene
+		const Instance *instances;
+		const MeshRange *meshes;
+		const uint32_t *trisInstance;	// Instance of every triangle
+		int instanceCount;
+		int drawVxCount;			// Instanced verticies and triangles, within vxCount and triCount
+		int drawTriCount;
+		int projectedCount;			// Triangles in `trisProjected`, the near plane splits some in two
+		int projectedCapacity;
+
+		// Streamed scenes, filled by GeometryStreamer::update()
+		std::vector<Instance> streamInstances;
+		std::vector<MeshRange> streamMeshes;
+		std::vector<uint32_t> streamTrisInstance;
+		std::vector<uint32_t> streamChunks;		// Pinned until the frame is built again
+		std::vector<Vec3> placeholders;			// Bounds (min, max) of the visible instances of missing chunks
+
+		Vec3 *verticies;			// Transformed verticies of this frame, a copy per instance of its mesh
+		Vec3 *normals;				// Transformed per vertex normals of this frame
+		Vec4 *clipVerticies;		// Projected, before the division by w (wireframe)
+		Tris3D_ref *trisRef;		// Triangle references into `verticies`
+		Tris2D_p *trisProjected;	// Projected triangles, clipped and in the order of `trisRef`
+		Light *lights;				// View space lights of this frame
+		LightGrid lightGrid;		// Lights of every screen tile
+		ShadowMap *shadowMaps;		// One per light, empty unless it casts shadows
+		DebugDraw debugDraw;		// Overlay recorded by the geometry stage, drawn after tonemapping
+
+		Color *buffer;				// Array of pixels
+		Color *samples;				// MSAA colour samples, `sampleCount` per pixel (null without MSAA)
+		float *depth;				// Depth buffer (1/w, larger is closer), `sampleCount` per pixel
+		uint32_t *visibility;		// Visibility buffer, index into `trisProjected` per pixel
+		uint32_t *textureBuffer;	// Resolved 32 bit pixels for SDLTexture
+		uint8_t *display;			// Presented image in `displayFormat`, null for RGB32F (the surface itself)
+		PixelFormat displayFormat;
+		Surface surface;			// Current render resolution, at most the allocated one
+
+		int maxWidth;				// Allocated resolution
+		int maxHeight;
+
+		// Progressive refinement, set by the geometry stage
+		int refineStep;				// -1 when progressive rendering is off
+		bool refineLast;			// Last step, the image has converged
+		bool cheapShading;			// Skips the shadow maps
+		int accumIndex;				// Sample index into the accumulation buffer, -1 to not accumulate
+		Vec2 jitter;				// Sub pixel offset of the projection (in pixels)
+		TIME_PT tPtRefine;			// Start of the refinement this frame belongs to
+
+		// Stage timings (in us)
+		TIME_PT tPtSubmit;
+		uint64_t tGeometry;
+		uint64_t tShadow;
+		uint64_t tRaster;
+
+		PipelineStats stats;		// Counted by the geometry stage, completed by the raster stage
+
+	// Methods
+	public:
+		void allocate(int vertexCount, int triangleCount, int lightsCount, int w, int h, int msaa, PixelFormat format = PixelFormat::RGB32F);
+		void release();
+
+		// Geometry buffers of a reloaded or streamed scene, only grown, the pixels are kept
+		void reserve(int vertexCount, int triangleCount, int lightsCount);
+
+		// Room for `count` projected triangles, the ones already projected are kept
+		void reserveProjected(int count);
+
+		// Renders at w x h from now on, within the allocated resolution
+		void resize(int w, int h);
+
+		// Bytes of the pixel buffers, at the allocated resolution
+		size_t pixelMemory() const;
+};
@@ -0,0 +1,302 @@
+#include <cstdio>
+#include <csignal>
+#include <iostream>
+#include <algorithm>
+
+#include "server.hpp"
+#include "../io/imagewriter.hpp"
+#include "../utils/utils.hpp"
+
+#include "nlohmann_json/json.hpp" // downloaded from https://github.com/nlohmann/json
+using json = nlohmann::json;
+
+
+#define SERVER_LINE_MAX 65536	// Longest request line, in bytes
+
+
+// Set by SIGINT and SIGTERM, the accept loop and the workers poll it
+static volatile std::sig_atomic_t serverStop = 0;
+
+static void onStopSignal(int) {
+	serverStop = 1;
+}
+
+static bool writeFile(const std::string &path, const std::vector<uint8_t> &bytes) {
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		return false;
+	}
+
+	size_t count = fwrite(bytes.data(), 1, bytes.size(), file);
+	fclose(file);
+
+	return count == bytes.size();
+}
+
+static std::string errorReply(const std::string &message) {
+	return json{ {"ok", false}, {"error", message} }.dump() + "\n";
+}
+
+
+// Constructors and Destructors
+RenderServer::RenderServer() {
+	jobs = 0;
+	hits = 0;
+	loads = 0;
+	_useClock = 0;
+}
+
+RenderServer::~RenderServer() {
+	_clients.close();
+
+	for (std::thread &t : _workers) {
+		if (t.joinable()) t.join();
+	}
+	_pool.stop();
+}
+
+
+// Methods
+bool RenderServer::run(const std::string &address) {
+	const char *settingsPath = "settings.json";
+
+	if ( !_settings.loadFromJSON(settingsPath) ) {
+		std::cerr << "Failed to load settings from " << settingsPath << ". Using default settings." << std::endl;
+	}
+
+	// Every job is a single still frame
+	_settings.PROGRESSIVE = false;
+	_settings.DYNAMIC_RESOLUTION = false;
+	_settings.CAPTURE = false;
+
+	if ( !_listener.listen(address) ) return false;
+
+	_pool.start(_settings.THREADS);
+
+	for (int i=0; i<_settings.SERVER_JOBS; i++) {
+		_workers.emplace_back(&RenderServer::worker, this);
+	}
+
+	std::signal(SIGINT, onStopSignal);
+	std::signal(SIGTERM, onStopSignal);
+
+	std::cout << "Serving on " << address << ", " << _settings.SERVER_JOBS << " jobs at once, "
+		<< _settings.SERVER_SCENES << " resident scenes, up to " << _settings.W << "x" << _settings.H << std::endl;
+
+	while ( !serverStop ) {
+		Socket client;
+		if ( _listener.accept(client, 200) ) {
+			_clients.push(std::move(client));
+		}
+	}
+
+	_clients.close();
+	for (std::thread &t : _workers) {
+		t.join();
+	}
+	_workers.clear();
+	_listener.close();
+
+	std::cout << "\nServed " << jobs << " jobs, " << hits << " on resident scenes, " << loads << " scene loads" << std::endl;
+	return true;
+}
+
+void RenderServer::worker() {
+	Socket client;
+
+	while ( _clients.pop(client) ) {
+		this->serve(client);
+		client.close();
+	}
+}
+
+// Jobs of one connection, in order, until the client closes it
+void RenderServer::serve(Socket &client) {
+	std::string buffer;
+	std::vector<uint8_t> bytes;
+	char chunk[4096];
+
+	while ( !serverStop ) {
+		size_t end = buffer.find('\n');
+
+		if (end == std::string::npos) {
+			if (buffer.size() > SERVER_LINE_MAX) {
+				client.sendAll( errorReply("Request line too long") );
+				return;
+			}
+
+			if ( !client.waitReadable(200) ) continue;
+
+			int64_t got = client.recvSome(chunk, sizeof(chunk));
+			if (got <= 0) return;
+
+			buffer.append(chunk, (size_t) got);
+			continue;
+		}
+
+		std::string line = buffer.substr(0, end);
+		buffer.erase(0, end + 1);
+
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+		bytes.clear();
+		std::string reply;
+
+		// Fields of the wrong type
+		try {
+			reply = this->job(line, bytes);
+		}
+		catch (const json::exception &e) {
+			bytes.clear();
+			reply = errorReply(e.what());
+		}
+
+		if ( !client.sendAll(reply) || !client.sendAll(bytes.data(), bytes.size()) ) return;
+	}
+}
+
+std::string RenderServer::job(const std::string &line, std::vector<uint8_t> &bytes) {
+	json request = json::parse(line, nullptr, false);
+	if ( request.is_discarded() || !request.is_object() ) {
+		return errorReply("Invalid JSON");
+	}
+
+	std::string path = request.value("scene", "");
+	std::string formatName = request.value("format", _settings.IMAGE_FORMAT);
+	std::string output = request.value("output", "");
+
+	RenderView view;
+	view.time = request.value("time", 0.f);
+	view.fov = request.value("fov", _settings.AOV);
+	view.width = request.value("width", _settings.W);
+	view.height = request.value("height", _settings.H);
+	view.region = {0, 0, view.width, view.height};
+
+	std::vector<int> region = request.value("region", std::vector<int>());
+	if (region.size() == 4) {
+		view.region = {region[0], region[1], region[2], region[3]};
+	}
+
+	const Rect &r = view.region;
+	int w = r.w, h = r.h;
+
+	// "raw" is the 8 bit RGB pixels, row after row
+	ImageFormat format = ImageFormat::PPM;
+	bool raw = (formatName == "raw");
+
+	if (path.empty()) return errorReply("No scene");
+	if (view.width < 1 || view.height < 1 || (!region.empty() && region.size() != 4)) return errorReply("Invalid resolution or region");
+	if (r.x < 0 || r.y < 0 || r.w < 1 || r.h < 1 || r.x + r.w > view.width || r.y + r.h > view.height) {
+		return errorReply("Region outside the image");
+	}
+	if (w > _settings.W || h > _settings.H) {
+		return errorReply( std::format("Rendered size {}x{} above {}x{}", w, h, _settings.W, _settings.H) );
+	}
+	if (view.fov <= 0.f || view.fov >= 180.f) return errorReply("fov must be within (0, 180) degrees");
+	if ( !raw && !ImageWriter::parseFormat(formatName, format) ) return errorReply("Unknown format " + formatName);
+
+	TIME_PT tPt1 = TIME_NOW();
+
+	bool cached = false;
+	std::shared_ptr<Resident> resident = this->scene(path, cached);
+	if ( !resident ) return errorReply("Failed to load " + path);
+
+	TIME_PT tPt2 = TIME_NOW();
+
+	std::vector<uint8_t> rgb;
+	resident->engine.renderImage(view, rgb);
+
+	TIME_PT tPt3 = TIME_NOW();
+
+	if (raw) bytes.swap(rgb);
+	else ImageWriter::encode(rgb.data(), w, h, format, bytes, &_pool);
+	size_t size = bytes.size();
+
+	if ( !output.empty() ) {
+		bool written = writeFile(output, bytes);
+		bytes.clear();
+		if ( !written ) return errorReply("Failed to write " + output);
+	}
+
+	TIME_PT tPt4 = TIME_NOW();
+
+	jobs++;
+	if (cached) hits++;
+
+	json reply = {
+		{"ok", true},
+		{"width", w},
+		{"height", h},
+		{"format", raw ? "raw" : ImageWriter::extension(format)},
+		{"size", size},
+		{"bytes", bytes.size()},
+		{"cached", cached},
+		{"load_ms", TIME_DUR(tPt2, tPt1)/1E3F},
+		{"render_ms", TIME_DUR(tPt3, tPt2)/1E3F},
+		{"encode_ms", TIME_DUR(tPt4, tPt3)/1E3F},
+	};
+	if ( !output.empty() ) reply["path"] = output;
+
+	std::cout << std::format("Job {} {}x{} t={}: load {} ms{}, render {} ms, encode {} ms\n",
+		path, w, h, view.time, TIME_DUR(tPt2, tPt1)/1E3F, cached ? " (resident)" : "", TIME_DUR(tPt3, tPt2)/1E3F, TIME_DUR(tPt4, tPt3)/1E3F);
+
+	return reply.dump() + "\n";
+}
+
+/*
+Scenes are keyed by their path and the modification time of the scene file, an edited
+file loads again. Meshes and textures the scene refers to are not checked
+*/
+std::shared_ptr<RenderServer::Resident> RenderServer::scene(const std::string &path, bool &cached) {
+	std::error_code error;
+	std::string key = std::filesystem::weakly_canonical(path, error).string();
+	if (error) key = path;
+
+	std::filesystem::file_time_type mtime = std::filesystem::last_write_time(key, error);
+	if (error) return nullptr;
+
+	std::shared_ptr<Resident> resident;
+	{
+		std::lock_guard<std::mutex> lock(_cacheMutex);
+
+		auto it = std::find_if(_cache.begin(), _cache.end(), [&](const CacheEntry &entry) { return entry.path == key; });
+
+		if (it != _cache.end() && it->mtime != mtime) {
+			_cache.erase(it);
+			it = _cache.end();
+		}
+
+		if (it == _cache.end()) {
+			// Least recently used out
+			if ((int) _cache.size() >= _settings.SERVER_SCENES) {
+				_cache.erase( std::min_element(_cache.begin(), _cache.end(), [](const CacheEntry &a, const CacheEntry &b) {
+					return a.lastUse < b.lastUse;
+				}) );
+			}
+
+			_cache.push_back({ key, mtime, std::make_shared<Resident>(_settings, _pool), 0 });
+			it = _cache.end() - 1;
+		}
+
+		it->lastUse = ++_useClock;
+		resident = it->scene;
+	}
+
+	// Jobs arriving while the scene loads wait for it instead of loading it again
+	std::lock_guard<std::mutex> lock(resident->loadMutex);
+	cached = resident->loaded;
+
+	if ( !resident->loaded ) {
+		resident->ok = resident->engine.loadResident(path.c_str());
+		resident->loaded = true;
+		loads++;
+	}
+
+	if ( !resident->ok ) {
+		std::lock_guard<std::mutex> cacheLock(_cacheMutex);
+		_cache.erase( std::remove_if(_cache.begin(), _cache.end(), [&](const CacheEntry &entry) { return entry.scene == resident; }), _cache.end() );
+		return nullptr;
+	}
+
+	return resident;
+}
@@ -0,0 +1,88 @@
+// Render server, renders the jobs of local clients on scenes kept loaded between jobs
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+#include "engine.hpp"
+#include "settings.hpp"
+#include "threadpool.hpp"
+#include "../io/socket.hpp"
+#include "../utils/queue.hpp"
+
+
+/*
+A client sends one JSON job per line:
+	{"scene": "Scenes/monkey.json", "time": 1.5, "width": 640, "height": 360, "fov": 60, "format": "png", "output": "Out/a.png"}
+Only "scene" is required, the view is the one of the scene at `time`. "region": [x, y, w, h]
+renders only that rectangle of the image (distributed rendering), the rendered size is at most
+W x H of the settings. "format" is "png", "qoi", "ppm" or "raw" (RGB8 pixels, row after row).
+Each job gets a JSON line back, then the `bytes` of the image unless it went to "output":
+	{"ok": true, "width": 640, "height": 360, "format": "png", "size": 51234, "bytes": 51234, "cached": true, ...}
+	{"ok": false, "error": "..."}
+Several jobs can follow each other on a connection.
+*/
+class RenderServer {
+	// Constructors / Destructors
+	public:
+		RenderServer();
+		~RenderServer();
+
+	private:
+		// Headless engine of a scene, loaded by the first job that needs it
+		struct Resident {
+			Engine engine;
+			std::mutex loadMutex;
+			bool loaded;
+			bool ok;
+
+			Resident(const Settings &settings, ThreadPool &pool) : engine(settings, pool), loaded(false), ok(false) {}
+		};
+
+		struct CacheEntry {
+			std::string path;
+			std::filesystem::file_time_type mtime;
+			std::shared_ptr<Resident> scene;	// Jobs hold on to it, eviction only drops the cache reference
+			uint64_t lastUse;
+		};
+
+	// Attributes
+	public:
+		std::atomic<int> jobs;		// Rendered
+		std::atomic<int> hits;		// Jobs on a resident scene
+		std::atomic<int> loads;
+
+	private:
+		Settings _settings;
+		ThreadPool _pool;				// Shared by the engines of every scene
+
+		Socket _listener;
+		BlockingQueue<Socket> _clients;	// Accepted, waiting for a worker
+		std::vector<std::thread> _workers;
+
+		std::mutex _cacheMutex;
+		std::vector<CacheEntry> _cache;	// At most SERVER_SCENES
+		uint64_t _useClock;
+
+	// Methods
+	public:
+		// Serves on `address` ("unix:<path>" or "host:port") until SIGINT or SIGTERM
+		bool run(const std::string &address);
+
+	private:
+		void worker();
+		void serve(Socket &client);
+
+		// Runs the job of one request line, fills `bytes` with the image to send after the reply
+		std::string job(const std::string &line, std::vector<uint8_t> &bytes);
+
+		// Resident scene of `path` (loaded if needed), nullptr if it fails to load
+		std::shared_ptr<Resident> scene(const std::string &path, bool &cached);
+};
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <algorithm>
 
 #include "nlohmann_json/json.hpp" // downloaded from https://github.com/nlohmann/json
 
@@ -26,6 +27,54 @@ Settings::Settings() {
 
 	UPDATE_TIME = 2.f;  // in sec
 	DEBUG = true;
+
+	FRAMES_IN_FLIGHT = 3;
+	LATENCY_BUDGET = 100.f;  // in ms
+	ROTATION_SPEED = 0.f;    // in deg/sec
+
+	DEPTH_TEST = true;
+	BACKFACE_CULLING = false;
+	VISIBILITY_BUFFER = false;
+	LIGHT_CULLING = true;
+	DEPTH_PREPASS = false;
+	MSAA = 1;
+
+	SHADOWS = true;
+	SHADOW_MAP_SIZE = 1024;
+	SHADOW_CASCADES = 3;
+	SHADOW_PCF = 1;
+	SHADOW_BIAS = 1.5f;  // in texels
+
+	THREADS = 0;
+
+	DYNAMIC_RESOLUTION = false;
+	MIN_SCALE = 0.5f;
+	MAX_SCALE = 1.f;
+	SCALE_INTERVAL = 8;  // in frames
+
+	PROGRESSIVE = false;
+	PROGRESSIVE_SAMPLES = 16;
+
+	SURFACE_FORMAT = "rgb32f";
+	IMAGE_FORMAT = "png";
+	CAPTURE = false;
+	IMAGE_QUEUE = 4;
+
+	DEBUG_VERTICES = false;
+	DEBUG_NORMALS = false;
+	DEBUG_BOUNDS = false;
+
+	WIREFRAME = false;
+	WIREFRAME_HIDDEN = true;
+
+	PIPELINE_STATS = false;
+	DEBUG_VIEW = "none";
+	METRICS = "";
+	HOT_RELOAD = false;
+	STREAM_BUDGET_MB = 256;
+
+	SERVER_SCENES = 4;
+	SERVER_JOBS = 2;
 };
 
 Settings::~Settings() {
@@ -68,6 +117,59 @@ bool Settings::loadFromJSON(const char* path) {
 	UPDATE_TIME = data.value("UPDATE_TIME", UPDATE_TIME);
 	DEBUG = data.value("DEBUG", DEBUG);
 
+	FRAMES_IN_FLIGHT = std::max(1, std::min(3, data.value("FRAMES_IN_FLIGHT", FRAMES_IN_FLIGHT)));
+	LATENCY_BUDGET = data.value("LATENCY_BUDGET", LATENCY_BUDGET);
+	ROTATION_SPEED = data.value("ROTATION_SPEED", ROTATION_SPEED);
+
+	DEPTH_TEST = data.value("DEPTH_TEST", DEPTH_TEST);
+	BACKFACE_CULLING = data.value("BACKFACE_CULLING", BACKFACE_CULLING);
+	VISIBILITY_BUFFER = data.value("VISIBILITY_BUFFER", VISIBILITY_BUFFER);
+	LIGHT_CULLING = data.value("LIGHT_CULLING", LIGHT_CULLING);
+	DEPTH_PREPASS = data.value("DEPTH_PREPASS", DEPTH_PREPASS);
+
+	MSAA = data.value("MSAA", MSAA);
+	if (MSAA != 1 && MSAA != 2 && MSAA != 4 && MSAA != 8) {
+		std::cerr << "MSAA must be 1, 2, 4 or 8, got " << MSAA << ". Using 1." << std::endl;
+		MSAA = 1;
+	}
+
+	SHADOWS = data.value("SHADOWS", SHADOWS);
+	SHADOW_MAP_SIZE = std::max(1, data.value("SHADOW_MAP_SIZE", SHADOW_MAP_SIZE));
+	SHADOW_CASCADES = std::max(1, std::min(4, data.value("SHADOW_CASCADES", SHADOW_CASCADES)));
+	SHADOW_PCF = std::max(0, data.value("SHADOW_PCF", SHADOW_PCF));
+	SHADOW_BIAS = data.value("SHADOW_BIAS", SHADOW_BIAS);
+
+	THREADS = data.value("THREADS", THREADS);
+
+	DYNAMIC_RESOLUTION = data.value("DYNAMIC_RESOLUTION", DYNAMIC_RESOLUTION);
+	MAX_SCALE = std::max(0.1f, std::min(1.f, data.value("MAX_SCALE", MAX_SCALE)));
+	MIN_SCALE = std::max(0.1f, std::min(MAX_SCALE, data.value("MIN_SCALE", MIN_SCALE)));
+	SCALE_INTERVAL = std::max(1, data.value("SCALE_INTERVAL", SCALE_INTERVAL));
+
+	PROGRESSIVE = data.value("PROGRESSIVE", PROGRESSIVE);
+	PROGRESSIVE_SAMPLES = std::max(1, data.value("PROGRESSIVE_SAMPLES", PROGRESSIVE_SAMPLES));
+
+	SURFACE_FORMAT = data.value("SURFACE_FORMAT", SURFACE_FORMAT);
+	IMAGE_FORMAT = data.value("IMAGE_FORMAT", IMAGE_FORMAT);
+	CAPTURE = data.value("CAPTURE", CAPTURE);
+	IMAGE_QUEUE = std::max(1, data.value("IMAGE_QUEUE", IMAGE_QUEUE));
+
+	DEBUG_VERTICES = data.value("DEBUG_VERTICES", DEBUG_VERTICES);
+	DEBUG_NORMALS = data.value("DEBUG_NORMALS", DEBUG_NORMALS);
+	DEBUG_BOUNDS = data.value("DEBUG_BOUNDS", DEBUG_BOUNDS);
+
+	WIREFRAME = data.value("WIREFRAME", WIREFRAME);
+	WIREFRAME_HIDDEN = data.value("WIREFRAME_HIDDEN", WIREFRAME_HIDDEN);
+
+	PIPELINE_STATS = data.value("PIPELINE_STATS", PIPELINE_STATS);
+	DEBUG_VIEW = data.value("DEBUG_VIEW", DEBUG_VIEW);
+	METRICS = data.value("METRICS", METRICS);
+	HOT_RELOAD = data.value("HOT_RELOAD", HOT_RELOAD);
+	STREAM_BUDGET_MB = std::max(1, data.value("STREAM_BUDGET_MB", STREAM_BUDGET_MB));
+
+	SERVER_SCENES = std::max(1, data.value("SERVER_SCENES", SERVER_SCENES));
+	SERVER_JOBS = std::max(1, data.value("SERVER_JOBS", SERVER_JOBS));
+
 
 	std::cout << "\nSettings Loaded from " << path << ":\n"
 			  << "\tFAR_CLIP: " << FAR_CLIP << "\n"
@@ -80,6 +182,43 @@ bool Settings::loadFromJSON(const char* path) {
 			  << "\tFPS: "      << FPS      << "\n"
 			  << "\tUPDATE_TIME: " << UPDATE_TIME << "\n"
 			  << "\tDEBUG: "    << (DEBUG ? "true" : "false") << "\n"
+			  << "\tFRAMES_IN_FLIGHT: " << FRAMES_IN_FLIGHT << "\n"
+			  << "\tLATENCY_BUDGET: "   << LATENCY_BUDGET   << "\n"
+			  << "\tROTATION_SPEED: "   << ROTATION_SPEED   << "\n"
+			  << "\tDEPTH_TEST: "       << (DEPTH_TEST ? "true" : "false") << "\n"
+			  << "\tBACKFACE_CULLING: " << (BACKFACE_CULLING ? "true" : "false") << "\n"
+			  << "\tVISIBILITY_BUFFER: " << (VISIBILITY_BUFFER ? "true" : "false") << "\n"
+			  << "\tLIGHT_CULLING: "    << (LIGHT_CULLING ? "true" : "false") << "\n"
+			  << "\tDEPTH_PREPASS: "    << (DEPTH_PREPASS ? "true" : "false") << "\n"
+			  << "\tMSAA: "             << MSAA             << "\n"
+			  << "\tSHADOWS: "          << (SHADOWS ? "true" : "false") << "\n"
+			  << "\tSHADOW_MAP_SIZE: "  << SHADOW_MAP_SIZE  << "\n"
+			  << "\tSHADOW_CASCADES: "  << SHADOW_CASCADES  << "\n"
+			  << "\tSHADOW_PCF: "       << SHADOW_PCF       << "\n"
+			  << "\tSHADOW_BIAS: "      << SHADOW_BIAS      << "\n"
+			  << "\tTHREADS: "          << THREADS          << "\n"
+			  << "\tDYNAMIC_RESOLUTION: " << (DYNAMIC_RESOLUTION ? "true" : "false") << "\n"
+			  << "\tMIN_SCALE: "        << MIN_SCALE        << "\n"
+			  << "\tMAX_SCALE: "        << MAX_SCALE        << "\n"
+			  << "\tSCALE_INTERVAL: "   << SCALE_INTERVAL   << "\n"
+			  << "\tPROGRESSIVE: "      << (PROGRESSIVE ? "true" : "false") << "\n"
+			  << "\tPROGRESSIVE_SAMPLES: " << PROGRESSIVE_SAMPLES << "\n"
+			  << "\tSURFACE_FORMAT: "   << SURFACE_FORMAT   << "\n"
+			  << "\tIMAGE_FORMAT: "     << IMAGE_FORMAT     << "\n"
+			  << "\tCAPTURE: "          << (CAPTURE ? "true" : "false") << "\n"
+			  << "\tIMAGE_QUEUE: "      << IMAGE_QUEUE      << "\n"
+			  << "\tDEBUG_VERTICES: "   << (DEBUG_VERTICES ? "true" : "false") << "\n"
+			  << "\tDEBUG_NORMALS: "    << (DEBUG_NORMALS ? "true" : "false") << "\n"
+			  << "\tDEBUG_BOUNDS: "     << (DEBUG_BOUNDS ? "true" : "false") << "\n"
+			  << "\tWIREFRAME: "        << (WIREFRAME ? "true" : "false") << "\n"
+			  << "\tWIREFRAME_HIDDEN: " << (WIREFRAME_HIDDEN ? "true" : "false") << "\n"
+			  << "\tPIPELINE_STATS: "   << (PIPELINE_STATS ? "true" : "false") << "\n"
+			  << "\tDEBUG_VIEW: "       << DEBUG_VIEW << "\n"
+			  << "\tMETRICS: "          << METRICS << "\n"
+			  << "\tHOT_RELOAD: "       << (HOT_RELOAD ? "true" : "false") << "\n"
+			  << "\tSTREAM_BUDGET_MB: " << STREAM_BUDGET_MB << "\n"
+			  << "\tSERVER_SCENES: "    << SERVER_SCENES    << "\n"
+			  << "\tSERVER_JOBS: "      << SERVER_JOBS      << "\n"
 			  << std::endl;
 
 	return true;
@@ -97,6 +236,43 @@ bool Settings::saveToJSON(const char* path) {
 	data["ASR"] = ASR;
 	data["FPS"] = FPS;
 	data["UPDATE_TIME"] = UPDATE_TIME;
+	data["FRAMES_IN_FLIGHT"] = FRAMES_IN_FLIGHT;
+	data["LATENCY_BUDGET"] = LATENCY_BUDGET;
+	data["ROTATION_SPEED"] = ROTATION_SPEED;
+	data["DEPTH_TEST"] = DEPTH_TEST;
+	data["BACKFACE_CULLING"] = BACKFACE_CULLING;
+	data["VISIBILITY_BUFFER"] = VISIBILITY_BUFFER;
+	data["LIGHT_CULLING"] = LIGHT_CULLING;
+	data["DEPTH_PREPASS"] = DEPTH_PREPASS;
+	data["MSAA"] = MSAA;
+	data["SHADOWS"] = SHADOWS;
+	data["SHADOW_MAP_SIZE"] = SHADOW_MAP_SIZE;
+	data["SHADOW_CASCADES"] = SHADOW_CASCADES;
+	data["SHADOW_PCF"] = SHADOW_PCF;
+	data["SHADOW_BIAS"] = SHADOW_BIAS;
+	data["THREADS"] = THREADS;
+	data["DYNAMIC_RESOLUTION"] = DYNAMIC_RESOLUTION;
+	data["MIN_SCALE"] = MIN_SCALE;
+	data["MAX_SCALE"] = MAX_SCALE;
+	data["SCALE_INTERVAL"] = SCALE_INTERVAL;
+	data["PROGRESSIVE"] = PROGRESSIVE;
+	data["PROGRESSIVE_SAMPLES"] = PROGRESSIVE_SAMPLES;
+	data["SURFACE_FORMAT"] = SURFACE_FORMAT;
+	data["IMAGE_FORMAT"] = IMAGE_FORMAT;
+	data["CAPTURE"] = CAPTURE;
+	data["IMAGE_QUEUE"] = IMAGE_QUEUE;
+	data["DEBUG_VERTICES"] = DEBUG_VERTICES;
+	data["DEBUG_NORMALS"] = DEBUG_NORMALS;
+	data["DEBUG_BOUNDS"] = DEBUG_BOUNDS;
+	data["WIREFRAME"] = WIREFRAME;
+	data["WIREFRAME_HIDDEN"] = WIREFRAME_HIDDEN;
+	data["PIPELINE_STATS"] = PIPELINE_STATS;
+	data["DEBUG_VIEW"] = DEBUG_VIEW;
+	data["METRICS"] = METRICS;
+	data["HOT_RELOAD"] = HOT_RELOAD;
+	data["STREAM_BUDGET_MB"] = STREAM_BUDGET_MB;
+	data["SERVER_SCENES"] = SERVER_SCENES;
+	data["SERVER_JOBS"] = SERVER_JOBS;
 
 	std::ofstream file(path);
 	if (!file.is_open()) {
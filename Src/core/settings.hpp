@@ -1,5 +1,7 @@
 # pragma once
 
+#include <string>
+
 class Settings {
 public:
 	float FAR_CLIP; 	// Far clip
@@ -17,6 +19,54 @@ public:
 	float UPDATE_TIME;  // in sec
 	bool DEBUG;
 
+	int FRAMES_IN_FLIGHT;   // Frames overlapping in the pipeline (1-3)
+	float LATENCY_BUDGET;   // in ms, max submit to present latency
+	float ROTATION_SPEED;   // in deg/sec, spins the scene around Y
+
+	bool DEPTH_TEST;        // Depth buffer instead of painter's order
+	bool BACKFACE_CULLING;  // Drops the triangles facing away, for closed meshes (materials are two sided)
+	bool VISIBILITY_BUFFER; // Deferred mode, shades every pixel once
+	bool LIGHT_CULLING;     // Bins local lights per screen tile
+	bool DEPTH_PREPASS;     // Depth only pass before forward shading
+	int MSAA;               // Samples per pixel of forward rendering (1, 2, 4, 8)
+
+	bool SHADOWS;           // Shadow maps for the lights with "shadows"
+	int SHADOW_MAP_SIZE;    // in texels, per cascade
+	int SHADOW_CASCADES;    // Cascades of directional lights (1-4)
+	int SHADOW_PCF;         // Filter radius in texels, 0 is a single tap
+	float SHADOW_BIAS;      // in texels
+
+	int THREADS;            // Worker threads, 0 uses all hardware threads
+
+	bool DYNAMIC_RESOLUTION; // Scales the render resolution to hold FPS
+	float MIN_SCALE;        // Render resolution bounds, fraction of W and H
+	float MAX_SCALE;
+	int SCALE_INTERVAL;     // in frames, between two scale changes
+
+	bool PROGRESSIVE;       // Refines still views over several frames
+	int PROGRESSIVE_SAMPLES; // Accumulated samples of the final image
+
+	std::string SURFACE_FORMAT; // Presented image, "rgb32f", "rgba16f", "rgb10a2", "rgba8" or "srgba8"
+	std::string IMAGE_FORMAT; // Saved images, "png", "qoi" or "ppm"
+	bool CAPTURE;           // Saves every presented frame
+	int IMAGE_QUEUE;        // Images waiting for the writer thread, more are dropped
+
+	bool DEBUG_VERTICES;    // Debug overlay, a marker on every vertex
+	bool DEBUG_NORMALS;     // Debug overlay, vertex normals
+	bool DEBUG_BOUNDS;      // Debug overlay, bounding box of every object
+
+	bool WIREFRAME;         // Draws the edges of the triangles instead of shading them
+	bool WIREFRAME_HIDDEN;  // Hides the edges behind the (opaque) surface, depth tested
+
+	bool PIPELINE_STATS;    // Logs the pipeline statistics with the timings
+	std::string DEBUG_VIEW; // Heatmap instead of the image, "none", "overdraw", "density" or "tile_cost"
+	std::string METRICS;    // Prometheus endpoint, "host:port" or "unix:<path>", empty to disable
+	bool HOT_RELOAD;        // Watches the scene and its textures, changes apply without a restart
+	int STREAM_BUDGET_MB;   // Geometry of a packed scene (.qzs) kept in memory, the rest streams from disk
+
+	int SERVER_SCENES;      // Scenes the render server keeps loaded, the least recently used goes first
+	int SERVER_JOBS;        // Jobs the render server runs at once
+
 public:
 	Settings();
 	~Settings();
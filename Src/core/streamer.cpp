@@ -0,0 +1,305 @@
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+#include "streamer.hpp"
+
+
+// Whether the box `min`, `max` may be seen through `viewProj`, false once all its corners are out of one clip plane
+static bool inFrustum(const glm::mat4 &viewProj, const Vec3 &min, const Vec3 &max) {
+	int outside[6] = {0, 0, 0, 0, 0, 0};
+
+	for (int c=0; c<8; c++) {
+		Vec4 p = viewProj * Vec4((c & 1) ? max.x : min.x, (c & 2) ? max.y : min.y, (c & 4) ? max.z : min.z, 1.f);
+
+		outside[0] += (p.x < -p.w);
+		outside[1] += (p.x >  p.w);
+		outside[2] += (p.y < -p.w);
+		outside[3] += (p.y >  p.w);
+		outside[4] += (p.z < -p.w);
+		outside[5] += (p.z >  p.w);
+	}
+
+	for (int k=0; k<6; k++) {
+		if (outside[k] == 8) return false;
+	}
+	return true;
+}
+
+static uint64_t chunkBytes(const PackChunk &chunk) {
+	return (uint64_t) chunk.vertexCount*(2*sizeof(Vec3) + sizeof(Vec2)) + (uint64_t) chunk.indexCount*sizeof(uint32_t);
+}
+
+
+// Constructors and Destructors
+GeometryStreamer::GeometryStreamer() {
+	slotCount = 0;
+
+	_pack = nullptr;
+	_verticies = nullptr;
+	_normals = nullptr;
+	_uvs = nullptr;
+	_indices = nullptr;
+	_loading = 0;
+	_clock = 0;
+	_stamp = 0;
+	_counters = {};
+}
+
+GeometryStreamer::~GeometryStreamer() {
+	this->stop();
+}
+
+
+// Methods
+void GeometryStreamer::start(ScenePack &pack, int slots, Vec3 *verticies, Vec3 *normals, Vec2 *uvs, uint32_t *indices) {
+	_pack = &pack;
+	slotCount = slots;
+	_verticies = verticies;
+	_normals = normals;
+	_uvs = uvs;
+	_indices = indices;
+
+	// Bounds of every instance once, the frames test them against their view
+	size_t count = pack.instances.size();
+	_instanceMin.resize(count);
+	_instanceMax.resize(count);
+	_instanceRigid.resize(count);
+
+	for (size_t i=0; i<count; i++) {
+		const PackInstance &inst = pack.instances[i];
+		const PackPart &part = pack.parts[inst.part];
+
+		_instanceMin[i] = Vec3(INFINITY);
+		_instanceMax[i] = Vec3(-INFINITY);
+		for (int c=0; c<8; c++) {
+			Vec3 corner((c & 1) ? part.max.x : part.min.x, (c & 2) ? part.max.y : part.min.y, (c & 4) ? part.max.z : part.min.z);
+			corner = Vec3( inst.transform * Vec4(corner, 1.f) );
+			_instanceMin[i] = glm::min(_instanceMin[i], corner);
+			_instanceMax[i] = glm::max(_instanceMax[i], corner);
+		}
+		_instanceRigid[i] = isRigid(inst.transform);
+	}
+
+	Chunk chunk = {};
+	chunk.state = ChunkState::MISSING;
+	chunk.slot = -1;
+	_chunks.assign(pack.chunks.size(), chunk);
+
+	_freeSlots.clear();
+	for (int s=slots-1; s>=0; s--) {
+		_freeSlots.push_back(s);
+	}
+
+	_loader = std::thread(&GeometryStreamer::loadLoop, this);
+}
+
+void GeometryStreamer::stop() {
+	_requests.close();
+	if (_loader.joinable()) _loader.join();
+}
+
+GeometryStreamer::Counters GeometryStreamer::counters() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _counters;
+}
+
+void GeometryStreamer::update(Frame &frame, const glm::mat4 &modelView, bool wait) {
+	const ScenePack &pack = *_pack;
+	glm::mat4 viewProj = frame.projection * modelView;
+
+	// Visible instances, nearest first, so are the requests
+	std::vector< std::pair<float, uint32_t> > visible;
+	for (uint32_t i=0; i<(uint32_t) pack.instances.size(); i++) {
+		if ( !inFrustum(viewProj, _instanceMin[i], _instanceMax[i]) ) continue;
+
+		Vec3 center = Vec3( modelView * Vec4((_instanceMin[i] + _instanceMax[i])/2.f, 1.f) );
+		visible.push_back({ glm::length(center), i });
+	}
+	std::sort(visible.begin(), visible.end());
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_clock++;
+
+	// The previous layout of the frame is done with
+	for (uint32_t c : frame.streamChunks) {
+		_chunks[c].pins--;
+	}
+	frame.streamChunks.clear();
+
+	std::vector<uint32_t> missing;
+	uint64_t frameHits;
+
+	while (true) {
+		_stamp++;
+		missing.clear();
+		frameHits = 0;
+
+		for (const auto &[distance, i] : visible) {
+			uint32_t c = pack.parts[ pack.instances[i].part ].chunk;
+			Chunk &chunk = _chunks[c];
+			if (chunk.stamp == _stamp) continue;
+			chunk.stamp = _stamp;
+
+			if (chunk.state == ChunkState::RESIDENT) {
+				chunk.pins++;
+				chunk.lastUse = _clock;
+				frame.streamChunks.push_back(c);
+				frameHits++;
+			}
+			else if (chunk.state != ChunkState::FAILED) {
+				missing.push_back(c);
+			}
+		}
+
+		this->request(missing);
+
+		if ( !wait || missing.empty() || _loading == 0 ) break;
+
+		// Pinned again once the reads are in
+		for (uint32_t c : frame.streamChunks) {
+			_chunks[c].pins--;
+		}
+		frame.streamChunks.clear();
+		_loaded.wait(lock);
+	}
+
+	_counters.hits += frameHits;
+	_counters.misses += missing.size();
+
+	// Layout of the frame, the parts of the pinned chunks where their slot is in the arena
+	frame.streamInstances.clear();
+	frame.streamMeshes.clear();
+	frame.streamTrisInstance.clear();
+	frame.placeholders.clear();
+
+	std::unordered_map<uint32_t, uint32_t> meshOf;	// Part to frame mesh
+	uint32_t vxCount = 0, triCount = 0;
+
+	for (const auto &[distance, i] : visible) {
+		const PackInstance &packed = pack.instances[i];
+		const PackPart &part = pack.parts[packed.part];
+		const Chunk &chunk = _chunks[part.chunk];
+
+		if (chunk.state != ChunkState::RESIDENT) {
+			frame.placeholders.push_back(_instanceMin[i]);
+			frame.placeholders.push_back(_instanceMax[i]);
+			continue;
+		}
+
+		auto [it, added] = meshOf.try_emplace(packed.part, (uint32_t) frame.streamMeshes.size());
+		if (added) {
+			MeshRange range = {};
+			range.firstVertex = (uint32_t) chunk.slot*CHUNK_VERTICES + part.firstVertex;
+			range.vertexCount = part.vertexCount;
+			range.firstIndex = (uint32_t) chunk.slot*CHUNK_INDICES + part.firstIndex;
+			range.triangleCount = part.triangleCount;
+			range.min = part.min;
+			range.max = part.max;
+			frame.streamMeshes.push_back(range);
+		}
+
+		Instance inst = {};
+		inst.transform = packed.transform;
+		inst.mesh = it->second;
+		inst.object = packed.object;
+		inst.firstVertex = vxCount;
+		inst.firstTriangle = triCount;
+		inst.rigid = _instanceRigid[i];
+
+		frame.streamTrisInstance.insert(frame.streamTrisInstance.end(), part.triangleCount, (uint32_t) frame.streamInstances.size());
+		frame.streamInstances.push_back(inst);
+		vxCount += part.vertexCount;
+		triCount += part.triangleCount;
+	}
+
+	lock.unlock();
+
+	frame.instances = frame.streamInstances.data();
+	frame.meshes = frame.streamMeshes.data();
+	frame.trisInstance = frame.streamTrisInstance.data();
+	frame.instanceCount = (int) frame.streamInstances.size();
+	frame.drawVxCount = (int) vxCount;
+	frame.drawTriCount = (int) triCount;
+
+	frame.reserve(vxCount, triCount, frame.lightCount);
+}
+
+void GeometryStreamer::request(const std::vector<uint32_t> &missing) {
+	for (uint32_t c : missing) {
+		if (_loading >= STREAM_REQUESTS) return;
+
+		Chunk &chunk = _chunks[c];
+		if (chunk.state != ChunkState::MISSING) continue;
+
+		int slot = this->takeSlot();
+		if (slot < 0) return;
+
+		chunk.state = ChunkState::LOADING;
+		chunk.slot = slot;
+		chunk.tPtRequest = TIME_NOW();
+		_loading++;
+		_requests.push({c, slot});
+	}
+}
+
+int GeometryStreamer::takeSlot() {
+	if ( !_freeSlots.empty() ) {
+		int slot = _freeSlots.back();
+		_freeSlots.pop_back();
+		return slot;
+	}
+
+	int lru = -1;
+	for (int k=0; k<(int) _resident.size(); k++) {
+		const Chunk &chunk = _chunks[ _resident[k] ];
+		if (chunk.pins > 0) continue;
+		if (lru < 0 || chunk.lastUse < _chunks[ _resident[lru] ].lastUse) lru = k;
+	}
+	if (lru < 0) return -1;
+
+	Chunk &chunk = _chunks[ _resident[lru] ];
+	int slot = chunk.slot;
+	chunk.state = ChunkState::MISSING;
+	chunk.slot = -1;
+	_counters.residentBytes -= chunkBytes(_pack->chunks[ _resident[lru] ]);
+	_counters.evictions++;
+
+	_resident[lru] = _resident.back();
+	_resident.pop_back();
+	return slot;
+}
+
+// One read at a time, into a slot no frame reads until the chunk is resident
+void GeometryStreamer::loadLoop() {
+	Request request;
+
+	while ( _requests.pop(request) ) {
+		size_t slot = (size_t) request.slot;
+		bool ok = _pack->readChunk(request.chunk, _verticies + slot*CHUNK_VERTICES, _normals + slot*CHUNK_VERTICES,
+			_uvs + slot*CHUNK_VERTICES, _indices + slot*CHUNK_INDICES);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		Chunk &chunk = _chunks[request.chunk];
+		_loading--;
+
+		if ( !ok ) {
+			std::cerr << "Failed to read the chunk " << request.chunk << " of " << _pack->path << ", drawing its bounds" << std::endl;
+			chunk.state = ChunkState::FAILED;
+			chunk.slot = -1;
+			_freeSlots.push_back(request.slot);
+		}
+		else {
+			uint64_t tPageIn = TIME_DUR(TIME_NOW(), chunk.tPtRequest);
+			chunk.state = ChunkState::RESIDENT;
+			_resident.push_back(request.chunk);
+
+			_counters.residentBytes += chunkBytes(_pack->chunks[request.chunk]);
+			_counters.pageIns++;
+			_counters.tPageInSum += tPageIn;
+			pageInLatency.observe(tPageIn);
+		}
+
+		_loaded.notify_all();
+	}
+}
@@ -0,0 +1,121 @@
+// Out-of-core geometry, pages the chunks of a packed scene in and out following what the frames see
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+
+#include "frame.hpp"
+#include "../scene/scenepack.hpp"
+#include "../io/metrics.hpp"
+#include "../utils/queue.hpp"
+#include "../utils/utils.hpp"
+
+
+#define STREAM_REQUESTS 8	// Chunk reads queued at once, the nearest chunks first
+
+
+/*
+The chunks go to the slots of an arena (the mesh library buffers of the engine), a slot holds
+CHUNK_VERTICES verticies and CHUNK_INDICES indices and the slot count follows the memory
+budget. Every frame tests the bounds of all the instances against its view, pins the resident
+chunks of the visible ones and draws only those, the missing ones are requested nearest first
+and drawn as their bounds meanwhile. A loader thread reads them into free slots, or into the
+least recently used chunk no frame has pinned
+*/
+class GeometryStreamer {
+	// Constructors / Destructors
+	public:
+		GeometryStreamer();
+		~GeometryStreamer();
+
+	private:
+		enum class ChunkState {
+			MISSING,
+			LOADING,
+			RESIDENT,
+			FAILED,		// Unreadable, drawn as its bounds from then on
+		};
+
+		struct Chunk {
+			ChunkState state;
+			int slot;
+			int pins;			// Frames drawn with it, not evicted while any
+			uint64_t lastUse;	// update() call, for the LRU
+			uint64_t stamp;		// Pass of update() that saw it last
+			TIME_PT tPtRequest;
+		};
+
+		struct Request {
+			uint32_t chunk;
+			int slot;
+		};
+
+	public:
+		struct Counters {
+			uint64_t hits;			// Chunks of visible instances, resident when a frame needed them
+			uint64_t misses;
+			uint64_t pageIns;
+			uint64_t evictions;
+			uint64_t residentBytes;
+			uint64_t tPageInSum;	// us, request to resident
+		};
+
+	// Attributes
+	public:
+		int slotCount;
+		Histogram pageInLatency;
+
+	private:
+		ScenePack *_pack;
+		std::vector<Vec3> _instanceMin;		// Scene model space
+		std::vector<Vec3> _instanceMax;
+		std::vector<uint8_t> _instanceRigid;
+
+		Vec3 *_verticies;					// Arena, slot after slot
+		Vec3 *_normals;
+		Vec2 *_uvs;
+		uint32_t *_indices;
+
+		std::mutex _mutex;
+		std::condition_variable _loaded;
+		std::vector<Chunk> _chunks;
+		std::vector<int> _freeSlots;
+		std::vector<uint32_t> _resident;	// Chunks in a slot
+		int _loading;
+		uint64_t _clock;
+		uint64_t _stamp;
+		Counters _counters;
+
+		BlockingQueue<Request> _requests;
+		std::thread _loader;
+
+	// Methods
+	public:
+		// Streams the chunks of an opened pack into the arena of `slots` slots
+		void start(ScenePack &pack, int slots, Vec3 *verticies, Vec3 *normals, Vec2 *uvs, uint32_t *indices);
+		void stop();
+
+		/*
+		Lays out the frame with the resident chunks of the instances visible through `modelView`
+		and the frame projection, the pins of its previous layout are released. `wait` blocks
+		until every visible chunk is resident, or the budget is full of them
+		*/
+		void update(Frame &frame, const glm::mat4 &modelView, bool wait);
+
+		// Copy taken under the lock, the counters agree with each other
+		Counters counters();
+
+	private:
+		void loadLoop();
+
+		// Queues the MISSING chunks of `missing`, nearest first
+		void request(const std::vector<uint32_t> &missing);
+
+		// Free slot, or the one of the least recently used chunk no frame pins, -1 if none
+		int takeSlot();
+};
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "threadpool.hpp"
+
+
+// Constructors and Destructors
+ThreadPool::ThreadPool() {
+	_stop = false;
+}
+
+ThreadPool::~ThreadPool() {
+	this->stop();
+}
+
+
+// Methods
+void ThreadPool::start(int threadCount) {
+	this->stop();
+	_stop = false;
+
+	if (threadCount <= 0) {
+		threadCount = std::max(1, (int) std::thread::hardware_concurrency());
+	}
+
+	// The thread calling parallelFor() is one of them
+	for (int i=0; i<threadCount-1; i++) {
+		_threads.emplace_back(&ThreadPool::worker, this);
+	}
+}
+
+void ThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_hasJob.notify_all();
+
+	for (std::thread &t : _threads) {
+		t.join();
+	}
+	_threads.clear();
+}
+
+int ThreadPool::threadCount() const {
+	return (int) _threads.size() + 1;
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)> &fn) {
+	if (count <= 0) return;
+	grain = std::max(1, grain);
+
+	// Not worth waking anyone up
+	if (count <= grain || _threads.empty()) {
+		fn(0, count);
+		return;
+	}
+
+	Job job = {&fn, count, grain, 0, 0};
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_jobs.push_back(&job);
+	_hasJob.notify_all();
+
+	// Help with our own job, then wait for the chunks taken by workers
+	while ( this->runChunk(&job, lock) );
+	_jobDone.wait(lock, [&job] { return job.done == job.count; });
+}
+
+void ThreadPool::worker() {
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while (true) {
+		_hasJob.wait(lock, [this] { return _stop || !_jobs.empty(); });
+		if (_stop) return;
+
+		this->runChunk(_jobs.front(), lock);
+	}
+}
+
+// Claims and runs the next chunk of `job` with the lock released,
+// returns false once every chunk of the job has been claimed
+bool ThreadPool::runChunk(Job *job, std::unique_lock<std::mutex> &lock) {
+	if (job->next >= job->count) return false;
+
+	int begin = job->next;
+	int end = std::min(job->count, begin + job->grain);
+	job->next = end;
+
+	// Fully claimed, nobody else needs to see it
+	if (end == job->count) {
+		_jobs.erase(std::find(_jobs.begin(), _jobs.end(), job));
+	}
+
+	lock.unlock();
+	(*job->fn)(begin, end);
+	lock.lock();
+
+	job->done += end - begin;
+	if (job->done == job->count) {
+		_jobDone.notify_all();
+	}
+
+	return true;
+}
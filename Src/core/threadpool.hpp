@@ -0,0 +1,53 @@
+// Worker threads for data parallel loops
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+
+class ThreadPool {
+	// Constructors / Destructors
+	public:
+		ThreadPool();
+		~ThreadPool();
+
+	private:
+		// A parallelFor() call, lives on the stack of the calling thread
+		struct Job {
+			const std::function<void(int, int)> *fn;
+			int count;
+			int grain;
+			int next;	// First item not claimed yet
+			int done;	// Items finished
+		};
+
+	// Attributes
+	private:
+		std::vector<std::thread> _threads;
+		std::deque<Job*> _jobs;
+		std::mutex _mutex;
+		std::condition_variable _hasJob;
+		std::condition_variable _jobDone;
+		bool _stop;
+
+	// Methods
+	public:
+		// 0 uses every hardware thread (the calling thread counts as one)
+		void start(int threadCount);
+		void stop();
+		int threadCount() const;
+
+		// Calls fn(begin, end) over [0, count) in chunks of `grain` items,
+		// the calling thread helps and returns once every chunk is done.
+		// Safe to call from several threads at once.
+		void parallelFor(int count, int grain, const std::function<void(int, int)> &fn);
+
+	private:
+		void worker();
+		bool runChunk(Job *job, std::unique_lock<std::mutex> &lock);
+};
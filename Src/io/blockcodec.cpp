@@ -0,0 +1,345 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "blockcodec.hpp"
+
+
+#define DDS_MAGIC 0x20534444u		// "DDS "
+#define DDS_HEADER_SIZE 124
+#define DDS_FOURCC(a, b, c, d) ( (uint32_t) (a) | ((uint32_t) (b) << 8) | ((uint32_t) (c) << 16) | ((uint32_t) (d) << 24) )
+
+
+// ------ Helpers ------
+
+static inline uint32_t rgba(int r, int g, int b) {
+	return r | (g << 8) | (b << 16) | 0xFF000000u;
+}
+
+static inline int channel(uint32_t texel, int c) {
+	return (texel >> (8*c)) & 0xFF;
+}
+
+static inline uint16_t toRGB565(const float c[3]) {
+	int r = std::clamp((int) (c[0]*31.f/255.f + 0.5f), 0, 31);
+	int g = std::clamp((int) (c[1]*63.f/255.f + 0.5f), 0, 63);
+	int b = std::clamp((int) (c[2]*31.f/255.f + 0.5f), 0, 31);
+	return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+// Bits replicated into the low ones, 31 and 63 expand to 255
+static inline void fromRGB565(uint16_t c, int out[3]) {
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+static inline uint16_t getU16(const uint8_t *p) {
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static inline uint32_t getU32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void putU32(uint8_t *p, uint32_t v) {
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+// The 4 colours of a BC1 block, 3 and black when c0 <= c1
+static void paletteBC1(uint16_t c0, uint16_t c1, int palette[4][3]) {
+	fromRGB565(c0, palette[0]);
+	fromRGB565(c1, palette[1]);
+
+	for (int k=0; k<3; k++) {
+		if (c0 > c1) {
+			palette[2][k] = (2*palette[0][k] + palette[1][k])/3;
+			palette[3][k] = (palette[0][k] + 2*palette[1][k])/3;
+		}
+		else {
+			palette[2][k] = (palette[0][k] + palette[1][k])/2;
+			palette[3][k] = 0;
+		}
+	}
+}
+
+// The 8 values of a BC4 block, 6 with 0 and 255 when a0 <= a1
+static void paletteBC4(int a0, int a1, int palette[8]) {
+	palette[0] = a0;
+	palette[1] = a1;
+
+	if (a0 > a1) {
+		for (int i=1; i<7; i++) palette[i + 1] = ((7 - i)*a0 + i*a1)/7;
+	}
+	else {
+		for (int i=1; i<5; i++) palette[i + 1] = ((5 - i)*a0 + i*a1)/5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+
+// ------ Encoders ------
+
+// Endpoints on the principal axis of the colours (a few power iterations), then the nearest palette entry per texel
+void encodeBC1(const uint32_t texels[16], uint8_t out[8]) {
+	float c[16][3];
+	float mean[3] = {0.f, 0.f, 0.f};
+
+	for (int i=0; i<16; i++) {
+		for (int k=0; k<3; k++) {
+			c[i][k] = (float) channel(texels[i], k);
+			mean[k] += c[i][k]/16.f;
+		}
+	}
+
+	float cov[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};	// rr, rg, rb, gg, gb, bb
+	for (int i=0; i<16; i++) {
+		float r = c[i][0] - mean[0], g = c[i][1] - mean[1], b = c[i][2] - mean[2];
+		cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+		cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+	}
+
+	float axis[3] = {1.f, 1.f, 1.f};
+	for (int it=0; it<4; it++) {
+		float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		float m = std::max({std::abs(x), std::abs(y), std::abs(z)});
+		if (m <= 0.f) break;
+
+		axis[0] = x/m;
+		axis[1] = y/m;
+		axis[2] = z/m;
+	}
+
+	float tMin = 0.f, tMax = 0.f;
+	for (int i=0; i<16; i++) {
+		float t = (c[i][0] - mean[0])*axis[0] + (c[i][1] - mean[1])*axis[1] + (c[i][2] - mean[2])*axis[2];
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+
+	float e0[3], e1[3];
+	float len2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+	for (int k=0; k<3; k++) {
+		e0[k] = mean[k] + axis[k]*tMax/len2;
+		e1[k] = mean[k] + axis[k]*tMin/len2;
+	}
+
+	uint16_t c0 = toRGB565(e0);
+	uint16_t c1 = toRGB565(e1);
+	if (c0 < c1) std::swap(c0, c1);
+
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		int palette[4][3];
+		paletteBC1(c0, c1, palette);
+
+		for (int i=0; i<16; i++) {
+			int best = 0;
+			float bestDist = 1E30F;
+
+			for (int p=0; p<4; p++) {
+				float dr = c[i][0] - palette[p][0], dg = c[i][1] - palette[p][1], db = c[i][2] - palette[p][2];
+				float dist = dr*dr + dg*dg + db*db;
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = p;
+				}
+			}
+
+			indices |= (uint32_t) best << (2*i);
+		}
+	}
+
+	out[0] = (uint8_t) c0;
+	out[1] = (uint8_t) (c0 >> 8);
+	out[2] = (uint8_t) c1;
+	out[3] = (uint8_t) (c1 >> 8);
+	putU32(out + 4, indices);
+}
+
+// Endpoints at the extremes, 8 value mode, nearest entry per texel
+void encodeBC4(const uint8_t values[16], uint8_t out[8]) {
+	int a0 = *std::max_element(values, values + 16);
+	int a1 = *std::min_element(values, values + 16);
+
+	int palette[8];
+	paletteBC4(a0, a1, palette);
+
+	uint64_t indices = 0;
+	if (a0 != a1) {
+		for (int i=0; i<16; i++) {
+			int best = 0;
+			for (int p=1; p<8; p++) {
+				if (std::abs(values[i] - palette[p]) < std::abs(values[i] - palette[best])) best = p;
+			}
+			indices |= (uint64_t) best << (3*i);
+		}
+	}
+
+	out[0] = (uint8_t) a0;
+	out[1] = (uint8_t) a1;
+	for (int k=0; k<6; k++) {
+		out[2 + k] = (uint8_t) (indices >> (8*k));
+	}
+}
+
+
+// ------ Decoders ------
+
+void decodeBC1(const uint8_t *block, uint32_t texels[16]) {
+	int palette[4][3];
+	paletteBC1(getU16(block), getU16(block + 2), palette);
+
+	uint32_t colors[4];
+	for (int p=0; p<4; p++) {
+		colors[p] = rgba(palette[p][0], palette[p][1], palette[p][2]);
+	}
+
+	uint32_t indices = getU32(block + 4);
+	for (int i=0; i<16; i++) {
+		texels[i] = colors[(indices >> (2*i)) & 3];
+	}
+}
+
+// The 16 values of a BC4 block
+static inline void valuesBC4(const uint8_t *block, int values[16]) {
+	int palette[8];
+	paletteBC4(block[0], block[1], palette);
+
+	uint64_t indices = 0;
+	for (int k=0; k<6; k++) {
+		indices |= (uint64_t) block[2 + k] << (8*k);
+	}
+
+	for (int i=0; i<16; i++) {
+		values[i] = palette[(indices >> (3*i)) & 7];
+	}
+}
+
+void decodeBC4(const uint8_t *block, uint32_t texels[16]) {
+	int v[16];
+	valuesBC4(block, v);
+
+	for (int i=0; i<16; i++) {
+		texels[i] = rgba(v[i], v[i], v[i]);
+	}
+}
+
+void decodeBC5(const uint8_t *block, uint32_t texels[16]) {
+	int r[16], g[16];
+	valuesBC4(block, r);
+	valuesBC4(block + 8, g);
+
+	for (int i=0; i<16; i++) {
+		texels[i] = rgba(r[i], g[i], 0);
+	}
+}
+
+
+// ------ DDS ------
+
+static uint32_t fourCC(BlockFormat format) {
+	switch (format) {
+		case BlockFormat::BC1: return DDS_FOURCC('D', 'X', 'T', '1');
+		case BlockFormat::BC4: return DDS_FOURCC('A', 'T', 'I', '1');
+		case BlockFormat::BC5: return DDS_FOURCC('A', 'T', 'I', '2');
+	}
+	return 0;
+}
+
+static size_t levelBytes(BlockFormat format, int w, int h, int levels) {
+	size_t size = 0;
+	for (int l=0; l<levels; l++) {
+		size += (size_t) ((w + 3)/4) * ((h + 3)/4) * blockBytes(format);
+		w = std::max(1, w/2);
+		h = std::max(1, h/2);
+	}
+	return size;
+}
+
+bool writeDDS(const std::string &path, BlockFormat format, int w, int h, int levels, const std::vector<uint8_t> &data) {
+	uint8_t header[4 + DDS_HEADER_SIZE];
+	std::memset(header, 0, sizeof(header));
+
+	uint8_t *hd = header + 4;
+	putU32(header, DDS_MAGIC);
+	putU32(hd, DDS_HEADER_SIZE);
+	putU32(hd + 4, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000);	// Caps, height, width, pixel format, mip count, linear size
+	putU32(hd + 8, h);
+	putU32(hd + 12, w);
+	putU32(hd + 16, (uint32_t) levelBytes(format, w, h, 1));
+	putU32(hd + 24, levels);
+
+	// Pixel format at 72
+	putU32(hd + 72, 32);
+	putU32(hd + 76, 0x4);		// Four CC
+	putU32(hd + 80, fourCC(format));
+
+	putU32(hd + 104, 0x1000 | 0x400000 | 0x8);	// Texture, mipmap, complex
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		std::cerr << "Failed to open " << path << std::endl;
+		return false;
+	}
+
+	bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header)
+		&& fwrite(data.data(), 1, data.size(), file) == data.size();
+	fclose(file);
+
+	if ( !ok ) std::cerr << "Failed to write " << path << std::endl;
+	return ok;
+}
+
+bool readDDS(const std::string &path, BlockFormat &format, int &w, int &h, int &levels, std::vector<uint8_t> &data) {
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		std::cerr << "Failed to open " << path << std::endl;
+		return false;
+	}
+
+	uint8_t header[4 + DDS_HEADER_SIZE];
+	bool ok = fread(header, 1, sizeof(header), file) == sizeof(header);
+	const uint8_t *hd = header + 4;
+
+	if ( !ok || getU32(header) != DDS_MAGIC || getU32(hd) != DDS_HEADER_SIZE ) {
+		std::cerr << "Not a DDS file: " << path << std::endl;
+		fclose(file);
+		return false;
+	}
+
+	h = (int) getU32(hd + 8);
+	w = (int) getU32(hd + 12);
+	levels = std::max(1, (int) getU32(hd + 24));
+
+	uint32_t code = getU32(hd + 80);
+	if      (code == DDS_FOURCC('D', 'X', 'T', '1')) format = BlockFormat::BC1;
+	else if (code == DDS_FOURCC('A', 'T', 'I', '1') || code == DDS_FOURCC('B', 'C', '4', 'U')) format = BlockFormat::BC4;
+	else if (code == DDS_FOURCC('A', 'T', 'I', '2') || code == DDS_FOURCC('B', 'C', '5', 'U')) format = BlockFormat::BC5;
+	else {
+		std::cerr << "Unsupported DDS format in " << path << ", expected DXT1, ATI1 (BC4) or ATI2 (BC5)" << std::endl;
+		fclose(file);
+		return false;
+	}
+
+	if (w <= 0 || h <= 0 || levels > 16) {
+		std::cerr << "Invalid DDS size in " << path << std::endl;
+		fclose(file);
+		return false;
+	}
+
+	data.resize( levelBytes(format, w, h, levels) );
+	ok = fread(data.data(), 1, data.size(), file) == data.size();
+	fclose(file);
+
+	if ( !ok ) std::cerr << "Truncated DDS file: " << path << std::endl;
+	return ok;
+}
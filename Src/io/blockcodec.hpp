@@ -0,0 +1,39 @@
+// Block compression of textures, 4x4 texels per block (the DXT1, ATI1 and ATI2 formats of DDS files)
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+#define BC_BLOCK 4		// Block size in texels
+
+
+enum class BlockFormat : uint8_t {
+	BC1,	// RGB, 8 bytes: two RGB565 endpoints and 2 bit indices
+	BC4,	// One channel, 8 bytes: two 8 bit endpoints and 3 bit indices
+	BC5,	// Two channels, 16 bytes: a BC4 block for red, then one for green
+};
+
+inline int blockBytes(BlockFormat format) {
+	return (format == BlockFormat::BC5) ? 16 : 8;
+}
+
+
+// `texels` are 16 RGBA8 (R in the low byte) in row-major order, alpha is dropped
+void encodeBC1(const uint32_t texels[16], uint8_t out[8]);
+void encodeBC4(const uint8_t values[16], uint8_t out[8]);
+
+// To RGBA8 texels, BC4 is grey and BC5 is (red, green, 0), alpha is opaque
+void decodeBC1(const uint8_t *block, uint32_t texels[16]);
+void decodeBC4(const uint8_t *block, uint32_t texels[16]);
+void decodeBC5(const uint8_t *block, uint32_t texels[16]);
+
+
+/*
+DDS files with a mip chain, `data` holds every level from the largest one,
+max(1, w/4)*max(1, h/4) blocks per level in row-major order
+*/
+bool writeDDS(const std::string &path, BlockFormat format, int w, int h, int levels, const std::vector<uint8_t> &data);
+bool readDDS(const std::string &path, BlockFormat &format, int &w, int &h, int &levels, std::vector<uint8_t> &data);
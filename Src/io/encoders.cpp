@@ -0,0 +1,455 @@
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#include "encoders.hpp"
+
+
+// ------ Helpers ------
+
+static void putU32BE(std::vector<uint8_t> &out, uint32_t v) {
+	out.push_back( (uint8_t) (v >> 24) );
+	out.push_back( (uint8_t) (v >> 16) );
+	out.push_back( (uint8_t) (v >> 8) );
+	out.push_back( (uint8_t) v );
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+	static const struct Table {
+		uint32_t v[256];
+		Table() {
+			for (uint32_t i=0; i<256; i++) {
+				uint32_t c = i;
+				for (int k=0; k<8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				v[i] = c;
+			}
+		}
+	} table;
+
+	crc = ~crc;
+	for (size_t i=0; i<size; i++) {
+		crc = table.v[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size) {
+	uint32_t a = 1, b = 0;
+
+	// 5552 bytes is the longest run before the sums can overflow
+	while (size > 0) {
+		size_t n = std::min<size_t>(size, 5552);
+		size -= n;
+
+		for (size_t i=0; i<n; i++) {
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+
+// ------ QOI ------
+
+void encodeQOI(const uint8_t *rgb, int w, int h, std::vector<uint8_t> &out) {
+	size_t count = (size_t) w*h;
+
+	out.clear();
+	out.reserve(14 + count*4 + 8);
+
+	out.insert(out.end(), {'q', 'o', 'i', 'f'});
+	putU32BE(out, w);
+	putU32BE(out, h);
+	out.push_back(3);	// RGB
+	out.push_back(0);	// sRGB with linear alpha
+
+	// RGBA like the decoder's, an empty slot is (0, 0, 0, 0) and not opaque black
+	uint8_t index[64][4] = {};
+	uint8_t prev[3] = {0, 0, 0};
+	int run = 0;
+
+	for (size_t i=0; i<count; i++) {
+		const uint8_t *px = rgb + 3*i;
+
+		if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2]) {
+			run++;
+			if (run == 62 || i == count-1) {
+				out.push_back( 0xC0 | (run - 1) );	// QOI_OP_RUN
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0) {
+			out.push_back( 0xC0 | (run - 1) );
+			run = 0;
+		}
+
+		// Alpha is always 255
+		int slot = (px[0]*3 + px[1]*5 + px[2]*7 + 255*11) % 64;
+
+		if (index[slot][0] == px[0] && index[slot][1] == px[1] && index[slot][2] == px[2] && index[slot][3] == 255) {
+			out.push_back( (uint8_t) slot );	// QOI_OP_INDEX
+		}
+		else {
+			std::memcpy(index[slot], px, 3);
+			index[slot][3] = 255;
+
+			int8_t dr = (int8_t) (px[0] - prev[0]);
+			int8_t dg = (int8_t) (px[1] - prev[1]);
+			int8_t db = (int8_t) (px[2] - prev[2]);
+			int8_t drg = dr - dg;
+			int8_t dbg = db - dg;
+
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+				out.push_back( 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2) );	// QOI_OP_DIFF
+			}
+			else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+				out.push_back( 0x80 | (dg + 32) );	// QOI_OP_LUMA
+				out.push_back( (drg + 8) << 4 | (dbg + 8) );
+			}
+			else {
+				out.insert(out.end(), {0xFE, px[0], px[1], px[2]});	// QOI_OP_RGB
+			}
+		}
+
+		std::memcpy(prev, px, 3);
+	}
+
+	out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+}
+
+bool decodeQOI(const uint8_t *bytes, size_t size, int &w, int &h, std::vector<uint8_t> &rgba) {
+	static const uint8_t END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+	if (size < 14 + 8 || std::memcmp(bytes, "qoif", 4) != 0) return false;
+	if (std::memcmp(bytes + size - 8, END, 8) != 0) return false;
+
+	auto getU32BE = [&](size_t p) {
+		return (uint32_t) bytes[p] << 24 | (uint32_t) bytes[p+1] << 16 | (uint32_t) bytes[p+2] << 8 | bytes[p+3];
+	};
+	w = (int) getU32BE(4);
+	h = (int) getU32BE(8);
+	if (w <= 0 || h <= 0 || (bytes[12] != 3 && bytes[12] != 4)) return false;
+
+	size_t count = (size_t) w*h;
+	rgba.resize(4*count);
+
+	uint8_t index[64][4] = {};
+	uint8_t px[4] = {0, 0, 0, 255};
+	size_t p = 14, end = size - 8;
+	int run = 0;
+
+	for (size_t i=0; i<count; i++) {
+		if (run > 0) {
+			run--;
+		}
+		else {
+			if (p >= end) return false;
+			uint8_t b1 = bytes[p++];
+
+			if (b1 == 0xFE || b1 == 0xFF) {		// QOI_OP_RGB, QOI_OP_RGBA
+				int n = (b1 == 0xFE) ? 3 : 4;
+				if (p + n > end) return false;
+				std::memcpy(px, bytes + p, n);
+				p += n;
+			}
+			else if ((b1 & 0xC0) == 0x00) {		// QOI_OP_INDEX
+				std::memcpy(px, index[b1], 4);
+			}
+			else if ((b1 & 0xC0) == 0x40) {		// QOI_OP_DIFF
+				px[0] += ((b1 >> 4) & 3) - 2;
+				px[1] += ((b1 >> 2) & 3) - 2;
+				px[2] += (b1 & 3) - 2;
+			}
+			else if ((b1 & 0xC0) == 0x80) {		// QOI_OP_LUMA
+				if (p >= end) return false;
+				uint8_t b2 = bytes[p++];
+				int dg = (b1 & 0x3F) - 32;
+				px[0] += dg - 8 + (b2 >> 4);
+				px[1] += dg;
+				px[2] += dg - 8 + (b2 & 0x0F);
+			}
+			else {									// QOI_OP_RUN
+				run = b1 & 0x3F;
+			}
+
+			int slot = (px[0]*3 + px[1]*5 + px[2]*7 + px[3]*11) % 64;
+			std::memcpy(index[slot], px, 4);
+		}
+
+		std::memcpy(&rgba[4*i], px, 4);
+	}
+
+	return p == end;
+}
+
+
+// ------ Deflate (fixed Huffman codes, greedy LZ77) ------
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MAX_CHAIN 32
+
+// Bits go out least significant first, Huffman codes most significant first
+class BitWriter {
+	public:
+		std::vector<uint8_t> &out;
+		uint64_t bits = 0;
+		int count = 0;
+
+		BitWriter(std::vector<uint8_t> &out) : out(out) {}
+
+		void put(uint32_t value, int n) {
+			bits |= (uint64_t) value << count;
+			count += n;
+			while (count >= 8) {
+				out.push_back( (uint8_t) bits );
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		void putCode(uint32_t code, int n) {
+			uint32_t reversed = 0;
+			for (int i=0; i<n; i++) reversed |= ((code >> i) & 1) << (n - 1 - i);
+			this->put(reversed, n);
+		}
+
+		void align() {
+			if (count > 0) this->put(0, 8 - count);
+		}
+};
+
+// Fixed literal/length code of symbol `v` (0-287)
+static void putLiteral(BitWriter &bw, int v) {
+	if (v < 144)      bw.putCode(0x30 + v, 8);
+	else if (v < 256) bw.putCode(0x190 + v - 144, 9);
+	else if (v < 280) bw.putCode(v - 256, 7);
+	else              bw.putCode(0xC0 + v - 280, 8);
+}
+
+static const int LENGTH_BASE[29]  = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+static const int LENGTH_EXTRA[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+static const int DIST_BASE[30]    = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+static const int DIST_EXTRA[30]   = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+static void putMatch(BitWriter &bw, int length, int dist) {
+	int l = 28;
+	while (LENGTH_BASE[l] > length) l--;
+	putLiteral(bw, 257 + l);
+	bw.put(length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+
+	int d = 29;
+	while (DIST_BASE[d] > dist) d--;
+	bw.putCode(d, 5);
+	bw.put(dist - DIST_BASE[d], DIST_EXTRA[d]);
+}
+
+static inline uint32_t hash3(const uint8_t *p) {
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+// Non final blocks of `data`, ended by a sync flush so the output is byte aligned
+static void deflateStrip(const uint8_t *data, int size, std::vector<uint8_t> &out) {
+	BitWriter bw(out);
+	bw.put(0, 1);	// BFINAL
+	bw.put(1, 2);	// Fixed Huffman codes
+
+	std::vector<int> head(1 << DEFLATE_HASH_BITS, -1);
+	std::vector<int> prev(size);
+
+	auto insert = [&](int p) {
+		uint32_t h = hash3(data + p);
+		prev[p] = head[h];
+		head[h] = p;
+	};
+
+	int i = 0;
+	while (i < size) {
+		int bestLen = 0;
+		int bestDist = 0;
+
+		if (i + 2 < size) {
+			int maxLen = std::min(258, size - i);
+			int cand = head[ hash3(data + i) ];
+
+			for (int chain=0; cand >= 0 && i - cand <= DEFLATE_WINDOW && chain < DEFLATE_MAX_CHAIN; chain++) {
+				int len = 0;
+				while (len < maxLen && data[cand + len] == data[i + len]) len++;
+
+				if (len > bestLen) {
+					bestLen = len;
+					bestDist = i - cand;
+					if (len == maxLen) break;
+				}
+				cand = prev[cand];
+			}
+
+			insert(i);
+		}
+
+		if (bestLen >= 3) {
+			putMatch(bw, bestLen, bestDist);
+			for (int k=1; k<bestLen; k++) {
+				if (i + k + 2 < size) insert(i + k);
+			}
+			i += bestLen;
+		}
+		else {
+			putLiteral(bw, data[i]);
+			i++;
+		}
+	}
+
+	putLiteral(bw, 256);	// End of block
+
+	// Empty stored block, LEN = 0, NLEN = ~0
+	bw.put(0, 3);
+	bw.align();
+	out.insert(out.end(), {0x00, 0x00, 0xFF, 0xFF});
+}
+
+
+// ------ PNG ------
+
+static inline uint8_t paeth(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = std::abs(p - a);
+	int pb = std::abs(p - b);
+	int pc = std::abs(p - c);
+
+	if (pa <= pb && pa <= pc) return (uint8_t) a;
+	if (pb <= pc) return (uint8_t) b;
+	return (uint8_t) c;
+}
+
+// Filters row `y` into `dst` (filter byte + stride bytes), picking the filter
+// with the smallest sum of absolute differences, `tmp` is scratch of stride bytes
+static void filterRow(const uint8_t *rgb, int w, int y, uint8_t *dst, std::vector<uint8_t> &tmp) {
+	int stride = 3*w;
+	const uint8_t *row = rgb + (size_t) y*stride;
+	const uint8_t *up = (y > 0) ? row - stride : nullptr;
+
+	int bestScore = -1;
+	int bestFilter = 0;
+
+	for (int f=0; f<5; f++) {
+		int score = 0;
+
+		for (int i=0; i<stride; i++) {
+			int a = (i >= 3) ? row[i-3] : 0;
+			int b = up ? up[i] : 0;
+			int c = (up && i >= 3) ? up[i-3] : 0;
+
+			uint8_t v = row[i];
+			switch (f) {
+				case 1: v -= a; break;
+				case 2: v -= b; break;
+				case 3: v -= (a + b) >> 1; break;
+				case 4: v -= paeth(a, b, c); break;
+			}
+
+			tmp[i] = v;
+			score += std::abs( (int8_t) v );
+		}
+
+		if (bestScore < 0 || score < bestScore) {
+			bestScore = score;
+			bestFilter = f;
+			std::memcpy(dst + 1, tmp.data(), stride);
+		}
+	}
+
+	dst[0] = (uint8_t) bestFilter;
+}
+
+static void putChunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data, size_t size) {
+	putU32BE(out, (uint32_t) size);
+
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + size);
+
+	putU32BE(out, crc32(out.data() + start, size + 4));
+}
+
+void encodePNG(const uint8_t *rgb, int w, int h, std::vector<uint8_t> &out, ThreadPool *pool) {
+	int rowSize = 1 + 3*w;
+	std::vector<uint8_t> filtered( (size_t) rowSize*h );
+
+	// Strips of about 256 KiB, whole rows
+	int rowsPerStrip = std::max(1, (256 << 10) / rowSize);
+	int stripCount = (h + rowsPerStrip - 1) / rowsPerStrip;
+	std::vector< std::vector<uint8_t> > strips(stripCount);
+
+	auto deflateStrips = [&](int begin, int end) {
+		for (int s=begin; s<end; s++) {
+			int y0 = s*rowsPerStrip;
+			int y1 = std::min(h, y0 + rowsPerStrip);
+
+			std::vector<uint8_t> tmp(3*w);
+			for (int y=y0; y<y1; y++) {
+				filterRow(rgb, w, y, filtered.data() + (size_t) y*rowSize, tmp);
+			}
+
+			strips[s].clear();
+			deflateStrip(filtered.data() + (size_t) y0*rowSize, (y1 - y0)*rowSize, strips[s]);
+		}
+	};
+
+	if (pool) pool->parallelFor(stripCount, 1, deflateStrips);
+	else deflateStrips(0, stripCount);
+
+	// zlib stream: header, the strips, an empty final block and the checksum
+	std::vector<uint8_t> zlib = {0x78, 0x01};
+	for (const std::vector<uint8_t> &strip : strips) {
+		zlib.insert(zlib.end(), strip.begin(), strip.end());
+	}
+
+	{
+		BitWriter bw(zlib);
+		bw.put(1, 1);
+		bw.put(1, 2);
+		putLiteral(bw, 256);
+		bw.align();
+	}
+	putU32BE(zlib, adler32(filtered.data(), filtered.size()));
+
+	uint8_t header[13];
+	uint32_t beW = (uint32_t) w, beH = (uint32_t) h;
+	for (int i=0; i<4; i++) {
+		header[i]     = (uint8_t) (beW >> (24 - 8*i));
+		header[4 + i] = (uint8_t) (beH >> (24 - 8*i));
+	}
+	header[8]  = 8;		// Bit depth
+	header[9]  = 2;		// RGB
+	header[10] = 0;		// Deflate
+	header[11] = 0;		// Adaptive filtering
+	header[12] = 0;		// No interlace
+
+	static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+	out.clear();
+	out.reserve(zlib.size() + 64);
+	out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+	putChunk(out, "IHDR", header, 13);
+	putChunk(out, "IDAT", zlib.data(), zlib.size());
+	putChunk(out, "IEND", nullptr, 0);
+}
+
+
+// ------ PPM ------
+
+void encodePPM(const uint8_t *rgb, int w, int h, std::vector<uint8_t> &out) {
+	char header[32];
+	int n = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", w, h);
+
+	out.assign(header, header + n);
+	out.insert(out.end(), rgb, rgb + (size_t) 3*w*h);
+}
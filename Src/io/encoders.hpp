@@ -0,0 +1,26 @@
+// Image file encoders, from 8 bit RGB pixels to the bytes of the file
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../core/threadpool.hpp"
+
+
+// QOI, lossless and a single fast pass (https://qoiformat.org)
+void encodeQOI(const uint8_t *rgb, int w, int h, std::vector<uint8_t> &out);
+
+// QOI to 8 bit RGBA following the specification, false if the file is not valid
+bool decodeQOI(const uint8_t *bytes, size_t size, int &w, int &h, std::vector<uint8_t> &rgba);
+
+/*
+PNG, the rows are filtered and deflated in strips on `pool` (nullptr runs serially).
+Each strip is an independent run of fixed Huffman blocks closed by an empty stored
+block (a sync flush), so the strips concatenate into one zlib stream.
+Matches do not reach across strips, the file is a little larger than a serial one.
+*/
+void encodePNG(const uint8_t *rgb, int w, int h, std::vector<uint8_t> &out, ThreadPool *pool);
+
+// Binary PPM (P6)
+void encodePPM(const uint8_t *rgb, int w, int h, std::vector<uint8_t> &out);
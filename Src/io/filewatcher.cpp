@@ -0,0 +1,116 @@
+#include <algorithm>
+
+#ifdef __linux__
+	#include <unistd.h>
+	#include <sys/inotify.h>
+#endif
+
+#include "filewatcher.hpp"
+
+
+// Constructors and Destructors
+FileWatcher::FileWatcher() {
+	_fd = -1;
+	tPtPoll = TIME_NOW();
+}
+
+FileWatcher::~FileWatcher() {
+	this->close();
+}
+
+
+// Methods
+void FileWatcher::watch(const std::vector<std::string> &paths) {
+	this->close();
+
+	for (const std::string &path : paths) {
+		std::error_code error;
+		std::filesystem::path absolute = std::filesystem::absolute(path, error).lexically_normal();
+		_files.push_back({ path, error ? path : absolute.string(), modified(path) });
+	}
+
+#ifdef __linux__
+	_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	for (const Entry &file : _files) {
+		std::string dir = std::filesystem::path(file.absolute).parent_path().string();
+		if ( std::find(_dirs.begin(), _dirs.end(), dir) != _dirs.end() ) continue;
+
+		int wd = (_fd >= 0) ? inotify_add_watch(_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) : -1;
+		if (wd < 0) {
+			// Polling then, for every file
+			std::vector<Entry> files = _files;
+			this->close();
+			_files = files;
+			return;
+		}
+
+		_watches.push_back(wd);
+		_dirs.push_back(dir);
+	}
+#endif
+}
+
+void FileWatcher::close() {
+#ifdef __linux__
+	if (_fd >= 0) ::close(_fd);
+#endif
+
+	_fd = -1;
+	_files.clear();
+	_watches.clear();
+	_dirs.clear();
+}
+
+bool FileWatcher::poll(std::vector<std::string> &changed) {
+	changed.clear();
+
+#ifdef __linux__
+	if (_fd >= 0) {
+		alignas(inotify_event) char buffer[4096];
+		ssize_t size;
+
+		while ( (size = read(_fd, buffer, sizeof(buffer))) > 0 ) {
+			for (char *p = buffer; p < buffer + size; ) {
+				const inotify_event *event = (const inotify_event *) p;
+				p += sizeof(inotify_event) + event->len;
+
+				size_t k = std::find(_watches.begin(), _watches.end(), event->wd) - _watches.begin();
+				if (k == _watches.size() || event->len == 0) continue;
+
+				std::string path = (std::filesystem::path(_dirs[k]) / event->name).string();
+
+				for (const Entry &file : _files) {
+					if (file.absolute == path && std::find(changed.begin(), changed.end(), file.path) == changed.end()) {
+						changed.push_back(file.path);
+					}
+				}
+			}
+		}
+
+		return !changed.empty();
+	}
+#endif
+
+	TIME_PT tPtNow = TIME_NOW();
+	if (TIME_DUR(tPtNow, tPtPoll) < WATCH_POLL_MS*1000) return false;
+	tPtPoll = tPtNow;
+
+	for (Entry &file : _files) {
+		std::filesystem::file_time_type mtime = modified(file.path);
+
+		if (mtime != file.mtime) {
+			file.mtime = mtime;
+			changed.push_back(file.path);
+		}
+	}
+
+	return !changed.empty();
+}
+
+// The minimum time when the file is missing, written again it counts as a change
+std::filesystem::file_time_type FileWatcher::modified(const std::string &path) {
+	std::error_code error;
+	std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : mtime;
+}
@@ -0,0 +1,51 @@
+// Change notifications of a few files, for the hot reload of scenes
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include "../utils/utils.hpp"
+
+#define WATCH_POLL_MS 250	// Modification time checks without inotify
+
+
+/*
+On Linux the directories of the files are watched with inotify, editors often write a
+new file and rename it over the old one, so a file is matched by name in its directory.
+Elsewhere the modification times are compared every WATCH_POLL_MS
+*/
+class FileWatcher {
+	// Constructors / Destructors
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+	private:
+		struct Entry {
+			std::string path;		// As given to watch()
+			std::string absolute;	// Matched against the inotify events
+			std::filesystem::file_time_type mtime;
+		};
+
+	// Attributes
+	private:
+		std::vector<Entry> _files;
+		int _fd;					// inotify, -1 when polling
+		std::vector<int> _watches;
+		std::vector<std::string> _dirs;	// Of every watch
+		TIME_PT tPtPoll;				// Last check of the modification times
+
+	// Methods
+	public:
+		// Replaces the watched files
+		void watch(const std::vector<std::string> &paths);
+		void close();
+
+		// Files changed since the last call (paths as given to watch()), without blocking, true when there are any
+		bool poll(std::vector<std::string> &changed);
+
+	private:
+		static std::filesystem::file_time_type modified(const std::string &path);
+};
@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+#include "imagewriter.hpp"
+#include "encoders.hpp"
+#include "../utils/utils.hpp"
+
+
+// Constructors and Destructors
+ImageWriter::ImageWriter() {
+	written = 0;
+	dropped = 0;
+	tEncodeSum = 0;
+
+	_snapshots = nullptr;
+	_snapshotCount = 0;
+	_pool = nullptr;
+}
+
+ImageWriter::~ImageWriter() {
+	this->stop();
+}
+
+
+// Methods
+void ImageWriter::start(int queueSize, ThreadPool *pool) {
+	this->stop();
+
+	_pool = pool;
+	_snapshotCount = std::max(1, queueSize);
+	_snapshots = new Snapshot[_snapshotCount];
+
+	for (int i=0; i<_snapshotCount; i++) {
+		_free.push(&_snapshots[i]);
+	}
+
+	_thread = std::thread(&ImageWriter::writer, this);
+}
+
+void ImageWriter::stop() {
+	if ( !_thread.joinable() ) return;
+
+	// Queued behind every pending image
+	_pending.push(nullptr);
+	_thread.join();
+
+	// Every snapshot is back, the queue is empty for the next start()
+	Snapshot *snapshot = nullptr;
+	for (int i=0; i<_snapshotCount; i++) {
+		_free.pop(snapshot);
+	}
+
+	delete[] _snapshots;
+	_snapshots = nullptr;
+	_snapshotCount = 0;
+}
+
+bool ImageWriter::submit(Surface &surface, const std::string &path, ImageFormat format, bool wait) {
+	if ( !_thread.joinable() ) return false;
+
+	Snapshot *snapshot = nullptr;
+	bool ok = wait ? _free.pop(snapshot) : _free.popFor(snapshot, milliseconds(0));
+
+	if ( !ok ) {
+		dropped++;
+		return false;
+	}
+
+	snapshot->w = surface.surfWidth;
+	snapshot->h = surface.surfHeight;
+	snapshot->path = path;
+	snapshot->format = format;
+	snapshot->rgb.resize( (size_t) 3*surface.surfSize );
+	surface.toRGB8(snapshot->rgb.data());
+
+	_pending.push(snapshot);
+	return true;
+}
+
+bool ImageWriter::parseFormat(const std::string &name, ImageFormat &format) {
+	if (name == "png") format = ImageFormat::PNG;
+	else if (name == "qoi") format = ImageFormat::QOI;
+	else if (name == "ppm") format = ImageFormat::PPM;
+	else return false;
+
+	return true;
+}
+
+const char *ImageWriter::extension(ImageFormat format) {
+	switch (format) {
+		case ImageFormat::QOI: return "qoi";
+		case ImageFormat::PPM: return "ppm";
+		default:               return "png";
+	}
+}
+
+void ImageWriter::writer() {
+	Snapshot *snapshot = nullptr;
+	std::vector<uint8_t> bytes;	// Encoded file, reused
+
+	while ( _pending.pop(snapshot) && snapshot ) {
+		TIME_PT tPtEncode1 = TIME_NOW();
+
+		if ( this->write(*snapshot, bytes) ) {
+			written++;
+			tEncodeSum += TIME_DUR(TIME_NOW(), tPtEncode1);
+		}
+		else {
+			std::cerr << "Failed to write " << snapshot->path << std::endl;
+		}
+
+		_free.push(snapshot);
+	}
+}
+
+void ImageWriter::encode(const uint8_t *rgb, int w, int h, ImageFormat format, std::vector<uint8_t> &bytes, ThreadPool *pool) {
+	switch (format) {
+		case ImageFormat::PNG: encodePNG(rgb, w, h, bytes, pool); break;
+		case ImageFormat::QOI: encodeQOI(rgb, w, h, bytes); break;
+		case ImageFormat::PPM: encodePPM(rgb, w, h, bytes); break;
+	}
+}
+
+bool ImageWriter::write(const Snapshot &snapshot, std::vector<uint8_t> &bytes) {
+	ImageWriter::encode(snapshot.rgb.data(), snapshot.w, snapshot.h, snapshot.format, bytes, _pool);
+
+	FILE *file = fopen(snapshot.path.c_str(), "wb");
+	if (file == NULL) {
+		return false;
+	}
+
+	size_t count = fwrite(bytes.data(), 1, bytes.size(), file);
+	fclose(file);
+
+	return count == bytes.size();
+}
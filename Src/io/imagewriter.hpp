@@ -0,0 +1,78 @@
+// Writes images to disk on a background thread, the render loop only copies the pixels
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "../render/surface.hpp"
+#include "../utils/queue.hpp"
+#include "../core/threadpool.hpp"
+
+
+enum class ImageFormat {
+	PNG,	// Deflated in parallel strips
+	QOI,	// Lossless, several times faster than PNG
+	PPM,	// Uncompressed
+};
+
+
+class ImageWriter {
+	// Constructors / Destructors
+	public:
+		ImageWriter();
+		~ImageWriter();
+
+	private:
+		// 8 bit RGB copy of a surface, waiting to be encoded
+		struct Snapshot {
+			std::vector<uint8_t> rgb;
+			int w;
+			int h;
+			std::string path;
+			ImageFormat format;
+		};
+
+	// Attributes
+	public:
+		std::atomic<int> written;			// Images on disk
+		std::atomic<int> dropped;			// Submitted while every snapshot was taken
+		std::atomic<uint64_t> tEncodeSum;	// in us, encoding and writing of the written images
+
+	private:
+		Snapshot *_snapshots;
+		int _snapshotCount;
+
+		BlockingQueue<Snapshot*> _free;		// Bounds the images in flight
+		BlockingQueue<Snapshot*> _pending;	// nullptr stops the writer
+
+		std::thread _thread;
+		ThreadPool *_pool;					// Parallel PNG deflate, may be nullptr
+
+	// Methods
+	public:
+		// Up to `queueSize` images wait for the writer at a time
+		void start(int queueSize, ThreadPool *pool);
+
+		// Writes every pending image, then joins the writer thread
+		void stop();
+
+		/*
+		Copies `surface` and queues it for `path`. Without a free snapshot the image
+		is dropped and false is returned, unless `wait` is set (blocks until one frees up)
+		*/
+		bool submit(Surface &surface, const std::string &path, ImageFormat format, bool wait = false);
+
+		static bool parseFormat(const std::string &name, ImageFormat &format);
+		static const char *extension(ImageFormat format);
+
+		// Encodes 8 bit RGB pixels into the bytes of the file, PNG strips go to `pool` (may be nullptr)
+		static void encode(const uint8_t *rgb, int w, int h, ImageFormat format, std::vector<uint8_t> &bytes, ThreadPool *pool);
+
+	private:
+		void writer();
+		bool write(const Snapshot &snapshot, std::vector<uint8_t> &bytes);
+};
@@ -0,0 +1,199 @@
+#include <format>
+#include <fstream>
+#include <iostream>
+
+#ifdef __linux__
+	#include <unistd.h>
+#endif
+
+#include "metrics.hpp"
+
+
+// ------ Histogram ------
+
+Histogram::Histogram() {
+	for (auto &bucket : _buckets) bucket = 0;
+	_sumUs = 0;
+}
+
+void Histogram::observe(uint64_t us) {
+	float ms = us/1E3F;
+
+	int i = 0;
+	while (i < METRICS_BUCKETS-1 && ms > bounds[i]) i++;
+
+	_buckets[i].fetch_add(1, std::memory_order_relaxed);
+	_sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+void Histogram::write(std::string &out, const char *name, const std::string &labels) const {
+	std::string sep = labels.empty() ? "" : ",";
+	uint64_t cumulative = 0;
+
+	// The count is the +Inf bucket of the same loads, a counter of its own could be ahead or behind it
+	for (int i=0; i<METRICS_BUCKETS; i++) {
+		cumulative += _buckets[i].load(std::memory_order_relaxed);
+		std::string le = (i < METRICS_BUCKETS-1) ? std::format("{}", bounds[i]/1E3F) : "+Inf";
+
+		out += std::string(name) + "_bucket{" + labels + sep + "le=\"" + le + "\"} " + std::to_string(cumulative) + "\n";
+	}
+
+	std::string braces = labels.empty() ? "" : "{" + labels + "}";
+	out += std::format("{}_sum{} {}\n", name, braces, _sumUs.load(std::memory_order_relaxed)/1E6);
+	out += std::format("{}_count{} {}\n", name, braces, cumulative);
+}
+
+
+// ------ Metrics ------
+
+// Constructors and Destructors
+Metrics::Metrics() {
+	_frames = 0;
+	_triangles = 0;
+	_pixelsWritten = 0;
+	_inFlight = 0;
+	_scale = 1.f;
+	_running = false;
+}
+
+Metrics::~Metrics() {
+	this->stop();
+}
+
+
+// Methods
+bool Metrics::start(const std::string &address, std::function<void(std::string&)> provider) {
+	this->stop();
+
+	if ( !_listener.listen(address) ) return false;
+
+	_provider = std::move(provider);
+	_running = true;
+	_thread = std::thread(&Metrics::server, this);
+
+	std::cout << "Metrics on " << address;
+	if (_listener.port() > 0) std::cout << " (port " << _listener.port() << ")";
+	std::cout << ", GET /metrics\n";
+	return true;
+}
+
+void Metrics::stop() {
+	if ( !_thread.joinable() ) return;
+
+	// The server checks every accept timeout
+	_running = false;
+	_thread.join();
+	_listener.close();
+}
+
+void Metrics::observe(const FrameSample &sample) {
+	_frame.observe(sample.tFrame);
+	_geometry.observe(sample.tGeometry);
+	_shadow.observe(sample.tShadow);
+	_raster.observe(sample.tRaster);
+	_present.observe(sample.tPresent);
+	_latency.observe(sample.tLatency);
+
+	_frames.fetch_add(1, std::memory_order_relaxed);
+	_triangles.fetch_add(sample.triangles, std::memory_order_relaxed);
+	_pixelsWritten.fetch_add(sample.pixelsWritten, std::memory_order_relaxed);
+	_inFlight.store(sample.inFlight, std::memory_order_relaxed);
+	_scale.store(sample.scale, std::memory_order_relaxed);
+}
+
+std::string Metrics::scrape() const {
+	std::string out;
+	out.reserve(4096);
+
+	header(out, "qazwsx_frame_seconds", "Time between two presented frames", "histogram");
+	_frame.write(out, "qazwsx_frame_seconds", "");
+
+	header(out, "qazwsx_stage_seconds", "Time of a frame in each pipeline stage", "histogram");
+	_geometry.write(out, "qazwsx_stage_seconds", "stage=\"geometry\"");
+	_shadow.write(out, "qazwsx_stage_seconds", "stage=\"shadow\"");
+	_raster.write(out, "qazwsx_stage_seconds", "stage=\"raster\"");
+	_present.write(out, "qazwsx_stage_seconds", "stage=\"present\"");
+
+	header(out, "qazwsx_latency_seconds", "Time from the geometry stage picking a frame up to its present", "histogram");
+	_latency.write(out, "qazwsx_latency_seconds", "");
+
+	header(out, "qazwsx_frames_total", "Presented frames", "counter");
+	sample(out, "qazwsx_frames_total", "", (double) _frames.load(std::memory_order_relaxed));
+
+	header(out, "qazwsx_triangles_total", "Triangles submitted to the raster stage", "counter");
+	sample(out, "qazwsx_triangles_total", "", (double) _triangles.load(std::memory_order_relaxed));
+
+	header(out, "qazwsx_pixels_written_total", "Pixels passing the depth test", "counter");
+	sample(out, "qazwsx_pixels_written_total", "", (double) _pixelsWritten.load(std::memory_order_relaxed));
+
+	header(out, "qazwsx_frames_in_flight", "Frames circulating in the pipeline", "gauge");
+	sample(out, "qazwsx_frames_in_flight", "", _inFlight.load(std::memory_order_relaxed));
+
+	header(out, "qazwsx_render_scale", "Fraction of the resolution frames render at", "gauge");
+	sample(out, "qazwsx_render_scale", "", _scale.load(std::memory_order_relaxed));
+
+	#ifdef __linux__
+		// Second field of statm, in pages
+		std::ifstream statm("/proc/self/statm");
+		uint64_t size = 0, resident = 0;
+		if (statm >> size >> resident) {
+			header(out, "qazwsx_resident_bytes", "Resident memory of the process", "gauge");
+			sample(out, "qazwsx_resident_bytes", "", (double) resident*sysconf(_SC_PAGESIZE));
+		}
+	#endif
+
+	if (_provider) _provider(out);
+
+	return out;
+}
+
+void Metrics::header(std::string &out, const char *name, const char *help, const char *type) {
+	out += std::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+void Metrics::sample(std::string &out, const char *name, const std::string &labels, double value) {
+	if (labels.empty()) out += std::format("{} {}\n", name, value);
+	else out += std::string(name) + "{" + labels + "} " + std::format("{}\n", value);
+}
+
+void Metrics::server() {
+	while (_running) {
+		Socket client;
+		if ( !_listener.accept(client, 200) ) continue;
+
+		this->answer(client);
+	}
+}
+
+// HTTP/1.0, one request per connection
+void Metrics::answer(Socket &client) {
+	std::string request;
+	char buffer[1024];
+
+	// Up to the end of the headers, a scraper that stalls is dropped
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+		if ( !client.waitReadable(1000) ) return;
+
+		int64_t got = client.recvSome(buffer, sizeof(buffer));
+		if (got <= 0) break;
+		request.append(buffer, (size_t) got);
+	}
+
+	std::string status, body;
+	if (request.rfind("GET /metrics", 0) == 0) {
+		status = "200 OK";
+		body = this->scrape();
+	}
+	else {
+		status = "404 Not Found";
+		body = "Only GET /metrics is served\n";
+	}
+
+	std::string response = std::format(
+		"HTTP/1.0 {}\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+		status, body.size()
+	);
+
+	client.sendAll(response);
+	client.sendAll(body);
+}
@@ -0,0 +1,105 @@
+// Prometheus metrics of a running render, scraped over a local socket
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "socket.hpp"
+
+
+#define METRICS_BUCKETS 11	// Histogram buckets, the last one is +Inf
+
+
+// Cumulative histogram of durations, observed without locks from the render loop
+class Histogram {
+	// Constructors / Destructors
+	public:
+		Histogram();
+
+	// Attributes
+	public:
+		static constexpr float bounds[METRICS_BUCKETS-1] = {0.5f, 1.f, 2.f, 4.f, 8.f, 16.f, 33.f, 50.f, 100.f, 250.f};	// in ms
+
+	private:
+		std::atomic<uint64_t> _buckets[METRICS_BUCKETS];	// Not cumulative, summed when written, the count is their sum
+		std::atomic<uint64_t> _sumUs;
+
+	// Methods
+	public:
+		void observe(uint64_t us);
+
+		// Bucket, sum and count lines of the series `name` (in seconds), `labels` is empty or `key="value"`
+		void write(std::string &out, const char *name, const std::string &labels) const;
+};
+
+
+// Per frame timings handed to the exporter, in us
+struct FrameSample {
+	uint64_t tFrame;		// Between two presented frames
+	uint64_t tGeometry;
+	uint64_t tShadow;
+	uint64_t tRaster;
+	uint64_t tPresent;
+	uint64_t tLatency;		// Submit to present
+
+	uint64_t triangles;		// Submitted to the raster stage
+	uint64_t pixelsWritten;
+	int inFlight;
+	float scale;
+};
+
+/*
+Aggregates of the presented frames, updated with relaxed atomics so the render loop never
+waits on a scrape. A server thread answers `GET /metrics` in the Prometheus text format,
+a scrape reads the counters and calls the provider for the gauges the engine owns
+*/
+class Metrics {
+	// Constructors / Destructors
+	public:
+		Metrics();
+		~Metrics();
+
+	// Attributes
+	private:
+		Histogram _frame;
+		Histogram _geometry;
+		Histogram _shadow;
+		Histogram _raster;
+		Histogram _present;
+		Histogram _latency;
+
+		std::atomic<uint64_t> _frames;
+		std::atomic<uint64_t> _triangles;
+		std::atomic<uint64_t> _pixelsWritten;
+		std::atomic<int> _inFlight;
+		std::atomic<float> _scale;
+
+		Socket _listener;
+		std::thread _thread;
+		std::atomic<bool> _running;
+		std::function<void(std::string&)> _provider;	// Appends extra metrics, called on the server thread
+
+	// Methods
+	public:
+		// Serves on `address` ("host:port" or "unix:<path>"), false if it cannot listen
+		bool start(const std::string &address, std::function<void(std::string&)> provider);
+		void stop();
+		bool isRunning() const { return _running; }
+
+		void observe(const FrameSample &sample);
+
+		// The whole exposition, as served
+		std::string scrape() const;
+
+		// HELP and TYPE lines of a metric, followed by its samples
+		static void header(std::string &out, const char *name, const char *help, const char *type);
+		static void sample(std::string &out, const char *name, const std::string &labels, double value);
+
+	private:
+		void server();
+		void answer(Socket &client);
+};
@@ -0,0 +1,301 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+
+	#define CLOSE_SOCKET closesocket
+	#define POLL WSAPoll
+	using socklen_t = int;
+#else
+	#include <csignal>
+	#include <unistd.h>
+	#include <poll.h>
+	#include <netdb.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+
+	#define CLOSE_SOCKET ::close
+	#define POLL ::poll
+#endif
+
+#include "socket.hpp"
+
+
+#ifdef MSG_NOSIGNAL
+	#define SEND_FLAGS MSG_NOSIGNAL
+#else
+	#define SEND_FLAGS 0
+#endif
+
+
+// ------ Address Helpers ------
+
+// Splits "host:port", an empty host is the loopback
+static bool splitAddress(const std::string &address, std::string &host, std::string &port) {
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos) return false;
+
+	host = address.substr(0, colon);
+	port = address.substr(colon + 1);
+	if (host.empty()) host = "127.0.0.1";
+
+	return !port.empty();
+}
+
+static bool isUnix(const std::string &address) {
+	return address.rfind("unix:", 0) == 0;
+}
+
+
+// Constructors and Destructors
+Socket::Socket() {
+	_fd = -1;
+}
+
+Socket::~Socket() {
+	this->close();
+}
+
+Socket::Socket(Socket &&other) {
+	_fd = other._fd;
+	_unixPath = std::move(other._unixPath);
+	other._fd = -1;
+	other._unixPath.clear();
+}
+
+Socket &Socket::operator=(Socket &&other) {
+	if (this != &other) {
+		this->close();
+		_fd = other._fd;
+		_unixPath = std::move(other._unixPath);
+		other._fd = -1;
+		other._unixPath.clear();
+	}
+	return *this;
+}
+
+
+// Methods
+bool Socket::startup() {
+	static const bool ready = [] {
+		#ifdef _WIN32
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		#else
+			// A peer going away fails the send instead of killing the process
+			signal(SIGPIPE, SIG_IGN);
+			return true;
+		#endif
+	}();
+
+	return ready;
+}
+
+bool Socket::listen(const std::string &address, int backlog) {
+	this->close();
+	if ( !Socket::startup() ) return false;
+
+	if (isUnix(address)) {
+		#ifdef _WIN32
+			std::cerr << "Unix domain sockets are not supported on Windows: " << address << std::endl;
+			return false;
+		#else
+			std::string path = address.substr(5);
+			sockaddr_un addr = {};
+			addr.sun_family = AF_UNIX;
+
+			if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+				std::cerr << "Invalid Unix socket path: " << path << std::endl;
+				return false;
+			}
+			std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+			_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (_fd == -1) return false;
+
+			::unlink(path.c_str());
+			if (::bind(_fd, (sockaddr *) &addr, sizeof(addr)) != 0 || ::listen(_fd, backlog) != 0) {
+				std::cerr << "Failed to listen on " << address << ": " << strerror(errno) << std::endl;
+				this->close();
+				return false;
+			}
+
+			_unixPath = path;
+			return true;
+		#endif
+	}
+
+	std::string host, port;
+	if ( !splitAddress(address, host, port) ) {
+		std::cerr << "Invalid address " << address << ", expected host:port or unix:<path>" << std::endl;
+		return false;
+	}
+
+	addrinfo hints = {}, *info = nullptr;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0 || info == nullptr) {
+		std::cerr << "Failed to resolve " << address << std::endl;
+		return false;
+	}
+
+	_fd = (intptr_t) ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+
+	int yes = 1;
+	setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, (const char *) &yes, sizeof(yes));
+
+	bool ok = _fd != -1
+		&& ::bind(_fd, info->ai_addr, (socklen_t) info->ai_addrlen) == 0
+		&& ::listen(_fd, backlog) == 0;
+	freeaddrinfo(info);
+
+	if ( !ok ) {
+		std::cerr << "Failed to listen on " << address << std::endl;
+		this->close();
+	}
+
+	return ok;
+}
+
+bool Socket::connect(const std::string &address) {
+	this->close();
+	if ( !Socket::startup() ) return false;
+
+	if (isUnix(address)) {
+		#ifdef _WIN32
+			std::cerr << "Unix domain sockets are not supported on Windows: " << address << std::endl;
+			return false;
+		#else
+			std::string path = address.substr(5);
+			sockaddr_un addr = {};
+			addr.sun_family = AF_UNIX;
+
+			if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+			std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+			_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (_fd == -1 || ::connect(_fd, (sockaddr *) &addr, sizeof(addr)) != 0) {
+				this->close();
+				return false;
+			}
+			return true;
+		#endif
+	}
+
+	std::string host, port;
+	if ( !splitAddress(address, host, port) ) return false;
+
+	addrinfo hints = {}, *info = nullptr;
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0 || info == nullptr) {
+		return false;
+	}
+
+	for (addrinfo *it = info; it != nullptr; it = it->ai_next) {
+		_fd = (intptr_t) ::socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+		if (_fd == -1) continue;
+
+		if (::connect(_fd, it->ai_addr, (socklen_t) it->ai_addrlen) == 0) break;
+		this->close();
+	}
+	freeaddrinfo(info);
+
+	// Small messages go out right away
+	if (_fd != -1) {
+		int yes = 1;
+		setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, (const char *) &yes, sizeof(yes));
+	}
+
+	return _fd != -1;
+}
+
+bool Socket::accept(Socket &client, int timeoutMs) {
+	if ( !this->waitReadable(timeoutMs) ) return false;
+
+	intptr_t fd = (intptr_t) ::accept(_fd, nullptr, nullptr);
+	if (fd == -1) return false;
+
+	client.close();
+	client._fd = fd;
+
+	if (_unixPath.empty()) {
+		int yes = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *) &yes, sizeof(yes));
+	}
+
+	return true;
+}
+
+bool Socket::waitReadable(int timeoutMs) {
+	if (_fd == -1) return false;
+
+	pollfd pfd = {};
+	pfd.fd = _fd;
+	pfd.events = POLLIN;
+
+	return POLL(&pfd, 1, timeoutMs) > 0;
+}
+
+bool Socket::sendAll(const void *data, size_t size) {
+	const char *p = (const char *) data;
+
+	while (size > 0) {
+		int chunk = (int) std::min(size, (size_t) 1 << 30);
+		int sent = (int) ::send(_fd, p, chunk, SEND_FLAGS);
+		if (sent <= 0) return false;
+
+		p += sent;
+		size -= sent;
+	}
+
+	return true;
+}
+
+bool Socket::recvAll(void *data, size_t size) {
+	char *p = (char *) data;
+
+	while (size > 0) {
+		int64_t got = this->recvSome(p, size);
+		if (got <= 0) return false;
+
+		p += got;
+		size -= got;
+	}
+
+	return true;
+}
+
+int64_t Socket::recvSome(void *data, size_t size) {
+	int chunk = (int) std::min(size, (size_t) 1 << 30);
+	return (int64_t) ::recv(_fd, (char *) data, chunk, 0);
+}
+
+void Socket::close() {
+	if (_fd == -1) return;
+
+	CLOSE_SOCKET(_fd);
+	_fd = -1;
+
+	#ifndef _WIN32
+		if ( !_unixPath.empty() ) ::unlink(_unixPath.c_str());
+	#endif
+	_unixPath.clear();
+}
+
+int Socket::port() const {
+	sockaddr_in addr = {};
+	socklen_t size = sizeof(addr);
+
+	if (_fd == -1 || getsockname(_fd, (sockaddr *) &addr, &size) != 0 || addr.sin_family != AF_INET) return 0;
+	return ntohs(addr.sin_port);
+}
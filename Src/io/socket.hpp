@@ -0,0 +1,60 @@
+// Blocking stream sockets, TCP and Unix domain, for the local services of the engine
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+
+class Socket {
+	// Constructors / Destructors
+	public:
+		Socket();
+		~Socket();
+
+		Socket(Socket &&other);
+		Socket &operator=(Socket &&other);
+		Socket(const Socket &) = delete;
+		Socket &operator=(const Socket &) = delete;
+
+	// Attributes
+	private:
+		intptr_t _fd;			// -1 when closed (a SOCKET on Windows)
+		std::string _unixPath;	// Removed when a listening Unix socket closes
+
+	// Methods
+	public:
+		/*
+		`address` is "host:port" for TCP (port 0 picks a free one) or "unix:<path>"
+		for a Unix domain socket (not on Windows). A listening Unix socket replaces
+		a stale file at `path`
+		*/
+		bool listen(const std::string &address, int backlog = 16);
+		bool connect(const std::string &address);
+
+		// Waits up to `timeoutMs` for a connection, false on timeout or error
+		bool accept(Socket &client, int timeoutMs);
+
+		// Waits up to `timeoutMs` for data (or the peer closing), -1 waits forever
+		bool waitReadable(int timeoutMs);
+
+		bool sendAll(const void *data, size_t size);
+		bool sendAll(const std::string &data) { return this->sendAll(data.data(), data.size()); }
+
+		// Exactly `size` bytes, false when the peer closes first
+		bool recvAll(void *data, size_t size);
+
+		// Up to `size` bytes, 0 once the peer closed, -1 on error
+		int64_t recvSome(void *data, size_t size);
+
+		void close();
+		bool isOpen() const { return _fd != -1; }
+
+		// Local TCP port, after listen()
+		int port() const;
+
+	private:
+		// Once per process, WSAStartup on Windows
+		static bool startup();
+};
@@ -0,0 +1,316 @@
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+	#include <io.h>
+	#include <fcntl.h>
+#else
+	#include <csignal>
+#endif
+
+#include "videostream.hpp"
+#include "../utils/utils.hpp"
+
+
+#define YUV_BLOCK 16	// Pixels of a block of the conversion kernels
+
+
+// ------ Conversion Kernels ------
+
+// Clamps to [0, 255] on the bit patterns, positive floats order like integers.
+// Integer min/max vectorize without -ffast-math, the float ones do not
+static inline uint8_t toU8(float v) {
+	int32_t bits = std::bit_cast<int32_t>(v);
+	bits = std::min(std::max(bits, 0), std::bit_cast<int32_t>(255.f));
+	return (uint8_t) (int32_t) (std::bit_cast<float>(bits) + 0.5f);
+}
+
+// BT.601 full range, on display values in [0, 1]
+static inline uint8_t lumaU8(float r, float g, float b) {
+	return toU8( 255.f*(0.299f*r + 0.587f*g + 0.114f*b) );
+}
+
+static inline uint8_t cbU8(float r, float g, float b) {
+	return toU8( 128.f + 255.f*(-0.168736f*r - 0.331264f*g + 0.5f*b) );
+}
+
+static inline uint8_t crU8(float r, float g, float b) {
+	return toU8( 128.f + 255.f*(0.5f*r - 0.418688f*g - 0.081312f*b) );
+}
+
+void rgbToYUV420(const Color *rgb, int w, int h, int y0, int y1, uint8_t *yPlane, uint8_t *uPlane, uint8_t *vPlane) {
+	int cw = (w + 1)/2;
+
+	for (int y=y0; y<y1; y+=2) {
+		// The last row pairs with itself on odd heights
+		bool hasRow1 = (y + 1 < h);
+		const float *row0 = &rgb[y*w].r;
+		const float *row1 = hasRow1 ? row0 + 3*w : row0;
+
+		uint8_t *yRow0 = yPlane + y*w;
+		uint8_t *yRow1 = yRow0 + w;
+		uint8_t *uRow = uPlane + (y/2)*cw;
+		uint8_t *vRow = vPlane + (y/2)*cw;
+
+		int x = 0;
+		for (; x + YUV_BLOCK <= w; x += YUV_BLOCK) {
+			// Interleaved RGB to planar, two rows
+			float r0[YUV_BLOCK], g0[YUV_BLOCK], b0[YUV_BLOCK];
+			float r1[YUV_BLOCK], g1[YUV_BLOCK], b1[YUV_BLOCK];
+
+			for (int i=0; i<YUV_BLOCK; i++) {
+				r0[i] = row0[3*(x+i)];
+				g0[i] = row0[3*(x+i) + 1];
+				b0[i] = row0[3*(x+i) + 2];
+				r1[i] = row1[3*(x+i)];
+				g1[i] = row1[3*(x+i) + 1];
+				b1[i] = row1[3*(x+i) + 2];
+			}
+
+			uint8_t luma0[YUV_BLOCK], luma1[YUV_BLOCK];
+			for (int i=0; i<YUV_BLOCK; i++) {
+				luma0[i] = lumaU8(r0[i], g0[i], b0[i]);
+				luma1[i] = lumaU8(r1[i], g1[i], b1[i]);
+			}
+
+			std::memcpy(yRow0 + x, luma0, YUV_BLOCK);
+			if (hasRow1) std::memcpy(yRow1 + x, luma1, YUV_BLOCK);
+
+			// Chroma of the average of every 2x2 quad
+			float rs[YUV_BLOCK/2], gs[YUV_BLOCK/2], bs[YUV_BLOCK/2];
+			for (int i=0; i<YUV_BLOCK/2; i++) {
+				rs[i] = 0.25f*(r0[2*i] + r0[2*i + 1] + r1[2*i] + r1[2*i + 1]);
+				gs[i] = 0.25f*(g0[2*i] + g0[2*i + 1] + g1[2*i] + g1[2*i + 1]);
+				bs[i] = 0.25f*(b0[2*i] + b0[2*i + 1] + b1[2*i] + b1[2*i + 1]);
+			}
+
+			for (int i=0; i<YUV_BLOCK/2; i++) {
+				uRow[x/2 + i] = cbU8(rs[i], gs[i], bs[i]);
+				vRow[x/2 + i] = crU8(rs[i], gs[i], bs[i]);
+			}
+		}
+
+		// Remaining columns, the last one pairs with itself on odd widths
+		for (; x < w; x += 2) {
+			int xr = std::min(x + 1, w - 1);
+			const float *p00 = row0 + 3*x, *p01 = row0 + 3*xr;
+			const float *p10 = row1 + 3*x, *p11 = row1 + 3*xr;
+
+			yRow0[x] = lumaU8(p00[0], p00[1], p00[2]);
+			if (xr != x) yRow0[xr] = lumaU8(p01[0], p01[1], p01[2]);
+			if (hasRow1) {
+				yRow1[x] = lumaU8(p10[0], p10[1], p10[2]);
+				if (xr != x) yRow1[xr] = lumaU8(p11[0], p11[1], p11[2]);
+			}
+
+			float r = 0.25f*(p00[0] + p01[0] + p10[0] + p11[0]);
+			float g = 0.25f*(p00[1] + p01[1] + p10[1] + p11[1]);
+			float b = 0.25f*(p00[2] + p01[2] + p10[2] + p11[2]);
+			uRow[x/2] = cbU8(r, g, b);
+			vRow[x/2] = crU8(r, g, b);
+		}
+	}
+}
+
+void rgbToRGBA8(const Color *rgb, int count, uint8_t *rgba) {
+	const float *src = &rgb[0].r;
+
+	int i = 0;
+	for (; i + YUV_BLOCK <= count; i += YUV_BLOCK) {
+		uint8_t block[4*YUV_BLOCK];
+		for (int k=0; k<YUV_BLOCK; k++) {
+			block[4*k]     = toU8( 255.f*src[3*(i+k)] );
+			block[4*k + 1] = toU8( 255.f*src[3*(i+k) + 1] );
+			block[4*k + 2] = toU8( 255.f*src[3*(i+k) + 2] );
+			block[4*k + 3] = 0xFF;
+		}
+		std::memcpy(rgba + 4*i, block, 4*YUV_BLOCK);
+	}
+
+	for (; i < count; i++) {
+		rgba[4*i]     = toU8( 255.f*src[3*i] );
+		rgba[4*i + 1] = toU8( 255.f*src[3*i + 1] );
+		rgba[4*i + 2] = toU8( 255.f*src[3*i + 2] );
+		rgba[4*i + 3] = 0xFF;
+	}
+}
+
+
+// ------ VideoStream ------
+
+// Constructors and Destructors
+VideoStream::VideoStream() {
+	frames = 0;
+	failed = false;
+	tWriteSum = 0;
+	tConvertSum = 0;
+
+	_file = nullptr;
+	_format = VideoFormat::Y4M;
+	_w = 0;
+	_h = 0;
+	_pool = nullptr;
+}
+
+VideoStream::~VideoStream() {
+	this->close();
+}
+
+
+// Methods
+bool VideoStream::open(const std::string &target, VideoFormat format, int w, int h, int fps, ThreadPool *pool) {
+	this->close();
+
+	if (target == "-") {
+		#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+		#endif
+		_file = stdout;
+	}
+	else {
+		_file = fopen(target.c_str(), "wb");
+	}
+
+	if (_file == nullptr) {
+		std::cerr << "Failed to open the video output " << target << std::endl;
+		return false;
+	}
+
+	// A reader closing the pipe ends the stream, not the renderer
+	#ifndef _WIN32
+		signal(SIGPIPE, SIG_IGN);
+	#endif
+
+	_format = format;
+	_w = w;
+	_h = h;
+	_pool = pool;
+	failed = false;
+
+	size_t frameSize = (size_t) 4*w*h;
+	if (format == VideoFormat::Y4M) {
+		size_t chroma = (size_t) ((w + 1)/2) * ((h + 1)/2);
+		frameSize = 6 + (size_t) w*h + 2*chroma;	// "FRAME\n" and the 3 planes
+
+		fprintf(_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, fps);
+	}
+
+	for (std::vector<uint8_t> &buffer : _buffers) {
+		buffer.resize(frameSize);
+	}
+
+	_free.push(0);
+	_free.push(1);
+
+	_thread = std::thread(&VideoStream::writer, this);
+	return true;
+}
+
+void VideoStream::close() {
+	if (_file == nullptr) return;
+
+	_pending.push(-1);
+	if (_thread.joinable()) _thread.join();
+
+	// Both buffers are back, the queue is empty for the next open()
+	int index = -1;
+	_free.pop(index);
+	_free.pop(index);
+
+	if (_file == stdout) fflush(_file);
+	else fclose(_file);
+
+	_file = nullptr;
+}
+
+bool VideoStream::submit(Surface &surface) {
+	if (_file == nullptr) return false;
+
+	TIME_PT tPtConvert1 = TIME_NOW();
+
+	// Frames below the stream resolution (dynamic resolution, progressive previews) are stretched,
+	// each worker stretches the rows it converts
+	const Color *rgb = surface.data();
+	bool stretch = (surface.surfWidth != _w || surface.surfHeight != _h);
+	if (stretch) {
+		_scratch.resize( (size_t) _w*_h );
+		rgb = _scratch.data();
+	}
+
+	auto stretchRows = [&](int y0, int y1) {
+		if ( !stretch ) return;
+
+		for (int y=y0; y<y1; y++) {
+			int sy = y*surface.surfHeight/_h;
+			for (int x=0; x<_w; x++) {
+				_scratch[y*_w + x] = surface.data()[sy*surface.surfWidth + x*surface.surfWidth/_w];
+			}
+		}
+	};
+
+	int index = -1;
+	if ( !_free.pop(index) ) return false;
+
+	uint8_t *out = _buffers[index].data();
+	int w = _w;
+	int h = _h;
+
+	if (_format == VideoFormat::Y4M) {
+		std::memcpy(out, "FRAME\n", 6);
+
+		uint8_t *yPlane = out + 6;
+		uint8_t *uPlane = yPlane + w*h;
+		uint8_t *vPlane = uPlane + ((w + 1)/2)*((h + 1)/2);
+
+		// Row pairs in parallel
+		_pool->parallelFor((h + 1)/2, 8, [&](int begin, int end) {
+			stretchRows(2*begin, std::min(h, 2*end));
+			rgbToYUV420(rgb, w, h, 2*begin, std::min(h, 2*end), yPlane, uPlane, vPlane);
+		});
+	}
+	else {
+		_pool->parallelFor(h, 16, [&](int begin, int end) {
+			stretchRows(begin, end);
+			rgbToRGBA8(rgb + begin*w, (end - begin)*w, out + 4*begin*w);
+		});
+	}
+
+	tConvertSum += TIME_DUR(TIME_NOW(), tPtConvert1);
+
+	_pending.push(index);
+	return true;
+}
+
+bool VideoStream::parseFormat(const std::string &name, VideoFormat &format) {
+	if (name == "y4m") format = VideoFormat::Y4M;
+	else if (name == "rgba") format = VideoFormat::RGBA;
+	else return false;
+
+	return true;
+}
+
+void VideoStream::writer() {
+	int index = -1;
+
+	while ( _pending.pop(index) && index >= 0 ) {
+		const std::vector<uint8_t> &buffer = _buffers[index];
+
+		if ( !failed ) {
+			TIME_PT tPtWrite1 = TIME_NOW();
+			size_t count = fwrite(buffer.data(), 1, buffer.size(), _file);
+			tWriteSum += TIME_DUR(TIME_NOW(), tPtWrite1);
+
+			if (count == buffer.size()) {
+				frames++;
+			}
+			else {
+				std::cerr << "Video output closed, dropping the remaining frames" << std::endl;
+				failed = true;
+			}
+		}
+
+		_free.push(index);
+	}
+}
@@ -0,0 +1,79 @@
+// Streams the presented frames as raw video to a file, a named pipe or stdout
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+#include "../render/surface.hpp"
+#include "../utils/queue.hpp"
+#include "../core/threadpool.hpp"
+
+
+enum class VideoFormat {
+	Y4M,	// YUV4MPEG2, 4:2:0 full range BT.601 (C420jpeg)
+	RGBA,	// Raw 8 bit RGBA, no header
+};
+
+
+/*
+Display values (after tonemapping) to 8 bit 4:2:0 planes, rows `y0` to `y1` (even).
+`yPlane` is w*h, `uPlane` and `vPlane` are ((w+1)/2)*((h+1)/2).
+Written as fixed width blocks of planar floats so the compiler vectorizes them.
+*/
+void rgbToYUV420(const Color *rgb, int w, int h, int y0, int y1, uint8_t *yPlane, uint8_t *uPlane, uint8_t *vPlane);
+
+// Display values to 8 bit RGBA, `count` pixels
+void rgbToRGBA8(const Color *rgb, int count, uint8_t *rgba);
+
+
+class VideoStream {
+	// Constructors / Destructors
+	public:
+		VideoStream();
+		~VideoStream();
+
+	// Attributes
+	public:
+		std::atomic<int> frames;			// Frames written
+		std::atomic<bool> failed;			// The target stopped taking frames (a closed pipe)
+		std::atomic<uint64_t> tWriteSum;	// in us, spent in fwrite by the writer thread
+		uint64_t tConvertSum;				// in us, spent converting in submit()
+
+	private:
+		FILE *_file;
+		VideoFormat _format;
+		int _w;
+		int _h;
+
+		// Double buffering, the writer flushes one while submit() converts into the other
+		std::vector<uint8_t> _buffers[2];
+		BlockingQueue<int> _free;
+		BlockingQueue<int> _pending;		// -1 stops the writer
+		std::thread _thread;
+
+		std::vector<Color> _scratch;		// Frames of another size, stretched to w x h
+		ThreadPool *_pool;
+
+	// Methods
+	public:
+		// `target` is a file or pipe path, "-" is stdout. Every frame is w x h
+		bool open(const std::string &target, VideoFormat format, int w, int h, int fps, ThreadPool *pool);
+
+		// Writes the pending frames and closes the target
+		void close();
+
+		bool isOpen() const { return _file != nullptr; }
+
+		// Converts `surface` and queues it, waits while the writer still holds both buffers
+		bool submit(Surface &surface);
+
+		static bool parseFormat(const std::string &name, VideoFormat &format);
+
+	private:
+		void writer();
+};
@@ -1,21 +1,163 @@
 #include <iostream>
+#include <string>
+#include <algorithm>
+#include <cmath>
 #include "core/engine.hpp"
+#include "core/server.hpp"
+#include "core/coordinator.hpp"
 #include "SDL3/SDL_main.h"
 
+// Offline compression of an image and its mips, with the size and error against RGBA8
+static int compressTexture(const char *input, const char *output, TextureFormat format) {
+	Texture texture;
+	if ( !texture.load(input) ) return EXIT_FAILURE;
+
+	size_t rgbaSize = texture.memorySize();
+	std::vector<uint32_t> original(texture.width()*texture.height());
+	for (int y=0; y<texture.height(); y++) {
+		for (int x=0; x<texture.width(); x++) {
+			original[y*texture.width() + x] = texture.texel(0, x, y);
+		}
+	}
+
+	texture.compress(format);
+	if ( !texture.save(output) ) return EXIT_FAILURE;
+
+	// Error of level 0, on the channels the format keeps
+	int channels = (format == TextureFormat::BC1) ? 3 : (format == TextureFormat::BC5) ? 2 : 1;
+	const TextureLevel &level = texture.levels[0];
+	double sum = 0.0;
+
+	for (int by=0; by<(level.height + BC_BLOCK - 1)/BC_BLOCK; by++) {
+		for (int bx=0; bx<level.blocksX; bx++) {
+			const uint8_t *block = texture.blocks.data() + (by*level.blocksX + bx)*blockBytes( Texture::blockFormat(format) );
+			uint32_t decoded[16];
+			if (format == TextureFormat::BC1) decodeBC1(block, decoded);
+			else if (format == TextureFormat::BC4) decodeBC4(block, decoded);
+			else decodeBC5(block, decoded);
+
+			for (int k=0; k<16; k++) {
+				int x = bx*BC_BLOCK + k % BC_BLOCK, y = by*BC_BLOCK + k / BC_BLOCK;
+				if (x >= level.width || y >= level.height) continue;
+
+				for (int c=0; c<channels; c++) {
+					int d = (int) ((decoded[k] >> (8*c)) & 0xFF) - (int) ((original[y*level.width + x] >> (8*c)) & 0xFF);
+					sum += d*d;
+				}
+			}
+		}
+	}
+
+	double mse = sum/((double) level.width*level.height*channels);
+	std::cout << "  Saved " << output << ": " << texture.memorySize()/1024 << " KB against " << rgbaSize/1024 << " KB in RGBA8 ("
+		<< (float) rgbaSize/texture.memorySize() << "x smaller), PSNR " << ((mse > 0.0) ? 10.0*std::log10(255.0*255.0/mse) : 99.0) << " dB" << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[]) {
 	// (void) argc;
 	// (void) argv;
 
+	if (argc > 1 && std::string(argv[1]) == "--compress") {
+		TextureFormat format = TextureFormat::BC1;
+
+		if (argc < 4 || (argc > 4 && (!Texture::parseFormat(argv[4], format) || format == TextureFormat::RGBA8))) {
+			std::cerr << "Usage: \n\tqazwsx --compress <image> <texture.dds> [bc1 | bc4 | bc5]" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		return compressTexture(argv[2], argv[3], format);
+	}
+
+	// Offline, the chunked layout the engine streams scenes larger than memory from
+	if (argc > 1 && std::string(argv[1]) == "--pack") {
+		if (argc < 4) {
+			std::cerr << "Usage: \n\tqazwsx --pack <scene_file.json> <scene.qzs>" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		Scene scene;
+		if ( !scene.loadJSONScene(argv[2]) ) return EXIT_FAILURE;
+		return ScenePack::write(scene, argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Headless, renders the jobs of local clients until interrupted
+	if (argc > 1 && std::string(argv[1]) == "--serve") {
+		if (argc < 3) {
+			std::cerr << "Usage: \n\tqazwsx --serve <unix:path | host:port>" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		RenderServer server;
+		return server.run(argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	if (argc < 2) {
 		std::cerr << "Error: No scene file provided." << std::endl;
-		std::cerr << "Usage: \n\tqazwsx <scene_file.json>" << std::endl;
+		std::cerr << "Usage: \n\tqazwsx <scene_file.json> [--bench [frames] [case]]" << std::endl;
+		std::cerr << "\tqazwsx <scene_file.json> --stream <file | pipe | -> [y4m | rgba] [frames]" << std::endl;
+		std::cerr << "\tqazwsx <scene_file.json> --distribute <host:port,host:port,...> [frames]" << std::endl;
+		std::cerr << "\tqazwsx --compress <image> <texture.dds> [bc1 | bc4 | bc5]" << std::endl;
+		std::cerr << "\tqazwsx --pack <scene_file.json> <scene.qzs>" << std::endl;
+		std::cerr << "\tqazwsx --serve <unix:path | host:port>" << std::endl;
 		return EXIT_FAILURE;
 	}
 
 	const char *filename = argv[1];
 
-	Engine LiRasterEngine = Engine();
-	LiRasterEngine.pipeline(filename);
+	// Raw video of the presented frames, "-" is stdout, rendered without a window
+	const char *streamTarget = nullptr;
+	VideoFormat streamFormat = VideoFormat::Y4M;
+	int streamFrames = 0;
+
+	if (argc > 3 && std::string(argv[2]) == "--stream") {
+		streamTarget = argv[3];
+
+		if (argc > 4 && !VideoStream::parseFormat(argv[4], streamFormat)) {
+			std::cerr << "Error: Unknown stream format " << argv[4] << ", expected y4m or rgba." << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		if (argc > 5) {
+			streamFrames = std::max(0, atoi(argv[5]));
+		}
+
+		// stdout carries the video, the logs move to stderr
+		if (std::string(streamTarget) == "-") {
+			std::cout.rdbuf(std::cerr.rdbuf());
+		}
+	}
+
+	// Headless, the frames are rendered by render servers
+	if (argc > 3 && std::string(argv[2]) == "--distribute") {
+		std::vector<std::string> workers;
+		std::string list = argv[3];
+
+		for (size_t begin = 0, end; begin <= list.size(); begin = end + 1) {
+			end = std::min(list.find(',', begin), list.size());
+			if (end > begin) workers.push_back(list.substr(begin, end - begin));
+		}
+
+		int frames = (argc > 4) ? std::max(1, atoi(argv[4])) : 10;
+
+		Coordinator coordinator;
+		return coordinator.run(filename, workers, frames) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	Engine LiRasterEngine = Engine(filename, streamTarget != nullptr);
+
+	if (argc > 2 && std::string(argv[2]) == "--bench") {
+		int frames = (argc > 3) ? std::max(1, atoi(argv[3])) : 100;
+		LiRasterEngine.benchmark(frames, (argc > 4) ? argv[4] : nullptr);
+		return EXIT_SUCCESS;
+	}
+
+	if (streamTarget) {
+		LiRasterEngine.streamTo(streamTarget, streamFormat, streamFrames);
+	}
+
+	LiRasterEngine.pipeline();
 
 	return EXIT_SUCCESS;
 }
@@ -21,8 +21,8 @@ Vec3 Tris3D::getNormal() {
 
 // ------ Tris3D_ref Class ------
 // Ctors and Dtors
-Tris3D_ref::Tris3D_ref() : v1(nullptr), v2(nullptr), v3(nullptr) {}
-Tris3D_ref::Tris3D_ref(Vec3 *a, Vec3 *b, Vec3 *c) : v1(a), v2(b), v3(c) {}
+Tris3D_ref::Tris3D_ref() : v1(nullptr), v2(nullptr), v3(nullptr), id(0) {}
+Tris3D_ref::Tris3D_ref(Vec3 *a, Vec3 *b, Vec3 *c) : v1(a), v2(b), v3(c), id(0) {}
 Tris3D_ref::~Tris3D_ref() {}
 
 // Methods
@@ -49,5 +49,17 @@ Vec2 Tris2D::getCenter() {
 }
 
 
+// ------ Tris2D_p Class ------
+// Ctors and Dtors
+Tris2D_p::Tris2D_p() : id(0), clipped(false) {}
+Tris2D_p::Tris2D_p(Vec4 a, Vec4 b, Vec4 c, uint32_t id) : v1(a), v2(b), v3(c), id(id), clipped(false) {}
+Tris2D_p::~Tris2D_p() {}
+
+// Methods
+Tris2D Tris2D_p::toTris2D() const {
+	return Tris2D( Vec2(v1), Vec2(v2), Vec2(v3) );
+}
+
+
 // ------ Tris2D_i Class ------
 // (No methods, just a data structure)
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include "../math/vec.hpp"
 
 class Tris3D {
@@ -20,6 +21,7 @@ public:
 class Tris3D_ref {
 public:
 	Vec3 *v1, *v2, *v3;
+	uint32_t id;	// Index of the source triangle
 
 public:
 	// Ctors and Dtors
@@ -48,6 +50,26 @@ public:
 };
 
 
+// Projected Triangle, keeps what perspective correct interpolation needs
+// x, y : Screen Space, z : NDC depth, w : 1/w of clip space
+class Tris2D_p {
+public:
+	Vec4 v1, v2, v3;
+	uint32_t id;	// Index of the source triangle
+	bool clipped;	// Cut by the near plane, its corners are blends of the source corners
+	Vec3 weights[3];	// Weights of the source corners of every corner (clip space), when clipped
+
+public:
+	// Ctors and Dtors
+	Tris2D_p();
+	Tris2D_p(Vec4 a, Vec4 b, Vec4 c, uint32_t id);
+	~Tris2D_p();
+
+	// Methods
+	Tris2D toTris2D() const;
+};
+
+
 // 2D Integer Triangle : x0, y0, x1, y1, x2, y2
 class Tris2D_i {
 public:
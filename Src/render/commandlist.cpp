@@ -0,0 +1,258 @@
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "commandlist.hpp"
+
+
+// Slack of the line bins, clipping to the surface moves the ends by up to a pixel
+#define COMMAND_LINE_MARGIN 2
+
+
+// Constructors and Destructors
+template <typename Format>
+CommandListT<Format>::CommandListT() {
+	tilesX = 0;
+	tilesY = 0;
+
+	_binnedW = 0;
+	_binnedH = 0;
+}
+
+template <typename Format>
+CommandListT<Format>::~CommandListT() {}
+
+
+// Methods
+template <typename Format>
+void CommandListT<Format>::clear() {
+	_commands.clear();
+
+	_binnedW = 0;
+	_binnedH = 0;
+}
+
+template <typename Format>
+void CommandListT<Format>::push(Op op, std::initializer_list<int> v, int width, const Color &color) {
+	Command cmd = {{0, 0, 0, 0, 0, 0}, width, color, op};
+	std::copy(v.begin(), v.end(), cmd.v);
+
+	_commands.push_back(cmd);
+
+	_binnedW = 0;
+	_binnedH = 0;
+}
+
+template <typename Format>
+void CommandListT<Format>::fill(const Color &color) {
+	this->push(Op::FILL, {}, 0, color);
+}
+
+template <typename Format>
+void CommandListT<Format>::drawLine(int x0, int y0, int x1, int y1, const Color &color, int lineWidth) {
+	if (lineWidth < 1) return;
+	this->push(Op::LINE, {x0, y0, x1, y1}, lineWidth, color);
+}
+
+// The 4 sides as lines, like SurfaceT::drawRect(), each one bins on its own
+template <typename Format>
+void CommandListT<Format>::drawRect(int x0, int y0, int w, int h, const Color &color, int thickness) {
+	this->drawLine(x0, y0, x0+w, y0, color, thickness);
+	this->drawLine(x0, y0+h, x0+w, y0+h, color, thickness);
+	this->drawLine(x0, y0, x0, y0+h, color, thickness);
+	this->drawLine(x0+w, y0, x0+w, y0+h, color, thickness);
+}
+
+template <typename Format>
+void CommandListT<Format>::fillRect(int x0, int y0, int w, int h, const Color &color) {
+	if (w < 1 || h < 1) return;
+	this->push(Op::FILL_RECT, {x0, y0, w, h}, 0, color);
+}
+
+template <typename Format>
+void CommandListT<Format>::drawCircle(int x0, int y0, int r, const Color &color, int thickness) {
+	if (r < 1 || thickness < 1) return;
+	this->push(Op::CIRCLE, {x0, y0, r}, thickness, color);
+}
+
+template <typename Format>
+void CommandListT<Format>::fillCircle(int x0, int y0, int r, const Color &color) {
+	if (r < 1) return;
+	this->push(Op::FILL_CIRCLE, {x0, y0, r}, 0, color);
+}
+
+template <typename Format>
+void CommandListT<Format>::drawTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color, int thickness) {
+	this->drawLine(x0, y0, x1, y1, color, thickness);
+	this->drawLine(x1, y1, x2, y2, color, thickness);
+	this->drawLine(x0, y0, x2, y2, color, thickness);
+}
+
+template <typename Format>
+void CommandListT<Format>::fillTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color) {
+	this->push(Op::FILL_TRIS, {x0, y0, x1, y1, x2, y2}, 0, color);
+}
+
+template <typename Format>
+void CommandListT<Format>::execute(SurfaceT<Format> &surface, ThreadPool &pool) {
+	if (_commands.empty()) return;
+
+	int w = surface.surfWidth;
+	int h = surface.surfHeight;
+
+	if (w != _binnedW || h != _binnedH) this->bin(w, h);
+
+	pool.parallelFor(tilesX*tilesY, 1, [&](int begin, int end) {
+		// A view of the same pixels, with the clip rectangle of the tile
+		SurfaceT<Format> view = surface;
+
+		for (int t=begin; t<end; t++) {
+			if (_tileStart[t] == _tileStart[t + 1]) continue;
+
+			int X0 = (t % tilesX)*COMMAND_TILE;
+			int Y0 = (t / tilesX)*COMMAND_TILE;
+			view.setClip(X0, Y0, X0 + COMMAND_TILE, Y0 + COMMAND_TILE);
+
+			for (uint32_t i=_tileStart[t]; i<_tileStart[t + 1]; i++) {
+				this->run(view, _commands[ _binned[i] ]);
+			}
+		}
+	});
+}
+
+// Counting sort of the command indices by tile, stable so a tile keeps the recording order
+template <typename Format>
+void CommandListT<Format>::bin(int w, int h) {
+	tilesX = (w + COMMAND_TILE - 1)/COMMAND_TILE;
+	tilesY = (h + COMMAND_TILE - 1)/COMMAND_TILE;
+	int tileCount = tilesX*tilesY;
+
+	_tileStart.assign(tileCount + 1, 0);
+	for (const Command &cmd : _commands) {
+		this->forEachTile(cmd, w, h, [&](int t) { _tileStart[t + 1]++; });
+	}
+
+	for (int t=0; t<tileCount; t++) {
+		_tileStart[t + 1] += _tileStart[t];
+	}
+
+	_binned.resize(_tileStart[tileCount]);
+	std::vector<uint32_t> cursors(_tileStart.begin(), _tileStart.end() - 1);
+
+	for (uint32_t i=0; i<(uint32_t) _commands.size(); i++) {
+		this->forEachTile(_commands[i], w, h, [&](int t) { _binned[ cursors[t]++ ] = i; });
+	}
+
+	_binnedW = w;
+	_binnedH = h;
+}
+
+template <typename Format>
+void CommandListT<Format>::run(SurfaceT<Format> &surface, const Command &cmd) const {
+	const int *v = cmd.v;
+
+	switch (cmd.op) {
+		case Op::FILL:        surface.fill(cmd.color); break;
+		case Op::LINE:        surface.drawLine(v[0], v[1], v[2], v[3], cmd.color, cmd.width); break;
+		case Op::FILL_RECT:   surface.fillRect(v[0], v[1], v[2], v[3], cmd.color); break;
+		case Op::CIRCLE:      surface.drawCircle(v[0], v[1], v[2], cmd.color, cmd.width); break;
+		case Op::FILL_CIRCLE: surface.fillCircle(v[0], v[1], v[2], cmd.color); break;
+		case Op::FILL_TRIS:   surface.fillTris(v[0], v[1], v[2], v[3], v[4], v[5], cmd.color); break;
+	}
+}
+
+template <typename Format>
+template <typename Fn>
+void CommandListT<Format>::forEachTile(const Command &cmd, int w, int h, Fn &&fn) const {
+	const int *v = cmd.v;
+
+	// Tiles of the pixel box [x0, x1] x [y0, y1]
+	auto box = [&](int x0, int y0, int x1, int y1) {
+		if (x1 < 0 || y1 < 0 || x0 >= w || y0 >= h) return;
+
+		int tx0 = std::max(0, x0)/COMMAND_TILE;
+		int ty0 = std::max(0, y0)/COMMAND_TILE;
+		int tx1 = std::min(w - 1, x1)/COMMAND_TILE;
+		int ty1 = std::min(h - 1, y1)/COMMAND_TILE;
+
+		for (int ty=ty0; ty<=ty1; ty++) {
+			for (int tx=tx0; tx<=tx1; tx++) {
+				fn(ty*tilesX + tx);
+			}
+		}
+	};
+
+	switch (cmd.op) {
+		case Op::FILL:
+			box(0, 0, w - 1, h - 1);
+			return;
+
+		case Op::FILL_RECT:
+			box(v[0], v[1], v[0] + v[2] - 1, v[1] + v[3] - 1);
+			return;
+
+		case Op::CIRCLE:
+		case Op::FILL_CIRCLE:
+			box(v[0] - v[2], v[1] - v[2], v[0] + v[2], v[1] + v[2]);
+			return;
+
+		case Op::FILL_TRIS:
+			box(std::min({v[0], v[2], v[4]}) - 1, std::min({v[1], v[3], v[5]}) - 1,
+				std::max({v[0], v[2], v[4]}) + 1, std::max({v[1], v[3], v[5]}) + 1);
+			return;
+
+		case Op::LINE:
+			break;
+	}
+
+	// Lines walk the tile columns (rows) of their major axis, a long diagonal
+	// only lands in the tiles along it instead of its whole bounding box
+	int m = cmd.width/2 + COMMAND_LINE_MARGIN;
+	int ax = v[0], ay = v[1], bx = v[2], by = v[3];
+
+	bool xMajor = std::abs(bx - ax) >= std::abs(by - ay);
+	int majorSize = w, minorSize = h;
+
+	if ( !xMajor ) {
+		std::swap(ax, ay);
+		std::swap(bx, by);
+		std::swap(majorSize, minorSize);
+	}
+	if (ax > bx) {
+		std::swap(ax, bx);
+		std::swap(ay, by);
+	}
+
+	if (bx + m < 0 || ax - m >= majorSize) return;
+
+	float slope = (bx > ax) ? float(by - ay)/(bx - ax) : 0.f;
+	int t0 = std::max(0, ax - m)/COMMAND_TILE;
+	int t1 = std::min(majorSize - 1, bx + m)/COMMAND_TILE;
+
+	for (int t=t0; t<=t1; t++) {
+		// Part of the line over this column (the nearest end past the line), and its extent across
+		int s = std::min(bx, std::max(ax, t*COMMAND_TILE - m));
+		int e = std::max(ax, std::min(bx, (t + 1)*COMMAND_TILE - 1 + m));
+
+		float ms = ay + (s - ax)*slope;
+		float me = ay + (e - ax)*slope;
+		int lo = (int) std::floor(std::min(ms, me)) - m;
+		int hi = (int) std::ceil(std::max(ms, me)) + m;
+		if (hi < 0 || lo >= minorSize) continue;
+
+		int u0 = std::max(0, lo)/COMMAND_TILE;
+		int u1 = std::min(minorSize - 1, hi)/COMMAND_TILE;
+
+		for (int u=u0; u<=u1; u++) {
+			fn(xMajor ? u*tilesX + t : t*tilesX + u);
+		}
+	}
+}
+
+
+// One instantiation per pixel format of surface.hpp
+template class CommandListT<PixelRGB32F>;
+template class CommandListT<PixelRGBA16F>;
+template class CommandListT<PixelRGB10A2>;
+template class CommandListT<PixelRGBA8>;
+template class CommandListT<PixelSRGBA8>;
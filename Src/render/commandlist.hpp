@@ -0,0 +1,90 @@
+// Retained 2D drawing, Surface calls recorded once and replayed tile by tile in parallel
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+
+#include "../math/color.hpp"
+#include "../core/threadpool.hpp"
+#include "surface.hpp"
+
+
+#define COMMAND_TILE 64		// Tile size in pixels
+
+
+/*
+Records the drawing calls of SurfaceT (same arguments) and executes them later.
+Commands are binned by the tiles they touch, tiles run in parallel through a clip
+rectangle and keep the recording order, so overlaps come out as if drawn one by one.
+The binning stays valid until the list changes, replaying an unchanged list only draws.
+*/
+template <typename Format>
+class CommandListT {
+	// Constructors / Destructors
+	public:
+		CommandListT();
+		~CommandListT();
+
+	private:
+		enum class Op : uint8_t {
+			FILL,
+			LINE,			// v = x0, y0, x1, y1
+			FILL_RECT,		// v = x, y, w, h
+			CIRCLE,			// v = x, y, r
+			FILL_CIRCLE,
+			FILL_TRIS,		// v = x0, y0, x1, y1, x2, y2
+		};
+
+		struct Command {
+			int v[6];
+			int width;		// Line width or ring thickness
+			Color color;
+			Op op;
+		};
+
+	// Attributes
+	public:
+		int tilesX;
+		int tilesY;
+
+	private:
+		std::vector<Command> _commands;		// In recording order
+
+		// Command indices sorted by tile, a tile reads one contiguous range
+		std::vector<uint32_t> _binned;
+		std::vector<uint32_t> _tileStart;	// tilesX*tilesY + 1 offsets into `_binned`
+
+		// Surface size of the binning, 0 once the list changed
+		int _binnedW;
+		int _binnedH;
+
+	// Methods
+	public:
+		void clear();
+		size_t count() const { return _commands.size(); }
+
+		void fill(const Color &color);
+		void drawLine(int x0, int y0, int x1, int y1, const Color &color, int lineWidth);
+		void drawRect(int x0, int y0, int w, int h, const Color &color, int thickness);
+		void fillRect(int x0, int y0, int w, int h, const Color &color);
+		void drawCircle(int x0, int y0, int r, const Color &color, int thickness);
+		void fillCircle(int x0, int y0, int r, const Color &color);
+		void drawTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color, int thickness);
+		void fillTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color);
+
+		// Draws the list on `surface`, bins it first when it changed or the size did
+		void execute(SurfaceT<Format> &surface, ThreadPool &pool);
+
+	private:
+		void push(Op op, std::initializer_list<int> v, int width, const Color &color);
+		void bin(int w, int h);
+		void run(SurfaceT<Format> &surface, const Command &cmd) const;
+
+		// Calls fn(tile) for every tile of a w x h surface `cmd` touches
+		template <typename Fn>
+		void forEachTile(const Command &cmd, int w, int h, Fn &&fn) const;
+};
+
+using CommandList = CommandListT<PixelRGB32F>;
@@ -0,0 +1,396 @@
+#include <cmath>
+#include <algorithm>
+
+#include "debugdraw.hpp"
+
+
+#define DEBUG_NEAR_W 1E-3F	// Smallest clip space w drawn, 3D primitives are cut there
+
+
+bool clipLine(Vec2 &a, Vec2 &b, float x0, float y0, float x1, float y1) {
+	float dx = b.x - a.x;
+	float dy = b.y - a.y;
+
+	// Entering and leaving parameters along a + t*(b-a)
+	float tIn = 0.f, tOut = 1.f;
+
+	const float p[4] = {-dx, dx, -dy, dy};
+	const float q[4] = {a.x - x0, x1 - a.x, a.y - y0, y1 - a.y};
+
+	for (int i=0; i<4; i++) {
+		if (p[i] == 0.f) {
+			// Parallel to this edge and outside of it
+			if (q[i] < 0.f) return false;
+			continue;
+		}
+
+		float t = q[i]/p[i];
+		if (p[i] < 0.f) tIn = std::max(tIn, t);
+		else tOut = std::min(tOut, t);
+
+		if (tIn > tOut) return false;
+	}
+
+	Vec2 start = a;
+	if (tOut < 1.f) b = start + tOut*Vec2(dx, dy);
+	if (tIn > 0.f) a = start + tIn*Vec2(dx, dy);
+
+	return true;
+}
+
+
+// std::floor is a library call without SSE 4.1, this one inlines
+static inline int floorInt(float v) {
+	int i = (int) v;
+	return i - (v < i);
+}
+
+
+// ------ Kernels ------
+// Both only touch the pixels of the tile [X0, X1) x [Y0, Y1), so tiles draw independently.
+// A pixel comes out the same whichever tile draws it, there are no seams
+
+// One span per row, the disc of the pixels with dx^2 + dy^2 <= r^2
+static inline void drawPoint(Color *data, int stride, Vec2 p, int r, const Color &color, int X0, int Y0, int X1, int Y1) {
+	int cx = floorInt(p.x);
+	int cy = floorInt(p.y);
+
+	int yStart = std::max(Y0, cy - r);
+	int yEnd = std::min(Y1 - 1, cy + r);
+
+	for (int y=yStart; y<=yEnd; y++) {
+		int dy = y - cy;
+		int half = (int) std::sqrt( (float) (r*r - dy*dy) );
+		while (half*half > r*r - dy*dy) half--;
+
+		int xStart = std::max(X0, cx - half);
+		int xEnd = std::min(X1 - 1, cx + half);
+		if (xStart > xEnd) continue;
+
+		std::fill(data + y*stride + xStart, data + y*stride + xEnd + 1, color);
+	}
+}
+
+// One pixel per column of the major axis, sampled at the pixel centre.
+// Lines along y come in swapped, `transposed` writes them back.
+// With a `depth` buffer the pixels behind it are skipped, `z` is 1/w at `a`
+static inline void drawLine(Color *data, const float *depth, int stride, Vec2 a, Vec2 b, float slope, float z, float zSlope, bool transposed, const Color &color, int X0, int Y0, int X1, int Y1) {
+	if (transposed) {
+		std::swap(X0, Y0);
+		std::swap(X1, Y1);
+	}
+
+	int start = std::max(X0, floorInt(a.x));
+	int end = std::min(X1 - 1, floorInt(b.x));
+
+	// Axis aligned, a run of one row or column
+	if (slope == 0.f && depth == nullptr) {
+		int j = floorInt(a.y);
+		if (j < Y0 || j >= Y1 || start > end) return;
+
+		if (transposed) {
+			for (int i=start; i<=end; i++) data[i*stride + j] = color;
+		}
+		else {
+			std::fill(data + j*stride + start, data + j*stride + end + 1, color);
+		}
+		return;
+	}
+
+	float minor0 = std::min(a.y, b.y);
+	float minor1 = std::max(a.y, b.y);
+
+	for (int i=start; i<=end; i++) {
+		float minor = std::clamp(a.y + (i + 0.5f - a.x)*slope, minor0, minor1);
+		int j = floorInt(minor);
+		if (j < Y0 || j >= Y1) continue;
+
+		int index = transposed ? i*stride + j : j*stride + i;
+
+		if (depth) {
+			float invW = z + (i + 0.5f - a.x)*zSlope;
+			if (invW*(1.f + DEBUG_DEPTH_BIAS) < depth[index]) continue;
+		}
+
+		data[index] = color;
+	}
+}
+
+
+// Constructors and Destructors
+DebugDraw::DebugDraw() {
+	tilesX = 0;
+	tilesY = 0;
+	_w = 0;
+	_h = 0;
+	_projMat = glm::mat4(1.f);
+}
+
+DebugDraw::~DebugDraw() {
+}
+
+
+// Methods
+void DebugDraw::begin(int w, int h, const glm::mat4 &projMat) {
+	_primitives.clear();
+	_projMat = projMat;
+
+	if (w == _w && h == _h) return;
+
+	_w = w;
+	_h = h;
+	tilesX = (w + DEBUG_TILE-1) / DEBUG_TILE;
+	tilesY = (h + DEBUG_TILE-1) / DEBUG_TILE;
+}
+
+void DebugDraw::point(const Vec2 &p, int radius, const Color &color) {
+	radius = std::max(0, radius);
+
+	if (p.x < -radius || p.y < -radius || p.x >= _w + radius || p.y >= _h + radius) return;
+
+	_primitives.push_back({p, p, color, 0.f, 0.f, 0.f, radius, Shape::POINT, false});
+}
+
+void DebugDraw::line(const Vec2 &a, const Vec2 &b, const Color &color) {
+	Primitive prim = this->screenLine(a, b, 0.f, 0.f, color, false);
+	if (prim.shape != Shape::NONE) _primitives.push_back(prim);
+}
+
+void DebugDraw::rect(const Vec2 &min, const Vec2 &max, const Color &color) {
+	this->line(Vec2(min.x, min.y), Vec2(max.x, min.y), color);
+	this->line(Vec2(max.x, min.y), Vec2(max.x, max.y), color);
+	this->line(Vec2(max.x, max.y), Vec2(min.x, max.y), color);
+	this->line(Vec2(min.x, max.y), Vec2(min.x, min.y), color);
+}
+
+// Same mapping as Engine::project()
+static inline Vec2 toScreen(const Vec4 &clip, int w, int h) {
+	return Vec2( w * (1.f + clip.x/clip.w)/2.f, h * (1.f - clip.y/clip.w)/2.f );
+}
+
+void DebugDraw::point3D(const Vec3 &p, int radius, const Color &color) {
+	Vec4 clip = _projMat * Vec4(p, 1.f);
+	if (clip.w < DEBUG_NEAR_W) return;
+
+	this->point(toScreen(clip, _w, _h), radius, color);
+}
+
+void DebugDraw::line3D(const Vec3 &a, const Vec3 &b, const Color &color) {
+	Primitive prim = this->clipSpaceLine(_projMat * Vec4(a, 1.f), _projMat * Vec4(b, 1.f), color, false);
+	if (prim.shape != Shape::NONE) _primitives.push_back(prim);
+}
+
+void DebugDraw::normal(const Vec3 &p, const Vec3 &n, float length, const Color &color) {
+	this->line3D(p, p + n*length, color);
+}
+
+void DebugDraw::aabb(const glm::mat4 &modelView, const Vec3 &min, const Vec3 &max, const Color &color) {
+	// Corner i takes max on the axes of its set bits
+	Vec3 corners[8];
+	for (int i=0; i<8; i++) {
+		Vec3 c( (i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z );
+		corners[i] = Vec3( modelView * Vec4(c, 1.f) );
+	}
+
+	// Edges join the corners one bit apart
+	for (int i=0; i<8; i++) {
+		for (int bit=1; bit<8; bit<<=1) {
+			if ( !(i & bit) ) this->line3D(corners[i], corners[i | bit], color);
+		}
+	}
+}
+
+void DebugDraw::lines(const Vec4 *clipVerts, const uint32_t *edges, int count, const Color &color, bool depthTest, ThreadPool &pool) {
+	size_t first = _primitives.size();
+	_primitives.resize(first + count);
+
+	// The clipped away edges stay as Shape::NONE, in place
+	pool.parallelFor(count, 1024, [&](int begin, int end) {
+		for (int i=begin; i<end; i++) {
+			const Vec4 &ca = clipVerts[ edges[2*i] ];
+			const Vec4 &cb = clipVerts[ edges[2*i + 1] ];
+			_primitives[first + i] = this->clipSpaceLine(ca, cb, color, depthTest);
+		}
+	});
+}
+
+void DebugDraw::draw(Surface &surface, ThreadPool &pool, const float *depth) {
+	if (_primitives.empty()) return;
+
+	// Recorded for another size, nothing lines up
+	if (surface.surfWidth != _w || surface.surfHeight != _h) return;
+
+	this->bin(pool);
+
+	Color *data = surface.data();
+
+	pool.parallelFor(tilesX*tilesY, 1, [&](int begin, int end) {
+		for (int t=begin; t<end; t++) {
+			this->drawTile(data, depth, t % tilesX, t / tilesX);
+		}
+	});
+}
+
+DebugDraw::Primitive DebugDraw::clipSpaceLine(Vec4 ca, Vec4 cb, const Color &color, bool depthTest) const {
+	if (ca.w < DEBUG_NEAR_W && cb.w < DEBUG_NEAR_W) {
+		return {Vec2(0.f), Vec2(0.f), color, 0.f, 0.f, 0.f, 0, Shape::NONE, depthTest};
+	}
+
+	// Cut at the near w, before the division flips the part behind the camera
+	if (ca.w < DEBUG_NEAR_W) ca = ca + (cb - ca)*((DEBUG_NEAR_W - ca.w)/(cb.w - ca.w));
+	if (cb.w < DEBUG_NEAR_W) cb = cb + (ca - cb)*((DEBUG_NEAR_W - cb.w)/(ca.w - cb.w));
+
+	return this->screenLine(toScreen(ca, _w, _h), toScreen(cb, _w, _h), 1.f/ca.w, 1.f/cb.w, color, depthTest);
+}
+
+DebugDraw::Primitive DebugDraw::screenLine(Vec2 a, Vec2 b, float za, float zb, const Color &color, bool depthTest) const {
+	Primitive prim = {a, b, color, 0.f, 0.f, 0.f, 0, Shape::NONE, depthTest};
+
+	// Along the major axis from here on, `a` first
+	Shape shape = Shape::LINE_X;
+	float xMax = (float) _w, yMax = (float) _h;
+
+	if (std::abs(b.y - a.y) > std::abs(b.x - a.x)) {
+		shape = Shape::LINE_Y;
+		std::swap(a.x, a.y);
+		std::swap(b.x, b.y);
+		std::swap(xMax, yMax);
+	}
+	if (a.x > b.x) {
+		std::swap(a, b);
+		std::swap(za, zb);
+	}
+
+	// 1/w is linear in screen space, like the minor axis
+	float major = b.x - a.x;
+	float slope = (major > 0.f) ? (b.y - a.y)/major : 0.f;
+	float depthSlope = (major > 0.f) ? (zb - za)/major : 0.f;
+
+	// Every tile has to see the same endpoints, so the line is clipped once here
+	Vec2 a1 = a, b1 = b;
+	if ( !clipLine(a1, b1, 0.f, 0.f, xMax, yMax) ) return prim;
+
+	prim.a = a1;
+	prim.b = b1;
+	prim.slope = slope;
+	prim.depth = za + (a1.x - a.x)*depthSlope;
+	prim.depthSlope = depthSlope;
+	prim.shape = shape;
+	return prim;
+}
+
+// Points go to the tiles of their square, lines walk the tile columns (or rows) of
+// their major axis and only land in the tiles they cross
+template <typename Fn>
+void DebugDraw::forEachTile(const Primitive &prim, Fn &&fn) const {
+	if (prim.shape == Shape::NONE) return;
+
+	auto tileOf = [](float v, int count) {
+		return std::max(0, std::min(count - 1, floorInt(v / DEBUG_TILE)));
+	};
+
+	if (prim.shape == Shape::POINT) {
+		int tx0 = tileOf(prim.a.x - prim.radius, tilesX), tx1 = tileOf(prim.a.x + prim.radius, tilesX);
+		int ty0 = tileOf(prim.a.y - prim.radius, tilesY), ty1 = tileOf(prim.a.y + prim.radius, tilesY);
+
+		for (int ty=ty0; ty<=ty1; ty++) {
+			for (int tx=tx0; tx<=tx1; tx++) {
+				fn(ty*tilesX + tx);
+			}
+		}
+		return;
+	}
+
+	bool transposed = (prim.shape == Shape::LINE_Y);
+	int majorTiles = transposed ? tilesY : tilesX;
+	int minorTiles = transposed ? tilesX : tilesY;
+	const Vec2 &a = prim.a;
+	const Vec2 &b = prim.b;
+
+	for (int m=tileOf(a.x, majorTiles); m<=tileOf(b.x, majorTiles); m++) {
+		float x0 = std::max(a.x, (float) m*DEBUG_TILE);
+		float x1 = std::min(b.x, (float) (m+1)*DEBUG_TILE);
+		float y0 = a.y + (x0 - a.x)*prim.slope;
+		float y1 = a.y + (x1 - a.x)*prim.slope;
+
+		// The kernel samples at pixel centres, a pixel of margin covers them
+		int n0 = tileOf(std::min(y0, y1) - 1.f, minorTiles);
+		int n1 = tileOf(std::max(y0, y1) + 1.f, minorTiles);
+
+		for (int n=n0; n<=n1; n++) {
+			fn( transposed ? m*tilesX + n : n*tilesX + m );
+		}
+	}
+}
+
+/*
+Counting sort by tile, in parallel over chunks of the primitives.
+The chunks of a tile are laid out in order, so every tile keeps the recording order
+*/
+void DebugDraw::bin(ThreadPool &pool) {
+	int tileCount = tilesX*tilesY;
+	int primCount = (int) _primitives.size();
+	int chunks = std::max(1, std::min(pool.threadCount(), primCount / DEBUG_BIN_CHUNK));
+
+	auto forChunks = [&](auto &&fn) {
+		pool.parallelFor(chunks, 1, [&](int cBegin, int cEnd) {
+			for (int c=cBegin; c<cEnd; c++) {
+				uint32_t *tiles = &_chunkTiles[ (size_t) c*tileCount ];
+				int begin = (int) ((int64_t) primCount*c/chunks);
+				int end = (int) ((int64_t) primCount*(c+1)/chunks);
+
+				for (int i=begin; i<end; i++) {
+					fn(_primitives[i], tiles);
+				}
+			}
+		});
+	};
+
+	_chunkTiles.assign( (size_t) chunks*tileCount, 0 );
+
+	forChunks([&](const Primitive &prim, uint32_t *counts) {
+		this->forEachTile(prim, [&](int t) { counts[t]++; });
+	});
+
+	// Counts to write offsets
+	_tileStart.resize(tileCount + 1);
+	uint32_t sum = 0;
+
+	for (int t=0; t<tileCount; t++) {
+		_tileStart[t] = sum;
+		for (int c=0; c<chunks; c++) {
+			uint32_t &slot = _chunkTiles[ (size_t) c*tileCount + t ];
+			uint32_t count = slot;
+			slot = sum;
+			sum += count;
+		}
+	}
+	_tileStart[tileCount] = sum;
+
+	_binned.resize(sum);
+
+	forChunks([&](const Primitive &prim, uint32_t *cursors) {
+		this->forEachTile(prim, [&](int t) { _binned[ cursors[t]++ ] = prim; });
+	});
+}
+
+// Later primitives draw over earlier ones
+void DebugDraw::drawTile(Color *data, const float *depth, int tx, int ty) const {
+	int X0 = tx*DEBUG_TILE;
+	int Y0 = ty*DEBUG_TILE;
+	int X1 = std::min(_w, X0 + DEBUG_TILE);
+	int Y1 = std::min(_h, Y0 + DEBUG_TILE);
+
+	int t = ty*tilesX + tx;
+	for (uint32_t i=_tileStart[t]; i<_tileStart[t + 1]; i++) {
+		const Primitive &prim = _binned[i];
+
+		if (prim.shape == Shape::POINT) {
+			drawPoint(data, _w, prim.a, prim.radius, prim.color, X0, Y0, X1, Y1);
+		}
+		else {
+			const float *lineDepth = prim.depthTest ? depth : nullptr;
+			drawLine(data, lineDepth, _w, prim.a, prim.b, prim.slope, prim.depth, prim.depthSlope, prim.shape == Shape::LINE_Y, prim.color, X0, Y0, X1, Y1);
+		}
+	}
+}
@@ -0,0 +1,117 @@
+// Batched debug overlay, primitives are recorded during the frame and drawn in one pass after shading
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../math/vec.hpp"
+#include "../math/color.hpp"
+#include "../core/threadpool.hpp"
+#include "surface.hpp"
+
+
+#define DEBUG_TILE 64			// Tile size in pixels
+#define DEBUG_BIN_CHUNK 4096	// Min primitives a binning task takes
+#define DEBUG_DEPTH_BIAS 0.01F	// Relative 1/w slack of depth tested lines, edges sit on their own surface
+
+
+/*
+Liang-Barsky, clips the segment a-b to the rectangle [x0, x1] x [y0, y1].
+Returns false when nothing of it is inside
+*/
+bool clipLine(Vec2 &a, Vec2 &b, float x0, float y0, float x1, float y1);
+
+
+class DebugDraw {
+	// Constructors / Destructors
+	public:
+		DebugDraw();
+		~DebugDraw();
+
+	private:
+		enum class Shape : uint8_t {
+			NONE,	// Clipped away by lines(), bins nowhere
+			POINT,	// Disc of `radius` pixels around `a`
+			LINE_X,	// One pixel per column, x is the major axis
+			LINE_Y,	// One pixel per row, stored with x and y swapped
+		};
+
+		// Lines are clipped to the screen when recorded and stored along their major axis,
+		// `a` is the end with the smaller major coordinate
+		struct Primitive {
+			Vec2 a;
+			Vec2 b;
+			Color color;
+			float slope;		// Minor axis step per pixel of a line
+			float depth;		// 1/w at `a`
+			float depthSlope;	// 1/w step per pixel
+			int radius;
+			Shape shape;
+			bool depthTest;		// Hidden behind the depth buffer of draw()
+		};
+
+	// Attributes
+	public:
+		int tilesX;
+		int tilesY;
+
+	private:
+		int _w;
+		int _h;
+		glm::mat4 _projMat;
+
+		std::vector<Primitive> _primitives;	// In recording order
+
+		// Copies of the primitives sorted by tile, a tile reads one contiguous range
+		std::vector<Primitive> _binned;
+		std::vector<uint32_t> _tileStart;	// tilesX*tilesY + 1 offsets into `_binned`
+		std::vector<uint32_t> _chunkTiles;	// Per chunk and tile counts, then write offsets
+
+	// Methods
+	public:
+		// Drops the recorded primitives, the next ones are for a w x h screen
+		void begin(int w, int h, const glm::mat4 &projMat);
+
+		size_t count() const { return _primitives.size(); }
+
+		// Screen space (pixels)
+		void point(const Vec2 &p, int radius, const Color &color);
+		void line(const Vec2 &a, const Vec2 &b, const Color &color);
+		void rect(const Vec2 &min, const Vec2 &max, const Color &color);
+
+		// View space, projected with the matrix of begin(). Clipped at the camera plane
+		void point3D(const Vec3 &p, int radius, const Color &color);
+		void line3D(const Vec3 &a, const Vec3 &b, const Color &color);
+		void normal(const Vec3 &p, const Vec3 &n, float length, const Color &color);
+
+		// The 12 edges of the box `min`-`max` (model space), placed by `modelView`
+		void aabb(const glm::mat4 &modelView, const Vec3 &min, const Vec3 &max, const Color &color);
+
+		/*
+		Whole meshes, edge i joins clipVerts[ edges[2*i] ] and clipVerts[ edges[2*i + 1] ]
+		(clip space, after the projection). Set up in parallel.
+		With `depthTest` they are hidden behind the depth buffer given to draw()
+		*/
+		void lines(const Vec4 *clipVerts, const uint32_t *edges, int count, const Color &color, bool depthTest, ThreadPool &pool);
+
+		/*
+		Bins the primitives into tiles and draws the tiles in parallel.
+		`depth` (1/w, larger is closer) hides the depth tested lines, all draw without it
+		*/
+		void draw(Surface &surface, ThreadPool &pool, const float *depth = nullptr);
+
+	private:
+		// Clips and projects a clip space line, Shape::NONE when nothing is left
+		Primitive clipSpaceLine(Vec4 ca, Vec4 cb, const Color &color, bool depthTest) const;
+
+		// Clips a screen space line with 1/w at its ends, Shape::NONE when nothing is left
+		Primitive screenLine(Vec2 a, Vec2 b, float za, float zb, const Color &color, bool depthTest) const;
+
+		void bin(ThreadPool &pool);
+		void drawTile(Color *data, const float *depth, int tx, int ty) const;
+
+		// Calls fn(tile) for every tile `prim` touches
+		template <typename Fn>
+		void forEachTile(const Primitive &prim, Fn &&fn) const;
+};
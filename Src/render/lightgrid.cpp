@@ -0,0 +1,172 @@
+#include <cmath>
+#include <algorithm>
+
+#include "lightgrid.hpp"
+
+
+// Constructors and Destructors
+LightGrid::LightGrid() {
+	tilesX = 0;
+	tilesY = 0;
+	_w = 0;
+	_h = 0;
+}
+
+LightGrid::~LightGrid() {
+}
+
+
+// Methods
+void LightGrid::resize(int w, int h) {
+	_w = w;
+	_h = h;
+	tilesX = (w + LIGHT_TILE-1) / LIGHT_TILE;
+	tilesY = (h + LIGHT_TILE-1) / LIGHT_TILE;
+
+	tiles.resize(tilesX*tilesY);
+	_tileMin.resize(tilesX*tilesY);
+	_tileMax.resize(tilesX*tilesY);
+}
+
+void LightGrid::build(const Light *lights, int count, const float *depthBuffer, const glm::mat4 &projMat, bool cull, ThreadPool &pool) {
+	global.clear();
+	for (std::vector<uint32_t> &tile : tiles) {
+		tile.clear();
+	}
+
+	for (int i=0; i<count; i++) {
+		if (lights[i].type == LightType::DIRECTIONAL || !cull) {
+			global.push_back(i);
+		}
+	}
+
+	if ( !cull ) return;
+
+	this->computeBounds(lights, count, projMat);
+	this->computeTileDepth(depthBuffer, pool);
+
+	// Every tile tests every local light, tile rows in parallel
+	pool.parallelFor(tilesY, 1, [&](int tyBegin, int tyEnd) {
+		for (int ty=tyBegin; ty<tyEnd; ty++) {
+			for (int tx=0; tx<tilesX; tx++) {
+				int t = ty*tilesX + tx;
+				float tMin = _tileMin[t];
+				float tMax = _tileMax[t];
+
+				// Nothing drawn in this tile
+				if (tMin > tMax) continue;
+
+				std::vector<uint32_t> &tile = tiles[t];
+
+				for (int i=0; i<count; i++) {
+					const Bounds &b = _bounds[i];
+
+					if (tx < b.tx0 || tx > b.tx1 || ty < b.ty0 || ty > b.ty1) continue;
+					if (b.invWMax < tMin || b.invWMin > tMax) continue;
+
+					tile.push_back(i);
+				}
+			}
+		}
+	});
+}
+
+// Conservative tile rectangle and depth range of every local light
+void LightGrid::computeBounds(const Light *lights, int count, const glm::mat4 &projMat) {
+	_bounds.resize(count);
+
+	for (int i=0; i<count; i++) {
+		const Light &light = lights[i];
+		Bounds &b = _bounds[i];
+
+		// Directional lights are in `global`, this range never overlaps
+		if (light.type == LightType::DIRECTIONAL) {
+			b = {1, 1, 0, 0, 1.f, 0.f};
+			continue;
+		}
+
+		const Vec3 &p = light.position;
+		float r = light.range;
+
+		// Entirely behind the camera
+		if (p.z - r >= 0.f) {
+			b = {1, 1, 0, 0, 1.f, 0.f};
+			continue;
+		}
+
+		// View looks down -z, so w = -z
+		b.invWMin = 1.f / -(p.z - r);
+		b.invWMax = (p.z + r < 0.f) ? 1.f / -(p.z + r) : INFINITY;
+
+		// Crosses the camera plane, could be anywhere on screen
+		if (p.z + r >= 0.f) {
+			b.tx0 = 0;
+			b.ty0 = 0;
+			b.tx1 = tilesX-1;
+			b.ty1 = tilesY-1;
+			continue;
+		}
+
+		// Screen rectangle of the projected bounding box of the sphere
+		float xMin = INFINITY, yMin = INFINITY;
+		float xMax = -INFINITY, yMax = -INFINITY;
+
+		for (int c=0; c<8; c++) {
+			Vec3 corner = p + Vec3( (c&1) ? r : -r, (c&2) ? r : -r, (c&4) ? r : -r );
+			Vec4 clip = projMat * Vec4(corner, 1.f);
+
+			float sx = _w * (1.f + clip.x/clip.w)/2.f;
+			float sy = _h * (1.f - clip.y/clip.w)/2.f;
+
+			xMin = std::min(xMin, sx);
+			xMax = std::max(xMax, sx);
+			yMin = std::min(yMin, sy);
+			yMax = std::max(yMax, sy);
+		}
+
+		// Clamped first, huge values would overflow the int
+		xMin = std::clamp(xMin, -1.f, (float) _w);
+		xMax = std::clamp(xMax, -1.f, (float) _w);
+		yMin = std::clamp(yMin, -1.f, (float) _h);
+		yMax = std::clamp(yMax, -1.f, (float) _h);
+
+		b.tx0 = std::max(0, (int) std::floor(xMin) / LIGHT_TILE);
+		b.ty0 = std::max(0, (int) std::floor(yMin) / LIGHT_TILE);
+		b.tx1 = std::min(tilesX-1, (int) std::floor(xMax) / LIGHT_TILE);
+		b.ty1 = std::min(tilesY-1, (int) std::floor(yMax) / LIGHT_TILE);
+	}
+}
+
+// 1/w range of the covered pixels of every tile
+void LightGrid::computeTileDepth(const float *depthBuffer, ThreadPool &pool) {
+	if (depthBuffer == nullptr) {
+		std::fill(_tileMin.begin(), _tileMin.end(), 0.f);
+		std::fill(_tileMax.begin(), _tileMax.end(), INFINITY);
+		return;
+	}
+
+	pool.parallelFor(tilesY, 1, [&](int tyBegin, int tyEnd) {
+		for (int ty=tyBegin; ty<tyEnd; ty++) {
+			for (int tx=0; tx<tilesX; tx++) {
+				float tMin = INFINITY;
+				float tMax = 0.f;
+
+				int yEn = std::min(_h, (ty+1)*LIGHT_TILE);
+				int xEn = std::min(_w, (tx+1)*LIGHT_TILE);
+
+				for (int y=ty*LIGHT_TILE; y<yEn; y++) {
+					for (int x=tx*LIGHT_TILE; x<xEn; x++) {
+						float z = depthBuffer[y*_w + x];
+						if (z <= 0.f) continue;
+
+						tMin = std::min(tMin, z);
+						tMax = std::max(tMax, z);
+					}
+				}
+
+				_tileMin[ty*tilesX + tx] = tMin;
+				_tileMax[ty*tilesX + tx] = tMax;
+			}
+		}
+	});
+}
@@ -0,0 +1,66 @@
+// Per screen tile light lists (tiled light culling)
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "../math/vec.hpp"
+#include "../scene/light.hpp"
+#include "../core/threadpool.hpp"
+
+
+#define LIGHT_TILE 16	// Tile size in pixels
+
+
+class LightGrid {
+	// Constructors / Destructors
+	public:
+		LightGrid();
+		~LightGrid();
+
+	// Attributes
+	public:
+		int tilesX;
+		int tilesY;
+
+		std::vector<uint32_t> global;				// Lights reaching every tile (directional)
+		std::vector< std::vector<uint32_t> > tiles;	// Local lights of each tile
+
+	private:
+		int _w;
+		int _h;
+
+		// Screen space bounds of a local light
+		struct Bounds {
+			int tx0, ty0, tx1, ty1;		// Tile rectangle, inclusive
+			float invWMin, invWMax;		// 1/w range
+		};
+		std::vector<Bounds> _bounds;
+		std::vector<float> _tileMin;	// 1/w range of the covered pixels of a tile
+		std::vector<float> _tileMax;
+
+	// Methods
+	public:
+		void resize(int w, int h);
+
+		/*
+		Bins `lights` (view space) into the tiles they can reach.
+		With a `depthBuffer` (1/w, 0 = empty) tiles also cull by their depth range
+		and empty tiles get no lights, without one only the screen rectangle is used.
+		With `cull` off every light lands in every tile.
+		*/
+		void build(const Light *lights, int count, const float *depthBuffer, const glm::mat4 &projMat, bool cull, ThreadPool &pool);
+
+		// Pixels off screen use the closest tile
+		const std::vector<uint32_t> &tileLights(int x, int y) const {
+			x = std::max(0, std::min(_w-1, x));
+			y = std::max(0, std::min(_h-1, y));
+			return tiles[ (y/LIGHT_TILE)*tilesX + x/LIGHT_TILE ];
+		}
+
+	private:
+		void computeBounds(const Light *lights, int count, const glm::mat4 &projMat);
+		void computeTileDepth(const float *depthBuffer, ThreadPool &pool);
+};
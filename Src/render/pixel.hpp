@@ -0,0 +1,230 @@
+// Pixel formats of SurfaceT, how a Color is stored in the framebuffer
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <bit>
+#include <algorithm>
+
+#include "../math/color.hpp"
+
+
+/*
+Every format is a class with
+	Type                   : one stored pixel
+	SRGB                   : the storage applies the sRGB transfer itself, tonemapping skips the gamma
+	FLOAT                  : floating point storage, tonemapped in place without banding
+	encode(const Color &)  : Color to stored pixel, clamped to the range of the format
+	decode(const Type &)   : stored pixel to Color
+*/
+
+
+// ------ Half floats (IEEE 754 binary16) ------
+
+// Rounds to nearest even, overflows to infinity
+inline uint16_t floatToHalf(float f) {
+	uint32_t x = std::bit_cast<uint32_t>(f);
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t mant = x & 0x7FFFFF;
+	int exp = (int) ((x >> 23) & 0xFF);
+
+	// Infinity and NaN
+	if (exp == 0xFF) return sign | 0x7C00 | (mant ? 0x200 : 0);
+
+	exp += 15 - 127;
+	if (exp >= 31) return sign | 0x7C00;
+
+	// Subnormal halves
+	if (exp <= 0) {
+		if (exp < -10) return sign;
+
+		mant |= 0x800000;
+		int shift = 14 - exp;
+		uint32_t half = mant >> shift;
+		uint32_t rest = mant & ((1u << shift) - 1);
+		uint32_t mid = 1u << (shift - 1);
+
+		if (rest > mid || (rest == mid && (half & 1))) half++;
+		return sign | half;
+	}
+
+	// The rounding carry runs into the exponent, up to infinity
+	uint32_t half = sign | (exp << 10) | (mant >> 13);
+	uint32_t rest = mant & 0x1FFF;
+
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+	return half;
+}
+
+inline float halfToFloat(uint16_t h) {
+	uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+	uint32_t exp = (h >> 10) & 0x1F;
+	uint32_t mant = h & 0x3FF;
+
+	if (exp == 0) {
+		float f = mant * (1.f/16777216.f);	// mant * 2^-24
+		return sign ? -f : f;
+	}
+
+	if (exp == 31) return std::bit_cast<float>(sign | 0x7F800000 | (mant << 13));
+
+	return std::bit_cast<float>(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+
+// ------ sRGB transfer ------
+
+inline float linearToSRGB(float c) {
+	return (c <= 0.0031308f) ? 12.92f*c : 1.055f*std::pow(c, 1.f/2.4f) - 0.055f;
+}
+
+inline float srgbToLinear(float c) {
+	return (c <= 0.04045f) ? c/12.92f : std::pow((c + 0.055f)/1.055f, 2.4f);
+}
+
+
+// ------ Formats ------
+
+// 3 x 32 bit float, 12 bytes, HDR
+class PixelRGB32F {
+	public:
+		using Type = Color;
+		static constexpr bool SRGB = false;
+		static constexpr bool FLOAT = true;
+
+		static Type encode(const Color &c) { return c; }
+		static Color decode(const Type &p) { return p; }
+};
+
+
+class Half4 {
+	public:
+		uint16_t r, g, b, a;
+};
+
+// 4 x 16 bit float, 8 bytes, HDR up to 65504
+class PixelRGBA16F {
+	public:
+		using Type = Half4;
+		static constexpr bool SRGB = false;
+		static constexpr bool FLOAT = true;
+
+		static Type encode(const Color &c) {
+			return { floatToHalf(c.r), floatToHalf(c.g), floatToHalf(c.b), 0x3C00 };	// alpha 1
+		}
+
+		static Color decode(const Type &p) {
+			return Color( halfToFloat(p.r), halfToFloat(p.g), halfToFloat(p.b) );
+		}
+};
+
+
+// 10 bit unorm r, g, b and 2 bit alpha in one uint32_t, 4 bytes, [0, 1]
+class PixelRGB10A2 {
+	public:
+		using Type = uint32_t;
+		static constexpr bool SRGB = false;
+		static constexpr bool FLOAT = false;
+
+		static Type encode(const Color &c) {
+			// Rounded by the +0.5 on the clamped (positive) values, lround does not vectorize
+			uint32_t r = (uint32_t) ( std::clamp(c.r, 0.f, 1.f)*1023.f + 0.5f );
+			uint32_t g = (uint32_t) ( std::clamp(c.g, 0.f, 1.f)*1023.f + 0.5f );
+			uint32_t b = (uint32_t) ( std::clamp(c.b, 0.f, 1.f)*1023.f + 0.5f );
+			return r | (g << 10) | (b << 20) | (3u << 30);
+		}
+
+		static Color decode(const Type &p) {
+			return Color( p & 0x3FF, (p >> 10) & 0x3FF, (p >> 20) & 0x3FF ) * (1.f/1023.f);
+		}
+};
+
+
+class Byte4 {
+	public:
+		uint8_t r, g, b, a;
+};
+
+// 8 bit unorm per channel, 4 bytes, [0, 1]
+class PixelRGBA8 {
+	public:
+		using Type = Byte4;
+		static constexpr bool SRGB = false;
+		static constexpr bool FLOAT = false;
+
+		static Type encode(const Color &c) {
+			return { _unorm8(c.r), _unorm8(c.g), _unorm8(c.b), 0xFF };
+		}
+
+		static Color decode(const Type &p) {
+			return Color(p.r, p.g, p.b) * (1.f/255.f);
+		}
+
+	private:
+		static uint8_t _unorm8(float c) {
+			return (uint8_t) ( std::clamp(c, 0.f, 1.f)*255.f + 0.5f );
+		}
+};
+
+// 8 bit sRGB encoded per channel, 4 bytes, [0, 1] with the precision in the darks
+class PixelSRGBA8 {
+	public:
+		using Type = Byte4;
+		static constexpr bool SRGB = true;
+		static constexpr bool FLOAT = false;
+
+		static Type encode(const Color &c) {
+			return { _srgb8(c.r), _srgb8(c.g), _srgb8(c.b), 0xFF };
+		}
+
+		static Color decode(const Type &p) {
+			const float *lut = _decodeLUT();
+			return Color( lut[p.r], lut[p.g], lut[p.b] );
+		}
+
+	private:
+		static uint8_t _srgb8(float c) {
+			return (uint8_t) std::lround( linearToSRGB( std::clamp(c, 0.f, 1.f) )*255.f );
+		}
+
+		static const float *_decodeLUT() {
+			static const struct Table {
+				float v[256];
+				Table() { for (int i=0; i<256; i++) v[i] = srgbToLinear(i/255.f); }
+			} table;
+			return table.v;
+		}
+};
+
+
+// ------ Runtime selection ------
+
+// Formats SURFACE_FORMAT chooses from
+enum class PixelFormat {
+	RGB32F,
+	RGBA16F,
+	RGB10A2,
+	RGBA8,
+	SRGBA8,
+};
+
+inline bool parsePixelFormat(const std::string &name, PixelFormat &format) {
+	if (name == "rgb32f") format = PixelFormat::RGB32F;
+	else if (name == "rgba16f") format = PixelFormat::RGBA16F;
+	else if (name == "rgb10a2") format = PixelFormat::RGB10A2;
+	else if (name == "rgba8") format = PixelFormat::RGBA8;
+	else if (name == "srgba8") format = PixelFormat::SRGBA8;
+	else return false;
+
+	return true;
+}
+
+inline int pixelBytes(PixelFormat format) {
+	switch (format) {
+		case PixelFormat::RGB32F:  return sizeof(PixelRGB32F::Type);
+		case PixelFormat::RGBA16F: return sizeof(PixelRGBA16F::Type);
+		default:                   return 4;
+	}
+}
@@ -0,0 +1,125 @@
+#include "raster.hpp"
+
+
+void rasterTrisID(uint32_t *idBuffer, float *depthBuffer, int w, int h, const Tris2D_p &tris, uint32_t id, PipelineStats &stats) {
+	const Vec4 &a = tris.v1;
+	const Vec4 &b = tris.v2;
+	const Vec4 &c = tris.v3;
+
+	if (a.w <= 0.f || b.w <= 0.f || c.w <= 0.f) return;
+
+	float area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	if (std::abs(area) < 1E-8F) return;
+	float invArea = 1.f/area;
+
+	int xSt = std::max(0, (int) std::floor( std::min({a.x, b.x, c.x}) ));
+	int ySt = std::max(0, (int) std::floor( std::min({a.y, b.y, c.y}) ));
+	int xEn = std::min(w-1, (int) std::ceil( std::max({a.x, b.x, c.x}) ));
+	int yEn = std::min(h-1, (int) std::ceil( std::max({a.y, b.y, c.y}) ));
+
+	if (xSt > xEn || ySt > yEn) return;
+
+	float dl0dx = -(c.y - b.y)*invArea,  dl0dy = (c.x - b.x)*invArea;
+	float dl1dx = -(a.y - c.y)*invArea,  dl1dy = (a.x - c.x)*invArea;
+	float dl2dx = -(b.y - a.y)*invArea,  dl2dy = (b.x - a.x)*invArea;
+
+	// 1/w is linear in screen space too
+	float dzdx = dl0dx*a.w + dl1dx*b.w + dl2dx*c.w;
+	float dzdy = dl0dy*a.w + dl1dy*b.w + dl2dy*c.w;
+
+	float px = xSt + 0.5f;
+	float py = ySt + 0.5f;
+	float l0Row = ( (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x) )*invArea;
+	float l1Row = ( (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x) )*invArea;
+	float l2Row = ( (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x) )*invArea;
+	float zRow  = l0Row*a.w + l1Row*b.w + l2Row*c.w;
+
+	uint32_t tested = 0, written = 0;
+
+	for (int y=ySt; y<=yEn; y++) {
+		float l0 = l0Row;
+		float l1 = l1Row;
+		float l2 = l2Row;
+		float z = zRow;
+
+		uint32_t *idRow = idBuffer + y*w;
+		float *depthRow = depthBuffer + y*w;
+
+		for (int x=xSt; x<=xEn; x++) {
+			if (l0 >= 0.f && l1 >= 0.f && l2 >= 0.f) {
+				tested++;
+
+				if (z > depthRow[x]) {
+					depthRow[x] = z;
+					idRow[x] = id;
+					written++;
+				}
+			}
+
+			l0 += dl0dx;
+			l1 += dl1dx;
+			l2 += dl2dx;
+			z  += dzdx;
+		}
+
+		l0Row += dl0dy;
+		l1Row += dl1dy;
+		l2Row += dl2dy;
+		zRow  += dzdy;
+	}
+
+	stats.raster(tested, written, 0);
+}
+
+void rasterTrisDepth(float *depthBuffer, int w, int h, const Tris2D_p &tris) {
+	const Vec4 &a = tris.v1;
+	const Vec4 &b = tris.v2;
+	const Vec4 &c = tris.v3;
+
+	if (a.w <= 0.f || b.w <= 0.f || c.w <= 0.f) return;
+
+	float area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	if (std::abs(area) < 1E-8F) return;
+	float invArea = 1.f/area;
+
+	int xSt = std::max(0, (int) std::floor( std::min({a.x, b.x, c.x}) ));
+	int ySt = std::max(0, (int) std::floor( std::min({a.y, b.y, c.y}) ));
+	int xEn = std::min(w-1, (int) std::ceil( std::max({a.x, b.x, c.x}) ));
+	int yEn = std::min(h-1, (int) std::ceil( std::max({a.y, b.y, c.y}) ));
+
+	if (xSt > xEn || ySt > yEn) return;
+
+	float dl0dx = -(c.y - b.y)*invArea,  dl0dy = (c.x - b.x)*invArea;
+	float dl1dx = -(a.y - c.y)*invArea,  dl1dy = (a.x - c.x)*invArea;
+	float dl2dx = -(b.y - a.y)*invArea,  dl2dy = (b.x - a.x)*invArea;
+
+	float px = xSt + 0.5f;
+	float py = ySt + 0.5f;
+	float l0Row = ( (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x) )*invArea;
+	float l1Row = ( (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x) )*invArea;
+	float l2Row = ( (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x) )*invArea;
+
+	for (int y=ySt; y<=yEn; y++) {
+		float l0 = l0Row;
+		float l1 = l1Row;
+		float l2 = l2Row;
+
+		float *depthRow = depthBuffer + y*w;
+
+		// z is not stepped incrementally, rasterTris() reproduces it up to DEPTH_EQUAL_BIAS for DepthMode::EQUAL
+		for (int x=xSt; x<=xEn; x++) {
+			float z = l0*a.w + l1*b.w + l2*c.w;
+			if (l0 >= 0.f && l1 >= 0.f && l2 >= 0.f && z > depthRow[x]) {
+				depthRow[x] = z;
+			}
+
+			l0 += dl0dx;
+			l1 += dl1dx;
+			l2 += dl2dx;
+		}
+
+		l0Row += dl0dy;
+		l1Row += dl1dy;
+		l2Row += dl2dy;
+	}
+}
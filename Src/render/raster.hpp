@@ -0,0 +1,627 @@
+// Triangle rasterizer, specialized at compile time for every shader and state combination
+
+#pragma once
+
+#include <cmath>
+#include <bit>
+#include <cstdint>
+#include <algorithm>
+
+#include "../math/vec.hpp"
+#include "../math/color.hpp"
+#include "../primitives/tris.hpp"
+#include "surface.hpp"
+#include "state.hpp"
+#include "stats.hpp"
+
+
+#define VISIBILITY_EMPTY 0xFFFFFFFFu	// ID of pixels not covered by any triangle
+#define DEPTH_EQUAL_BIAS 1E-5F		// Relative slack of DepthMode::EQUAL, FMA contraction rounds z differently in each pass
+
+
+// Interpolants passed from the vertex shader to the fragment shader
+enum Varying : uint32_t {
+	VARYING_NONE   = 0,
+	VARYING_NORMAL = 1 << 0,
+	VARYING_UV     = 1 << 1,
+	VARYING_COLOR  = 1 << 2,
+	VARYING_POSITION = 1 << 3,	// View space position
+};
+
+class Varyings {
+	public:
+		Vec3 normal;
+		Vec2 uv;
+		Color color;
+		Vec3 position;
+
+		int px, py;		// Pixel being shaded, always set
+};
+
+
+// Fragment shaders with a quad() entry point run on 2x2 pixel quads, lanes (x, y), (x+1, y), (x, y+1), (x+1, y+1):
+// void quad(const Varyings in[4], uint32_t mask, Color out[4]) const, lanes outside `mask` are helpers
+template <typename FragmentShader>
+concept QuadShader = requires (const FragmentShader &fs, const Varyings *in, Color *out) {
+	fs.quad(in, 0u, out);
+};
+
+// Perspective corrected varyings from the weights of the corners times their 1/w
+template <uint32_t INPUTS>
+inline void interpolate(const Varyings vary[3], float p0, float p1, float p2, Varyings &in) {
+	float invSum = 1.f/(p0 + p1 + p2);
+	p0 *= invSum;
+	p1 *= invSum;
+	p2 *= invSum;
+
+	if constexpr ((INPUTS & VARYING_NORMAL) != 0) in.normal = p0*vary[0].normal + p1*vary[1].normal + p2*vary[2].normal;
+	if constexpr ((INPUTS & VARYING_UV)     != 0) in.uv     = p0*vary[0].uv     + p1*vary[1].uv     + p2*vary[2].uv;
+	if constexpr ((INPUTS & VARYING_COLOR)  != 0) in.color  = p0*vary[0].color  + p1*vary[1].color  + p2*vary[2].color;
+	if constexpr ((INPUTS & VARYING_POSITION) != 0) in.position = p0*vary[0].position + p1*vary[1].position + p2*vary[2].position;
+}
+
+// Vertex stage, the corners of a clipped triangle blend the varyings of the corners of its source triangle
+template <uint32_t INPUTS, typename VertexShader>
+inline void vertexStage(const Tris2D_p &tris, const VertexShader &vs, Varyings vary[3]) {
+	vs(0, vary[0]);
+	vs(1, vary[1]);
+	vs(2, vary[2]);
+	if (!tris.clipped) return;
+
+	// Clip space weights, the varyings are linear there
+	const Varyings source[3] = {vary[0], vary[1], vary[2]};
+	for (int k=0; k<3; k++) {
+		const Vec3 &l = tris.weights[k];
+		interpolate<INPUTS>(source, l.x, l.y, l.z, vary[k]);
+	}
+}
+
+/*
+A QuadShader on a single pixel of screen space weights `l`, the pixel is lane 0 and the
+other lanes are helpers a pixel to the right and below, only there for the derivatives
+*/
+template <typename FragmentShader>
+inline Color shadeAsQuad(const FragmentShader &fs, const Varyings vary[3], const Tris2D_p &tris, const Vec3 &l, const Vec3 &dldx, const Vec3 &dldy, int x, int y) {
+	Varyings in[4];
+	for (int k=0; k<4; k++) {
+		Vec3 m = l;
+		if (k & 1) m += dldx;
+		if (k & 2) m += dldy;
+
+		in[k].px = x + (k & 1);
+		in[k].py = y + (k >> 1);
+		interpolate<FragmentShader::INPUTS>(vary, m.x*tris.v1.w, m.y*tris.v2.w, m.z*tris.v3.w, in[k]);
+	}
+
+	Color out[4];
+	fs.quad(in, 1u, out);
+	return out[0];
+}
+
+
+/*
+rasterTris() of a QuadShader, the bounding box is walked by 2x2 pixel quads aligned on
+even pixels. Lanes outside the triangle or the box still get (extrapolated) varyings for
+the derivatives of the others. The edge functions are stepped pixel by pixel from the
+corner of the box like rasterTrisDepth()
+*/
+template <typename State, typename VertexShader, typename FragmentShader, typename Format>
+requires QuadShader<FragmentShader>
+void rasterTris(SurfaceT<Format> &surface, float *depthBuffer, const Tris2D_p &tris, const VertexShader &vs, const FragmentShader &fs, PipelineStats &stats) {
+	constexpr uint32_t INPUTS = FragmentShader::INPUTS;
+	constexpr bool DEPTH = (State::DEPTH != DepthMode::NONE);
+
+	const Vec4 &a = tris.v1;
+	const Vec4 &b = tris.v2;
+	const Vec4 &c = tris.v3;
+
+	if (a.w <= 0.f || b.w <= 0.f || c.w <= 0.f) return;
+
+	float area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	if (std::abs(area) < 1E-8F) return;
+	float invArea = 1.f/area;
+
+	int xSt = std::max(0, (int) std::floor( std::min({a.x, b.x, c.x}) ));
+	int ySt = std::max(0, (int) std::floor( std::min({a.y, b.y, c.y}) ));
+	int xEn = std::min(surface.surfWidth-1,  (int) std::ceil( std::max({a.x, b.x, c.x}) ));
+	int yEn = std::min(surface.surfHeight-1, (int) std::ceil( std::max({a.y, b.y, c.y}) ));
+
+	if (xSt > xEn || ySt > yEn) return;
+
+	Varyings vary[3];
+	vertexStage<INPUTS>(tris, vs, vary);
+
+	Vec3 dldx( -(c.y - b.y)*invArea, -(a.y - c.y)*invArea, -(b.y - a.y)*invArea );
+	Vec3 dldy( (c.x - b.x)*invArea, (a.x - c.x)*invArea, (b.x - a.x)*invArea );
+
+	float px = xSt + 0.5f;
+	float py = ySt + 0.5f;
+	Vec3 lStart(
+		( (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x) )*invArea,
+		( (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x) )*invArea,
+		( (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x) )*invArea
+	);
+
+	auto *data = surface.data();
+	int w = surface.surfWidth;
+
+	uint32_t tested = 0, written = 0;
+
+	// Weights at the first column of both rows of the quad row, a row above the box is a helper
+	Vec3 rows[2];
+	if (ySt & 1) {
+		rows[1] = lStart;
+		rows[0] = lStart - dldy;
+	}
+	else {
+		rows[0] = lStart;
+		rows[1] = lStart + dldy;
+	}
+
+	for (int y=(ySt & ~1); y<=yEn; y+=2) {
+		// Weights of the lanes, [row][column]
+		Vec3 lanes[2][2];
+		for (int r=0; r<2; r++) {
+			if (xSt & 1) {
+				lanes[r][1] = rows[r];
+				lanes[r][0] = rows[r] - dldx;
+			}
+			else {
+				lanes[r][0] = rows[r];
+				lanes[r][1] = rows[r] + dldx;
+			}
+		}
+
+		for (int x=(xSt & ~1); x<=xEn; x+=2) {
+			uint32_t mask = 0;
+			float z[4] = {};
+
+			for (int k=0; k<4; k++) {
+				int lx = x + (k & 1);
+				int ly = y + (k >> 1);
+				const Vec3 &l = lanes[k >> 1][k & 1];
+
+				if (lx < xSt || lx > xEn || ly < ySt || ly > yEn) continue;
+				if (l.x < 0.f || l.y < 0.f || l.z < 0.f) continue;
+				tested++;
+
+				if constexpr (DEPTH) {
+					z[k] = l.x*a.w + l.y*b.w + l.z*c.w;
+					float d = depthBuffer[ly*w + lx];
+
+					if constexpr (State::DEPTH == DepthMode::EQUAL) {
+						if (z[k] < d*(1.f - DEPTH_EQUAL_BIAS)) continue;
+					}
+					else {
+						if (z[k] <= d) continue;
+					}
+				}
+
+				mask |= 1u << k;
+			}
+
+			if (mask != 0) {
+				written += std::popcount(mask);
+
+				Varyings in[4];
+				for (int k=0; k<4; k++) {
+					const Vec3 &l = lanes[k >> 1][k & 1];
+					in[k].px = x + (k & 1);
+					in[k].py = y + (k >> 1);
+					interpolate<INPUTS>(vary, l.x*a.w, l.y*b.w, l.z*c.w, in[k]);
+				}
+
+				Color out[4];
+				fs.quad(in, mask, out);
+
+				for (int k=0; k<4; k++) {
+					if ((mask & (1u << k)) == 0) continue;
+					int i = (y + (k >> 1))*w + x + (k & 1);
+
+					if constexpr (State::BLEND == BlendMode::ADDITIVE) {
+						data[i] = Format::encode( Format::decode(data[i]) + out[k] );
+					}
+					else {
+						data[i] = Format::encode(out[k]);
+					}
+
+					if constexpr (State::DEPTH == DepthMode::TEST_WRITE) {
+						depthBuffer[i] = z[k];
+					}
+				}
+			}
+
+			for (int r=0; r<2; r++) {
+				lanes[r][0] = lanes[r][1] + dldx;
+				lanes[r][1] = lanes[r][0] + dldx;
+			}
+		}
+
+		rows[0] = rows[1] + dldy;
+		rows[1] = rows[0] + dldy;
+	}
+
+	stats.raster(tested, written, written);
+}
+
+
+/*
+Edge function rasterizer
+
+VertexShader   : void operator()(int corner, Varyings &out) const
+	Fills the varyings of corner 0, 1, 2 of the triangle
+FragmentShader : Color operator()(const Varyings &in) const
+	`FragmentShader::INPUTS` is a mask of the Varying it reads, the others
+	are neither interpolated nor perspective corrected.
+	A QuadShader goes through the quad overload instead
+State          : RasterState<DepthMode, BlendMode>
+Format         : pixel format of the surface, colours are encoded on write
+                 (and decoded first for blending), a no-op for PixelRGB32F
+
+Varyings are interpolated with perspective corrected (1/w) barycentrics.
+The depth buffer holds 1/w, which is linear in screen space and keeps its
+precision whatever the clip planes are, larger values are closer (clear to 0).
+`depthBuffer` is only touched when State::DEPTH != DepthMode::NONE.
+The pixels and the culling of the triangle are counted in `stats`, the ones of the frame it draws
+*/
+template <typename State, typename VertexShader, typename FragmentShader, typename Format>
+requires (!QuadShader<FragmentShader>)
+void rasterTris(SurfaceT<Format> &surface, float *depthBuffer, const Tris2D_p &tris, const VertexShader &vs, const FragmentShader &fs, PipelineStats &stats) {
+	constexpr uint32_t INPUTS = FragmentShader::INPUTS;
+	constexpr bool PERSPECTIVE = (INPUTS != VARYING_NONE);
+	constexpr bool DEPTH = (State::DEPTH != DepthMode::NONE);
+
+	const Vec4 &a = tris.v1;
+	const Vec4 &b = tris.v2;
+	const Vec4 &c = tris.v3;
+
+	// Behind the camera, project() clips the triangles against the near plane before they get here
+	if (a.w <= 0.f || b.w <= 0.f || c.w <= 0.f) return;
+
+	// Twice the signed area, sign depends on the winding
+	float area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	if (std::abs(area) < 1E-8F) return;
+	float invArea = 1.f/area;
+
+	int xSt = std::max(0, (int) std::floor( std::min({a.x, b.x, c.x}) ));
+	int ySt = std::max(0, (int) std::floor( std::min({a.y, b.y, c.y}) ));
+	int xEn = std::min(surface.surfWidth-1,  (int) std::ceil( std::max({a.x, b.x, c.x}) ));
+	int yEn = std::min(surface.surfHeight-1, (int) std::ceil( std::max({a.y, b.y, c.y}) ));
+
+	if (xSt > xEn || ySt > yEn) return;
+
+	// Vertex stage
+	Varyings vary[3];
+	if constexpr (PERSPECTIVE) {
+		vertexStage<INPUTS>(tris, vs, vary);
+	}
+
+	// Normalized edge functions, l0 is the weight of `a` (edge b->c) and so on
+	// l(x, y) = l + x*dldx + y*dldy
+	float dl0dx = -(c.y - b.y)*invArea,  dl0dy = (c.x - b.x)*invArea;
+	float dl1dx = -(a.y - c.y)*invArea,  dl1dy = (a.x - c.x)*invArea;
+	float dl2dx = -(b.y - a.y)*invArea,  dl2dy = (b.x - a.x)*invArea;
+
+	float px = xSt + 0.5f;
+	float py = ySt + 0.5f;
+	float l0Row = ( (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x) )*invArea;
+	float l1Row = ( (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x) )*invArea;
+	float l2Row = ( (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x) )*invArea;
+
+	auto *data = surface.data();
+	int w = surface.surfWidth;
+	uint32_t tested = 0, written = 0;
+
+	for (int y=ySt; y<=yEn; y++) {
+		float l0 = l0Row;
+		float l1 = l1Row;
+		float l2 = l2Row;
+
+		auto *row = data + y*w;
+		float *depthRow = DEPTH ? depthBuffer + y*w : nullptr;
+
+		for (int x=xSt; x<=xEn; x++, l0 += dl0dx, l1 += dl1dx, l2 += dl2dx) {
+			if (l0 < 0.f || l1 < 0.f || l2 < 0.f) continue;
+			tested++;
+
+			float z = 0.f;
+			if constexpr (DEPTH) {
+				z = l0*a.w + l1*b.w + l2*c.w;
+				if constexpr (State::DEPTH == DepthMode::EQUAL) {
+					if (z < depthRow[x]*(1.f - DEPTH_EQUAL_BIAS)) continue;
+				}
+				else {
+					if (z <= depthRow[x]) continue;
+				}
+			}
+
+			written++;
+
+			Varyings in;
+			in.px = x;
+			in.py = y;
+
+			if constexpr (PERSPECTIVE) {
+				interpolate<INPUTS>(vary, l0*a.w, l1*b.w, l2*c.w, in);
+			}
+
+			Color color = fs(in);
+
+			if constexpr (State::BLEND == BlendMode::ADDITIVE) {
+				row[x] = Format::encode( Format::decode(row[x]) + color );
+			}
+			else {
+				row[x] = Format::encode(color);
+			}
+
+			if constexpr (State::DEPTH == DepthMode::TEST_WRITE) {
+				depthRow[x] = z;
+			}
+		}
+
+		l0Row += dl0dy;
+		l1Row += dl1dy;
+		l2Row += dl2dy;
+	}
+
+	stats.raster(tested, written, written);
+}
+
+
+// Sample positions of MSAA, relative to the pixel center (the standard 1/16th pixel grid patterns)
+template <int SAMPLES> class SamplePattern;
+
+template <> class SamplePattern<2> {
+	public:
+		static constexpr float OFFSETS[2][2] = {
+			{ 4/16.f,  4/16.f}, {-4/16.f, -4/16.f},
+		};
+};
+
+template <> class SamplePattern<4> {
+	public:
+		static constexpr float OFFSETS[4][2] = {
+			{-2/16.f, -6/16.f}, { 6/16.f, -2/16.f}, {-6/16.f,  2/16.f}, { 2/16.f,  6/16.f},
+		};
+};
+
+template <> class SamplePattern<8> {
+	public:
+		static constexpr float OFFSETS[8][2] = {
+			{ 1/16.f, -3/16.f}, {-1/16.f,  3/16.f}, { 5/16.f,  1/16.f}, {-3/16.f, -5/16.f},
+			{-5/16.f,  5/16.f}, {-7/16.f, -1/16.f}, { 3/16.f,  7/16.f}, { 7/16.f, -7/16.f},
+		};
+};
+
+
+/*
+Multi-sampled rasterTris(), `SAMPLES` colour and depth samples per pixel,
+stored next to each other: sample s of pixel (x, y) is at (y*w + x)*SAMPLES + s.
+
+Coverage and depth are tested per sample, the shaders run once per pixel
+(at the center, or at the first covered sample when the center is outside)
+and the colour goes to every covered sample. DepthMode::EQUAL is not supported.
+*/
+template <int SAMPLES, typename State, typename VertexShader, typename FragmentShader>
+void rasterTrisMS(Color *sampleBuffer, float *depthBuffer, int w, int h, const Tris2D_p &tris, const VertexShader &vs, const FragmentShader &fs, PipelineStats &stats) {
+	static_assert(State::DEPTH != DepthMode::EQUAL, "No depth pre-pass with MSAA");
+
+	constexpr uint32_t INPUTS = FragmentShader::INPUTS;
+	constexpr bool PERSPECTIVE = (INPUTS != VARYING_NONE);
+	constexpr bool DEPTH = (State::DEPTH != DepthMode::NONE);
+	constexpr auto &OFFSETS = SamplePattern<SAMPLES>::OFFSETS;
+
+	const Vec4 &a = tris.v1;
+	const Vec4 &b = tris.v2;
+	const Vec4 &c = tris.v3;
+
+	if (a.w <= 0.f || b.w <= 0.f || c.w <= 0.f) return;
+
+	float area = (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x);
+	if (std::abs(area) < 1E-8F) return;
+	float invArea = 1.f/area;
+
+	int xSt = std::max(0, (int) std::floor( std::min({a.x, b.x, c.x}) ));
+	int ySt = std::max(0, (int) std::floor( std::min({a.y, b.y, c.y}) ));
+	int xEn = std::min(w-1, (int) std::ceil( std::max({a.x, b.x, c.x}) ));
+	int yEn = std::min(h-1, (int) std::ceil( std::max({a.y, b.y, c.y}) ));
+
+	if (xSt > xEn || ySt > yEn) return;
+
+	Varyings vary[3];
+	if constexpr (PERSPECTIVE) {
+		vertexStage<INPUTS>(tris, vs, vary);
+	}
+
+	float dl0dx = -(c.y - b.y)*invArea,  dl0dy = (c.x - b.x)*invArea;
+	float dl1dx = -(a.y - c.y)*invArea,  dl1dy = (a.x - c.x)*invArea;
+	float dl2dx = -(b.y - a.y)*invArea,  dl2dy = (b.x - a.x)*invArea;
+
+	// Edge function offsets of every sample from the pixel center
+	float s0[SAMPLES], s1[SAMPLES], s2[SAMPLES];
+	for (int s=0; s<SAMPLES; s++) {
+		s0[s] = OFFSETS[s][0]*dl0dx + OFFSETS[s][1]*dl0dy;
+		s1[s] = OFFSETS[s][0]*dl1dx + OFFSETS[s][1]*dl1dy;
+		s2[s] = OFFSETS[s][0]*dl2dx + OFFSETS[s][1]*dl2dy;
+	}
+
+	float px = xSt + 0.5f;
+	float py = ySt + 0.5f;
+	float l0Row = ( (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x) )*invArea;
+	float l1Row = ( (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x) )*invArea;
+	float l2Row = ( (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x) )*invArea;
+
+	// Counted by pixel, a pixel is tested when a sample is covered
+	uint32_t tested = 0, written = 0;
+
+	for (int y=ySt; y<=yEn; y++) {
+		float l0 = l0Row;
+		float l1 = l1Row;
+		float l2 = l2Row;
+
+		for (int x=xSt; x<=xEn; x++, l0 += dl0dx, l1 += dl1dx, l2 += dl2dx) {
+			Color *samples = sampleBuffer + (y*w + x)*SAMPLES;
+			float *depths = DEPTH ? depthBuffer + (y*w + x)*SAMPLES : nullptr;
+
+			// Coverage mask, samples inside the triangle and passing the depth test
+			uint32_t mask = 0, covered = 0;
+			float z[SAMPLES] = {};
+
+			for (int s=0; s<SAMPLES; s++) {
+				float m0 = l0 + s0[s];
+				float m1 = l1 + s1[s];
+				float m2 = l2 + s2[s];
+				if (m0 < 0.f || m1 < 0.f || m2 < 0.f) continue;
+				covered = 1;
+
+				if constexpr (DEPTH) {
+					z[s] = m0*a.w + m1*b.w + m2*c.w;
+					if (z[s] <= depths[s]) continue;
+				}
+
+				mask |= 1u << s;
+			}
+
+			tested += covered;
+			if (mask == 0) continue;
+			written++;
+
+			Varyings in;
+			in.px = x;
+			in.py = y;
+
+			// Center of the pixel, unless it lies outside, extrapolated varyings can be way off
+			float p0 = l0, p1 = l1, p2 = l2;
+			if constexpr (PERSPECTIVE) {
+				if (p0 < 0.f || p1 < 0.f || p2 < 0.f) {
+					int s = std::countr_zero(mask);
+					p0 += s0[s];
+					p1 += s1[s];
+					p2 += s2[s];
+				}
+			}
+
+			// Shaded once, stored in every covered sample
+			Color color;
+			if constexpr (QuadShader<FragmentShader>) {
+				color = shadeAsQuad(fs, vary, tris, Vec3(p0, p1, p2), Vec3(dl0dx, dl1dx, dl2dx), Vec3(dl0dy, dl1dy, dl2dy), x, y);
+			}
+			else {
+				if constexpr (PERSPECTIVE) interpolate<INPUTS>(vary, p0*a.w, p1*b.w, p2*c.w, in);
+				color = fs(in);
+			}
+
+			for (int s=0; s<SAMPLES; s++) {
+				if ((mask & (1u << s)) == 0) continue;
+
+				if constexpr (State::BLEND == BlendMode::ADDITIVE) {
+					samples[s] += color;
+				}
+				else {
+					samples[s] = color;
+				}
+
+				if constexpr (State::DEPTH == DepthMode::TEST_WRITE) {
+					depths[s] = z[s];
+				}
+			}
+		}
+
+		l0Row += dl0dy;
+		l1Row += dl1dy;
+		l2Row += dl2dy;
+	}
+
+	stats.raster(tested, written, written);
+}
+
+
+/*
+Runs the shaders of `tris` at the center of pixel (x, y) without touching any buffer,
+used by the shading pass of the visibility buffer to shade each pixel once
+*/
+template <typename VertexShader, typename FragmentShader>
+Color shadePixel(const Tris2D_p &tris, int x, int y, const VertexShader &vs, const FragmentShader &fs) {
+	constexpr uint32_t INPUTS = FragmentShader::INPUTS;
+
+	Varyings in;
+	in.px = x;
+	in.py = y;
+
+	if constexpr (INPUTS != VARYING_NONE) {
+		const Vec4 &a = tris.v1;
+		const Vec4 &b = tris.v2;
+		const Vec4 &c = tris.v3;
+
+		float px = x + 0.5f;
+		float py = y + 0.5f;
+
+		// Barycentrics from the edge functions, then perspective corrected
+		float invArea = 1.f/( (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x) );
+		float l0 = ( (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x) )*invArea;
+		float l1 = ( (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x) )*invArea;
+		float l2 = ( (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x) )*invArea;
+
+		Varyings vary[3];
+		vertexStage<INPUTS>(tris, vs, vary);
+
+		if constexpr (QuadShader<FragmentShader>) {
+			Vec3 dldx( -(c.y - b.y)*invArea, -(a.y - c.y)*invArea, -(b.y - a.y)*invArea );
+			Vec3 dldy( (c.x - b.x)*invArea, (a.x - c.x)*invArea, (b.x - a.x)*invArea );
+			return shadeAsQuad(fs, vary, tris, Vec3(l0, l1, l2), dldx, dldy, x, y);
+		}
+
+		interpolate<INPUTS>(vary, l0*a.w, l1*b.w, l2*c.w, in);
+	}
+
+	return fs(in);
+}
+
+/*
+shadePixel() of the lanes in `mask` of the quad at (x, y), every one covered by `tris`.
+A QuadShader runs once for the whole quad, the lanes outside `mask` are its helpers
+*/
+template <typename VertexShader, typename FragmentShader>
+void shadeQuad(const Tris2D_p &tris, int x, int y, uint32_t mask, const VertexShader &vs, const FragmentShader &fs, Color out[4]) {
+	if constexpr (QuadShader<FragmentShader>) {
+		const Vec4 &a = tris.v1;
+		const Vec4 &b = tris.v2;
+		const Vec4 &c = tris.v3;
+
+		Varyings vary[3];
+		vertexStage<FragmentShader::INPUTS>(tris, vs, vary);
+
+		float invArea = 1.f/( (b.x - a.x)*(c.y - a.y) - (b.y - a.y)*(c.x - a.x) );
+
+		Varyings in[4];
+		for (int k=0; k<4; k++) {
+			float px = x + (k & 1) + 0.5f;
+			float py = y + (k >> 1) + 0.5f;
+			float l0 = ( (c.x - b.x)*(py - b.y) - (c.y - b.y)*(px - b.x) )*invArea;
+			float l1 = ( (a.x - c.x)*(py - c.y) - (a.y - c.y)*(px - c.x) )*invArea;
+			float l2 = ( (b.x - a.x)*(py - a.y) - (b.y - a.y)*(px - a.x) )*invArea;
+
+			in[k].px = x + (k & 1);
+			in[k].py = y + (k >> 1);
+			interpolate<FragmentShader::INPUTS>(vary, l0*a.w, l1*b.w, l2*c.w, in[k]);
+		}
+
+		fs.quad(in, mask, out);
+	}
+	else {
+		for (int k=0; k<4; k++) {
+			if (mask & (1u << k)) out[k] = shadePixel(tris, x + (k & 1), y + (k >> 1), vs, fs);
+		}
+	}
+}
+
+
+// Visibility buffer pass, writes `id` and 1/w of every visible pixel and nothing else (but `stats`)
+void rasterTrisID(uint32_t *idBuffer, float *depthBuffer, int w, int h, const Tris2D_p &tris, uint32_t id, PipelineStats &stats);
+
+/*
+Depth only pass for shadow maps and the depth pre-pass, no colour and no varyings.
+Keeps the largest `w` of every pixel, `w` only has to be linear in screen space:
+1/w for perspective projections, any affine depth for orthographic ones
+*/
+void rasterTrisDepth(float *depthBuffer, int w, int h, const Tris2D_p &tris);
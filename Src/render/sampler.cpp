@@ -0,0 +1,213 @@
+#include <cmath>
+#include <algorithm>
+
+#include "sampler.hpp"
+
+
+#define SAMPLER_CACHE_SLOTS 256		// Decoded blocks per thread (16x16), 16 KB of texels
+
+// A decoded 4x4 block, `key` is the texture id and the byte offset of the block (0 is empty)
+struct DecodedBlock {
+	uint64_t key;
+	uint32_t texels[16];
+};
+
+static thread_local DecodedBlock samplerCache[SAMPLER_CACHE_SLOTS];
+
+
+// ------ Texel Fetches ------
+
+// RGBA8 texels in `LAYOUT`
+template <TextureLayout LAYOUT>
+struct TexelFetch {
+	const Texture &texture;
+
+	// The 2x2 footprint (xa, ya) to (xb, yb)
+	inline void operator()(const TextureLevel &level, int xa, int ya, int xb, int yb, uint32_t t[4]) const {
+		t[0] = texture.texels[ texture.indexOf<LAYOUT>(level, xa, ya) ];
+		t[1] = texture.texels[ texture.indexOf<LAYOUT>(level, xb, ya) ];
+		t[2] = texture.texels[ texture.indexOf<LAYOUT>(level, xa, yb) ];
+		t[3] = texture.texels[ texture.indexOf<LAYOUT>(level, xb, yb) ];
+	}
+};
+
+/*
+Compressed blocks through the direct-mapped cache of the thread. The slot comes from the
+low bits of the block coordinates (moved by the level, the two levels of a trilinear
+lookup then land apart), so the blocks of a 64x64 texel window never evict each other
+and the next row of quads finds the blocks of the previous one
+*/
+template <BlockFormat FORMAT>
+struct BlockFetch {
+	const Texture &texture;
+
+	inline const uint32_t *block(const TextureLevel &level, uint32_t bx, uint32_t by) const {
+		uint32_t offset = level.offset + (by*level.blocksX + bx)*blockBytes(FORMAT);
+		uint64_t key = ((uint64_t) texture.id << 32) | offset;
+
+		uint32_t l = (uint32_t) (&level - texture.levels);
+		DecodedBlock &slot = samplerCache[ ((bx ^ l) & 15) | (((by ^ l) & 15) << 4) ];
+
+		if (slot.key != key) {
+			const uint8_t *data = texture.blocks.data() + offset;
+			if constexpr (FORMAT == BlockFormat::BC1) decodeBC1(data, slot.texels);
+			else if constexpr (FORMAT == BlockFormat::BC4) decodeBC4(data, slot.texels);
+			else decodeBC5(data, slot.texels);
+			slot.key = key;
+		}
+
+		return slot.texels;
+	}
+
+	// The 2x2 footprint (xa, ya) to (xb, yb), one lookup when it is inside a block
+	inline void operator()(const TextureLevel &level, int xa, int ya, int xb, int yb, uint32_t t[4]) const {
+		uint32_t bxa = (uint32_t) xa / BC_BLOCK, bya = (uint32_t) ya / BC_BLOCK;
+		uint32_t bxb = (uint32_t) xb / BC_BLOCK, byb = (uint32_t) yb / BC_BLOCK;
+		uint32_t ia = ((uint32_t) xa % BC_BLOCK), ib = ((uint32_t) xb % BC_BLOCK);
+		uint32_t ja = ((uint32_t) ya % BC_BLOCK)*BC_BLOCK, jb = ((uint32_t) yb % BC_BLOCK)*BC_BLOCK;
+
+		if (bxa == bxb && bya == byb) {
+			const uint32_t *texels = this->block(level, bxa, bya);
+			t[0] = texels[ja + ia];
+			t[1] = texels[ja + ib];
+			t[2] = texels[jb + ia];
+			t[3] = texels[jb + ib];
+		}
+		else {
+			t[0] = this->block(level, bxa, bya)[ja + ia];
+			t[1] = this->block(level, bxb, bya)[ja + ib];
+			t[2] = this->block(level, bxa, byb)[jb + ia];
+			t[3] = this->block(level, bxb, byb)[jb + ib];
+		}
+	}
+};
+
+
+/*
+Trilinear filtering of N lanes at the same mip level, on planar (one array per
+component) lane data so the weights and the blends vectorize across the lanes.
+Only the texel fetches are per lane. Addressing wraps, the levels are powers of two
+*/
+template <int N, typename FETCH>
+static void trilinear(const Texture &texture, const FETCH &fetch, const float *u, const float *v, float lod, Color *out) {
+	int last = texture.levelCount - 1;
+	lod = std::clamp(lod, 0.f, (float) last);
+
+	int base = (int) lod;
+	float t = lod - base;
+
+	float r[N], g[N], b[N];
+	for (int k=0; k<N; k++) {
+		r[k] = 0.f;
+		g[k] = 0.f;
+		b[k] = 0.f;
+	}
+
+	// The finer level, and the coarser one when the lod falls between them
+	for (int l=base; l<=std::min(base + 1, last); l++) {
+		float levelWeight = (l == base) ? 1.f - t : t;
+		if (levelWeight == 0.f) continue;
+
+		const TextureLevel &level = texture.levels[l];
+		int maskX = level.width - 1;
+		int maskY = level.height - 1;
+
+		// Texel coordinates of the 2x2 footprints and their bilinear weights
+		int x0[N], y0[N];
+		float fx[N], fy[N];
+
+		for (int k=0; k<N; k++) {
+			float x = u[k]*level.width - 0.5f;
+			float y = v[k]*level.height - 0.5f;
+			float xf = std::floor(x);
+			float yf = std::floor(y);
+			fx[k] = x - xf;
+			fy[k] = y - yf;
+			x0[k] = (int) xf;
+			y0[k] = (int) yf;
+		}
+
+		float w00[N], w10[N], w01[N], w11[N];
+		for (int k=0; k<N; k++) {
+			w00[k] = (1.f - fx[k])*(1.f - fy[k])*levelWeight;
+			w10[k] = fx[k]*(1.f - fy[k])*levelWeight;
+			w01[k] = (1.f - fx[k])*fy[k]*levelWeight;
+			w11[k] = fx[k]*fy[k]*levelWeight;
+		}
+
+		// Gather, wrapping with the masks (two's complement wraps negative coordinates too)
+		uint32_t t00[N], t10[N], t01[N], t11[N];
+		for (int k=0; k<N; k++) {
+			int xa = x0[k] & maskX, xb = (x0[k] + 1) & maskX;
+			int ya = y0[k] & maskY, yb = (y0[k] + 1) & maskY;
+			uint32_t t[4];
+			fetch(level, xa, ya, xb, yb, t);
+			t00[k] = t[0];
+			t10[k] = t[1];
+			t01[k] = t[2];
+			t11[k] = t[3];
+		}
+
+		for (int k=0; k<N; k++) {
+			Color c = w00[k]*Texture::decode(t00[k]) + w10[k]*Texture::decode(t10[k])
+				+ w01[k]*Texture::decode(t01[k]) + w11[k]*Texture::decode(t11[k]);
+			r[k] += c.r;
+			g[k] += c.g;
+			b[k] += c.b;
+		}
+	}
+
+	for (int k=0; k<N; k++) {
+		out[k] = Color(r[k], g[k], b[k]);
+	}
+}
+
+
+// Trilinear filtering with the fetch of the format and layout of the texture
+template <int N>
+static void dispatch(const Texture &texture, const float *u, const float *v, float lod, Color *out) {
+	switch (texture.format) {
+		case TextureFormat::BC1:
+			trilinear<N>(texture, BlockFetch<BlockFormat::BC1>{texture}, u, v, lod, out);
+			break;
+		case TextureFormat::BC4:
+			trilinear<N>(texture, BlockFetch<BlockFormat::BC4>{texture}, u, v, lod, out);
+			break;
+		case TextureFormat::BC5:
+			trilinear<N>(texture, BlockFetch<BlockFormat::BC5>{texture}, u, v, lod, out);
+			break;
+		default:
+			if (texture.layout == TextureLayout::TILED) {
+				trilinear<N>(texture, TexelFetch<TextureLayout::TILED>{texture}, u, v, lod, out);
+			}
+			else {
+				trilinear<N>(texture, TexelFetch<TextureLayout::ROW_MAJOR>{texture}, u, v, lod, out);
+			}
+	}
+}
+
+
+// Methods
+float Sampler::lod(const Vec2 &dx, const Vec2 &dy) const {
+	Vec2 size(texture->width(), texture->height());
+	Vec2 tx = dx*size;
+	Vec2 ty = dy*size;
+
+	// log2 of the longest texel footprint side, from its square
+	float rho2 = std::max(glm::dot(tx, tx), glm::dot(ty, ty));
+	return (rho2 > 0.f) ? 0.5f*std::log2(rho2) : 0.f;
+}
+
+Color Sampler::sample(const Vec2 &uv, float lod) const {
+	Color c;
+	dispatch<1>(*texture, &uv.x, &uv.y, lod, &c);
+	return c;
+}
+
+void Sampler::sampleQuad(const Vec2 uv[4], Color out[4]) const {
+	float l = this->lod(uv[1] - uv[0], uv[2] - uv[0]);
+
+	float u[4] = {uv[0].x, uv[1].x, uv[2].x, uv[3].x};
+	float v[4] = {uv[0].y, uv[1].y, uv[2].y, uv[3].y};
+	dispatch<4>(*texture, u, v, l, out);
+}
@@ -0,0 +1,29 @@
+// Filtered texture lookups, trilinear across the mip chain with wrapping UVs, compressed blocks decoded on the fly
+
+#pragma once
+
+#include "../math/vec.hpp"
+#include "../math/color.hpp"
+#include "texture.hpp"
+
+
+class Sampler {
+	// Attributes
+	public:
+		const Texture *texture;
+
+	// Methods
+	public:
+		// Mip level of a pixel from the screen space derivatives of its UV
+		float lod(const Vec2 &dx, const Vec2 &dy) const;
+
+		// One pixel, the texels of every lookup are fetched and blended one by one
+		Color sample(const Vec2 &uv, float lod) const;
+
+		/*
+		A 2x2 pixel quad, lanes (x, y), (x+1, y), (x, y+1), (x+1, y+1).
+		The derivatives come from the differences between the lanes, the quad
+		shares one mip level and the 4 lanes are filtered together
+		*/
+		void sampleQuad(const Vec2 uv[4], Color out[4]) const;
+};
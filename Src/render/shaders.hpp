@@ -0,0 +1,207 @@
+// Vertex and Fragment shaders for rasterTris()
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+#include "../math/vec.hpp"
+#include "../math/color.hpp"
+#include "raster.hpp"
+#include "lightgrid.hpp"
+#include "shadowmap.hpp"
+#include "sampler.hpp"
+#include "../scene/light.hpp"
+
+
+#define AMBIENT 0.05f
+
+
+// Lights visible to the shaders of a frame
+class ShadingContext {
+	public:
+		const Light *lights;	// View space lights
+		const LightGrid *grid;	// Lights per tile
+		const ShadowMap *shadows;	// One per light
+		int pcf;				// Shadow filter radius in texels
+		float bias;				// Shadow bias in texels
+};
+
+// Light `i` arriving at `pos`, through its shadow map
+inline Color lightContribution(const ShadingContext &ctx, uint32_t i, const Vec3 &pos, const Vec3 &normal) {
+	const Light &light = ctx.lights[i];
+	Color c = light.illuminate(pos, normal);
+
+	if (light.castShadows && (c.r > 0.f || c.g > 0.f || c.b > 0.f)) {
+		c *= ctx.shadows[i].visibility(pos, normal, ctx.pcf, ctx.bias);
+	}
+
+	return c;
+}
+
+// Lambertian diffuse from the global lights and the lights of the tile
+// of pixel (px, py), with a bit of ambient
+inline Color shadeLit(const ShadingContext &ctx, const Vec3 &pos, const Vec3 &normal, const Color &albedo, int px, int py) {
+	Color light(AMBIENT);
+
+	for (uint32_t i : ctx.grid->global) {
+		light += lightContribution(ctx, i, pos, normal);
+	}
+
+	for (uint32_t i : ctx.grid->tileLights(px, py)) {
+		light += lightContribution(ctx, i, pos, normal);
+	}
+
+	return albedo * light;
+}
+
+
+// ------ Vertex Shaders ------
+// `idx` points at the 3 vertex indices of the triangle
+
+// No varyings
+class NullVS {
+	public:
+		void operator()(int, Varyings &) const {}
+};
+
+// Passes the per vertex normal
+class NormalVS {
+	public:
+		const Vec3 *normals;
+		const uint32_t *idx;
+
+		void operator()(int corner, Varyings &out) const {
+			out.normal = normals[idx[corner]];
+		}
+};
+
+// Passes the per vertex normal and view space position
+class PhongVS {
+	public:
+		const Vec3 *verticies;
+		const Vec3 *normals;
+		const uint32_t *idx;
+
+		void operator()(int corner, Varyings &out) const {
+			out.normal = normals[idx[corner]];
+			out.position = verticies[idx[corner]];
+		}
+};
+
+// Passes the per vertex UV
+class UVVS {
+	public:
+		const Vec2 *uvs;
+		const uint32_t *idx;
+
+		void operator()(int corner, Varyings &out) const {
+			out.uv = uvs[idx[corner]];
+		}
+};
+
+// The varyings of `VS` and the per vertex UV, `idx` points at the mesh library verticies
+template <typename VS>
+class TexturedVS {
+	public:
+		VS base;
+		const Vec2 *uvs;
+		const uint32_t *idx;
+
+		void operator()(int corner, Varyings &out) const {
+			base(corner, out);
+			out.uv = uvs[idx[corner]];
+		}
+};
+
+// Lights every vertex with the lights of its tile, passes the lit colour (Gouraud)
+class GouraudVS {
+	public:
+		ShadingContext ctx;
+		const Vec3 *verticies;
+		const Vec3 *normals;
+		const uint32_t *idx;
+		const Tris2D_p *tris;
+		Color albedo;
+
+		void operator()(int corner, Varyings &out) const {
+			const Vec4 &screen = (corner == 0) ? tris->v1 : (corner == 1) ? tris->v2 : tris->v3;
+			uint32_t v = idx[corner];
+			out.color = shadeLit(ctx, verticies[v], normals[v], albedo, (int) screen.x, (int) screen.y);
+		}
+};
+
+
+// ------ Fragment Shaders ------
+
+// Same colour for the whole triangle
+class ConstantFS {
+	public:
+		static constexpr uint32_t INPUTS = VARYING_NONE;
+		Color color;
+
+		Color operator()(const Varyings &) const {
+			return color;
+		}
+};
+
+// Interpolated vertex colour
+class ColorFS {
+	public:
+		static constexpr uint32_t INPUTS = VARYING_COLOR;
+
+		Color operator()(const Varyings &in) const {
+			return in.color;
+		}
+};
+
+// Lights every pixel with the interpolated normal and the lights of its tile (Phong)
+class PhongFS {
+	public:
+		static constexpr uint32_t INPUTS = VARYING_NORMAL | VARYING_POSITION;
+		ShadingContext ctx;
+		Color albedo;
+
+		Color operator()(const Varyings &in) const {
+			return shadeLit(ctx, in.position, glm::normalize(in.normal), albedo, in.px, in.py);
+		}
+};
+
+// Interpolated normal as colour
+class NormalFS {
+	public:
+		static constexpr uint32_t INPUTS = VARYING_NORMAL;
+
+		Color operator()(const Varyings &in) const {
+			return in.normal;
+		}
+};
+
+// Interpolated UV as colour
+class UVFS {
+	public:
+		static constexpr uint32_t INPUTS = VARYING_UV;
+
+		Color operator()(const Varyings &in) const {
+			return Color(in.uv.x, in.uv.y, 0.f);
+		}
+};
+
+// Colour of `FS` times the texture, shaded by pixel quads to get the UV derivatives of the mip level
+template <typename FS>
+class TexturedFS {
+	public:
+		static constexpr uint32_t INPUTS = FS::INPUTS | VARYING_UV;
+		FS base;
+		Sampler sampler;
+
+		void quad(const Varyings in[4], uint32_t mask, Color out[4]) const {
+			Vec2 uv[4] = {in[0].uv, in[1].uv, in[2].uv, in[3].uv};
+			sampler.sampleQuad(uv, out);
+
+			// Helper lanes only fed the derivatives
+			for (int k=0; k<4; k++) {
+				if (mask & (1u << k)) out[k] *= base(in[k]);
+			}
+		}
+};
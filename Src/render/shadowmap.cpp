@@ -0,0 +1,187 @@
+#include <cmath>
+#include <algorithm>
+
+#include "shadowmap.hpp"
+#include "raster.hpp"
+
+
+// Constructors and Destructors
+ShadowMap::ShadowMap() {
+	size = 0;
+	cascadeCount = 0;
+	perspective = false;
+}
+
+ShadowMap::~ShadowMap() {
+}
+
+
+// Methods
+void ShadowMap::setup(const Light &light, int mapSize, int cascades, const Vec3 &boundsMin, const Vec3 &boundsMax, float tanHalfFovY, float aspect) {
+	size = mapSize;
+	cascadeCount = 0;
+
+	Vec3 dir = light.direction;
+	Vec3 up = (std::abs(dir.y) > 0.99f) ? Vec3(1.f, 0.f, 0.f) : Vec3(0.f, 1.f, 0.f);
+
+	if (light.type == LightType::SPOT) {
+		perspective = true;
+		cascadeCount = 1;
+
+		// Covers the whole cone, up to where the light fades out
+		float fov = std::min(2.f*std::acos(light.cosOuter), glm::radians(170.f));
+		float near = std::max(1E-3F, light.range*1E-3F);
+
+		glm::mat4 lightView = glm::lookAt(light.position, light.position + dir, up);
+		glm::mat4 lightProj = glm::perspective(fov, 1.f, near, light.range);
+
+		ShadowCascade &cascade = this->cascades[0];
+		cascade.toMap = lightProj * lightView;
+		cascade.split = INFINITY;
+		cascade.texel = 2.f*std::tan(fov/2.f) / size;
+		return;
+	}
+
+	if (light.type != LightType::DIRECTIONAL) return;
+
+	perspective = false;
+	cascadeCount = std::max(1, std::min(SHADOW_MAX_CASCADES, cascades));
+
+	glm::mat4 lightView = glm::lookAt(Vec3(0.f), dir, up);
+
+	// Depth range of the geometry along the light, every caster has to fit in every cascade
+	float zMin = INFINITY;
+	for (int i=0; i<8; i++) {
+		Vec3 corner( (i&1) ? boundsMax.x : boundsMin.x, (i&2) ? boundsMax.y : boundsMin.y, (i&4) ? boundsMax.z : boundsMin.z );
+		zMin = std::min(zMin, Vec3(lightView * Vec4(corner, 1.f)).z);
+	}
+
+	// View distance range of the geometry, split between uniform and logarithmic
+	float far = std::max(1E-3F, -boundsMin.z);
+	float near = std::max(far*1E-3F, -boundsMax.z);
+	float lambda = 0.5f;
+
+	float tanHalfFovX = tanHalfFovY*aspect;
+	float sliceNear = near;
+
+	for (int c=0; c<cascadeCount; c++) {
+		float t = (float) (c+1) / cascadeCount;
+		float sliceFar = lambda*near*std::pow(far/near, t) + (1.f - lambda)*(near + (far - near)*t);
+
+		// Bounding sphere of the frustum slice, in view space
+		Vec3 corners[8];
+		Vec3 center(0.f);
+		for (int i=0; i<8; i++) {
+			float d = (i&4) ? sliceFar : sliceNear;
+			corners[i] = Vec3( ((i&1) ? d : -d)*tanHalfFovX, ((i&2) ? d : -d)*tanHalfFovY, -d );
+			center += corners[i] / 8.f;
+		}
+
+		float radius = 0.f;
+		for (int i=0; i<8; i++) {
+			radius = std::max(radius, glm::length(corners[i] - center));
+		}
+
+		ShadowCascade &cascade = this->cascades[c];
+		cascade.split = sliceFar;
+		cascade.texel = 2.f*radius / size;
+
+		// Snapped to whole texels, so the shadow edges do not crawl while the camera moves
+		Vec3 centerL = Vec3(lightView * Vec4(center, 1.f));
+		centerL.x = std::floor(centerL.x / cascade.texel) * cascade.texel;
+		centerL.y = std::floor(centerL.y / cascade.texel) * cascade.texel;
+
+		// Light space to (texels, texels, z - zMin + 1), the depth stays above 0 for rasterTrisDepth()
+		glm::mat4 toTexels(1.f);
+		toTexels[0][0] =  1.f / cascade.texel;
+		toTexels[1][1] = -1.f / cascade.texel;
+		toTexels[3][0] = (radius - centerL.x) / cascade.texel;
+		toTexels[3][1] = (radius + centerL.y) / cascade.texel;
+		toTexels[3][2] = 1.f - zMin;
+
+		cascade.toMap = toTexels * lightView;
+
+		sliceNear = sliceFar;
+	}
+}
+
+void ShadowMap::clear(int c) {
+	this->cascades[c].depth.assign(size*size, 0.f);
+}
+
+void ShadowMap::render(int c, const Vec3 *verticies, int vxCount, const uint32_t *indices, int triCount) {
+	ShadowCascade &cascade = this->cascades[c];
+	cascade.projected.resize(vxCount);
+
+	for (int i=0; i<vxCount; i++) {
+		cascade.projected[i] = this->toMap(cascade, verticies[i]);
+	}
+
+	for (int i=0; i<triCount; i++) {
+		const uint32_t *idx = &indices[i*3];
+		Tris2D_p tris(cascade.projected[idx[0]], cascade.projected[idx[1]], cascade.projected[idx[2]], i);
+		rasterTrisDepth(cascade.depth.data(), size, size, tris);
+	}
+}
+
+float ShadowMap::visibility(const Vec3 &pos, const Vec3 &normal, int pcf, float bias) const {
+	if (cascadeCount == 0) return 1.f;
+
+	// First cascade reaching `pos`, nothing casts shadows past the last one
+	int c = 0;
+	if ( !perspective ) {
+		float dist = -pos.z;
+		while (c < cascadeCount && dist > cascades[c].split) c++;
+		if (c == cascadeCount) return 1.f;
+	}
+
+	const ShadowCascade &cascade = cascades[c];
+
+	// Texel footprint at `pos`, grows with the distance for perspective maps
+	float texel = cascade.texel;
+	if (perspective) {
+		float key = this->toMap(cascade, pos).w;
+		if (key <= 0.f) return 1.f;
+		texel /= key;
+	}
+
+	// Normal offset, then the same slack along the depth
+	Vec4 m = this->toMap(cascade, pos + normal*(bias*texel));
+	if (m.w <= 0.f) return 1.f;
+
+	float slack = bias*texel;
+	if (perspective) slack *= m.w*m.w;	// d(1/w) = -dw/w^2
+
+	int x0 = (int) std::floor(m.x);
+	int y0 = (int) std::floor(m.y);
+
+	int lit = 0;
+	for (int dy=-pcf; dy<=pcf; dy++) {
+		int y = std::max(0, std::min(size-1, y0 + dy));
+		const float *row = cascade.depth.data() + y*size;
+
+		for (int dx=-pcf; dx<=pcf; dx++) {
+			int x = std::max(0, std::min(size-1, x0 + dx));
+			lit += (row[x] <= m.w + slack);
+		}
+	}
+
+	int taps = (2*pcf + 1)*(2*pcf + 1);
+	return (float) lit / taps;
+}
+
+Vec4 ShadowMap::toMap(const ShadowCascade &cascade, const Vec3 &pos) const {
+	Vec4 m = cascade.toMap * Vec4(pos, 1.f);
+
+	if ( !perspective ) {
+		return Vec4(m.x, m.y, 0.f, m.z);
+	}
+
+	// Behind the light
+	if (m.w <= 0.f) {
+		return Vec4(0.f);
+	}
+
+	float invW = 1.f / m.w;
+	return Vec4( size*(1.f + m.x*invW)/2.f, size*(1.f - m.y*invW)/2.f, 0.f, invW );
+}
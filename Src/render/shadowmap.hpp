@@ -0,0 +1,64 @@
+// Depth maps rendered from the point of view of the shadow casting lights
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../math/vec.hpp"
+#include "../scene/light.hpp"
+
+
+#define SHADOW_MAX_CASCADES 4
+
+
+class ShadowCascade {
+	public:
+		glm::mat4 toMap;				// View space to map space
+		float split;					// View distance this cascade covers up to
+		float texel;					// Size of a texel in view space (at distance 1 for perspective maps)
+
+		std::vector<float> depth;		// size*size, larger is closer to the light, 0 is empty
+		std::vector<Vec4> projected;	// Verticies in map space, scratch for render()
+};
+
+
+class ShadowMap {
+	// Constructors / Destructors
+	public:
+		ShadowMap();
+		~ShadowMap();
+
+	// Attributes
+	public:
+		int size;				// Width and height of every cascade
+		int cascadeCount;		// 0 when the light casts no shadow this frame
+		bool perspective;		// SPOT lights, DIRECTIONAL ones are orthographic
+		ShadowCascade cascades[SHADOW_MAX_CASCADES];
+
+	// Methods
+	public:
+		/*
+		Fits the cascades of `light` (view space) around the geometry.
+		`boundsMin`, `boundsMax` : view space bounds of the geometry
+		`tanHalfFovY`, `aspect`  : camera frustum, directional lights split it along the view distance
+		*/
+		void setup(const Light &light, int mapSize, int cascades, const Vec3 &boundsMin, const Vec3 &boundsMax, float tanHalfFovY, float aspect);
+
+		// Empties cascade `c`, render() then adds to it
+		void clear(int c);
+
+		// Depth only rasterization of the triangles `indices` (3 per triangle) into cascade `c`
+		void render(int c, const Vec3 *verticies, int vxCount, const uint32_t *indices, int triCount);
+
+		/*
+		Fraction of the (2*pcf + 1)^2 texels around `pos` (view space) that see the light.
+		`bias` is in texels, it pushes `pos` off the surface along `normal` and
+		is the depth slack of the comparison
+		*/
+		float visibility(const Vec3 &pos, const Vec3 &normal, int pcf, float bias) const;
+
+	private:
+		// (map x, map y, unused, depth)
+		Vec4 toMap(const ShadowCascade &cascade, const Vec3 &pos) const;
+};
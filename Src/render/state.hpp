@@ -0,0 +1,23 @@
+// Depth and Blend state of the rasterizer
+
+#pragma once
+
+
+enum class DepthMode {
+	NONE,		// No depth buffer, relies on painter's order
+	TEST,		// Test against the depth buffer without writing it
+	TEST_WRITE,	// Test and write the depth buffer
+	EQUAL,		// Only the depth already in the buffer passes, up to DEPTH_EQUAL_BIAS (after a depth pre-pass)
+};
+
+enum class BlendMode {
+	OPAQUE,		// Replaces the destination
+	ADDITIVE,	// Adds to the destination
+};
+
+template <DepthMode D, BlendMode B>
+class RasterState {
+	public:
+		static constexpr DepthMode DEPTH = D;
+		static constexpr BlendMode BLEND = B;
+};
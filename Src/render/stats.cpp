@@ -0,0 +1,75 @@
+#include <algorithm>
+
+#include "stats.hpp"
+
+
+// Constructors and Destructors
+PipelineStats::PipelineStats() {
+	this->reset();
+}
+
+
+// Methods
+void PipelineStats::reset() {
+	vertices = 0;
+	submitted = 0;
+	backFacing = 0;
+	clipped = 0;
+	culledBack = 0;
+	culledNear = 0;
+	culledFrustum = 0;
+	culledSmall = 0;
+	culledOccluded = 0;
+	rasterized = 0;
+	pixelsTested = 0;
+	pixelsWritten = 0;
+	pixelsShaded = 0;
+	pixels = 0;
+}
+
+PipelineStats &PipelineStats::operator+=(const PipelineStats &other) {
+	vertices += other.vertices;
+	submitted += other.submitted;
+	backFacing += other.backFacing;
+	clipped += other.clipped;
+	culledBack += other.culledBack;
+	culledNear += other.culledNear;
+	culledFrustum += other.culledFrustum;
+	culledSmall += other.culledSmall;
+	culledOccluded += other.culledOccluded;
+	rasterized += other.rasterized;
+	pixelsTested += other.pixelsTested;
+	pixelsWritten += other.pixelsWritten;
+	pixelsShaded += other.pixelsShaded;
+	pixels += other.pixels;
+	return *this;
+}
+
+void PipelineStats::print(std::ostream &out, int frames) const {
+	frames = std::max(1, frames);
+
+	out << "Stats"
+		<< "\tVerticies " << vertices/frames
+		<< "\tTriangles " << submitted/frames
+		<< " (back-facing " << backFacing/frames << ", clipped " << clipped/frames << ")"
+		<< "\tCulled back " << culledBack/frames
+		<< ", near " << culledNear/frames
+		<< ", frustum " << culledFrustum/frames
+		<< ", small " << culledSmall/frames
+		<< ", occluded " << culledOccluded/frames
+		<< "\tRasterized " << rasterized/frames
+		<< "\tPixels tested " << pixelsTested/frames
+		<< ", written " << pixelsWritten/frames
+		<< ", shaded " << pixelsShaded/frames
+		<< "\tOverdraw " << this->overdraw() << "\n";
+}
+
+bool PipelineStats::parseView(const std::string &name, DebugView &view) {
+	if (name == "none") view = DebugView::NONE;
+	else if (name == "overdraw") view = DebugView::OVERDRAW;
+	else if (name == "density") view = DebugView::DENSITY;
+	else if (name == "tile_cost") view = DebugView::TILE_COST;
+	else return false;
+
+	return true;
+}
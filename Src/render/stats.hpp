@@ -0,0 +1,74 @@
+// Pipeline statistics of a frame, like the query counters of a GPU, and the heatmap debug views
+
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+
+#define STATS_TILE 16	// Tile size in pixels of the raster cost heatmap
+
+
+enum class DebugView : uint8_t {
+	NONE,
+	OVERDRAW,	// Fragments written per pixel
+	DENSITY,	// Triangles per pixel, from the area of the triangles covering it
+	TILE_COST,	// Raster time of every tile
+};
+
+/*
+The geometry stage counts the triangles it projects, the rasterizers count their pixels
+in the counters of the frame they draw (passed down to them, a frame is rasterized by one
+thread at a time). The passes split over the workers, like the visibility buffer shading,
+count in counters of their own and add them to the frame once done.
+Every triangle submitted ends up in exactly one of the culled counters or in `rasterized`
+*/
+class PipelineStats {
+	// Constructors / Destructors
+	public:
+		PipelineStats();
+
+	// Attributes
+	public:
+		uint64_t vertices;			// Transformed verticies
+		uint64_t submitted;			// Triangles sent to the raster stage, every piece of the clipped ones
+		uint64_t backFacing;		// Facing away and drawn, BACKFACE_CULLING is off
+		uint64_t clipped;			// Crossing the near plane or the guard band, cut in one or more triangles
+
+		uint64_t culledBack;		// Facing away, with BACKFACE_CULLING
+		uint64_t culledNear;		// Behind the near plane
+		uint64_t culledFrustum;		// Bounding box outside the screen
+		uint64_t culledSmall;		// Zero area, or covering no pixel center
+		uint64_t culledOccluded;	// Every covered pixel failed the depth test
+		uint64_t rasterized;		// At least one pixel written
+
+		uint64_t pixelsTested;		// Covered pixels reaching the depth test
+		uint64_t pixelsWritten;		// Pixels passing it
+		uint64_t pixelsShaded;		// Pixels the fragment shaders ran for, once each with the visibility buffer
+		uint64_t pixels;			// Pixels of the frame
+
+	// Methods
+	public:
+		void reset();
+		PipelineStats &operator+=(const PipelineStats &other);
+
+		// Pixels written per pixel of the frame
+		float overdraw() const { return pixels ? (float) pixelsWritten/pixels : 0.f; }
+
+		// One line, every counter averaged over `frames`
+		void print(std::ostream &out, int frames) const;
+
+		// Raster side of a triangle that got through the setup
+		inline void raster(uint32_t tested, uint32_t written, uint32_t shaded) {
+			pixelsTested += tested;
+			pixelsWritten += written;
+			pixelsShaded += shaded;
+
+			if (tested == 0) culledSmall++;
+			else if (written == 0) culledOccluded++;
+			else rasterized++;
+		}
+
+		static bool parseView(const std::string &name, DebugView &view);
+};
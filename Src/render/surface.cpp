@@ -1,6 +1,8 @@
 #include <fstream>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <type_traits>
 #include <time.h>
 
 
@@ -18,76 +20,221 @@
 #define ACES_e 0.4329510f
 
 
-// Private macro of Surface class
-#define _SET_SURF_AT(x, y, color) _surfData[(y)*surfWidth + (x)] = (color)
+// Private macro of Surface class, `pixel` is already encoded in the surface format
+#define _SET_SURF_AT(x, y, pixel) _surfData[(y)*surfWidth + (x)] = (pixel)
 #define _SURF_AT(x, y) _surfData[(y)*surfWidth + (x)]
 
 
 
 // --------- Constructors ---------
-Surface::Surface() {}
+template <typename Format>
+SurfaceT<Format>::SurfaceT(): surfWidth(0), surfHeight(0), surfSize(0), surfAspectRatio(0.f), _surfData(nullptr),
+    _clipX0(0), _clipY0(0), _clipX1(0), _clipY1(0) {}
 
-Surface::Surface(Color* data, int w, int h): surfWidth(w), surfHeight(h) {
+template <typename Format>
+SurfaceT<Format>::SurfaceT(Pixel* data, int w, int h): surfWidth(w), surfHeight(h) {
     surfSize  = surfWidth * surfHeight;
     surfAspectRatio = (float)surfWidth/surfHeight;
     _surfData = data;
+    this->resetClip();
 }
 
 
 
 
 // --------- Private Methods ---------
-void Surface::_aces() {
+template <typename Format>
+void SurfaceT<Format>::_aces() {
     for (int i=0; i<surfSize; i++) {
-        _surfData[i].r = std::max(0.f, (float)(_surfData[i].r*(_surfData[i].r+ACES_a) - ACES_b) / (_surfData[i].r * (_surfData[i].r*ACES_c + ACES_d) + ACES_e));
-        _surfData[i].g = std::max(0.f, (float)(_surfData[i].g*(_surfData[i].g+ACES_a) - ACES_b) / (_surfData[i].g * (_surfData[i].g*ACES_c + ACES_d) + ACES_e));
-        _surfData[i].b = std::max(0.f, (float)(_surfData[i].b*(_surfData[i].b+ACES_a) - ACES_b) / (_surfData[i].b * (_surfData[i].b*ACES_c + ACES_d) + ACES_e));
+        Color c = Format::decode(_surfData[i]);
+        c.r = std::max(0.f, (float)(c.r*(c.r+ACES_a) - ACES_b) / (c.r * (c.r*ACES_c + ACES_d) + ACES_e));
+        c.g = std::max(0.f, (float)(c.g*(c.g+ACES_a) - ACES_b) / (c.g * (c.g*ACES_c + ACES_d) + ACES_e));
+        c.b = std::max(0.f, (float)(c.b*(c.b+ACES_a) - ACES_b) / (c.b * (c.b*ACES_c + ACES_d) + ACES_e));
+        _surfData[i] = Format::encode(c);
     }
 }
 
-void Surface::_reinhard() {
+template <typename Format>
+void SurfaceT<Format>::_reinhard() {
     for (int i=0; i<surfSize; i++) {
-        _surfData[i].r = (float) _surfData[i].r/(1+_surfData[i].r);
-        _surfData[i].g = (float) _surfData[i].g/(1+_surfData[i].g);
-        _surfData[i].b = (float) _surfData[i].b/(1+_surfData[i].b);
+        Color c = Format::decode(_surfData[i]);
+        c.r = (float) c.r/(1+c.r);
+        c.g = (float) c.g/(1+c.g);
+        c.b = (float) c.b/(1+c.b);
+        _surfData[i] = Format::encode(c);
     }
 }
 
-void Surface::_gamma() {
+template <typename Format>
+void SurfaceT<Format>::_gamma() requires (Format::FLOAT || Format::SRGB) {
+    if constexpr (Format::SRGB) return;
+
     for (int i=0; i<surfSize; i++) {
-        _surfData[i].r = std::powf(_surfData[i].r, 1.f/2.2f);
-        _surfData[i].g = std::powf(_surfData[i].g, 1.f/2.2f);
-        _surfData[i].b = std::powf(_surfData[i].b, 1.f/2.2f);
+        Color c = Format::decode(_surfData[i]);
+        c.r = std::powf(c.r, 1.f/2.2f);
+        c.g = std::powf(c.g, 1.f/2.2f);
+        c.b = std::powf(c.b, 1.f/2.2f);
+        _surfData[i] = Format::encode(c);
+    }
+}
+
+template <typename Format>
+void SurfaceT<Format>::_toBytes(const Pixel &pixel, uint8_t &r, uint8_t &g, uint8_t &b) const {
+    // 8 bit formats store display bytes, sRGB ones or linear ones after tonemapping
+    if constexpr (std::is_same_v<Pixel, Byte4>) {
+        r = pixel.r;
+        g = pixel.g;
+        b = pixel.b;
+    }
+    else if constexpr (std::is_same_v<Pixel, uint32_t>) {
+        r = (uint8_t) (((pixel & 0x3FF)*255 + 511)/1023);
+        g = (uint8_t) ((((pixel >> 10) & 0x3FF)*255 + 511)/1023);
+        b = (uint8_t) ((((pixel >> 20) & 0x3FF)*255 + 511)/1023);
+    }
+    else {
+        Color c = Format::decode(pixel) * 255.f;
+        r = std::max(0, std::min(int(c.r), 255));
+        g = std::max(0, std::min(int(c.g), 255));
+        b = std::max(0, std::min(int(c.b), 255));
     }
 }
 
 
+// Cohen-Sutherland, against the surface grown by `margin` pixels on every side
+template <typename Format>
+bool SurfaceT<Format>::_clipLine(int &x0, int &y0, int &x1, int &y1, int margin) const {
+    const int xMin = -margin;
+    const int yMin = -margin;
+    const int xMax = surfWidth - 1 + margin;
+    const int yMax = surfHeight - 1 + margin;
+
+    auto outCode = [&](int x, int y) {
+        return (x < xMin) | (x > xMax) << 1 | (y < yMin) << 2 | (y > yMax) << 3;
+    };
+
+    int code0 = outCode(x0, y0);
+    int code1 = outCode(x1, y1);
+
+    // Every round puts one endpoint on an edge, 4 are enough
+    for (int i = 0; i < 4; i++) {
+        if ( !(code0 | code1) ) return true;
+        if (code0 & code1) return false;
+
+        int code = code0 ? code0 : code1;
+        int64_t dx = x1 - x0;
+        int64_t dy = y1 - y0;
+        int64_t x, y;
+
+        if (code & 8)      { y = yMax; x = x0 + dx*(yMax - y0)/dy; }
+        else if (code & 4) { y = yMin; x = x0 + dx*(yMin - y0)/dy; }
+        else if (code & 2) { x = xMax; y = y0 + dy*(xMax - x0)/dx; }
+        else               { x = xMin; y = y0 + dy*(xMin - x0)/dx; }
+
+        if (code == code0) {
+            x0 = (int) x;
+            y0 = (int) y;
+            code0 = outCode(x0, y0);
+        }
+        else {
+            x1 = (int) x;
+            y1 = (int) y;
+            code1 = outCode(x1, y1);
+        }
+    }
+
+    return !(code0 | code1);
+}
+
 
 // --------- Public Methods ---------
-void Surface::tonemap() {
+template <typename Format>
+void SurfaceT<Format>::tonemap() requires (Format::FLOAT || Format::SRGB) {
     // this->_aces();  // ACES TMO
     // this->_reinhard();  // Reinhard TMO
     this->_gamma();
 }
 
-void Surface::toU32Surface(uint32_t *buffer) {
+template <typename Format>
+void SurfaceT<Format>::heatmap(float maxValue) {
+    static const Color RAMP[5] = {
+        Color(0.f, 0.f, 0.f), Color(0.f, 0.2f, 1.f), Color(0.f, 0.9f, 0.2f), Color(1.f, 0.9f, 0.f), Color(1.f, 0.f, 0.f)
+    };
+
+    float scale = (maxValue > 0.f) ? 4.f/maxValue : 0.f;
+
+    for (int i=0; i<surfSize; i++) {
+        float t = std::clamp(Format::decode(_surfData[i]).r*scale, 0.f, 4.f);
+        int k = std::min((int) t, 3);
+        _surfData[i] = Format::encode( RAMP[k] + (t - k)*(RAMP[k+1] - RAMP[k]) );
+    }
+}
+
+// Box filter of the `sampleCount` samples of every pixel, then the same operator as tonemap()
+template <typename Format>
+void SurfaceT<Format>::tonemap(const Color *samples, int sampleCount) {
+    float invCount = 1.f/sampleCount;
+
+    for (int i=0; i<surfSize; i++) {
+        const Color *pixel = samples + i*sampleCount;
+
+        Color sum(0.f);
+        for (int s=0; s<sampleCount; s++) {
+            sum += pixel[s];
+        }
+        sum *= invCount;
+
+        if constexpr ( !Format::SRGB ) {
+            sum.r = std::powf(sum.r, 1.f/2.2f);
+            sum.g = std::powf(sum.g, 1.f/2.2f);
+            sum.b = std::powf(sum.b, 1.f/2.2f);
+        }
+
+        _surfData[i] = Format::encode(sum);
+    }
+}
+
+// The gamma is already applied, quantizing now keeps the steps even on screen
+template <typename Format>
+void SurfaceT<Format>::encodeDisplay(const Color *display, int begin, int end) {
+    for (int i=begin; i<end; i++) {
+        Color c = display[i];
+
+        if constexpr (Format::SRGB) {
+            c.r = std::powf(std::max(c.r, 0.f), 2.2f);
+            c.g = std::powf(std::max(c.g, 0.f), 2.2f);
+            c.b = std::powf(std::max(c.b, 0.f), 2.2f);
+        }
+
+        _surfData[i] = Format::encode(c);
+    }
+}
+
+template <typename Format>
+void SurfaceT<Format>::toU32Surface(uint32_t *buffer) {
     uint8_t r;
     uint8_t g;
     uint8_t b;
 
     for (int i=0; i<surfSize; i++) {
 
-        r = std::max(0, std::min(int(_surfData[i].r * 255.f), 255));
-        g = std::max(0, std::min(int(_surfData[i].g * 255.f), 255));
-        b = std::max(0, std::min(int(_surfData[i].b * 255.f), 255));
+        this->_toBytes(_surfData[i], r, g, b);
 
         buffer[i] = (uint32_t) (r<<24) | (g<<16) | (b<<8) | 0xFF;
     }
 }
 
 
+template <typename Format>
+void SurfaceT<Format>::toRGB8(uint8_t *bytes) {
+    for (int i=0; i<surfSize; i++) {
+        this->_toBytes(_surfData[i], bytes[3*i], bytes[3*i + 1], bytes[3*i + 2]);  // R, G, B
+    }
+}
+
+
 // Saving
-int Surface::saveFloatBuffer(const char* file_path) {
+template <typename Format>
+int SurfaceT<Format>::saveFloatBuffer(const char* file_path) {
     FILE *file = fopen(file_path, "wb");
     if (file == NULL) {
         return -1;
@@ -97,13 +244,25 @@ int Surface::saveFloatBuffer(const char* file_path) {
     int dim[2] = {surfWidth, surfHeight};
     fwrite(dim, sizeof(int)*2, 1, file);
 
-    fwrite(_surfData, sizeof(float)*size, 1, file);
+    if constexpr (std::is_same_v<Format, PixelRGB32F>) {
+        fwrite(_surfData, sizeof(float)*size, 1, file);
+    }
+    else {
+        Color *floats = new Color[surfSize];
+        for (int i=0; i<surfSize; i++) {
+            floats[i] = Format::decode(_surfData[i]);
+        }
+
+        fwrite(floats, sizeof(float)*size, 1, file);
+        delete[] floats;
+    }
     fclose(file);
 
     return 0;
 }
 
-int Surface::savePPM(const char* file_path) {
+template <typename Format>
+int SurfaceT<Format>::savePPM(const char* file_path) {
     FILE *file = fopen(file_path, "wb");
     if (file == NULL) {
         return -1;
@@ -112,14 +271,7 @@ int Surface::savePPM(const char* file_path) {
     fprintf(file, "P6\n%d %d\n255\n", surfWidth, surfHeight);
     uint8_t *bytes = new uint8_t[3 * surfSize];
 
-    int j=0;
-    Color c;
-    for (int i=0; i<surfSize; i++) {
-        c = _surfData[i] * 255.f;
-        bytes[j++] = std::max(0, std::min(0xff, int(c.r)));  // R
-        bytes[j++] = std::max(0, std::min(0xff, int(c.g)));  // G
-        bytes[j++] = std::max(0, std::min(0xff, int(c.b)));  // B
-    }
+    this->toRGB8(bytes);
 
     fwrite(bytes, 3*surfSize*sizeof(uint8_t), 1, file);
     fclose(file);
@@ -128,17 +280,11 @@ int Surface::savePPM(const char* file_path) {
     return 0;
 }
 
-int Surface::savePNG(const char* file_name) {
+template <typename Format>
+int SurfaceT<Format>::savePNG(const char* file_name) {
     uint8_t *bytes = new uint8_t[3 * surfSize];
-    Color c;
-
-    int j = 0;
-    for (int i = 0; i < surfSize; i++) {
-        c = _surfData[i] * 255.f;
-        bytes[j++] = std::max(0, std::min(0xff, (int)c.r));  // R
-        bytes[j++] = std::max(0, std::min(0xff, (int)c.g));  // G
-        bytes[j++] = std::max(0, std::min(0xff, (int)c.b));  // B
-    }
+
+    this->toRGB8(bytes);
 
     stbi_write_png(file_name, surfWidth, surfHeight, 3, bytes, 3*surfWidth*sizeof(uint8_t));
     delete[] bytes;
@@ -147,86 +293,149 @@ int Surface::savePNG(const char* file_name) {
 
 
 // Drawing Methods
-void Surface::setAt(int x, int y, const Color &color) {
-    _SET_SURF_AT(x, y, color);
+template <typename Format>
+void SurfaceT<Format>::setAt(int x, int y, const Color &color) {
+    _SET_SURF_AT(x, y, Format::encode(color));
 }
 
 
-void Surface::fill(const Color &color) {
-	for (int i=0; i<surfSize; ++i) {
-		_surfData[i] = color;
+template <typename Format>
+void SurfaceT<Format>::fill(const Color &color) {
+	const Pixel pixel = Format::encode(color);
+
+	if (_clipX0 == 0 && _clipY0 == 0 && _clipX1 == surfWidth && _clipY1 == surfHeight) {
+		std::fill(_surfData, _surfData + surfSize, pixel);
+		return;
+	}
+
+	for (int y=_clipY0; y<_clipY1; y++) {
+		std::fill(_surfData + y*surfWidth + _clipX0, _surfData + y*surfWidth + _clipX1, pixel);
 	}
 }
 
-void Surface::fillNoise() {
+template <typename Format>
+void SurfaceT<Format>::setClip(int x0, int y0, int x1, int y1) {
+	_clipX0 = std::max(0, x0);
+	_clipY0 = std::max(0, y0);
+	_clipX1 = std::max(_clipX0, std::min(surfWidth, x1));
+	_clipY1 = std::max(_clipY0, std::min(surfHeight, y1));
+}
+
+template <typename Format>
+void SurfaceT<Format>::fillNoise() {
 	srand(time(NULL));
 	for (int i = 0; i < surfSize; ++i) {
-		_surfData[i] = randColor();
+		_surfData[i] = Format::encode(randColor());
 	}
 }
 
 
 // Lines
 
-// TODO: Excessive error checking required
 // _DRAW_LINE(int x0, int y0, int x1, int y1, const Color &color, int lineWidth);
-#define _DRAW_LINE(x0, y0, x1, y1, color, lineWidth) {      \
-    if (x0 < 0 || x0 >= surfWidth  ||                       \
-        x1 < 0 || x1 >= surfWidth  ||                       \
-        y0 < 0 || y0 >= surfHeight ||                       \
-        y1 < 0 || y1 >= surfHeight  ) {                     \
-        return;                                             \
-    }                                                       \
-                                                            \
-    int startX = x0;                                        \
-    int startY = y0;                                        \
-    int endX = x1;                                          \
-    int endY = y1;                                          \
-                                                            \
-    int dx = abs(endX - startX);                            \
-    int dy = abs(endY - startY);                            \
-                                                            \
-    if (dx == 0 && dy == 0) {                               \
-        _SET_SURF_AT(startX, startY, color);                \
-        return;                                             \
-    }                                                       \
-                                                            \
-    int sx = (startX < endX) ? 1 : -1;                      \
-    int sy = (startY < endY) ? 1 : -1;                      \
-    int err = dx - dy;                                      \
-                                                            \
-    for (int i = 0; i < lineWidth; i++) {                   \
-        int x = startX;                                     \
-        int y = startY;                                     \
-                                                            \
-        while (x != endX || y != endY) {                    \
-            _SET_SURF_AT(x, y, color);                      \
-                                                            \
-            int err2 = 2 * err;                             \
-            if (err2 > -dy) {                               \
-                err -= dy;                                  \
-                x += sx;                                    \
-            }                                               \
-            if (err2 < dx) {                                \
-                err += dx;                                  \
-                y += sy;                                    \
-            }                                               \
-        }                                                   \
-                                                            \
-        _SET_SURF_AT(endX, endY, color);                    \
-                                                            \
-        startX += sy;                                       \
-        endX += sy;                                         \
-        startY -= sx;                                       \
-        endY -= sx;                                         \
-    }                                                       \
-}                                                           \
-
-void Surface::drawLine(int x0, int y0, int x1, int y1, const Color &color, int lineWidth) {
+// Clipped to the surface grown by the half width, then one Bresenham pass. Wide lines set a span
+// across the minor axis at every step, horizontal and vertical lines fill their rectangle directly.
+// The pass only walks the part of the line over the clip rectangle, pixels outside it are skipped
+#define _DRAW_LINE(x0, y0, x1, y1, color, lineWidth) {                      \
+    if (lineWidth < 1) return;                                              \
+                                                                            \
+    int startX = x0;                                                        \
+    int startY = y0;                                                        \
+    int endX = x1;                                                          \
+    int endY = y1;                                                          \
+                                                                            \
+    int margin = lineWidth/2;                                               \
+    if ( !_clipLine(startX, startY, endX, endY, margin) ) return;           \
+                                                                            \
+    /* Nothing inside the clip rectangle */                                 \
+    if (std::max(startX, endX) + margin < _clipX0 ||                        \
+        std::min(startX, endX) - margin >= _clipX1 ||                       \
+        std::max(startY, endY) + margin < _clipY0 ||                        \
+        std::min(startY, endY) - margin >= _clipY1) return;                 \
+                                                                            \
+    const Pixel pixel = Format::encode(color);                              \
+    int before = (lineWidth - 1)/2;                                         \
+    int after = lineWidth - 1 - before;                                     \
+                                                                            \
+    int dx = abs(endX - startX);                                            \
+    int dy = abs(endY - startY);                                            \
+                                                                            \
+    if (dx == 0 || dy == 0) {                                               \
+        int xSt = std::min(startX, endX) - (dx == 0 ? before : 0);          \
+        int xEn = std::max(startX, endX) + (dx == 0 ? after : 0);           \
+        int ySt = std::min(startY, endY) - (dx == 0 ? 0 : before);          \
+        int yEn = std::max(startY, endY) + (dx == 0 ? 0 : after);           \
+                                                                            \
+        xSt = std::max(_clipX0, xSt);                                       \
+        ySt = std::max(_clipY0, ySt);                                       \
+        xEn = std::min(_clipX1 - 1, xEn);                                   \
+        yEn = std::min(_clipY1 - 1, yEn);                                   \
+        if (xSt > xEn) return;                                              \
+                                                                            \
+        for (int y = ySt; y <= yEn; y++) {                                  \
+            Pixel *row = _surfData + y*surfWidth;                           \
+            std::fill(row + xSt, row + xEn + 1, pixel);                     \
+        }                                                                   \
+        return;                                                             \
+    }                                                                       \
+                                                                            \
+    bool xMajor = (dx >= dy);                                               \
+    int sx = (startX < endX) ? 1 : -1;                                      \
+    int sy = (startY < endY) ? 1 : -1;                                      \
+    int err = dx - dy;                                                      \
+                                                                            \
+    int x = startX;                                                         \
+    int y = startY;                                                         \
+                                                                            \
+    /* Steps before the clip rectangle, in closed form */                   \
+    int skip = xMajor ? (sx > 0 ? _clipX0 - startX : startX - _clipX1 + 1)  \
+                      : (sy > 0 ? _clipY0 - startY : startY - _clipY1 + 1); \
+    skip = std::min(skip, xMajor ? dx : dy);                                \
+    if (skip > 0) {                                                         \
+        int n = xMajor ? (2*dy*skip + dx - 1)/(2*dx)                        \
+                       : (2*dx*skip + dy - 1)/(2*dy);                       \
+        x += sx*(xMajor ? skip : n);                                        \
+        y += sy*(xMajor ? n : skip);                                        \
+        err = xMajor ? dx - dy*(skip + 1) + n*dx                            \
+                     : dx*(skip + 1) - dy - n*dy;                           \
+    }                                                                       \
+                                                                            \
+    /* Last major coordinate that can reach the clip rectangle */           \
+    int stop = xMajor ? (sx > 0 ? _clipX1 : _clipX0 - 1)                    \
+                      : (sy > 0 ? _clipY1 : _clipY0 - 1);                   \
+                                                                            \
+    while (true) {                                                          \
+        for (int k = -before; k <= after; k++) {                            \
+            int px = xMajor ? x : x + k;                                    \
+            int py = xMajor ? y + k : y;                                    \
+            if (px >= _clipX0 && px < _clipX1 &&                            \
+                py >= _clipY0 && py < _clipY1) {                            \
+                _SET_SURF_AT(px, py, pixel);                                \
+            }                                                               \
+        }                                                                   \
+                                                                            \
+        if (x == endX && y == endY) break;                                  \
+        if ((xMajor ? x : y) == stop) break;                                \
+                                                                            \
+        int err2 = 2 * err;                                                 \
+        if (err2 > -dy) {                                                   \
+            err -= dy;                                                      \
+            x += sx;                                                        \
+        }                                                                   \
+        if (err2 < dx) {                                                    \
+            err += dx;                                                      \
+            y += sy;                                                        \
+        }                                                                   \
+    }                                                                       \
+}                                                                           \
+
+template <typename Format>
+void SurfaceT<Format>::drawLine(int x0, int y0, int x1, int y1, const Color &color, int lineWidth) {
     _DRAW_LINE(x0,y0, x1,y1, color, lineWidth);
 }
 
-void Surface::drawLine(const Vec3 &v1, const Vec3 &v2, const Color &color, int lineWidth) {
+template <typename Format>
+void SurfaceT<Format>::drawLine(const Vec3 &v1, const Vec3 &v2, const Color &color, int lineWidth) {
     const int &x0 = v1.x;
     const int &y0 = v1.y;
     const int &x1 = v2.x;
@@ -235,7 +444,8 @@ void Surface::drawLine(const Vec3 &v1, const Vec3 &v2, const Color &color, int l
     _DRAW_LINE(x0,y0, x1,y1, color, lineWidth);
 }
 
-void Surface::drawLine(const Line &line, const Color &color, int lineWidth) {
+template <typename Format>
+void SurfaceT<Format>::drawLine(const Line &line, const Color &color, int lineWidth) {
     const int &x0 = line.x0;
     const int &y0 = line.y0;
     const int &x1 = line.x1;
@@ -248,49 +458,54 @@ void Surface::drawLine(const Line &line, const Color &color, int lineWidth) {
 // Circles
 
 // _DRAW_CIRCLE(int x, int y, int r, const Color &color, int thickness)
-#define _DRAW_CIRCLE(x0, y0, r, color, thickness){          \
-    if ( (r < 1) || (thickness < 1) ) return;               \
-                                                            \
-    int y_st = std::max(0, std::min( surfHeight, y0 - r));  \
-    int y_en = std::max(0, std::min( surfHeight, y0+r+1 )); \
-    int x_st = std::max(0, std::min( surfWidth,  x0 - r));  \
-    int x_en = std::max(0, std::min( surfWidth,  x0+r+1 )); \
-                                                            \
-    int r_sq = r*r + 1;                                     \
-    int rt_sq = (r-thickness)*(r-thickness);                \
-                                                            \
-    int d_sq;                                               \
-                                                            \
-    for (int y=y_st; y<y_en; y++) {                         \
-        for (int x=x_st; x<x_en; x++) {                     \
-                                                            \
-            d_sq = (x-x0)*(x-x0) + (y-y0)*(y-y0);           \
-            if ( (d_sq>rt_sq)  && (d_sq<r_sq) ) {           \
-                _SET_SURF_AT(x, y, color);                  \
-            }                                               \
-        }                                                   \
-    }                                                       \
-}                                                           \
-
-void Surface::drawCircle(int x0, int y0, int r, const Color &color, int thickness) {
+#define _DRAW_CIRCLE(x0, y0, r, color, thickness){             \
+    if ( (r < 1) || (thickness < 1) ) return;                  \
+                                                               \
+    int y_st = std::max(_clipY0, std::min( _clipY1, y0 - r));  \
+    int y_en = std::max(_clipY0, std::min( _clipY1, y0+r+1 )); \
+    int x_st = std::max(_clipX0, std::min( _clipX1, x0 - r));  \
+    int x_en = std::max(_clipX0, std::min( _clipX1, x0+r+1 )); \
+                                                               \
+    const Pixel pixel = Format::encode(color);                 \
+    int r_sq = r*r + 1;                                        \
+    int rt_sq = (r-thickness)*(r-thickness);                   \
+                                                               \
+    int d_sq;                                                  \
+                                                               \
+    for (int y=y_st; y<y_en; y++) {                            \
+        for (int x=x_st; x<x_en; x++) {                        \
+                                                               \
+            d_sq = (x-x0)*(x-x0) + (y-y0)*(y-y0);              \
+            if ( (d_sq>rt_sq)  && (d_sq<r_sq) ) {              \
+                _SET_SURF_AT(x, y, pixel);                     \
+            }                                                  \
+        }                                                      \
+    }                                                          \
+}                                                              \
+
+template <typename Format>
+void SurfaceT<Format>::drawCircle(int x0, int y0, int r, const Color &color, int thickness) {
     _DRAW_CIRCLE(x0, y0, r, color, thickness);
 }
 
-void Surface::drawCircle(const Vec3 &pos_vec, int r, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawCircle(const Vec3 &pos_vec, int r, const Color &color, int thickness) {
     const int &x0 = pos_vec.x;
     const int &y0 = pos_vec.y;
 
     _DRAW_CIRCLE(x0, y0, r, color, thickness);
 }
 
-void Surface::drawCircle(const Vec2 &pos_vec, int r, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawCircle(const Vec2 &pos_vec, int r, const Color &color, int thickness) {
     const int &x0 = pos_vec.x;
     const int &y0 = pos_vec.y;
 
     _DRAW_CIRCLE(x0, y0, r, color, thickness);
 }
 
-void Surface::drawCircle(const Circle &circle, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawCircle(const Circle &circle, const Color &color, int thickness) {
     const int &x0 = circle.x;
     const int &y0 = circle.y;
     const int &r = circle.r;
@@ -300,46 +515,51 @@ void Surface::drawCircle(const Circle &circle, const Color &color, int thickness
 
 
 // _FILL_CIRCLE(int x0, int y0, int r, const Color &color)
-#define _FILL_CIRCLE(x0, y0, r, color){                       \
-    if ( r < 1 )  return;                                     \
-                                                              \
-    int y_st = std::max(0, std::min( surfHeight, y0 - r));    \
-    int y_en = std::max(0, std::min( surfHeight, y0+r+1 ));   \
-    int x_st = std::max(0, std::min( surfWidth,  x0 - r));    \
-    int x_en = std::max(0, std::min( surfWidth,  x0+r+1 ));   \
-                                                              \
-    int r_sq = r*r + 1;                                       \
-    int d_sq;                                                 \
-                                                              \
-    for (int y=y_st; y<y_en; y++) {                           \
-        for (int x=x_st; x<x_en; x++) {                       \
-            d_sq = (x-x0)*(x-x0) + (y-y0)*(y-y0);             \
-            if ( d_sq < r_sq ) {                              \
-                _SET_SURF_AT( x, y, color);                   \
-            }                                                 \
-        }                                                     \
-    }                                                         \
-}                                                             \
-
-void Surface::fillCircle(int x0, int y0, int r, const Color &color) {
+#define _FILL_CIRCLE(x0, y0, r, color){                        \
+    if ( r < 1 )  return;                                      \
+                                                               \
+    int y_st = std::max(_clipY0, std::min( _clipY1, y0 - r));  \
+    int y_en = std::max(_clipY0, std::min( _clipY1, y0+r+1 )); \
+    int x_st = std::max(_clipX0, std::min( _clipX1, x0 - r));  \
+    int x_en = std::max(_clipX0, std::min( _clipX1, x0+r+1 )); \
+                                                               \
+    const Pixel pixel = Format::encode(color);                 \
+    int r_sq = r*r + 1;                                        \
+    int d_sq;                                                  \
+                                                               \
+    for (int y=y_st; y<y_en; y++) {                            \
+        for (int x=x_st; x<x_en; x++) {                        \
+            d_sq = (x-x0)*(x-x0) + (y-y0)*(y-y0);              \
+            if ( d_sq < r_sq ) {                               \
+                _SET_SURF_AT( x, y, pixel);                    \
+            }                                                  \
+        }                                                      \
+    }                                                          \
+}                                                              \
+
+template <typename Format>
+void SurfaceT<Format>::fillCircle(int x0, int y0, int r, const Color &color) {
     _FILL_CIRCLE(x0, y0, r, color);
 }
 
-void Surface::fillCircle(const Vec3 &pos_vec, int r, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillCircle(const Vec3 &pos_vec, int r, const Color &color) {
     const int &x0 = pos_vec.x;
     const int &y0 = pos_vec.y;
 
     _FILL_CIRCLE(x0, y0, r, color);
 }
 
-void Surface::fillCircle(const Vec2 &pos_vec, int r, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillCircle(const Vec2 &pos_vec, int r, const Color &color) {
     const int &x0 = pos_vec.x;
     const int &y0 = pos_vec.y;
 
     _FILL_CIRCLE(x0, y0, r, color);
 }
 
-void Surface::fillCircle(const Circle &circle, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillCircle(const Circle &circle, const Color &color) {
     const int &x0 = circle.x;
     const int &y0 = circle.y;
     const int &r  = circle.r;
@@ -358,11 +578,13 @@ void Surface::fillCircle(const Circle &circle, const Color &color) {
     this->drawLine(x0+w, y0, x0+w, y0+h, color, thickness);     \
 }                                                               \
 
-void Surface::drawRect(int x0, int y0, int w, int h, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawRect(int x0, int y0, int w, int h, const Color &color, int thickness) {
     _DRAW_RECT(x0,y0, w,h, color, thickness);
 }
 
-void Surface::drawRect(const Vec3 &pos_vec, const Vec3 &size_vec, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawRect(const Vec3 &pos_vec, const Vec3 &size_vec, const Color &color, int thickness) {
     const int &x0 = pos_vec.x;
     const int &y0 = pos_vec.y;
     const int &w = size_vec.x;
@@ -371,7 +593,8 @@ void Surface::drawRect(const Vec3 &pos_vec, const Vec3 &size_vec, const Color &c
     _DRAW_RECT(x0,y0, w,h, color, thickness);
 }
 
-void Surface::drawRect(const Rect &rect, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawRect(const Rect &rect, const Color &color, int thickness) {
     const int &x0 = rect.x;
     const int &y0 = rect.y;
     const int &w = rect.w;
@@ -382,25 +605,28 @@ void Surface::drawRect(const Rect &rect, const Color &color, int thickness) {
 
 
 // _FILL_RECT(int x0, int y0, int w, int h, const Color &color)
-#define _FILL_RECT(x0, y0, w, h, color) {     \
-    int xSt = std::max(0, x0);                \
-    int ySt = std::max(0, y0);                \
-                                              \
-    int xEn = std::min(surfWidth, xSt+w);     \
-    int yEn = std::min(surfHeight, ySt+h);    \
-                                              \
-    for (int y=ySt; y<yEn; y++) {             \
-        for (int x=xSt; x<xEn; x++) {         \
-            _SET_SURF_AT(x,y,color);          \
-        }                                     \
-    }                                         \
-}                                             \
-
-void Surface::fillRect(int x0, int y0, int w, int h, const Color &color) {
+#define _FILL_RECT(x0, y0, w, h, color) {      \
+    const Pixel pixel = Format::encode(color); \
+    int xSt = std::max(_clipX0, x0);           \
+    int ySt = std::max(_clipY0, y0);           \
+                                               \
+    int xEn = std::min(_clipX1, x0+w);         \
+    int yEn = std::min(_clipY1, y0+h);         \
+                                               \
+    for (int y=ySt; y<yEn; y++) {              \
+        for (int x=xSt; x<xEn; x++) {          \
+            _SET_SURF_AT(x,y,pixel);           \
+        }                                      \
+    }                                          \
+}                                              \
+
+template <typename Format>
+void SurfaceT<Format>::fillRect(int x0, int y0, int w, int h, const Color &color) {
     _FILL_RECT(x0,y0, w,h, color);
 }
 
-void Surface::fillRect(const Vec3 &pos_vec, const Vec3 &size_vec, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillRect(const Vec3 &pos_vec, const Vec3 &size_vec, const Color &color) {
     const int x0 = pos_vec.x;
     const int y0 = pos_vec.y;
     const int w = size_vec.x;
@@ -409,7 +635,8 @@ void Surface::fillRect(const Vec3 &pos_vec, const Vec3 &size_vec, const Color &c
     _FILL_RECT(x0,y0, w,h, color);
 }
 
-void Surface::fillRect(const Rect &rect, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillRect(const Rect &rect, const Color &color) {
     const int x0 = rect.x;
     const int y0 = rect.y;
     const int w = rect.w;
@@ -428,11 +655,13 @@ void Surface::fillRect(const Rect &rect, const Color &color) {
     this->drawLine(x0, y0, x2, y2, color, thickness);       \
 }                                                           \
 
-void Surface::drawTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color, int thickness) {
     _DRAW_TRIS(x0,y0, x1,y1, x2,y2, color, thickness);
 }
 
-void Surface::drawTris(const Vec3 &v1, const Vec3 &v2, const Vec3 &v3, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawTris(const Vec3 &v1, const Vec3 &v2, const Vec3 &v3, const Color &color, int thickness) {
     const int &x0 = v1.x;
     const int &y0 = v1.y;
     const int &x1 = v2.x;
@@ -443,7 +672,8 @@ void Surface::drawTris(const Vec3 &v1, const Vec3 &v2, const Vec3 &v3, const Col
     _DRAW_TRIS(x0,y0, x1,y1, x2,y2, color, thickness);
 }
 
-void Surface::drawTris(const Vec2 &v1, const Vec2 &v2, const Vec2 &v3, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawTris(const Vec2 &v1, const Vec2 &v2, const Vec2 &v3, const Color &color, int thickness) {
     const int &x0 = v1.x;
     const int &y0 = v1.y;
     const int &x1 = v2.x;
@@ -454,7 +684,8 @@ void Surface::drawTris(const Vec2 &v1, const Vec2 &v2, const Vec2 &v3, const Col
     _DRAW_TRIS(x0,y0, x1,y1, x2,y2, color, thickness);
 }
 
-void Surface::drawTris(const Tris2D &tris, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawTris(const Tris2D &tris, const Color &color, int thickness) {
     const int &x0 = tris.v1.x;
     const int &y0 = tris.v1.y;
     const int &x1 = tris.v2.x;
@@ -465,7 +696,8 @@ void Surface::drawTris(const Tris2D &tris, const Color &color, int thickness) {
     _DRAW_TRIS(x0,y0, x1,y1, x2,y2, color, thickness);
 }
 
-void Surface::drawTris(const Tris2D_i &tris, const Color &color, int thickness) {
+template <typename Format>
+void SurfaceT<Format>::drawTris(const Tris2D_i &tris, const Color &color, int thickness) {
     const int &x0 = tris.x0;
     const int &y0 = tris.y0;
     const int &x1 = tris.x1;
@@ -508,11 +740,13 @@ void Surface::drawTris(const Tris2D_i &tris, const Color &color, int thickness)
     }                                                                           \
 }                                                                               \
 
-void Surface::fillTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillTris(int x0, int y0, int x1, int y1, int x2, int y2, const Color &color) {
     _FILL_TRIS(x0,y0, x1,y1, x2,y2, color);
 }
 
-void Surface::fillTris(const Vec3 &v1, const Vec3 &v2, const Vec3 &v3, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillTris(const Vec3 &v1, const Vec3 &v2, const Vec3 &v3, const Color &color) {
     int x0 = v1.x;
     int y0 = v1.y;
     int x1 = v2.x;
@@ -523,7 +757,8 @@ void Surface::fillTris(const Vec3 &v1, const Vec3 &v2, const Vec3 &v3, const Col
     _FILL_TRIS(x0,y0, x1,y1, x2,y2, color);
 }
 
-void Surface::fillTris(const Vec2 &v1, const Vec2 &v2, const Vec2 &v3, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillTris(const Vec2 &v1, const Vec2 &v2, const Vec2 &v3, const Color &color) {
     int x0 = v1.x;
     int y0 = v1.y;
     int x1 = v2.x;
@@ -534,7 +769,8 @@ void Surface::fillTris(const Vec2 &v1, const Vec2 &v2, const Vec2 &v3, const Col
     _FILL_TRIS(x0,y0, x1,y1, x2,y2, color);
 }
 
-void Surface::fillTris(const Tris2D &tris, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillTris(const Tris2D &tris, const Color &color) {
     int x0 = tris.v1.x;
     int y0 = tris.v1.y;
     int x1 = tris.v2.x;
@@ -545,7 +781,8 @@ void Surface::fillTris(const Tris2D &tris, const Color &color) {
     _FILL_TRIS(x0,y0, x1,y1, x2,y2, color);
 }
 
-void Surface::fillTris(const Tris2D_i &tris, const Color &color) {
+template <typename Format>
+void SurfaceT<Format>::fillTris(const Tris2D_i &tris, const Color &color) {
     int x0 = tris.x0;
     int y0 = tris.y0;
     int x1 = tris.x1;
@@ -555,3 +792,11 @@ void Surface::fillTris(const Tris2D_i &tris, const Color &color) {
 
     _FILL_TRIS(x0,y0, x1,y1, x2,y2, color);
 }
+
+
+// One instantiation per pixel format of surface.hpp
+template class SurfaceT<PixelRGB32F>;
+template class SurfaceT<PixelRGBA16F>;
+template class SurfaceT<PixelRGB10A2>;
+template class SurfaceT<PixelRGBA8>;
+template class SurfaceT<PixelSRGBA8>;
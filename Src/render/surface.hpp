@@ -2,34 +2,62 @@
 
 #include "../math/vec.hpp"
 #include "../math/color.hpp"
+#include "pixel.hpp"
 #include "../primitives/line.hpp"
 #include "../primitives/tris.hpp"
 #include "../primitives/rect.hpp"
 #include "../primitives/circle.hpp"
 
 
-class Surface {
+/*
+Image of `Format::Type` pixels (see pixel.hpp), colours go through
+Format::encode() on the way in and Format::decode() on the way out.
+Instantiated for every format in surface.cpp.
+*/
+template <typename Format>
+class SurfaceT {
 
 	public:
+		using Pixel = typename Format::Type;
+
 		int surfWidth;
 		int surfHeight;
 		int surfSize;
 		float surfAspectRatio;
 
 	private:
-		Color *_surfData;
+		Pixel *_surfData;
+
+		// Clip rectangle [x0, x1) x [y0, y1), the whole surface by default
+		int _clipX0;
+		int _clipY0;
+		int _clipX1;
+		int _clipY1;
 
 
 	//Methods
 	public:
-		Surface();
-		Surface(Color* data, int w, int h);
+		SurfaceT();
+		SurfaceT(Pixel* data, int w, int h);
+
+		Pixel *data() { return _surfData; }
+
+		// tonemapping, sRGB formats already store the display encoding and skip the gamma.
+		// Linear unorm formats quantized the colours before the gamma and would band, they are
+		// filled from float colours with the two below instead
+		void tonemap() requires (Format::FLOAT || Format::SRGB);
+		void tonemap(const Color *samples, int sampleCount);	// Resolves MSAA samples in the same pass
+
+		// Stores the display values (tonemapped) of pixels [begin, end), sRGB formats take linear colours back first
+		void encodeDisplay(const Color *display, int begin, int end);
 
-		// tonemapping
-		void tonemap();
+		// Debug views, the red channel of every pixel is a value, replaced by a colour
+		// from black (0) through blue, green and yellow to red (`maxValue` and above)
+		void heatmap(float maxValue);
 
 		// conversion
 		void toU32Surface(uint32_t* buffer);
+		void toRGB8(uint8_t *bytes);	// 3 bytes per pixel, for the image files
 
 
 		// Saving
@@ -40,10 +68,19 @@ class Surface {
 
 		// Drawing Methods
 		void setAt(int x, int y, const Color &color);
+		Color getAt(int x, int y) const { return Format::decode( _surfData[y*surfWidth + x] ); }
 
 		void fill(const Color &color);
 		void fillNoise();
 
+		/*
+		The drawing methods below only touch the pixels inside the clip rectangle.
+		Shapes are still traced against the whole surface, so drawing one through
+		several clip rectangles gives the same pixels as drawing it at once
+		*/
+		void setClip(int x0, int y0, int x1, int y1);
+		void resetClip() { this->setClip(0, 0, surfWidth, surfHeight); }
+
 
 		void drawLine(int x0, int y0, int x1, int y1, const Color &color, int lineWidth);
 		void drawLine(const Vec3 &v1, const Vec3 &v2, const Color &color, int lineWidth);
@@ -86,5 +123,18 @@ class Surface {
 	private:
 		void _aces();
 		void _reinhard();
-		void _gamma();
+		void _gamma() requires (Format::FLOAT || Format::SRGB);
+
+		// 8 bit display values of a pixel, for the conversion and the image files
+		void _toBytes(const Pixel &pixel, uint8_t &r, uint8_t &g, uint8_t &b) const;
+
+		// Clips the line to the surface grown by `margin`, false when nothing is left
+		bool _clipLine(int &x0, int &y0, int &x1, int &y1, int margin) const;
 };
+
+
+using Surface        = SurfaceT<PixelRGB32F>;	// Render target of the engine
+using SurfaceRGBA16F = SurfaceT<PixelRGBA16F>;
+using SurfaceRGB10A2 = SurfaceT<PixelRGB10A2>;
+using SurfaceRGBA8   = SurfaceT<PixelRGBA8>;
+using SurfaceSRGBA8  = SurfaceT<PixelSRGBA8>;
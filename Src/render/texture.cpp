@@ -0,0 +1,298 @@
+#include <cmath>
+#include <bit>
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "STB/stb_image.h"
+
+#include "texture.hpp"
+#include "../math/vec.hpp"
+
+
+float TEXTURE_SRGB[256];
+
+static std::atomic<uint32_t> nextTextureId = 1;
+
+[[maybe_unused]] static const bool _srgbReady = [] {
+	for (int i=0; i<256; i++) {
+		float c = i/255.f;
+		TEXTURE_SRGB[i] = (c <= 0.04045f) ? c/12.92f : std::pow((c + 0.055f)/1.055f, 2.4f);
+	}
+	return true;
+}();
+
+
+// ------ Linear Space Helpers ------
+
+static inline uint8_t encodeSRGB(float c) {
+	c = std::clamp(c, 0.f, 1.f);
+	c = (c <= 0.0031308f) ? 12.92f*c : 1.055f*std::pow(c, 1.f/2.4f) - 0.055f;
+	return (uint8_t) (c*255.f + 0.5f);
+}
+
+static inline Vec4 toLinear(uint32_t texel) {
+	return Vec4(Texture::decode(texel), ((texel >> 24) & 0xFF)/255.f);
+}
+
+static inline uint32_t toTexel(const Vec4 &c) {
+	uint32_t a = (uint32_t) (std::clamp(c.a, 0.f, 1.f)*255.f + 0.5f);
+	return encodeSRGB(c.r) | (encodeSRGB(c.g) << 8) | (encodeSRGB(c.b) << 16) | (a << 24);
+}
+
+
+// Constructors and Destructors
+Texture::Texture() {
+	id = nextTextureId++;
+	layout = TextureLayout::TILED;
+	format = TextureFormat::RGBA8;
+	levelCount = 0;
+}
+
+Texture::~Texture() {}
+
+
+// Methods
+bool Texture::load(const std::string &path, TextureLayout layout) {
+	if (path.size() > 4 && path.compare(path.size() - 4, 4, ".dds") == 0) {
+		BlockFormat block;
+		int w = 0, h = 0, count = 0;
+		std::vector<uint8_t> data;
+
+		if ( !readDDS(path, block, w, h, count, data) ) return false;
+
+		if ( !std::has_single_bit((uint32_t) w) || !std::has_single_bit((uint32_t) h) ) {
+			std::cerr << "Failed to load the texture " << path << ": compressed textures need power of two sizes" << std::endl;
+			return false;
+		}
+
+		this->format = (block == BlockFormat::BC1) ? TextureFormat::BC1 : (block == BlockFormat::BC4) ? TextureFormat::BC4 : TextureFormat::BC5;
+		this->layoutBlocks(w, h, count);
+		this->blocks = std::move(data);
+		this->texels.clear();
+
+		std::cout << "  Texture: " << path << ", " << w << "x" << h << ", " << levelCount << " levels, "
+			<< this->memorySize()/1024 << " KB compressed" << std::endl;
+
+		return true;
+	}
+
+	int w = 0, h = 0, channels = 0;
+	uint8_t *pixels = stbi_load(path.c_str(), &w, &h, &channels, 4);
+
+	if (pixels == nullptr) {
+		std::cerr << "Failed to load the texture " << path << ": " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+
+	std::vector<uint32_t> rgba((size_t) w*h);
+	for (size_t i=0; i<rgba.size(); i++) {
+		const uint8_t *p = pixels + 4*i;
+		rgba[i] = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+	}
+	stbi_image_free(pixels);
+
+	this->create(rgba.data(), w, h, layout);
+
+	std::cout << "  Texture: " << path << ", " << w << "x" << h;
+	if (w != this->width() || h != this->height()) std::cout << " resized to " << this->width() << "x" << this->height();
+	std::cout << ", " << levelCount << " levels, " << this->memorySize()/1024 << " KB" << std::endl;
+
+	return true;
+}
+
+void Texture::create(const uint32_t *rgba, int w, int h, TextureLayout layout) {
+	this->layout = layout;
+	this->format = TextureFormat::RGBA8;
+	this->blocks.clear();
+
+	int pw = std::min( (int) std::bit_ceil((uint32_t) w), 1 << (TEXTURE_MAX_LEVELS - 1) );
+	int ph = std::min( (int) std::bit_ceil((uint32_t) h), 1 << (TEXTURE_MAX_LEVELS - 1) );
+
+	if (pw == w && ph == h) {
+		this->build(std::vector<uint32_t>(rgba, rgba + (size_t) w*h), w, h);
+		return;
+	}
+
+	// Bilinear resampling up to powers of two, in linear space
+	std::vector<uint32_t> base((size_t) pw*ph);
+
+	for (int y=0; y<ph; y++) {
+		float sy = std::max(0.f, (y + 0.5f)*h/ph - 0.5f);
+		int y0 = std::min((int) sy, h - 1);
+		int y1 = std::min(y0 + 1, h - 1);
+		float fy = sy - y0;
+
+		for (int x=0; x<pw; x++) {
+			float sx = std::max(0.f, (x + 0.5f)*w/pw - 0.5f);
+			int x0 = std::min((int) sx, w - 1);
+			int x1 = std::min(x0 + 1, w - 1);
+			float fx = sx - x0;
+
+			Vec4 top = glm::mix(toLinear(rgba[y0*w + x0]), toLinear(rgba[y0*w + x1]), fx);
+			Vec4 bot = glm::mix(toLinear(rgba[y1*w + x0]), toLinear(rgba[y1*w + x1]), fx);
+			base[y*pw + x] = toTexel( glm::mix(top, bot, fy) );
+		}
+	}
+
+	this->build(base, pw, ph);
+}
+
+void Texture::build(const std::vector<uint32_t> &base, int w, int h) {
+	// Level sizes and offsets, down to 1x1
+	levelCount = 0;
+	uint32_t total = 0;
+
+	for (int lw=w, lh=h; levelCount < TEXTURE_MAX_LEVELS; lw = std::max(1, lw/2), lh = std::max(1, lh/2)) {
+		TextureLevel &level = levels[levelCount++];
+		level.width = lw;
+		level.height = lh;
+		level.tilesX = std::max(1, lw/TEXTURE_TILE);
+		level.blocksX = 0;
+		level.offset = total;
+
+		if (layout == TextureLayout::TILED) {
+			total += level.tilesX * std::max(1, lh/TEXTURE_TILE) * TEXTURE_TILE*TEXTURE_TILE;
+		}
+		else {
+			total += lw*lh;
+		}
+
+		if (lw == 1 && lh == 1) break;
+	}
+
+	texels.assign(total, 0);
+
+	// Every level from the previous one (row-major), then stored in the layout
+	std::vector<uint32_t> current = base, next;
+
+	for (int l=0; l<levelCount; l++) {
+		const TextureLevel &level = levels[l];
+
+		for (int y=0; y<level.height; y++) {
+			for (int x=0; x<level.width; x++) {
+				texels[ this->index(level, x, y) ] = current[y*level.width + x];
+			}
+		}
+
+		if (l + 1 == levelCount) break;
+
+		// 2x2 box filter, 2x1 once one side is down to a texel
+		const TextureLevel &down = levels[l + 1];
+		int sx = level.width / down.width;
+		int sy = level.height / down.height;
+		next.resize((size_t) down.width*down.height);
+
+		for (int y=0; y<down.height; y++) {
+			for (int x=0; x<down.width; x++) {
+				Vec4 sum(0.f);
+				for (int j=0; j<sy; j++) {
+					for (int i=0; i<sx; i++) {
+						sum += toLinear( current[(y*sy + j)*level.width + x*sx + i] );
+					}
+				}
+				next[y*down.width + x] = toTexel( sum/float(sx*sy) );
+			}
+		}
+
+		std::swap(current, next);
+	}
+}
+
+void Texture::layoutBlocks(int w, int h, int count) {
+	int bytes = blockBytes( Texture::blockFormat(format) );
+	levelCount = 0;
+	uint32_t total = 0;
+
+	for (int lw=w, lh=h; levelCount < std::min(count, TEXTURE_MAX_LEVELS); lw = std::max(1, lw/2), lh = std::max(1, lh/2)) {
+		TextureLevel &level = levels[levelCount++];
+		level.width = lw;
+		level.height = lh;
+		level.tilesX = 0;
+		level.blocksX = (lw + BC_BLOCK - 1)/BC_BLOCK;
+		level.offset = total;
+
+		total += level.blocksX * ((lh + BC_BLOCK - 1)/BC_BLOCK) * bytes;
+	}
+}
+
+void Texture::compress(TextureFormat format) {
+	if (this->compressed() || format == TextureFormat::RGBA8) return;
+
+	int count = levelCount;
+	this->format = format;
+	TextureLevel source[TEXTURE_MAX_LEVELS];
+	std::copy(levels, levels + count, source);
+
+	this->layoutBlocks(levels[0].width, levels[0].height, count);
+	const TextureLevel &last = levels[levelCount - 1];
+	blocks.assign(last.offset + last.blocksX * ((last.height + BC_BLOCK - 1)/BC_BLOCK) * blockBytes( Texture::blockFormat(format) ), 0);
+
+	for (int l=0; l<levelCount; l++) {
+		const TextureLevel &level = levels[l];
+		int blocksY = (level.height + BC_BLOCK - 1)/BC_BLOCK;
+		uint8_t *out = blocks.data() + level.offset;
+
+		for (int by=0; by<blocksY; by++) {
+			for (int bx=0; bx<level.blocksX; bx++) {
+				// Levels under 4 texels repeat their texels across the block
+				uint32_t block[16];
+				for (int j=0; j<BC_BLOCK; j++) {
+					for (int i=0; i<BC_BLOCK; i++) {
+						int x = (bx*BC_BLOCK + i) & (level.width - 1);
+						int y = (by*BC_BLOCK + j) & (level.height - 1);
+						block[j*BC_BLOCK + i] = texels[ this->index(source[l], x, y) ];
+					}
+				}
+
+				if (format == TextureFormat::BC1) {
+					encodeBC1(block, out);
+				}
+				else {
+					uint8_t r[16], g[16];
+					for (int k=0; k<16; k++) {
+						r[k] = block[k] & 0xFF;
+						g[k] = (block[k] >> 8) & 0xFF;
+					}
+
+					encodeBC4(r, out);
+					if (format == TextureFormat::BC5) encodeBC4(g, out + 8);
+				}
+
+				out += blockBytes( Texture::blockFormat(format) );
+			}
+		}
+	}
+
+	texels.clear();
+	texels.shrink_to_fit();
+}
+
+bool Texture::save(const std::string &path) const {
+	if ( !this->compressed() ) {
+		std::cerr << "Only compressed textures are saved, " << path << " skipped" << std::endl;
+		return false;
+	}
+
+	return writeDDS(path, Texture::blockFormat(format), this->width(), this->height(), levelCount, blocks);
+}
+
+BlockFormat Texture::blockFormat(TextureFormat format) {
+	switch (format) {
+		case TextureFormat::BC4: return BlockFormat::BC4;
+		case TextureFormat::BC5: return BlockFormat::BC5;
+		default: return BlockFormat::BC1;
+	}
+}
+
+bool Texture::parseFormat(const std::string &name, TextureFormat &format) {
+	if (name == "rgba8") format = TextureFormat::RGBA8;
+	else if (name == "bc1") format = TextureFormat::BC1;
+	else if (name == "bc4") format = TextureFormat::BC4;
+	else if (name == "bc5") format = TextureFormat::BC5;
+	else return false;
+
+	return true;
+}
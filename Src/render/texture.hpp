@@ -0,0 +1,138 @@
+// Textures with their mip chain, texels stored in Morton order inside small tiles or in 4x4 compressed blocks
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "../math/color.hpp"
+#include "../io/blockcodec.hpp"
+
+
+#define TEXTURE_TILE 8				// Tile size in texels, a tile is 256 bytes (4 cache lines)
+#define TEXTURE_MAX_LEVELS 16		// 32768 texels wide at most
+
+
+enum class TextureLayout : uint8_t {
+	TILED,		// Tiles in row-major order, texels of a tile in Morton order
+	ROW_MAJOR,	// Plain rows, the reference layout of the benchmark
+};
+
+enum class TextureFormat : uint8_t {
+	RGBA8,		// 4 bytes per texel in `texels`
+	BC1,		// Compressed blocks in `blocks`, see blockcodec.hpp
+	BC4,
+	BC5,
+};
+
+class TextureLevel {
+	public:
+		int width;
+		int height;
+		int tilesX;			// Tiles of a row (TILED)
+		int blocksX;		// Blocks of a row (compressed formats)
+		uint32_t offset;	// First texel in Texture::texels, or first byte in Texture::blocks
+};
+
+
+/*
+RGBA8 texels (R in the low byte), sRGB encoded like the image files they come from.
+Sizes are rounded up to powers of two at load time, addressing then wraps with masks,
+and the mips are box filtered in linear space down to 1x1.
+Compressed textures keep only their blocks, in row-major order at every level (the
+layout is then unused), the sampler decodes them a block at a time
+*/
+class Texture {
+	// Constructors / Destructors
+	public:
+		Texture();
+		~Texture();
+
+	// Attributes
+	public:
+		std::string name;
+		uint32_t id;					// Unique, tags the decoded blocks of the sampler cache
+		TextureLayout layout;
+		TextureFormat format;
+
+		int levelCount;
+		TextureLevel levels[TEXTURE_MAX_LEVELS];
+		std::vector<uint32_t> texels;	// Every level, level 0 first (RGBA8)
+		std::vector<uint8_t> blocks;	// Every level, level 0 first (compressed formats)
+
+	// Methods
+	public:
+		// Image file through stb_image, or a DDS file of compressed blocks
+		bool load(const std::string &path, TextureLayout layout = TextureLayout::TILED);
+
+		// `rgba` is w*h texels, row-major, resized to powers of two when needed
+		void create(const uint32_t *rgba, int w, int h, TextureLayout layout = TextureLayout::TILED);
+
+		// Compresses every level of an RGBA8 texture and drops its texels
+		void compress(TextureFormat format);
+
+		// DDS file of a compressed texture
+		bool save(const std::string &path) const;
+
+		int width() const { return levels[0].width; }
+		int height() const { return levels[0].height; }
+		bool compressed() const { return format != TextureFormat::RGBA8; }
+
+		// Bytes of texel data
+		size_t memorySize() const { return texels.size()*sizeof(uint32_t) + blocks.size(); }
+
+		static BlockFormat blockFormat(TextureFormat format);
+		static bool parseFormat(const std::string &name, TextureFormat &format);
+
+		// Texel (x, y) of `level`, x and y already wrapped into the level (RGBA8)
+		inline uint32_t texel(int level, int x, int y) const {
+			return texels[ this->index(levels[level], x, y) ];
+		}
+
+		// Linear colour of an RGBA8 texel
+		static inline Color decode(uint32_t texel);
+
+		// Position of texel (x, y) of `level` in `texels`, for a layout known at compile time
+		template <TextureLayout LAYOUT>
+		inline uint32_t indexOf(const TextureLevel &level, int x, int y) const;
+
+	private:
+		inline uint32_t index(const TextureLevel &level, int x, int y) const;
+
+		// Rebuilds `texels` from the row-major level 0 in `base`
+		void build(const std::vector<uint32_t> &base, int w, int h);
+
+		// Level sizes and block offsets of a w*h compressed texture
+		void layoutBlocks(int w, int h, int count);
+};
+
+
+// sRGB byte to linear, filled before main()
+extern float TEXTURE_SRGB[256];
+
+inline Color Texture::decode(uint32_t texel) {
+	return Color(TEXTURE_SRGB[texel & 0xFF], TEXTURE_SRGB[(texel >> 8) & 0xFF], TEXTURE_SRGB[(texel >> 16) & 0xFF]);
+}
+
+// Morton order of the texels of a tile, the bits of x and y interleaved (x in the even bits)
+static constexpr uint8_t MORTON_SPREAD[TEXTURE_TILE] = {0, 1, 4, 5, 16, 17, 20, 21};
+
+template <TextureLayout LAYOUT>
+inline uint32_t Texture::indexOf(const TextureLevel &level, int x, int y) const {
+	if constexpr (LAYOUT == TextureLayout::ROW_MAJOR) {
+		return level.offset + y*level.width + x;
+	}
+	else {
+		// Unsigned, the divisions become shifts
+		uint32_t ux = x, uy = y;
+		uint32_t tile = (uy / TEXTURE_TILE)*level.tilesX + (ux / TEXTURE_TILE);
+		uint32_t inTile = MORTON_SPREAD[ux % TEXTURE_TILE] | (MORTON_SPREAD[uy % TEXTURE_TILE] << 1);
+		return level.offset + tile*(TEXTURE_TILE*TEXTURE_TILE) + inTile;
+	}
+}
+
+inline uint32_t Texture::index(const TextureLevel &level, int x, int y) const {
+	if (layout == TextureLayout::ROW_MAJOR) return this->indexOf<TextureLayout::ROW_MAJOR>(level, x, y);
+	return this->indexOf<TextureLayout::TILED>(level, x, y);
+}
@@ -0,0 +1,84 @@
+#include <cmath>
+
+#include "instance.hpp"
+
+
+// Affine transform of one block, `w` is 1 for points and 0 for directions
+static inline void transformBlock(const Vec3 *in, Vec3 *out, const float *m, float w) {
+	float x[INSTANCE_BLOCK], y[INSTANCE_BLOCK], z[INSTANCE_BLOCK];
+
+	// Interleaved to planar
+	for (int k=0; k<INSTANCE_BLOCK; k++) {
+		x[k] = in[k].x;
+		y[k] = in[k].y;
+		z[k] = in[k].z;
+	}
+
+	float ox[INSTANCE_BLOCK], oy[INSTANCE_BLOCK], oz[INSTANCE_BLOCK];
+	for (int k=0; k<INSTANCE_BLOCK; k++) {
+		ox[k] = m[0]*x[k] + m[3]*y[k] + m[6]*z[k] + m[9]*w;
+		oy[k] = m[1]*x[k] + m[4]*y[k] + m[7]*z[k] + m[10]*w;
+		oz[k] = m[2]*x[k] + m[5]*y[k] + m[8]*z[k] + m[11]*w;
+	}
+
+	for (int k=0; k<INSTANCE_BLOCK; k++) {
+		out[k] = Vec3(ox[k], oy[k], oz[k]);
+	}
+}
+
+static inline void normalizeBlock(Vec3 *v) {
+	float len[INSTANCE_BLOCK];
+	for (int k=0; k<INSTANCE_BLOCK; k++) {
+		len[k] = std::sqrt(v[k].x*v[k].x + v[k].y*v[k].y + v[k].z*v[k].z);
+		len[k] = (len[k] > 0.f) ? 1.f/len[k] : 0.f;
+	}
+
+	for (int k=0; k<INSTANCE_BLOCK; k++) {
+		v[k] *= len[k];
+	}
+}
+
+void transformVerticies(const Vec3 *verticies, const Vec3 *normals, int count, const glm::mat4 &m, const glm::mat3 &n, bool rigid, Vec3 *outVerticies, Vec3 *outNormals) {
+	// Columns of the upper 3x3 and then the translation
+	const float pm[12] = {
+		m[0][0], m[0][1], m[0][2],
+		m[1][0], m[1][1], m[1][2],
+		m[2][0], m[2][1], m[2][2],
+		m[3][0], m[3][1], m[3][2],
+	};
+	const float pn[12] = {
+		n[0][0], n[0][1], n[0][2],
+		n[1][0], n[1][1], n[1][2],
+		n[2][0], n[2][1], n[2][2],
+		0.f, 0.f, 0.f,
+	};
+
+	int i = 0;
+	for (; i + INSTANCE_BLOCK <= count; i += INSTANCE_BLOCK) {
+		transformBlock(verticies + i, outVerticies + i, pm, 1.f);
+		transformBlock(normals + i, outNormals + i, pn, 0.f);
+		if ( !rigid ) normalizeBlock(outNormals + i);
+	}
+
+	// Remaining verticies
+	for (; i < count; i++) {
+		outVerticies[i] = Vec3( m * Vec4(verticies[i], 1.f) );
+		outNormals[i] = n * normals[i];
+		if ( !rigid ) {
+			float len = glm::length(outNormals[i]);
+			outNormals[i] = (len > 0.f) ? outNormals[i]/len : Vec3(0.f);
+		}
+	}
+}
+
+bool isRigid(const glm::mat4 &m) {
+	glm::mat3 r(m);
+	glm::mat3 rtr = glm::transpose(r) * r;
+
+	for (int c=0; c<3; c++) {
+		for (int l=0; l<3; l++) {
+			if (std::abs(rtr[c][l] - (c == l ? 1.f : 0.f)) > 1E-4F) return false;
+		}
+	}
+	return true;
+}
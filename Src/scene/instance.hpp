@@ -0,0 +1,45 @@
+// Instances of the mesh library, laid out in the flat buffers of the engine. The library is shared,
+// the transformed verticies and triangles of the frames still grow with the instances
+
+#pragma once
+
+#include <cstdint>
+
+#include "../math/vec.hpp"
+
+
+#define INSTANCE_BLOCK 8		// Verticies of a block of the transform kernel
+#define INSTANCE_BATCH 4096		// Verticies (or triangles) a transform task takes, across instances
+
+
+// A mesh of the library, stored once whatever its instance count
+struct MeshRange {
+	uint32_t firstVertex;	// Into the library verticies, normals and UVs
+	uint32_t vertexCount;
+	uint32_t firstIndex;	// Into the library indices, which are relative to `firstVertex`
+	uint32_t triangleCount;
+	uint32_t firstEdge;		// Into the edge list (wireframe only)
+	uint32_t edgeCount;
+	Vec3 min;				// Bounds (model space)
+	Vec3 max;
+};
+
+// One placement of a mesh, its verticies and triangles get their own range of the frame buffers
+struct Instance {
+	glm::mat4 transform;	// Mesh to scene model space
+	uint32_t mesh;			// Index into the mesh library
+	uint32_t object;		// Scene object, gives the material
+	uint32_t firstVertex;	// Into the transformed verticies of a frame
+	uint32_t firstTriangle;	// Into the triangles of a frame
+	bool rigid;				// No scale or shear, normals keep their length
+};
+
+
+/*
+`count` verticies and normals through `m` (normals through `n`), renormalized unless `rigid`.
+Written as fixed width blocks of planar floats so the compiler vectorizes them
+*/
+void transformVerticies(const Vec3 *verticies, const Vec3 *normals, int count, const glm::mat4 &m, const glm::mat3 &n, bool rigid, Vec3 *outVerticies, Vec3 *outNormals);
+
+// Whether `m` only rotates and translates
+bool isRigid(const glm::mat4 &m);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+#include "../math/vec.hpp"
+#include "../math/color.hpp"
+
+
+enum class LightType {
+	DIRECTIONAL,	// Infinitely far, lights everything along `direction`
+	POINT,			// Lights every direction up to `range`
+	SPOT,			// Point light limited to a cone around `direction`
+};
+
+
+class Light {
+	public:
+		LightType type;
+		Vec3 position;
+		Vec3 direction;		// Direction the light travels in
+		Color color;
+		float intensity;
+		float range;		// Distance at which POINT and SPOT lights fade out
+		float cosOuter;		// Cosine of the SPOT cone half angle
+		float cosInner;		// Cosine of the angle the SPOT cone starts fading at
+		bool castShadows;	// Renders a shadow map (DIRECTIONAL and SPOT only)
+
+	public:
+		Light() :
+			type(LightType::DIRECTIONAL),
+			position(0.f), direction(0.f, 0.f, -1.f),
+			color(1.f), intensity(1.f), range(10.f),
+			cosOuter(std::cos(0.5f)), cosInner(std::cos(0.4f)),
+			castShadows(false) {}
+
+		// Light arriving at `pos` on a surface facing `normal`
+		Color illuminate(const Vec3 &pos, const Vec3 &normal) const {
+			if (type == LightType::DIRECTIONAL) {
+				return color * (intensity * std::max(0.f, glm::dot(normal, -direction)));
+			}
+
+			Vec3 toLight = position - pos;
+			float dist = glm::length(toLight);
+			if (dist >= range) return Color(0.f);
+
+			Vec3 l = toLight / dist;
+			float nDotL = glm::dot(normal, l);
+			if (nDotL <= 0.f) return Color(0.f);
+
+			// Smooth window, reaches 0 at `range`
+			float fade = 1.f - dist/range;
+			float attenuation = fade*fade;
+
+			if (type == LightType::SPOT) {
+				float cosAngle = glm::dot(-l, direction);
+				if (cosAngle <= cosOuter) return Color(0.f);
+				attenuation *= std::min(1.f, (cosAngle - cosOuter) / std::max(1E-4F, cosInner - cosOuter));
+			}
+
+			return color * (intensity * attenuation * nDotL);
+		}
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../math/color.hpp"
+#include "../render/state.hpp"
+
+
+enum class ShadingModel {
+	FLAT,		// Lit once per triangle with the face normal
+	GOURAUD,	// Lit per vertex, colour interpolated across the triangle
+	PHONG,		// Normal interpolated across the triangle, lit per pixel
+	NORMAL,		// Interpolated normal as colour (debug)
+	UV,			// Interpolated UVs as colour (debug)
+};
+
+
+class Material {
+	public:
+		ShadingModel shading;
+		BlendMode blend;
+		Color color;
+		int texture;	// Scene texture multiplying `color`, -1 for none
+
+	public:
+		Material() : shading(ShadingModel::FLAT), blend(BlendMode::OPAQUE), color(1.f), texture(-1) {}
+};
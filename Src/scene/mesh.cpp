@@ -2,10 +2,15 @@
 
 // Constructors and Destructors
 Mesh::Mesh() {
+	name = "";
+	firstVertex = 0;
 	vertexCount = 0;
 	indexCount = 0;
 	triangleCount = 0;
 	indices  = nullptr;
+
+	hasNormals = false;
+	hasUVs = false;
 }
 
 Mesh::~Mesh() {
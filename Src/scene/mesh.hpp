@@ -1,6 +1,6 @@
 #pragma once
 
-// #include <string>
+#include <string>
 #include <cstdint>
 
 #include "../math/vec.hpp"
@@ -15,11 +15,18 @@ class Mesh {
 
 	// Attributes
 	public:
-		uint32_t vertexCount;
+		std::string name;
+
+		uint32_t firstVertex;	// First scene vertex it uses
+		uint32_t vertexCount;	// Scene verticies from `firstVertex` on
 		uint32_t indexCount;
 		uint32_t triangleCount;
 
-		uint32_t *indices;
+		uint32_t *indices;		// Relative to `firstVertex`, shared by every instance
+
+		// Per vertex attributes found in the scene file
+		bool hasNormals;
+		bool hasUVs;
 
 	// Methods
 	public:
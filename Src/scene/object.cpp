@@ -7,10 +7,7 @@
 Object::Object() {
 	name = "";
 	id = rand();
-	mesh = nullptr;
+	mesh = 0;
 }
 
-Object::~Object() {
-	delete mesh;
-	mesh = nullptr;
-}
+Object::~Object() {}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <cstdint>
 
+#include "../math/vec.hpp"
 #include "mesh.hpp"
+#include "material.hpp"
 
 class Object {
 	// Constructors / Destructors
@@ -15,7 +18,9 @@ class Object {
 	public:
 		std::string name;
 		uint32_t id;
-		Mesh *mesh;
+		uint32_t mesh;						// Index into the mesh library of the scene
+		std::vector<glm::mat4> transforms;	// One per instance, mesh to scene model space
+		Material material;
 
 	// Methods
 	public:
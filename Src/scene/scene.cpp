@@ -2,6 +2,7 @@
 #include <iostream>
 #include <string>
 #include <cstdint>
+#include <algorithm>
 
 
 #include "nlohmann_json/json.hpp" // downloaded from https://github.com/nlohmann/json
@@ -17,8 +18,17 @@ Scene::Scene() {
 	sceneVertexCount = 0;
 	sceneTriangleCount = 0;
 	sceneObjectCount = 0;
+	sceneMeshCount = 0;
+	sceneInstanceCount = 0;
+	sceneLightCount = 0;
+	sceneTextureCount = 0;
 	sceneVerticies = nullptr;
+	sceneNormals = nullptr;
+	sceneUVs = nullptr;
+	sceneMeshes = nullptr;
 	sceneObjects = nullptr;
+	sceneLights = nullptr;
+	sceneTextures = nullptr;
 	name = "default";
 }
 
@@ -27,6 +37,121 @@ Scene::~Scene() {
 }
 
 
+// Helpers
+static Vec3 readVec3(const json &data, const char *key, const Vec3 &fallback) {
+	if ( !data.contains(key) || !data[key].is_array() || data[key].size() != 3 ) {
+		return fallback;
+	}
+
+	const auto &v = data[key];
+	return Vec3(v[0], v[1], v[2]);
+}
+
+// Position, rotation (in degrees, applied X, then Y, then Z) and scale (a number or per axis)
+static glm::mat4 readTransform(const json &data) {
+	Vec3 position = readVec3(data, "position", Vec3(0.f));
+	Vec3 rotation = readVec3(data, "rotation", Vec3(0.f));
+
+	Vec3 scale(1.f);
+	if (data.contains("scale") && data["scale"].is_number()) scale = Vec3( data["scale"].get<float>() );
+	else scale = readVec3(data, "scale", scale);
+
+	glm::mat4 transform = glm::translate(glm::mat4(1.f), position);
+	transform = glm::rotate(transform, glm::radians(rotation.z), Vec3(0.f, 0.f, 1.f));
+	transform = glm::rotate(transform, glm::radians(rotation.y), Vec3(0.f, 1.f, 0.f));
+	transform = glm::rotate(transform, glm::radians(rotation.x), Vec3(1.f, 0.f, 0.f));
+	return glm::scale(transform, scale);
+}
+
+// Indices of a mesh, made relative to the first scene vertex they use
+static bool readMesh(const json &data, Mesh &mesh, uint32_t sceneVertexCount) {
+	uint32_t vertexCount = data.value("vertexCount", -1);
+	uint32_t indexCount = data.value("indexCount", -1);
+	uint32_t triangleCount = data.value("triangleCount", -1);
+
+	if (vertexCount <= 0 || indexCount <= 0 || triangleCount <= 0) {
+		std::cerr << "No vertex or triangle in the mesh: '" << mesh.name << "'\n";
+		return false;
+	}
+
+	// Validate arrays
+	if ( !data.contains("indices") || !data["indices"].is_array()) {
+		std::cerr << "Invalid indices format in scene file." << std::endl;
+		return false;
+	}
+
+	// Validate counts
+	if (data["indices"].size() != indexCount || indexCount != triangleCount*3) {
+		std::cerr << "Index count mismatch in scene file." << std::endl;
+		std::cerr << "Expected " << triangleCount*3 << " values, got " << data["indices"].size() << std::endl;
+		return false;
+	}
+
+	const auto &indices = data["indices"];
+	mesh.indexCount = indexCount;
+	mesh.triangleCount = triangleCount;
+	mesh.indices = new uint32_t[mesh.indexCount];
+
+	uint32_t first = UINT32_MAX, last = 0;
+	for (uint32_t j=0; j<mesh.indexCount; j++) {
+		mesh.indices[j] = indices[j];
+		first = std::min(first, mesh.indices[j]);
+		last = std::max(last, mesh.indices[j]);
+	}
+
+	if (last >= sceneVertexCount) {
+		std::cerr << "Index " << last << " out of the " << sceneVertexCount << " scene verticies in the mesh: '" << mesh.name << "'\n";
+		return false;
+	}
+
+	for (uint32_t j=0; j<mesh.indexCount; j++) {
+		mesh.indices[j] -= first;
+	}
+
+	mesh.firstVertex = first;
+	mesh.vertexCount = last - first + 1;
+
+	std::cout
+		<< "  Mesh Vertex Count: " << mesh.vertexCount
+		<< ", Mesh Index Count: " << mesh.indexCount
+		<< ", Mesh Triangle Count: " << mesh.triangleCount
+		<< std::endl;
+
+	return true;
+}
+
+static bool readLight(const json &data, Light &light) {
+	std::string type = data.value("type", "point");
+	if      (type == "directional") light.type = LightType::DIRECTIONAL;
+	else if (type == "point")       light.type = LightType::POINT;
+	else if (type == "spot")        light.type = LightType::SPOT;
+	else {
+		std::cerr << "Unknown light type '" << type << "' in scene file." << std::endl;
+		return false;
+	}
+
+	light.position  = readVec3(data, "position", light.position);
+	light.direction = glm::normalize( readVec3(data, "direction", light.direction) );
+	light.color     = readVec3(data, "color", light.color);
+	light.intensity = data.value("intensity", light.intensity);
+	light.range     = data.value("range", light.range);
+
+	// Cone half angles in degrees
+	float angle = data.value("angle", 30.f);
+	float blend = data.value("blend", 0.15f);	// Fraction of the cone that fades out
+	light.cosOuter = std::cos( glm::radians(angle) );
+	light.cosInner = std::cos( glm::radians(angle * (1.f - blend)) );
+
+	light.castShadows = data.value("shadows", false);
+	if (light.castShadows && light.type == LightType::POINT) {
+		std::cerr << "Point lights can not cast shadows, ignoring." << std::endl;
+		light.castShadows = false;
+	}
+
+	return true;
+}
+
+
 // Methods
 bool Scene::loadJSONScene(const char *filename) {
 	this->unload();
@@ -97,77 +222,275 @@ bool Scene::loadJSONScene(const char *filename) {
 		v.z = verts[j++];
 	}
 
-	for (uint32_t i=0; i<sceneObjectCount; i++) {
+	// Optional per vertex attributes
+	if (data.contains("normals")) {
+		const auto& norms = data["normals"];
+
+		if ( !norms.is_array() || norms.size() != sceneVertexCount*3 ) {
+			std::cerr << "Normal count mismatch in scene file." << std::endl;
+			std::cerr << "Expected " << sceneVertexCount*3 << " values, got " << norms.size() << std::endl;
+			return false;
+		}
+
+		sceneNormals = new Vec3[sceneVertexCount];
+		for (uint32_t i=0, j=0; i<sceneVertexCount; i++) {
+			Vec3 &n = sceneNormals[i];
+			n.x = norms[j++];
+			n.y = norms[j++];
+			n.z = norms[j++];
+			n = glm::normalize(n);
+		}
+	}
+
+	if (data.contains("uvs")) {
+		const auto& uvs = data["uvs"];
+
+		if ( !uvs.is_array() || uvs.size() != sceneVertexCount*2 ) {
+			std::cerr << "UV count mismatch in scene file." << std::endl;
+			std::cerr << "Expected " << sceneVertexCount*2 << " values, got " << uvs.size() << std::endl;
+			return false;
+		}
+
+		sceneUVs = new Vec2[sceneVertexCount];
+		for (uint32_t i=0, j=0; i<sceneVertexCount; i++) {
+			Vec2 &uv = sceneUVs[i];
+			uv.x = uvs[j++];
+			uv.y = uvs[j++];
+		}
+	}
+
+	// Textures, the files are relative to the scene file
+	if (data.contains("textures")) {
+		const auto &textures = data["textures"];
+
+		if ( !textures.is_array() ) {
+			std::cerr << "Invalid textures format in scene file." << std::endl;
+			return false;
+		}
+
+		std::string dir = filename;
+		size_t slash = dir.find_last_of("/\\");
+		dir = (slash == std::string::npos) ? "" : dir.substr(0, slash + 1);
+
+		// Named here for the objects, their files load later (Texture::load on sceneTextureFiles)
+		sceneTextureCount = textures.size();
+		sceneTextures = new Texture[sceneTextureCount];
+
+		for (uint32_t i=0; i<sceneTextureCount; i++) {
+			sceneTextures[i].name = textures[i].value("name", "");
+			sceneTextureFiles.push_back(dir + textures[i].value("file", ""));
+		}
+	}
+
+	// Mesh library, the shared meshes first and then one per object with its own indices
+	const json noMeshes = json::array();
+	const auto &meshes = (data.contains("meshes") && data["meshes"].is_array()) ? data["meshes"] : noMeshes;
+
+	sceneMeshCount = meshes.size();
+	for (const auto &objData : objs) {
+		if ( !objData.contains("mesh") ) sceneMeshCount++;
+	}
+
+	sceneMeshes = new Mesh[sceneMeshCount];
+
+	for (uint32_t i=0; i<sceneMeshCount; i++) {
+		sceneMeshes[i].hasNormals = (sceneNormals != nullptr);
+		sceneMeshes[i].hasUVs = (sceneUVs != nullptr);
+	}
+
+	for (uint32_t i=0; i<meshes.size(); i++) {
+		Mesh &mesh = sceneMeshes[i];
+		mesh.name = meshes[i].value("name", "");
+		std::cout << "\nLoading Mesh: '" << mesh.name << "'\n";
+
+		if ( !readMesh(meshes[i], mesh, sceneVertexCount) ) {
+			return false;
+		}
+	}
+
+	for (uint32_t i=0, m=meshes.size(); i<sceneObjectCount; i++) {
 		auto objData = objs[i];
 		Object &obj = sceneObjects[i];
 
-		obj.mesh = new Mesh();
-		Mesh &mesh = *obj.mesh;
-
 		auto objName = objData.value("name", "");
 		obj.name = objName;
+		obj.id = i;
 		std::cout << "\nLoading Object: '" << objName << "'\n";
 
-		uint32_t vertexCount = objData.value("vertexCount", -1);
-		uint32_t indexCount = objData.value("indexCount", -1);
-		uint32_t triangleCount = objData.value("triangleCount", -1);
-		obj.id = i;
+		// A mesh of the library by name, or its own
+		if (objData.contains("mesh")) {
+			std::string meshName = objData.value("mesh", "");
+			uint32_t j = 0;
+			while (j < meshes.size() && sceneMeshes[j].name != meshName) j++;
+
+			if (j == meshes.size()) {
+				std::cerr << "Unknown mesh '" << meshName << "' in the object: '" << objName << "'\n";
+				return false;
+			}
+			obj.mesh = j;
+		}
+		else {
+			obj.mesh = m++;
+			sceneMeshes[obj.mesh].name = objName;
 
-		if (vertexCount <= 0 || indexCount <= 0 || triangleCount <= 0) {
-			std::cerr << "No vertex or triangle in the object: '" << objName << "'\n";
-			return false;
+			if ( !readMesh(objData, sceneMeshes[obj.mesh], sceneVertexCount) ) {
+				return false;
+			}
 		}
 
+		// Instances, each with its own transform, or the object once
+		if (objData.contains("instances")) {
+			if ( !objData["instances"].is_array() ) {
+				std::cerr << "Invalid instances format in the object: '" << objName << "'\n";
+				return false;
+			}
 
-		// Validate counts
-		if (objData["indices"].size() != indexCount) {
-			std::cerr << "Index count mismatch in scene file." << std::endl;
-			std::cerr << "Expected " << indexCount*3 << " values, got " << objData["indices"].size() << std::endl;
-			return false;
+			for (const auto &instance : objData["instances"]) {
+				obj.transforms.push_back( readTransform(instance) );
+			}
+		}
+		else {
+			obj.transforms.push_back( readTransform(objData) );
 		}
 
-		// Validate arrays
-		if ( !objData["indices"].is_array()) {
-			std::cerr << "Invalid indices format in scene file." << std::endl;
-			return false;
+		// Material
+		std::string shading = objData.value("shading", "flat");
+		if      (shading == "flat")    obj.material.shading = ShadingModel::FLAT;
+		else if (shading == "gouraud") obj.material.shading = ShadingModel::GOURAUD;
+		else if (shading == "phong")   obj.material.shading = ShadingModel::PHONG;
+		else if (shading == "normal")  obj.material.shading = ShadingModel::NORMAL;
+		else if (shading == "uv")      obj.material.shading = ShadingModel::UV;
+		else {
+			std::cerr << "Unknown shading '" << shading << "' in the object: '" << objName << "', using flat\n";
 		}
 
-		mesh.vertexCount = vertexCount;
-		mesh.indexCount = indexCount;
-		mesh.triangleCount = triangleCount;
-		std::cout
-			<< "  Mesh Vertex Count: " << mesh.vertexCount
-			<< ", Mesh Index Count: " << mesh.indexCount
-			<< ", Mesh Triangle Count: " << mesh.triangleCount
-			<< std::endl;
+		std::string blend = objData.value("blend", "opaque");
+		if      (blend == "opaque")   obj.material.blend = BlendMode::OPAQUE;
+		else if (blend == "additive") obj.material.blend = BlendMode::ADDITIVE;
+		else {
+			std::cerr << "Unknown blend '" << blend << "' in the object: '" << objName << "', using opaque\n";
+		}
+
+		if (objData.contains("color") && objData["color"].is_array() && objData["color"].size() == 3) {
+			const auto &color = objData["color"];
+			obj.material.color = Color(color[0], color[1], color[2]);
+		}
 
+		const Mesh &mesh = sceneMeshes[obj.mesh];
 
-		// Load the indices
-		const auto &indices = objData["indices"];
-		mesh.indices = new uint32_t[mesh.indexCount];
+		// Texture by name, it needs UVs
+		if (objData.contains("texture")) {
+			std::string textureName = objData.value("texture", "");
+			uint32_t j = 0;
+			while (j < sceneTextureCount && sceneTextures[j].name != textureName) j++;
 
-		for (uint32_t j=0; j<mesh.indexCount; j++) {
-			mesh.indices[j] = indices[j];
+			if (j == sceneTextureCount) {
+				std::cerr << "Unknown texture '" << textureName << "' in the object: '" << objName << "'\n";
+				return false;
+			}
+
+			if (mesh.hasUVs) obj.material.texture = j;
+			else std::cerr << "No UVs for the texture '" << textureName << "' in the object: '" << objName << "', ignoring it\n";
 		}
 
-		sceneTriangleCount += triangleCount;
-		std::cout << "  Loaded Object: '" << obj.name << "' successfully.\n";
+		sceneInstanceCount += obj.transforms.size();
+		sceneTriangleCount += mesh.triangleCount * obj.transforms.size();
+
+		std::cout << "  Loaded Object: '" << obj.name << "' successfully, " << obj.transforms.size() << " instance(s) of '" << mesh.name << "'.\n";
+	}
+
+	std::cout << "\nMeshes: " << sceneMeshCount << ", Instances: " << sceneInstanceCount << ", Triangles: " << sceneTriangleCount << "\n";
+
+	if (sceneNormals == nullptr) {
+		this->generateNormals();
+	}
+
+	// Lights, the scene gets one directional light if it has none
+	if (data.contains("lights") && data["lights"].is_array() && data["lights"].size() > 0) {
+		const auto &lights = data["lights"];
+
+		sceneLightCount = lights.size();
+		sceneLights = new Light[sceneLightCount];
+
+		for (uint32_t i=0; i<sceneLightCount; i++) {
+			if ( !readLight(lights[i], sceneLights[i]) ) {
+				return false;
+			}
+		}
+	}
+	else {
+		sceneLightCount = 1;
+		sceneLights = new Light[1];
+		sceneLights[0].direction = glm::normalize( Vec3(-1.f, -1.f, -1.f) );
 	}
 
+	std::cout << "Lights: " << sceneLightCount << "\n";
+
 	file.close();
 	std::cout << "\nScene loaded successfully.\n\n";
 	return true;
 
 }
 
+// Area weighted average of the face normals around each vertex
+void Scene::generateNormals() {
+	delete [] sceneNormals;
+	sceneNormals = new Vec3[sceneVertexCount];
+
+	for (uint32_t i=0; i<sceneVertexCount; i++) {
+		sceneNormals[i] = Vec3(0.f);
+	}
+
+	for (uint32_t i=0; i<sceneMeshCount; i++) {
+		Mesh &mesh = sceneMeshes[i];
+
+		for (uint32_t j=0; j<mesh.triangleCount*3; j+=3) {
+			uint32_t i1 = mesh.firstVertex + mesh.indices[j];
+			uint32_t i2 = mesh.firstVertex + mesh.indices[j+1];
+			uint32_t i3 = mesh.firstVertex + mesh.indices[j+2];
+
+			// Cross product length is twice the area
+			Vec3 n = glm::cross(sceneVerticies[i2] - sceneVerticies[i1], sceneVerticies[i3] - sceneVerticies[i1]);
+			sceneNormals[i1] += n;
+			sceneNormals[i2] += n;
+			sceneNormals[i3] += n;
+		}
+	}
+
+	for (uint32_t i=0; i<sceneVertexCount; i++) {
+		float len = glm::length(sceneNormals[i]);
+		sceneNormals[i] = (len > 0.f) ? sceneNormals[i]/len : Vec3(0.f, 0.f, 1.f);
+	}
+}
+
 void Scene::unload() {
 	delete [] sceneVerticies;
 	sceneVerticies = nullptr;
 	sceneVertexCount = 0;
 
+	delete [] sceneNormals;
+	sceneNormals = nullptr;
+
+	delete [] sceneUVs;
+	sceneUVs = nullptr;
+
 	sceneTriangleCount = 0;
 
 	delete [] sceneObjects;
 	sceneObjects = nullptr;
 	sceneObjectCount = 0;
+
+	delete [] sceneMeshes;
+	sceneMeshes = nullptr;
+	sceneMeshCount = 0;
+	sceneInstanceCount = 0;
+
+	delete [] sceneLights;
+	sceneLights = nullptr;
+	sceneLightCount = 0;
+
+	delete [] sceneTextures;
+	sceneTextures = nullptr;
+	sceneTextureCount = 0;
+	sceneTextureFiles.clear();
 }
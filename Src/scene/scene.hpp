@@ -3,21 +3,34 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <cstdint>
 
 #include "../math/vec.hpp"
 #include "object.hpp"
+#include "light.hpp"
+#include "../render/texture.hpp"
 
 class Scene {
 
 public:
 	// Scene Data
 	uint32_t sceneVertexCount;	// Vertex Count
-	uint32_t sceneTriangleCount;	// Triangle Count
+	uint32_t sceneTriangleCount;	// Triangle Count, of every instance
 	uint32_t sceneObjectCount;	// Object Count
+	uint32_t sceneMeshCount;	// Mesh Count
+	uint32_t sceneInstanceCount;	// Instance Count
+	uint32_t sceneLightCount;	// Light Count
+	uint32_t sceneTextureCount;	// Texture Count
 
 	Vec3 *sceneVerticies;    	// Raw Verticies
-	Object *sceneObjects;		// Objects in the scene
+	Vec3 *sceneNormals;			// Per vertex normals (optional, generated if missing)
+	Vec2 *sceneUVs;				// Per vertex UVs (optional)
+	Mesh *sceneMeshes;			// Mesh library, every mesh is stored once
+	Object *sceneObjects;		// Objects in the scene, instances of the meshes
+	Light *sceneLights;			// Lights in the scene
+	Texture *sceneTextures;		// Textures of the materials, only named
+	std::vector<std::string> sceneTextureFiles;	// Of every texture, not loaded by loadJSONScene()
 
 	std::string name;			// Scene Name
 
@@ -28,5 +41,6 @@ public:
 // Methods
 public:
 	bool loadJSONScene(const char *filename);
+	void generateNormals();
 	void unload();
 };
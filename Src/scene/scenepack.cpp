@@ -0,0 +1,417 @@
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#include "scenepack.hpp"
+
+#include "nlohmann_json/json.hpp" // downloaded from https://github.com/nlohmann/json
+using json = nlohmann::json;
+
+
+static const char PACK_MAGIC[4] = {'Q', 'Z', 'S', 'P'};
+
+
+// 64 bit offsets, chunks of large scenes go past 2 GB
+static bool seekTo(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+	return _fseeki64(file, (long long) offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t alignUp(uint64_t offset) {
+	return (offset + PACK_ALIGN - 1)/PACK_ALIGN*PACK_ALIGN;
+}
+
+static uint64_t chunkBytes(uint32_t vertexCount, uint32_t indexCount) {
+	return (uint64_t) vertexCount*(2*sizeof(Vec3) + sizeof(Vec2)) + (uint64_t) indexCount*sizeof(uint32_t);
+}
+
+// Bounds of the box `min`, `max` through `m`
+static void transformBounds(const glm::mat4 &m, const Vec3 &min, const Vec3 &max, Vec3 &outMin, Vec3 &outMax) {
+	outMin = Vec3(INFINITY);
+	outMax = Vec3(-INFINITY);
+
+	for (int c=0; c<8; c++) {
+		Vec3 corner((c & 1) ? max.x : min.x, (c & 2) ? max.y : min.y, (c & 4) ? max.z : min.z);
+		corner = Vec3( m * Vec4(corner, 1.f) );
+		outMin = glm::min(outMin, corner);
+		outMax = glm::max(outMax, corner);
+	}
+}
+
+// 10 bits of each axis interleaved, `p` within [0, 1]
+static uint32_t mortonCode(const Vec3 &p) {
+	auto spread = [](uint32_t v) {
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	};
+
+	Vec3 q = glm::clamp(p, 0.f, 1.f)*1023.f;
+	return (spread((uint32_t) q.x) << 2) | (spread((uint32_t) q.y) << 1) | spread((uint32_t) q.z);
+}
+
+
+// Constructors and Destructors
+ScenePack::ScenePack() {
+	dataBytes = 0;
+	_file = nullptr;
+}
+
+ScenePack::~ScenePack() {
+	this->close();
+}
+
+
+// Methods
+bool ScenePack::open(const std::string &filename) {
+	this->close();
+
+	_file = fopen(filename.c_str(), "rb");
+	if (_file == nullptr) {
+		std::cerr << "Failed to open packed scene: " << filename << std::endl;
+		return false;
+	}
+
+	Header header;
+	if (fread(&header, sizeof(header), 1, _file) != 1 || std::memcmp(header.magic, PACK_MAGIC, 4) != 0) {
+		std::cerr << "Not a packed scene: " << filename << std::endl;
+		this->close();
+		return false;
+	}
+
+	if (header.version != PACK_VERSION) {
+		std::cerr << "Packed scene version " << header.version << " in " << filename << ", expected " << PACK_VERSION << ", pack it again" << std::endl;
+		this->close();
+		return false;
+	}
+
+	std::string text(header.indexBytes, '\0');
+	chunks.resize(header.chunkCount);
+	parts.resize(header.partCount);
+	instances.resize(header.instanceCount);
+	materials.resize(header.objectCount);
+	lights.resize(header.lightCount);
+
+	auto readTable = [&](auto &table) {
+		return table.empty() || fread(table.data(), sizeof(table[0]), table.size(), _file) == table.size();
+	};
+
+	bool ok = (text.empty() || fread(text.data(), 1, text.size(), _file) == text.size())
+		&& readTable(chunks) && readTable(parts) && readTable(instances) && readTable(materials) && readTable(lights);
+
+	json index = ok ? json::parse(text, nullptr, false) : json();
+	if ( !ok || index.is_discarded() || !index.is_object() ) {
+		std::cerr << "Truncated packed scene: " << filename << std::endl;
+		this->close();
+		return false;
+	}
+
+	path = filename;
+	name = index.value("name", "default");
+	objectNames = index.value("objects", std::vector<std::string>());
+	objectNames.resize(materials.size());
+
+	// Texture files are relative to the packed file, like those of a scene file
+	std::string dir = std::filesystem::path(filename).parent_path().string();
+	if ( !dir.empty() ) dir += "/";
+
+	textureNames.clear();
+	textureFiles.clear();
+	for (const json &texture : index.value("textures", json::array())) {
+		textureNames.push_back(texture.value("name", ""));
+		textureFiles.push_back(dir + texture.value("file", ""));
+	}
+
+	// Indices into the tables, the rest is trusted like the scene files
+	dataBytes = 0;
+	for (const PackChunk &chunk : chunks) {
+		ok = ok && chunk.vertexCount <= CHUNK_VERTICES && chunk.indexCount <= CHUNK_INDICES;
+		dataBytes += chunkBytes(chunk.vertexCount, chunk.indexCount);
+	}
+	for (const PackPart &part : parts) {
+		ok = ok && part.chunk < chunks.size()
+			&& part.firstVertex + part.vertexCount <= chunks[part.chunk].vertexCount
+			&& part.firstIndex + 3*part.triangleCount <= chunks[part.chunk].indexCount;
+	}
+	for (const PackInstance &inst : instances) {
+		ok = ok && inst.part < parts.size() && inst.object < materials.size();
+	}
+	for (Material &material : materials) {
+		if (material.texture >= (int) textureFiles.size()) material.texture = -1;
+	}
+
+	if ( !ok ) {
+		std::cerr << "Invalid tables in the packed scene: " << filename << std::endl;
+		this->close();
+		return false;
+	}
+
+	std::cout << "Packed scene: " << filename << ", " << instances.size() << " instances of " << parts.size() << " parts in "
+		<< chunks.size() << " chunks (" << dataBytes/1024/1024.f << " MB on disk)" << std::endl;
+	return true;
+}
+
+void ScenePack::close() {
+	if (_file) fclose(_file);
+	_file = nullptr;
+}
+
+bool ScenePack::readChunk(uint32_t i, Vec3 *verticies, Vec3 *normals, Vec2 *uvs, uint32_t *indices) {
+	const PackChunk &chunk = chunks[i];
+
+	return _file && seekTo(_file, chunk.offset)
+		&& fread(verticies, sizeof(Vec3), chunk.vertexCount, _file) == chunk.vertexCount
+		&& fread(normals, sizeof(Vec3), chunk.vertexCount, _file) == chunk.vertexCount
+		&& fread(uvs, sizeof(Vec2), chunk.vertexCount, _file) == chunk.vertexCount
+		&& fread(indices, sizeof(uint32_t), chunk.indexCount, _file) == chunk.indexCount;
+}
+
+bool ScenePack::write(const Scene &scene, const std::string &filename) {
+	// Scene verticies and part local indices of every part
+	struct Part {
+		std::vector<uint32_t> verticies;
+		std::vector<uint32_t> indices;
+		Vec3 min, max;
+		uint32_t key;
+	};
+
+	std::vector<Part> parts;
+	std::vector< std::vector<uint32_t> > meshParts(scene.sceneMeshCount);
+
+	// Triangles in index order, a part closes when the next one would not fit in a chunk
+	for (uint32_t m=0; m<scene.sceneMeshCount; m++) {
+		const Mesh &mesh = scene.sceneMeshes[m];
+		std::vector<int> local(mesh.vertexCount, -1);
+		Part part;
+
+		auto closePart = [&]() {
+			if (part.indices.empty()) return;
+
+			part.min = Vec3(INFINITY);
+			part.max = Vec3(-INFINITY);
+			for (uint32_t v : part.verticies) {
+				part.min = glm::min(part.min, scene.sceneVerticies[v]);
+				part.max = glm::max(part.max, scene.sceneVerticies[v]);
+				local[v - mesh.firstVertex] = -1;
+			}
+
+			meshParts[m].push_back( (uint32_t) parts.size() );
+			parts.push_back( std::move(part) );
+			part = Part();
+		};
+
+		for (uint32_t j=0; j<mesh.indexCount; j+=3) {
+			int added = 0;
+			for (int k=0; k<3; k++) {
+				added += (local[ mesh.indices[j+k] ] < 0);
+			}
+			if (part.verticies.size() + added > CHUNK_VERTICES || part.indices.size() + 3 > CHUNK_INDICES) closePart();
+
+			for (int k=0; k<3; k++) {
+				int &v = local[ mesh.indices[j+k] ];
+				if (v < 0) {
+					v = (int) part.verticies.size();
+					part.verticies.push_back(mesh.firstVertex + mesh.indices[j+k]);
+				}
+				part.indices.push_back( (uint32_t) v );
+			}
+		}
+		closePart();
+	}
+
+	// Every instance of a mesh is an instance of each of its parts
+	std::vector<PackInstance> instances;
+	std::vector<Vec3> instanceMin, instanceMax;
+	std::vector<int> firstInstance(parts.size(), -1);
+
+	for (uint32_t o=0; o<scene.sceneObjectCount; o++) {
+		const Object &obj = scene.sceneObjects[o];
+
+		for (const glm::mat4 &transform : obj.transforms) {
+			for (uint32_t p : meshParts[obj.mesh]) {
+				PackInstance inst = {};
+				inst.transform = transform;
+				inst.part = p;
+				inst.object = o;
+
+				Vec3 min, max;
+				transformBounds(transform, parts[p].min, parts[p].max, min, max);
+				if (firstInstance[p] < 0) firstInstance[p] = (int) instances.size();
+
+				instances.push_back(inst);
+				instanceMin.push_back(min);
+				instanceMax.push_back(max);
+			}
+		}
+	}
+
+	// Parts ordered along a Morton curve of their first instance, then cut into chunks
+	Vec3 sceneMin(INFINITY), sceneMax(-INFINITY);
+	std::vector<Vec3> centers(parts.size());
+
+	for (size_t p=0; p<parts.size(); p++) {
+		int i = firstInstance[p];
+		centers[p] = (i < 0) ? (parts[p].min + parts[p].max)/2.f : (instanceMin[i] + instanceMax[i])/2.f;
+		sceneMin = glm::min(sceneMin, centers[p]);
+		sceneMax = glm::max(sceneMax, centers[p]);
+	}
+
+	Vec3 extent = glm::max(sceneMax - sceneMin, Vec3(1E-6F));
+	for (size_t p=0; p<parts.size(); p++) {
+		parts[p].key = mortonCode( (centers[p] - sceneMin)/extent );
+	}
+
+	std::vector<uint32_t> order(parts.size());
+	for (size_t p=0; p<order.size(); p++) order[p] = (uint32_t) p;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return parts[a].key < parts[b].key; });
+
+	std::vector<PackChunk> chunks;
+	std::vector<PackPart> packParts(parts.size());
+	std::vector<uint32_t> remap(parts.size());
+
+	for (size_t k=0; k<order.size(); k++) {
+		const Part &part = parts[ order[k] ];
+		uint32_t vc = (uint32_t) part.verticies.size(), ic = (uint32_t) part.indices.size();
+
+		if (chunks.empty() || chunks.back().vertexCount + vc > CHUNK_VERTICES || chunks.back().indexCount + ic > CHUNK_INDICES) {
+			PackChunk chunk = {};
+			chunk.min = Vec3(INFINITY);
+			chunk.max = Vec3(-INFINITY);
+			chunks.push_back(chunk);
+		}
+
+		PackChunk &chunk = chunks.back();
+		PackPart &packed = packParts[k];
+		packed = {};
+		packed.chunk = (uint32_t) chunks.size() - 1;
+		packed.firstVertex = chunk.vertexCount;
+		packed.vertexCount = vc;
+		packed.firstIndex = chunk.indexCount;
+		packed.triangleCount = ic/3;
+		packed.min = part.min;
+		packed.max = part.max;
+
+		chunk.vertexCount += vc;
+		chunk.indexCount += ic;
+		remap[ order[k] ] = (uint32_t) k;
+	}
+
+	for (size_t i=0; i<instances.size(); i++) {
+		PackInstance &inst = instances[i];
+		PackChunk &chunk = chunks[ packParts[ remap[inst.part] ].chunk ];
+
+		inst.part = remap[inst.part];
+		chunk.min = glm::min(chunk.min, instanceMin[i]);
+		chunk.max = glm::max(chunk.max, instanceMax[i]);
+	}
+
+	// Index, texture files relative to the packed file
+	std::filesystem::path dir = std::filesystem::absolute(filename).parent_path();
+	json index = { {"name", scene.name}, {"objects", json::array()}, {"textures", json::array()} };
+
+	for (uint32_t o=0; o<scene.sceneObjectCount; o++) {
+		index["objects"].push_back(scene.sceneObjects[o].name);
+	}
+	for (uint32_t t=0; t<scene.sceneTextureCount; t++) {
+		std::error_code error;
+		std::filesystem::path file = std::filesystem::proximate(scene.sceneTextureFiles[t], dir, error);
+		index["textures"].push_back({ {"name", scene.sceneTextures[t].name}, {"file", error ? scene.sceneTextureFiles[t] : file.generic_string()} });
+	}
+	std::string text = index.dump();
+
+	std::vector<Material> materials(scene.sceneObjectCount);
+	for (uint32_t o=0; o<scene.sceneObjectCount; o++) {
+		materials[o] = scene.sceneObjects[o].material;
+	}
+
+	Header header = {};
+	std::memcpy(header.magic, PACK_MAGIC, 4);
+	header.version = PACK_VERSION;
+	header.indexBytes = (uint32_t) text.size();
+	header.chunkCount = (uint32_t) chunks.size();
+	header.partCount = (uint32_t) packParts.size();
+	header.instanceCount = (uint32_t) instances.size();
+	header.objectCount = scene.sceneObjectCount;
+	header.lightCount = scene.sceneLightCount;
+
+	// Chunk data after the tables, every chunk on a page boundary
+	uint64_t offset = sizeof(header) + text.size() + chunks.size()*sizeof(PackChunk) + packParts.size()*sizeof(PackPart)
+		+ instances.size()*sizeof(PackInstance) + materials.size()*sizeof(Material) + scene.sceneLightCount*sizeof(Light);
+	uint64_t dataBytes = 0;
+
+	for (PackChunk &chunk : chunks) {
+		chunk.offset = offset = alignUp(offset);
+		offset += chunkBytes(chunk.vertexCount, chunk.indexCount);
+		dataBytes += chunkBytes(chunk.vertexCount, chunk.indexCount);
+	}
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (file == nullptr) {
+		std::cerr << "Failed to open " << filename << std::endl;
+		return false;
+	}
+
+	auto writeBytes = [&](const void *data, size_t size) {
+		return size == 0 || fwrite(data, 1, size, file) == size;
+	};
+
+	bool ok = writeBytes(&header, sizeof(header)) && writeBytes(text.data(), text.size())
+		&& writeBytes(chunks.data(), chunks.size()*sizeof(PackChunk))
+		&& writeBytes(packParts.data(), packParts.size()*sizeof(PackPart))
+		&& writeBytes(instances.data(), instances.size()*sizeof(PackInstance))
+		&& writeBytes(materials.data(), materials.size()*sizeof(Material))
+		&& writeBytes(scene.sceneLights, scene.sceneLightCount*sizeof(Light));
+
+	// Chunk data, verticies then normals, UVs and indices of every part in turn
+	std::vector<uint8_t> padding(PACK_ALIGN, 0);
+	std::vector<Vec3> verticies, normals;
+	std::vector<Vec2> uvs;
+	std::vector<uint32_t> indices;
+	uint64_t written = ftell(file);
+
+	for (size_t c=0, k=0; ok && c<chunks.size(); c++) {
+		verticies.clear();
+		normals.clear();
+		uvs.clear();
+		indices.clear();
+
+		for (; k<order.size() && packParts[k].chunk == c; k++) {
+			const Part &part = parts[ order[k] ];
+
+			for (uint32_t v : part.verticies) {
+				verticies.push_back(scene.sceneVerticies[v]);
+				normals.push_back(scene.sceneNormals[v]);
+				uvs.push_back(scene.sceneUVs ? scene.sceneUVs[v] : Vec2(0.f));
+			}
+			indices.insert(indices.end(), part.indices.begin(), part.indices.end());
+		}
+
+		ok = writeBytes(padding.data(), chunks[c].offset - written)
+			&& writeBytes(verticies.data(), verticies.size()*sizeof(Vec3))
+			&& writeBytes(normals.data(), normals.size()*sizeof(Vec3))
+			&& writeBytes(uvs.data(), uvs.size()*sizeof(Vec2))
+			&& writeBytes(indices.data(), indices.size()*sizeof(uint32_t));
+		written = chunks[c].offset + chunkBytes(chunks[c].vertexCount, chunks[c].indexCount);
+	}
+
+	fclose(file);
+
+	if ( !ok ) {
+		std::cerr << "Failed to write " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Packed " << scene.sceneMeshCount << " meshes into " << parts.size() << " parts, " << instances.size() << " instances, "
+		<< chunks.size() << " chunks (" << dataBytes/1024.f/1024.f << " MB) to " << filename << std::endl;
+	return true;
+}
+
+bool ScenePack::isPack(const std::string &filename) {
+	return std::filesystem::path(filename).extension() == ".qzs";
+}
@@ -0,0 +1,107 @@
+// Chunked on-disk layout of a scene, the engine streams its geometry in while it renders
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include "../math/vec.hpp"
+#include "scene.hpp"
+#include "material.hpp"
+#include "light.hpp"
+
+
+#define PACK_VERSION 1
+#define PACK_ALIGN 4096			// Chunks start on page boundaries
+#define CHUNK_VERTICES 16384	// At most per chunk, larger meshes are split into parts
+#define CHUNK_INDICES 49152
+
+
+// Verticies and indices of one or more parts, read in one piece
+struct PackChunk {
+	uint64_t offset;			// In the file: verticies, normals, UVs, then indices
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	Vec3 min;					// Bounds of the instances of its parts (scene model space)
+	Vec3 max;
+};
+
+// A mesh, or a piece of one, drawn like a mesh of its own
+struct PackPart {
+	uint32_t chunk;
+	uint32_t firstVertex;		// Within the chunk
+	uint32_t vertexCount;
+	uint32_t firstIndex;		// Within the chunk, relative to `firstVertex`
+	uint32_t triangleCount;
+	Vec3 min;					// Bounds (model space)
+	Vec3 max;
+};
+
+struct PackInstance {
+	glm::mat4 transform;
+	uint32_t part;
+	uint32_t object;			// Gives the material
+};
+
+
+/*
+	header | JSON index | chunks, parts, instances, materials, lights | chunk data
+
+The JSON index holds the names (scene, objects, textures) and the texture files relative to
+the packed file. The tables are the structs above as they are in memory (little endian,
+like the rest of the binary formats here). Parts are sorted along a Morton curve of their
+bounds and cut into chunks in that order, so a chunk holds geometry that is close together
+*/
+class ScenePack {
+	// Constructors / Destructors
+	public:
+		ScenePack();
+		~ScenePack();
+
+	private:
+		struct Header {
+			char magic[4];		// "QZSP"
+			uint32_t version;
+			uint32_t indexBytes;
+			uint32_t chunkCount;
+			uint32_t partCount;
+			uint32_t instanceCount;
+			uint32_t objectCount;
+			uint32_t lightCount;
+		};
+
+	// Attributes
+	public:
+		std::string path;
+		std::string name;
+		std::vector<std::string> objectNames;
+		std::vector<std::string> textureNames;
+		std::vector<std::string> textureFiles;	// Relative to the working directory, like Scene::sceneTextureFiles
+
+		std::vector<PackChunk> chunks;
+		std::vector<PackPart> parts;
+		std::vector<PackInstance> instances;
+		std::vector<Material> materials;		// One per object
+		std::vector<Light> lights;
+
+		size_t dataBytes;						// Of every chunk
+
+	private:
+		FILE *_file;
+
+	// Methods
+	public:
+		// Everything but the chunk data, kept open for readChunk()
+		bool open(const std::string &filename);
+		void close();
+
+		// Chunk `i` into buffers of at least its counts, from any thread but one at a time
+		bool readChunk(uint32_t i, Vec3 *verticies, Vec3 *normals, Vec2 *uvs, uint32_t *indices);
+
+		// Splits the meshes of a loaded scene into parts and writes them in chunks
+		static bool write(const Scene &scene, const std::string &filename);
+
+		static bool isPack(const std::string &filename);
+};
@@ -0,0 +1,85 @@
+// Thread safe FIFO used to hand work between pipeline stages
+
+#pragma once
+
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <cstddef>
+#include <condition_variable>
+
+
+template <typename T>
+class BlockingQueue {
+
+	private:
+		std::deque<T> _items;
+		std::mutex _mutex;
+		std::condition_variable _notEmpty;
+		std::condition_variable _notFull;
+
+		size_t _capacity;	// 0 means unbounded
+		bool _closed;
+
+	public:
+		BlockingQueue(size_t capacity = 0) : _capacity(capacity), _closed(false) {}
+
+		// Blocks while the queue is full, returns false if the queue was closed
+		bool push(T item) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_notFull.wait(lock, [this] { return _closed || _capacity == 0 || _items.size() < _capacity; });
+
+			if (_closed) return false;
+
+			_items.push_back(std::move(item));
+			_notEmpty.notify_one();
+			return true;
+		}
+
+		// Blocks until an item is available, returns false once the queue is closed
+		bool pop(T &item) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_notEmpty.wait(lock, [this] { return _closed || !_items.empty(); });
+
+			if (_closed) return false;
+
+			item = std::move(_items.front());
+			_items.pop_front();
+			_notFull.notify_one();
+			return true;
+		}
+
+		// Same as pop() but gives up after `timeout`
+		template <typename Rep, typename Period>
+		bool popFor(T &item, const std::chrono::duration<Rep, Period> &timeout) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			if ( !_notEmpty.wait_for(lock, timeout, [this] { return _closed || !_items.empty(); }) ) {
+				return false;
+			}
+
+			if (_closed) return false;
+
+			item = std::move(_items.front());
+			_items.pop_front();
+			_notFull.notify_one();
+			return true;
+		}
+
+		// Wakes up every waiting thread, further push/pop calls fail
+		void close() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_closed = true;
+			_notEmpty.notify_all();
+			_notFull.notify_all();
+		}
+
+		bool closed() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _closed;
+		}
+
+		size_t size() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _items.size();
+		}
+};
@@ -23,3 +23,17 @@ Vec3 randVec3onSphere(Vec3 normal) {
 	}
 	return v;
 }
+
+
+float halton(int index, int base) {
+	float f = 1.f;
+	float r = 0.f;
+
+	while (index > 0) {
+		f /= base;
+		r += f * (index % base);
+		index /= base;
+	}
+
+	return r;
+}
@@ -81,3 +81,6 @@ const Color COLOR_PURPLE(1.f, 0.f, 1.f);
 // Functions
 uint32_t pcg32_random_r();
 Vec3 randVec3onSphere(Vec3 normal);
+
+// Low discrepancy sequence in [0, 1), index >= 1
+float halton(int index, int base);
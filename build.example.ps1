@@ -15,7 +15,7 @@ $C_FLAGS = "-Wall", "-Wextra", "-pedantic", "-std=c++20", "-masm=intel", "-Wsign
 $Optimization_flags = "-O3", "-mavx512f", "-march=native", "-s"
 # $Optimization_flags = "-ggdb", "-g3"
 
-$LINKER_FLAGS = "-lSDL3"
+$LINKER_FLAGS = "-lSDL3 -lws2_32"
 
 
 $buildAll = $true